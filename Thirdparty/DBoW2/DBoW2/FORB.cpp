@@ -13,6 +13,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
 #include <stdint-gcc.h>
 
 #include "FORB.h"
@@ -81,20 +82,21 @@ void FORB::meanValue(const std::vector<FORB::pDescriptor> &descriptors,
 int FORB::distance(const FORB::TDescriptor &a,
   const FORB::TDescriptor &b)
 {
-  // Bit set count operation from
+  // Hardware population count over the four 64-bit words of the descriptor,
+  // same result as the parallel bit count of
   // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
 
-  const int *pa = a.ptr<int32_t>();
-  const int *pb = b.ptr<int32_t>();
+  const unsigned char *pa = a.ptr<unsigned char>();
+  const unsigned char *pb = b.ptr<unsigned char>();
 
   int dist=0;
 
-  for(int i=0; i<8; i++, pa++, pb++)
+  for(int i=0; i<4; i++)
   {
-      unsigned  int v = *pa ^ *pb;
-      v = v - ((v >> 1) & 0x55555555);
-      v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-      dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+      uint64_t va, vb;
+      memcpy(&va, pa + 8*i, sizeof(va));
+      memcpy(&vb, pb + 8*i, sizeof(vb));
+      dist += __builtin_popcountll(va ^ vb);
   }
 
   return dist;
@@ -66,27 +66,32 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
   bool toNotFixed = !(to->fixed());
 
   if (fromNotFixed || toNotFixed) {
-#ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-    to->lockQuadraticForm();
-#endif
+    // edges may be accumulated concurrently, each vertex is locked only while its own blocks are
+    // updated, so that no edge ever holds two locks
+    OptimizableGraph::Vertex* blockOwner = OptimizableGraph::Vertex::offDiagonalLockOwner(from, to);
     const InformationType& omega = _information;
     Matrix<double, D, 1> omega_r = - omega * _error;
     if (this->robustKernel() == 0) {
       if (fromNotFixed) {
         Matrix<double, VertexXiType::Dimension, D> AtO = A.transpose() * omega;
+        from->lockQuadraticForm();
         from->b().noalias() += A.transpose() * omega_r;
         from->A().noalias() += AtO*A;
+        from->unlockQuadraticForm();
         if (toNotFixed ) {
+          blockOwner->lockQuadraticForm();
           if (_hessianRowMajor) // we have to write to the block as transposed
             _hessianTransposed.noalias() += B.transpose() * AtO.transpose();
           else
             _hessian.noalias() += AtO * B;
+          blockOwner->unlockQuadraticForm();
         }
       } 
       if (toNotFixed) {
+        to->lockQuadraticForm();
         to->b().noalias() += B.transpose() * omega_r;
         to->A().noalias() += B.transpose() * omega * B;
+        to->unlockQuadraticForm();
       }
     } else { // robust (weighted) error according to some kernel
       double error = this->chi2();
@@ -98,24 +103,26 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
 
       omega_r *= rho[1];
       if (fromNotFixed) {
+        from->lockQuadraticForm();
         from->b().noalias() += A.transpose() * omega_r;
         from->A().noalias() += A.transpose() * weightedOmega * A;
+        from->unlockQuadraticForm();
         if (toNotFixed ) {
+          blockOwner->lockQuadraticForm();
           if (_hessianRowMajor) // we have to write to the block as transposed
             _hessianTransposed.noalias() += B.transpose() * weightedOmega * A;
           else
             _hessian.noalias() += A.transpose() * weightedOmega * B;
+          blockOwner->unlockQuadraticForm();
         }
       } 
       if (toNotFixed) {
+        to->lockQuadraticForm();
         to->b().noalias() += B.transpose() * omega_r;
         to->A().noalias() += B.transpose() * weightedOmega * B;
+        to->unlockQuadraticForm();
       }
     }
-#ifdef G2O_OPENMP
-    to->unlockQuadraticForm();
-    from->unlockQuadraticForm();
-#endif
   }
 }
 
@@ -183,39 +183,32 @@ void BaseMultiEdge<D, E>::computeQuadraticForm(const InformationType& omega, con
       Eigen::Map<MatrixXd> fromMap(from->hessianData(), fromDim, fromDim);
       Eigen::Map<VectorXd> fromB(from->bData(), fromDim);
 
-      // ii block in the hessian
-#ifdef G2O_OPENMP
+      // ii block in the hessian. Edges may be accumulated concurrently, each vertex is locked
+      // only while its own blocks are updated, so that no edge ever holds two locks
       from->lockQuadraticForm();
-#endif
       fromMap.noalias() += AtO * A;
       fromB.noalias() += A.transpose() * weightedError;
+      from->unlockQuadraticForm();
 
       // compute the off-diagonal blocks ij for all j
       for (size_t j = i+1; j < _vertices.size(); ++j) {
         OptimizableGraph::Vertex* to = static_cast<OptimizableGraph::Vertex*>(_vertices[j]);
-#ifdef G2O_OPENMP
-        to->lockQuadraticForm();
-#endif
         bool jstatus = !(to->fixed());
         if (jstatus) {
           const MatrixXd& B = _jacobianOplus[j];
           int idx = internal::computeUpperTriangleIndex(i, j);
           assert(idx < (int)_hessian.size());
           HessianHelper& hhelper = _hessian[idx];
+          OptimizableGraph::Vertex* blockOwner = OptimizableGraph::Vertex::offDiagonalLockOwner(from, to);
+          blockOwner->lockQuadraticForm();
           if (hhelper.transposed) { // we have to write to the block as transposed
             hhelper.matrix.noalias() += B.transpose() * AtO.transpose();
           } else {
             hhelper.matrix.noalias() += AtO * B;
           }
+          blockOwner->unlockQuadraticForm();
         }
-#ifdef G2O_OPENMP
-        to->unlockQuadraticForm();
-#endif
       }
-
-#ifdef G2O_OPENMP
-      from->unlockQuadraticForm();
-#endif
     }
 
   }
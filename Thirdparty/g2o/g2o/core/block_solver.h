@@ -31,7 +31,7 @@
 #include "linear_solver.h"
 #include "sparse_block_matrix.h"
 #include "sparse_block_matrix_diagonal.h"
-#include "openmp_mutex.h"
+#include "optimizable_graph.h"
 #include "../../config.h"
 
 namespace g2o {
@@ -147,6 +147,9 @@ namespace g2o {
 
       void deallocate();
 
+      //! adds the linearization of e to the system, with its Jacobians in jacobianWorkspace
+      void linearizeEdge(OptimizableGraph::Edge* e, JacobianWorkspace& jacobianWorkspace);
+
       SparseBlockMatrix<PoseMatrixType>* _Hpp;
       SparseBlockMatrix<LandmarkMatrixType>* _Hll;
       SparseBlockMatrix<PoseLandmarkMatrixType>* _Hpl;
@@ -155,6 +158,7 @@ namespace g2o {
       SparseBlockMatrixDiagonal<LandmarkMatrixType>* _DInvSchur;
 
       SparseBlockMatrixCCS<PoseLandmarkMatrixType>* _HplCCS;
+      SparseBlockMatrixCCS<PoseLandmarkMatrixType>* _HplTransposedCCS; ///< the blocks of _Hpl by pose
       SparseBlockMatrixCCS<PoseMatrixType>* _HschurTransposedCCS;
 
       LinearSolver<PoseMatrixType>* _linearSolver;
@@ -162,9 +166,6 @@ namespace g2o {
       std::vector<PoseVectorType, Eigen::aligned_allocator<PoseVectorType> > _diagonalBackupPose;
       std::vector<LandmarkVectorType, Eigen::aligned_allocator<LandmarkVectorType> > _diagonalBackupLandmark;
 
-#    ifdef G2O_OPENMP
-      std::vector<OpenMPMutex> _coefficientsMutex;
-#    endif
 
       bool _doSchur;
 
@@ -48,6 +48,7 @@ BlockSolver<Traits>::BlockSolver(LinearSolverType* linearSolver) :
   _Hll=0;
   _Hpl=0;
   _HplCCS = 0;
+  _HplTransposedCCS = 0;
   _HschurTransposedCCS = 0;
   _Hschur=0;
   _DInvSchur=0;
@@ -84,10 +85,8 @@ void BlockSolver<Traits>::resize(int* blockPoseIndices, int numPoseBlocks,
     _DInvSchur = new SparseBlockMatrixDiagonal<LandmarkMatrixType>(_Hll->colBlockIndices());
     _Hpl=new PoseLandmarkHessianType(blockPoseIndices, blockLandmarkIndices, numPoseBlocks, numLandmarkBlocks);
     _HplCCS = new SparseBlockMatrixCCS<PoseLandmarkMatrixType>(_Hpl->rowBlockIndices(), _Hpl->colBlockIndices());
+    _HplTransposedCCS = new SparseBlockMatrixCCS<PoseLandmarkMatrixType>(_Hpl->colBlockIndices(), _Hpl->rowBlockIndices());
     _HschurTransposedCCS = new SparseBlockMatrixCCS<PoseMatrixType>(_Hschur->colBlockIndices(), _Hschur->rowBlockIndices());
-#ifdef G2O_OPENMP
-    _coefficientsMutex.resize(numPoseBlocks);
-#endif
   }
 }
 
@@ -126,6 +125,10 @@ void BlockSolver<Traits>::deallocate()
     delete _HplCCS;
     _HplCCS = 0;
   }
+  if (_HplTransposedCCS) {
+    delete _HplTransposedCCS;
+    _HplTransposedCCS = 0;
+  }
   if (_HschurTransposedCCS) {
     delete _HschurTransposedCCS;
     _HschurTransposedCCS = 0;
@@ -258,6 +261,7 @@ bool BlockSolver<Traits>::buildStructure(bool zeroBlocks)
 
   _DInvSchur->diagonal().resize(landmarkIdx);
   _Hpl->fillSparseBlockMatrixCCS(*_HplCCS);
+  _Hpl->fillSparseBlockMatrixCCSTransposed(*_HplTransposedCCS);
 
   for (size_t i = 0; i < _optimizer->indexMapping().size(); ++i) {
     OptimizableGraph::Vertex* v = _optimizer->indexMapping()[i];
@@ -373,63 +377,73 @@ bool BlockSolver<Traits>::solve(){
   _Hschur->clear();
   _Hpp->add(_Hschur);
 
-  //_DInvSchur->clear();
-  memset (_coefficients, 0, _sizePoses*sizeof(double));
-# ifdef G2O_OPENMP
-# pragma omp parallel for default (shared) schedule(dynamic, 10)
-# endif
-  for (int landmarkIndex = 0; landmarkIndex < static_cast<int>(_Hll->blockCols().size()); ++landmarkIndex) {
-    const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
-    assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
-
-    // calculate inverse block for the landmark
-    const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
-    assert (D && D->rows()==D->cols() && "Error in landmark matrix");
-    LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
-    Dinv = D->inverse();
-
-    LandmarkVectorType  db(D->rows());
-    for (int j=0; j<D->rows(); ++j) {
-      db[j]=_b[_Hll->rowBaseOfBlock(landmarkIndex) + _sizePoses + j];
+  // The elimination runs in blocks that may be concurrent (see SparseOptimizer::setParallelFor),
+  // split such that no two blocks write the same memory, hence without locks. Every block of the
+  // reduced system still sums its terms in increasing landmark order.
+
+  // invert the landmark blocks and keep Dinv * b of each landmark in the landmark part of
+  // _coefficients, unused until the back-substitution
+  const int numLandmarks = static_cast<int>(_Hll->blockCols().size());
+  double* dbl = _coefficients + _sizePoses;
+  _optimizer->forEachBlock(numLandmarks, [&](int begin, int end) {
+    for (int landmarkIndex = begin; landmarkIndex < end; ++landmarkIndex) {
+      const typename SparseBlockMatrix<LandmarkMatrixType>::IntBlockMap& marginalizeColumn = _Hll->blockCols()[landmarkIndex];
+      assert(marginalizeColumn.size() == 1 && "more than one block in _Hll column");
+
+      // calculate inverse block for the landmark
+      const LandmarkMatrixType * D = marginalizeColumn.begin()->second;
+      assert (D && D->rows()==D->cols() && "Error in landmark matrix");
+      LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      Dinv = D->inverse();
+
+      const int landmarkBase = _Hll->rowBaseOfBlock(landmarkIndex);
+      typename LandmarkVectorType::ConstMapType bl(_b + _sizePoses + landmarkBase, D->rows());
+      typename LandmarkVectorType::MapType db(dbl + landmarkBase, D->rows());
+      db.noalias() = Dinv * bl;
     }
-    db=Dinv*db;
-
-    assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
-    const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
-
-    for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_outer = landmarkColumn.begin();
-        it_outer != landmarkColumn.end(); ++it_outer) {
-      int i1 = it_outer->row;
-
-      const PoseLandmarkMatrixType* Bi = it_outer->block;
-      assert(Bi);
-
-      PoseLandmarkMatrixType BDinv = (*Bi)*(Dinv);
-      assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
-      typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
-#    ifdef G2O_OPENMP
-      ScopedOpenMPMutex mutexLock(&_coefficientsMutex[i1]);
-#    endif
-      Bb.noalias() += (*Bi)*db;
-
-      assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
-      typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
-
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
-      typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
-      for (; it_inner != landmarkColumn.end(); ++it_inner) {
-        int i2 = it_inner->row;
-        const PoseLandmarkMatrixType* Bj = it_inner->block;
-        assert(Bj); 
-        while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
-          ++targetColumnIt;
-        assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
-        PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
-        assert(Hi1i2);
-        (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+  });
+
+  // eliminate the landmarks, each pose row of _Hschur and of the coefficients built by one task
+  // from the landmarks the pose observes
+  memset (_coefficients, 0, _sizePoses*sizeof(double));
+  const int numPoses = static_cast<int>(_HplTransposedCCS->blockCols().size());
+  _optimizer->forEachBlock(numPoses, [&](int begin, int end) {
+    for (int i1 = begin; i1 < end; ++i1) {
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& poseRow = _HplTransposedCCS->blockCols()[i1];
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_row = poseRow.begin();
+          it_row != poseRow.end(); ++it_row) {
+        int landmarkIndex = it_row->row;
+
+        const PoseLandmarkMatrixType* Bi = it_row->block;
+        assert(Bi);
+
+        PoseLandmarkMatrixType BDinv = (*Bi)*(_DInvSchur->diagonal()[landmarkIndex]);
+        assert(_HplCCS->rowBaseOfBlock(i1) < _sizePoses && "Index out of bounds");
+        typename PoseVectorType::MapType Bb(&_coefficients[_HplCCS->rowBaseOfBlock(i1)], Bi->rows());
+        typename LandmarkVectorType::ConstMapType db(dbl + _Hll->rowBaseOfBlock(landmarkIndex), Bi->cols());
+        Bb.noalias() += (*Bi)*db;
+
+        assert(i1 >= 0 && i1 < static_cast<int>(_HschurTransposedCCS->blockCols().size()) && "Index out of bounds");
+        typename SparseBlockMatrixCCS<PoseMatrixType>::SparseColumn::iterator targetColumnIt = _HschurTransposedCCS->blockCols()[i1].begin();
+
+        assert((size_t)landmarkIndex < _HplCCS->blockCols().size() && "Index out of bounds");
+        const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::RowBlock aux(i1, 0);
+        typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it_inner = lower_bound(landmarkColumn.begin(), landmarkColumn.end(), aux);
+        for (; it_inner != landmarkColumn.end(); ++it_inner) {
+          int i2 = it_inner->row;
+          const PoseLandmarkMatrixType* Bj = it_inner->block;
+          assert(Bj); 
+          while (targetColumnIt->row < i2 /*&& targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end()*/)
+            ++targetColumnIt;
+          assert(targetColumnIt != _HschurTransposedCCS->blockCols()[i1].end() && targetColumnIt->row == i2 && "invalid iterator, something wrong with the matrix structure");
+          PoseMatrixType* Hi1i2 = targetColumnIt->block;//_Hschur->block(i1,i2);
+          assert(Hi1i2);
+          (*Hi1i2).noalias() -= BDinv*Bj->transpose();
+        }
       }
     }
-  }
+  }, 1);
   //cerr << "Solve [marginalize] = " <<  get_monotonic_time()-t << endl;
 
   // _bschur = _b for calling solver, and not touching _b
@@ -457,29 +471,27 @@ bool BlockSolver<Traits>::solve(){
     return false;
 
   // _x contains the solution for the poses, now applying it to the landmarks to get the new part of the
-  // solution;
-  double* xp = _x;
-  double* cp = _coefficients;
-
-  double* xl=_x+_sizePoses;
-  double* cl=_coefficients + _sizePoses;
-  double* bl=_b+_sizePoses;
-
-  // cp = -xp
-  for (int i=0; i<_sizePoses; ++i)
-    cp[i]=-xp[i];
-
-  // cl = bl
-  memcpy(cl,bl,_sizeLandmarks*sizeof(double));
-
-  // cl = bl - Bt * xp
-  //Bt->multiply(cl, cp);
-  _HplCCS->rightMultiply(cl, cp);
+  // solution, xl = Dinv * (bl - Hpl^T * xp) independently for every landmark, with the landmark part
+  // of _coefficients as scratch
+  _optimizer->forEachBlock(numLandmarks, [&](int begin, int end) {
+    for (int landmarkIndex = begin; landmarkIndex < end; ++landmarkIndex) {
+      const LandmarkMatrixType& Dinv = _DInvSchur->diagonal()[landmarkIndex];
+      const int landmarkBase = _Hll->rowBaseOfBlock(landmarkIndex);
+      typename LandmarkVectorType::MapType cl(_coefficients + _sizePoses + landmarkBase, Dinv.rows());
+      cl = typename LandmarkVectorType::ConstMapType(_b + _sizePoses + landmarkBase, Dinv.rows());
+
+      const typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn& landmarkColumn = _HplCCS->blockCols()[landmarkIndex];
+      for (typename SparseBlockMatrixCCS<PoseLandmarkMatrixType>::SparseColumn::const_iterator it = landmarkColumn.begin();
+          it != landmarkColumn.end(); ++it) {
+        const PoseLandmarkMatrixType* B = it->block;
+        typename PoseVectorType::ConstMapType xp(_x + _HplCCS->rowBaseOfBlock(it->row), B->rows());
+        cl.noalias() -= B->transpose() * xp;
+      }
 
-  // xl = Dinv * cl
-  memset(xl,0, _sizeLandmarks*sizeof(double));
-  _DInvSchur->multiply(xl,cl);
-  //_DInvSchur->rightMultiply(xl,cl);
+      typename LandmarkVectorType::MapType xl(_x + _sizePoses + landmarkBase, Dinv.rows());
+      xl.noalias() = Dinv * cl;
+    }
+  });
   //cerr << "Solve [landmark delta] = " <<  get_monotonic_time()-t << endl;
 
   return true;
@@ -502,6 +514,7 @@ template <typename Traits>
 bool BlockSolver<Traits>::buildSystem()
 {
   // clear b vector
+  const bool concurrent = _optimizer->numThreads() > 1;
 # ifdef G2O_OPENMP
 # pragma omp parallel for default (shared) if (_optimizer->indexMapping().size() > 1000)
 # endif
@@ -509,6 +522,7 @@ bool BlockSolver<Traits>::buildSystem()
     OptimizableGraph::Vertex* v=_optimizer->indexMapping()[i];
     assert(v);
     v->clearQuadraticForm();
+    v->setQuadraticFormConcurrent(concurrent);
   }
   _Hpp->clear();
   if (_doSchur) {
@@ -519,30 +533,29 @@ bool BlockSolver<Traits>::buildSystem()
   // resetting the terms for the pairwise constraints
   // built up the current system by storing the Hessian blocks in the edges and vertices
 # ifndef G2O_OPENMP
-  // no threading, we do not need to copy the workspace
-  JacobianWorkspace& jacobianWorkspace = _optimizer->jacobianWorkspace();
+  // blocks of edges may be linearized concurrently (see SparseOptimizer::setParallelFor), every
+  // block but the one spanning all edges needs its own copy of the workspace. The edges lock the
+  // vertices while adding to their blocks of the Hessian.
+  const int numEdges = static_cast<int>(_optimizer->activeEdges().size());
+  _optimizer->forEachBlock(numEdges, [this, numEdges](int begin, int end) {
+    JacobianWorkspace* jacobianWorkspace = &_optimizer->jacobianWorkspace();
+    JacobianWorkspace blockWorkspace;
+    if (end - begin < numEdges) {
+      blockWorkspace = *jacobianWorkspace;
+      jacobianWorkspace = &blockWorkspace;
+    }
+    for (int k = begin; k < end; ++k) {
+      linearizeEdge(_optimizer->activeEdges()[k], *jacobianWorkspace);
+    }
+  });
 # else
   // if running with threads need to produce copies of the workspace for each thread
   JacobianWorkspace jacobianWorkspace = _optimizer->jacobianWorkspace();
 # pragma omp parallel for default (shared) firstprivate(jacobianWorkspace) if (_optimizer->activeEdges().size() > 100)
-# endif
   for (int k = 0; k < static_cast<int>(_optimizer->activeEdges().size()); ++k) {
-    OptimizableGraph::Edge* e = _optimizer->activeEdges()[k];
-    e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
-    e->constructQuadraticForm();
-#  ifndef NDEBUG
-    for (size_t i = 0; i < e->vertices().size(); ++i) {
-      const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
-      if (! v->fixed()) {
-        bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
-        if (hasANan) {
-          cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
-          break;
-        }
-      }
-    }
-#  endif
+    linearizeEdge(_optimizer->activeEdges()[k], jacobianWorkspace);
   }
+# endif
 
   // flush the current system in a sparse block matrix
 # ifdef G2O_OPENMP
@@ -559,6 +572,25 @@ bool BlockSolver<Traits>::buildSystem()
   return 0;
 }
 
+template <typename Traits>
+void BlockSolver<Traits>::linearizeEdge(OptimizableGraph::Edge* e, JacobianWorkspace& jacobianWorkspace)
+{
+  e->linearizeOplus(jacobianWorkspace); // jacobian of the nodes' oplus (manifold)
+  e->constructQuadraticForm();
+#  ifndef NDEBUG
+  for (size_t i = 0; i < e->vertices().size(); ++i) {
+    const OptimizableGraph::Vertex* v = static_cast<const OptimizableGraph::Vertex*>(e->vertex(i));
+    if (! v->fixed()) {
+      bool hasANan = arrayHasNaN(jacobianWorkspace.workspaceForVertex(i), e->dimension() * v->dimension());
+      if (hasANan) {
+        cerr << "buildSystem(): NaN within Jacobian for edge " << e << " for vertex " << i << endl;
+        break;
+      }
+    }
+  }
+#  endif
+}
+
 
 template <typename Traits>
 bool BlockSolver<Traits>::setLambda(double lambda, bool backup)
@@ -615,6 +647,7 @@ bool BlockSolver<Traits>::init(SparseOptimizer* optimizer, bool online)
     if (_Hll)
       _Hll->clear();
   }
+  _linearSolver->setOptimizer(optimizer);
   _linearSolver->init();
   return true;
 }
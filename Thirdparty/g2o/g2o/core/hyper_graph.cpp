@@ -108,7 +108,7 @@ namespace g2o {
     return true;
   }
 
-  bool HyperGraph::removeVertex(Vertex* v)
+  bool HyperGraph::removeVertex(Vertex* v, bool detach)
   {
     VertexIDMap::iterator it=_vertices.find(v->id());
     if (it==_vertices.end())
@@ -117,16 +117,17 @@ namespace g2o {
     //remove all edges which are entering or leaving v;
     EdgeSet tmp(v->edges());
     for (EdgeSet::iterator it=tmp.begin(); it!=tmp.end(); ++it){
-      if (!removeEdge(*it)){
+      if (!removeEdge(*it, detach)){
         assert(0);
       }
     }
     _vertices.erase(it);
-    delete v;
+    if (! detach)
+      delete v;
     return true;
   }
 
-  bool HyperGraph::removeEdge(Edge* e)
+  bool HyperGraph::removeEdge(Edge* e, bool detach)
   {
     EdgeSet::iterator it = _edges.find(e);
     if (it == _edges.end())
@@ -140,7 +141,8 @@ namespace g2o {
       v->edges().erase(it);
     }
 
-    delete e;
+    if (! detach)
+      delete e;
     return true;
   }
 
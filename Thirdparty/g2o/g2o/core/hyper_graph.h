@@ -166,10 +166,16 @@ namespace g2o {
       //! returns a vertex <i>id</i> in the hyper-graph, or 0 if the vertex id is not present
       const Vertex* vertex(int id) const;
 
-      //! removes a vertex from the graph. Returns true on success (vertex was present)
-      virtual bool removeVertex(Vertex* v);
-      //! removes a vertex from the graph. Returns true on success (edge was present)
-      virtual bool removeEdge(Edge* e);
+      /**
+       * removes a vertex and the edges entering or leaving it from the graph. Returns true on
+       * success (vertex was present). With detach, they are not deleted but left to the caller.
+       */
+      virtual bool removeVertex(Vertex* v, bool detach = false);
+      /**
+       * removes an edge from the graph. Returns true on success (edge was present). With detach,
+       * it is not deleted but left to the caller.
+       */
+      virtual bool removeEdge(Edge* e, bool detach = false);
       //! clears the graph and empties all structures.
       virtual void clear();
 
@@ -31,6 +31,8 @@
 
 namespace g2o {
 
+class SparseOptimizer;
+
 /**
  * \brief basic solver for Ax = b
  *
@@ -49,6 +51,12 @@ class LinearSolver
      */
     virtual bool init() = 0;
 
+    /**
+     * the optimizer whose systems are solved, set before init(). Solvers may run their work on
+     * its threads, see SparseOptimizer::forEachBlock().
+     */
+    virtual void setOptimizer(const SparseOptimizer* optimizer) { (void) optimizer; }
+
     /**
      * Assumes that A is the same matrix for several calls.
      * Among other assumptions, the non-zero pattern does not change!
@@ -32,7 +32,9 @@
 #ifdef G2O_OPENMP
 #include <omp.h>
 #else
+#include <atomic>
 #include <cassert>
+#include <thread>
 #endif
 
 namespace g2o {
@@ -49,6 +51,7 @@ namespace g2o {
       ~OpenMPMutex() { omp_destroy_lock(&_lock); }
       void lock() { omp_set_lock(&_lock); }
       void unlock() { omp_unset_lock(&_lock); }
+      void setConcurrent(bool) {}
     protected:
       omp_lock_t _lock;
   };
@@ -56,23 +59,48 @@ namespace g2o {
 #else
 
   /*
-   * dummy which does nothing in case we don't have OpenMP support.
-   * In debug mode, the mutex allows to verify the correct lock and unlock behavior
+   * dummy which does nothing in case we don't have OpenMP support, unless set concurrent, e.g., while
+   * the edges are linearized by several threads (see SparseOptimizer::setParallelFor). It is then a
+   * spin lock guarding short updates, such as the accumulation of an edge into the quadratic form of
+   * a vertex. In debug mode, the mutex allows to verify the correct lock and unlock behavior.
+   * Copies start unlocked and not concurrent.
    */
   class OpenMPMutex
   {
     public:
 #ifdef NDEBUG
-      OpenMPMutex() {}
+      OpenMPMutex() : _concurrent(false) { _flag.clear(); }
+      OpenMPMutex(const OpenMPMutex&) : _concurrent(false) { _flag.clear(); }
 #else
-      OpenMPMutex() : _cnt(0) {}
+      OpenMPMutex() : _concurrent(false), _cnt(0) { _flag.clear(); }
+      OpenMPMutex(const OpenMPMutex&) : _concurrent(false), _cnt(0) { _flag.clear(); }
 #endif
+      OpenMPMutex& operator=(const OpenMPMutex&) { return *this; }
       ~OpenMPMutex() { assert(_cnt == 0 && "Freeing locked mutex");}
-      void lock() { assert(++_cnt == 1 && "Locking already locked mutex");}
-      void unlock() { assert(--_cnt == 0 && "Trying to unlock a mutex which is not locked");}
+      void lock()
+      {
+        if (_concurrent)
+          while (_flag.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+        assert(++_cnt == 1 && "Locking already locked mutex");
+      }
+      void unlock()
+      {
+        assert(--_cnt == 0 && "Trying to unlock a mutex which is not locked");
+        if (_concurrent)
+          _flag.clear(std::memory_order_release);
+      }
+      //! whether lock() has to exclude other threads, to be changed only while unlocked
+      void setConcurrent(bool concurrent)
+      {
+        assert(_cnt == 0 && "Changing the mode of a locked mutex");
+        _concurrent = concurrent;
+      }
     protected:
+      bool             _concurrent;
+      std::atomic_flag _flag;
 #ifndef NDEBUG
-      char _cnt;
+      int              _cnt;
 #endif
   };
 
@@ -32,6 +32,7 @@
 #include <list>
 #include <limits>
 #include <cmath>
+#include <functional>
 #include <typeinfo>
 
 #include "openmp_mutex.h"
@@ -335,6 +336,16 @@ namespace g2o {
          * unlock the block of the hessian and the b vector associated with this vertex
          */
         void unlockQuadraticForm() { _quadraticFormMutex.unlock();}
+        /**
+         * whether edges may lock the quadratic form of this vertex from several threads at once,
+         * locking does nothing otherwise
+         */
+        void setQuadraticFormConcurrent(bool concurrent) { _quadraticFormMutex.setConcurrent(concurrent);}
+        /**
+         * the vertex among v1 and v2 whose lock guards the off-diagonal Hessian block between
+         * them, the same for every edge connecting the two whatever the order of its vertices
+         */
+        static Vertex* offDiagonalLockOwner(Vertex* v1, Vertex* v2) { return std::less<Vertex*>()(v1, v2) ? v1 : v2;}
 
         //! read the vertex from a stream, i.e., the internal state of the vertex
         virtual bool read(std::istream& is) = 0;
@@ -48,7 +48,7 @@ namespace g2o{
 
 
   SparseOptimizer::SparseOptimizer() :
-    _forceStopFlag(0), _verbose(false), _algorithm(0), _computeBatchStatistics(false)
+    _forceStopFlag(0), _verbose(false), _numThreads(1), _algorithm(0), _computeBatchStatistics(false)
   {
     _graphActions.resize(AT_NUM_ELEMENTS);
   }
@@ -69,11 +69,19 @@ namespace g2o{
 
 #   ifdef G2O_OPENMP
 #   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
-#   endif
     for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
       OptimizableGraph::Edge* e = _activeEdges[k];
       e->computeError();
     }
+#   else
+    // every edge writes only its own error
+    forEachBlock(static_cast<int>(_activeEdges.size()), [this](int begin, int end) {
+      for (int k = begin; k < end; ++k) {
+        OptimizableGraph::Edge* e = _activeEdges[k];
+        e->computeError();
+      }
+    });
+#   endif
 
 #  ifndef NDEBUG
     for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
@@ -571,19 +579,38 @@ namespace g2o{
     return _algorithm->computeMarginals(spinv, blockIndices);
   }
 
+  void SparseOptimizer::setParallelFor(int numThreads, const ParallelFor& parallelFor)
+  {
+    _numThreads = parallelFor ? max(numThreads, 1) : 1;
+    _parallelFor = parallelFor;
+  }
+
+  void SparseOptimizer::forEachBlock(int n, const std::function<void(int begin, int end)>& fn, int minBlockSize) const
+  {
+    // a few blocks per thread balance items of different cost
+    const int numBlocks = min(4 * _numThreads, (n + minBlockSize - 1) / minBlockSize);
+    if (_numThreads <= 1 || numBlocks <= 1) {
+      fn(0, n);
+      return;
+    }
+    _parallelFor(0, numBlocks, [&](int b) {
+      fn(static_cast<int>(static_cast<long>(n) * b / numBlocks), static_cast<int>(static_cast<long>(n) * (b + 1) / numBlocks));
+    });
+  }
+
   void SparseOptimizer::setForceStopFlag(bool* flag)
   {
     _forceStopFlag=flag;
   }
 
-  bool SparseOptimizer::removeVertex(HyperGraph::Vertex* v)
+  bool SparseOptimizer::removeVertex(HyperGraph::Vertex* v, bool detach)
   {
     OptimizableGraph::Vertex* vv = static_cast<OptimizableGraph::Vertex*>(v);
     if (vv->hessianIndex() >= 0) {
       clearIndexMapping();
       _ivMap.clear();
     }
-    return HyperGraph::removeVertex(v);
+    return HyperGraph::removeVertex(v, detach);
   }
 
   bool SparseOptimizer::addComputeErrorAction(HyperGraphAction* action)
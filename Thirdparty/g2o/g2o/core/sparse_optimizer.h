@@ -33,6 +33,7 @@
 #include "sparse_block_matrix.h"
 #include "batch_stats.h"
 
+#include <functional>
 #include <map>
 
 namespace g2o {
@@ -187,6 +188,30 @@ namespace g2o {
     //! if external stop flag is given, return its state. False otherwise
     bool terminate() {return _forceStopFlag ? (*_forceStopFlag) : false; }
 
+    /**
+     * calls fn(k) for every k in [begin, end), possibly concurrently, and returns once all calls returned
+     */
+    typedef std::function<void(int begin, int end, const std::function<void(int)>& fn)> ParallelFor;
+
+    /**
+     * evaluates the errors and linearizes the active edges in blocks handed to parallelFor, sized
+     * for numThreads threads. The edges of different blocks may read the same vertices, so every
+     * edge must compute its Jacobians analytically: the numerical differentiation of the base
+     * edges perturbs the estimates of its vertices. With numThreads <= 1, the default, everything
+     * runs on the calling thread and locking the quadratic forms costs nothing. With more threads,
+     * the edges add into a Hessian block in the order the threads reach it, so the results of two
+     * runs may differ in the last bits; a single thread reproduces them exactly.
+     */
+    void setParallelFor(int numThreads, const ParallelFor& parallelFor);
+    int numThreads() const { return _numThreads;}
+
+    /**
+     * splits [0, n) into contiguous blocks of at least minBlockSize items and calls fn(begin, end)
+     * for each of them, through the ParallelFor of setParallelFor when there is more than one
+     * block, in a single call fn(0, n) on the calling thread otherwise
+     */
+    void forEachBlock(int n, const std::function<void(int begin, int end)>& fn, int minBlockSize = 32) const;
+
     //! the index mapping of the vertices
     const VertexContainer& indexMapping() const {return _ivMap;}
     //! the vertices active in the current optimization
@@ -200,7 +225,7 @@ namespace g2o {
      * mapping is erased. In case you need the index mapping for manipulating the
      * graph, you have to store it in your own copy.
      */
-    virtual bool removeVertex(HyperGraph::Vertex* v);
+    virtual bool removeVertex(HyperGraph::Vertex* v, bool detach = false);
 
     /**
      * search for an edge in _activeVertices and return the iterator pointing to it
@@ -290,6 +315,9 @@ namespace g2o {
     bool* _forceStopFlag;
     bool _verbose;
 
+    int _numThreads;
+    ParallelFor _parallelFor;
+
     VertexContainer _ivMap;
     VertexContainer _activeVertices;   ///< sorted according to VertexIDCompare
     EdgeContainer _activeEdges;        ///< sorted according to EdgeIDCompare
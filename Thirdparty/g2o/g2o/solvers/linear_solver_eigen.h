@@ -36,6 +36,7 @@
 
 #include "../core/eigen_types.h"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -96,7 +97,7 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
       if (_init)
         _sparseMatrix.resize(A.rows(), A.cols());
       fillSparseMatrix(A, !_init);
-      if (_init) // compute the symbolic composition once
+      if (_init && ! samePattern()) // compute the symbolic composition once per pattern
         computeSymbolicDecomposition(A);
       _init = false;
 
@@ -137,6 +138,29 @@ class LinearSolverEigen: public LinearSolver<MatrixType>
     bool _writeDebug;
     SparseMatrix _sparseMatrix;
     CholeskyDecomposition _cholesky;
+    //! non-zero pattern of the matrix of the last symbolic decomposition
+    std::vector<int> _outerIndices;
+    std::vector<int> _innerIndices;
+
+    /**
+     * whether the refilled matrix has the non-zero pattern of the last symbolic decomposition,
+     * which then still holds, e.g. when init() was called for the same graph again. The pattern
+     * is stored for the next call otherwise.
+     */
+    bool samePattern()
+    {
+      const int* outer = _sparseMatrix.outerIndexPtr();
+      const int* inner = _sparseMatrix.innerIndexPtr();
+      const int outerSize = _sparseMatrix.outerSize() + 1;
+      const int nonZeros = _sparseMatrix.nonZeros();
+      if (static_cast<int>(_outerIndices.size()) == outerSize && static_cast<int>(_innerIndices.size()) == nonZeros
+          && std::equal(outer, outer + outerSize, _outerIndices.begin())
+          && std::equal(inner, inner + nonZeros, _innerIndices.begin()))
+        return true;
+      _outerIndices.assign(outer, outer + outerSize);
+      _innerIndices.assign(inner, inner + nonZeros);
+      return false;
+    }
 
     /**
      * compute the symbolic decompostion of the matrix only once.
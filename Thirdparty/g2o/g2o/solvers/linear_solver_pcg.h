@@ -0,0 +1,254 @@
+#ifndef G2O_LINEAR_SOLVER_PCG_H
+#define G2O_LINEAR_SOLVER_PCG_H
+
+#include "../core/linear_solver.h"
+#include "../core/batch_stats.h"
+#include "../core/matrix_operations.h"
+#include "../core/sparse_optimizer.h"
+#include "../stuff/timeutil.h"
+
+#include "../core/eigen_types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <Eigen/StdVector>
+
+namespace g2o {
+
+/**
+ * \brief linear solver using the conjugate gradients preconditioned by the inverse diagonal blocks
+ *
+ * Does not factorize A, so there is no fill-in: memory and time per iteration grow with the
+ * non-zero blocks of A only. Given the Schur complement of a BlockSolver, the preconditioner is
+ * the Schur-Jacobi one. The matrix-vector products run in parallel by block rows through the
+ * SparseOptimizer set by setOptimizer, if it has threads.
+ *
+ * Each solve stops once the residual is below a relative tolerance that follows the
+ * Eisenstat-Walker forcing sequence, see setForcingTerm(): the first steps of the nonlinear
+ * optimization, which are far from the minimum, are only solved roughly.
+ */
+template <typename MatrixType>
+class LinearSolverPCG : public LinearSolver<MatrixType>
+{
+  public:
+    LinearSolverPCG() :
+      LinearSolver<MatrixType>(),
+      _optimizer(0), _tolerance(1e-6), _forcingTerm(0.1), _maxIterations(-1),
+      _previousNormB(-1.), _iterations(0), _residual(0.)
+    {
+    }
+
+    virtual ~LinearSolverPCG()
+    {
+    }
+
+    virtual bool init()
+    {
+      _previousNormB = -1.;
+      return true;
+    }
+
+    virtual void setOptimizer(const SparseOptimizer* optimizer) { _optimizer = optimizer;}
+
+    bool solve(const SparseBlockMatrix<MatrixType>& A, double* x, double* b)
+    {
+      double t=get_monotonic_time();
+      const int n = A.rows();
+      VectorXD::MapType xx(x, n);
+      VectorXD::ConstMapType bb(b, n);
+      xx.setZero();
+      _iterations = 0;
+
+      const double normB = bb.norm();
+      if (normB == 0.) {
+        _residual = 0.;
+        return true;
+      }
+      const double tolerance = relativeTolerance(normB) * normB;
+      const int maxIterations = _maxIterations > 0 ? _maxIterations : n;
+
+      buildRows(A);
+      invertDiagonal();
+
+      // x starts at 0, hence r = b
+      _r = bb;
+      applyPreconditioner(_r, _z);
+      _p = _z;
+      double rz = _r.dot(_z);
+      _residual = normB;
+      while (_residual > tolerance && _iterations < maxIterations) {
+        multiply(_p, _q);
+        const double pq = _p.dot(_q);
+        if (! (pq > 0.)) { // A is not positive definite along p, stop with the descent direction so far
+          if (_iterations == 0)
+            return false;
+          break;
+        }
+        const double alpha = rz / pq;
+        xx += alpha * _p;
+        _r -= alpha * _q;
+        _residual = _r.norm();
+        ++_iterations;
+
+        applyPreconditioner(_r, _z);
+        const double rzNew = _r.dot(_z);
+        _p = _z + (rzNew / rz) * _p;
+        rz = rzNew;
+      }
+
+      G2OBatchStatistics* globalStats = G2OBatchStatistics::globalStats();
+      if (globalStats) {
+        globalStats->timeNumericDecomposition = get_monotonic_time() - t;
+        globalStats->iterationsLinearSolver = _iterations;
+      }
+      return xx.allFinite();
+    }
+
+    //! relative residual |b - Ax| / |b| at which a solve stops at the latest, 1e-6 by default
+    double tolerance() const { return _tolerance;}
+    void setTolerance(double tolerance) { _tolerance = tolerance;}
+
+    /**
+     * upper bound of the relative residual at which a solve stops, 0.1 by default. After the first
+     * solve since init(), the bound is min(forcingTerm, 0.9 * (|b| / |b_previous|)^2), the
+     * Eisenstat-Walker choice 2, but never below tolerance(). A forcing term of 0 solves every
+     * system to tolerance().
+     */
+    double forcingTerm() const { return _forcingTerm;}
+    void setForcingTerm(double forcingTerm) { _forcingTerm = forcingTerm;}
+
+    //! iterations of a solve at most, the dimension of A if <= 0, the default
+    int maxIterations() const { return _maxIterations;}
+    void setMaxIterations(int maxIterations) { _maxIterations = maxIterations;}
+
+    //! iterations and residual |b - Ax| of the last solve
+    int iterations() const { return _iterations;}
+    double residual() const { return _residual;}
+
+  protected:
+    //! a block of A in a block row, transposed if it was stored in the upper triangle below it
+    struct RowBlock
+    {
+      const MatrixType* block;
+      int colBase;
+      bool transposed;
+    };
+
+    const SparseOptimizer* _optimizer;
+    double _tolerance;
+    double _forcingTerm;
+    int _maxIterations;
+    double _previousNormB;
+    int _iterations;
+    double _residual;
+
+    std::vector<std::vector<RowBlock> > _rows;
+    std::vector<int> _rowBases;
+    std::vector<const MatrixType*> _diagonal;
+    std::vector<MatrixType, Eigen::aligned_allocator<MatrixType> > _diagonalInverse;
+    VectorXD _r, _z, _p, _q;
+
+    double relativeTolerance(double normB)
+    {
+      double eta = _forcingTerm;
+      if (_previousNormB > 0.) {
+        const double ratio = normB / _previousNormB;
+        eta = std::min(eta, 0.9 * ratio * ratio);
+      }
+      _previousNormB = normB;
+      return std::max(eta, _tolerance);
+    }
+
+    /**
+     * collects the blocks of both triangles of A by block row, so that each row of a product is
+     * written by a single task
+     */
+    void buildRows(const SparseBlockMatrix<MatrixType>& A)
+    {
+      const int numRows = A.rowBlockIndices().size();
+      _rows.resize(numRows);
+      _rowBases.resize(numRows);
+      _diagonal.assign(numRows, 0);
+      for (int i = 0; i < numRows; ++i) {
+        _rows[i].clear();
+        _rowBases[i] = A.rowBaseOfBlock(i);
+      }
+      for (size_t c = 0; c < A.blockCols().size(); ++c) {
+        const int colBase = A.colBaseOfBlock(c);
+        const typename SparseBlockMatrix<MatrixType>::IntBlockMap& column = A.blockCols()[c];
+        for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it = column.begin(); it != column.end(); ++it) {
+          const int r = it->first;
+          if (r > static_cast<int>(c)) // only upper triangle
+            break;
+          RowBlock upper = {it->second, colBase, false};
+          _rows[r].push_back(upper);
+          if (r == static_cast<int>(c)) {
+            _diagonal[r] = it->second;
+          } else {
+            RowBlock lower = {it->second, _rowBases[r], true};
+            _rows[c].push_back(lower);
+          }
+        }
+      }
+    }
+
+    void invertDiagonal()
+    {
+      const int numRows = _diagonal.size();
+      _diagonalInverse.resize(numRows);
+      forEachRow(numRows, [this](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          assert(_diagonal[i] && "the diagonal block of a row is missing");
+          _diagonalInverse[i] = _diagonal[i]->inverse();
+        }
+      });
+    }
+
+    //! dest = M^-1 src for the block diagonal M of A
+    void applyPreconditioner(const VectorXD& src, VectorXD& dest)
+    {
+      dest.resize(src.size());
+      const int numRows = _diagonalInverse.size();
+      forEachRow(numRows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          const MatrixType& m = _diagonalInverse[i];
+          dest.segment(_rowBases[i], m.rows()).noalias() = m * src.segment(_rowBases[i], m.cols());
+        }
+      });
+    }
+
+    //! dest = A src, one block row at a time
+    void multiply(const VectorXD& src, VectorXD& dest)
+    {
+      dest.setZero(src.size());
+      const Eigen::Map<const VectorXd> srcVec(src.data(), src.size());
+      Eigen::Map<VectorXd> destVec(dest.data(), dest.size());
+      const int numRows = _rows.size();
+      forEachRow(numRows, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          const int destOffset = _rowBases[i];
+          for (size_t k = 0; k < _rows[i].size(); ++k) {
+            const RowBlock& rb = _rows[i][k];
+            if (rb.transposed)
+              internal::atxpy(*rb.block, srcVec, rb.colBase, destVec, destOffset);
+            else
+              internal::axpy(*rb.block, srcVec, rb.colBase, destVec, destOffset);
+          }
+        }
+      });
+    }
+
+    void forEachRow(int numRows, const std::function<void(int begin, int end)>& fn) const
+    {
+      if (_optimizer)
+        _optimizer->forEachBlock(numRows, fn, 16);
+      else
+        fn(0, numRows);
+    }
+};
+
+} // end namespace
+
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <Eigen/Core>
+#include "GeometricCamera.h"
+
+namespace ORB_SLAM3 {
+
+// Projection policies for code templated on the camera model, e.g. the reprojection edges of the
+// optimizer. Each has Project and ProjectJac taking the camera and a point in its frame. The
+// policies of the concrete models read the parameters of the camera directly, so that the calls
+// inline instead of going through the virtual functions of GeometricCamera.
+
+// Any camera model, through the virtual functions
+struct GeometricCameraProjection {
+  static Eigen::Vector2d Project(GeometricCamera* pCamera, const Eigen::Vector3d& v3D) {
+    return pCamera->project(v3D);
+  }
+
+  static Eigen::Matrix<double, 2, 3> ProjectJac(
+    GeometricCamera* pCamera, const Eigen::Vector3d& v3D
+  ) {
+    return pCamera->projectJac(v3D);
+  }
+};
+
+// Pinhole, parameters fx, fy, cx, cy
+struct PinholeProjection {
+  static Eigen::Vector2d Project(const float* p, const Eigen::Vector3d& v3D) {
+    Eigen::Vector2d res;
+    res[0] = p[0] * v3D[0] / v3D[2] + p[2];
+    res[1] = p[1] * v3D[1] / v3D[2] + p[3];
+
+    return res;
+  }
+
+  static Eigen::Matrix<double, 2, 3> ProjectJac(const float* p, const Eigen::Vector3d& v3D) {
+    Eigen::Matrix<double, 2, 3> Jac;
+    Jac(0, 0) = p[0] / v3D[2];
+    Jac(0, 1) = 0.f;
+    Jac(0, 2) = -p[0] * v3D[0] / (v3D[2] * v3D[2]);
+    Jac(1, 0) = 0.f;
+    Jac(1, 1) = p[1] / v3D[2];
+    Jac(1, 2) = -p[1] * v3D[1] / (v3D[2] * v3D[2]);
+
+    return Jac;
+  }
+
+  static Eigen::Vector2d Project(GeometricCamera* pCamera, const Eigen::Vector3d& v3D) {
+    return Project(pCamera->parameterData(), v3D);
+  }
+
+  static Eigen::Matrix<double, 2, 3> ProjectJac(
+    GeometricCamera* pCamera, const Eigen::Vector3d& v3D
+  ) {
+    return ProjectJac(pCamera->parameterData(), v3D);
+  }
+};
+
+// KannalaBrandt8, parameters fx, fy, cx, cy, k1, k2, k3, k4
+struct KannalaBrandt8Projection {
+  static Eigen::Vector2d Project(const float* p, const Eigen::Vector3d& v3D) {
+    const double x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
+    const double theta      = atan2f(sqrtf(x2_plus_y2), v3D[2]);
+    const double psi        = atan2f(v3D[1], v3D[0]);
+
+    const double theta2 = theta * theta;
+    const double theta3 = theta * theta2;
+    const double theta5 = theta3 * theta2;
+    const double theta7 = theta5 * theta2;
+    const double theta9 = theta7 * theta2;
+    const double r = theta + p[4] * theta3 + p[5] * theta5 + p[6] * theta7 + p[7] * theta9;
+
+    Eigen::Vector2d res;
+    res[0] = p[0] * r * std::cos(psi) + p[2];
+    res[1] = p[1] * r * std::sin(psi) + p[3];
+
+    return res;
+  }
+
+  static Eigen::Matrix<double, 2, 3> ProjectJac(const float* p, const Eigen::Vector3d& v3D) {
+    const double x2 = v3D[0] * v3D[0], y2 = v3D[1] * v3D[1], z2 = v3D[2] * v3D[2];
+    const double r2    = x2 + y2;
+    const double r     = std::sqrt(r2);
+    const double r3    = r2 * r;
+    const double theta = std::atan2(r, v3D[2]);
+
+    const double theta2 = theta * theta, theta3 = theta2 * theta;
+    const double theta4 = theta2 * theta2, theta5 = theta4 * theta;
+    const double theta6 = theta2 * theta4, theta7 = theta6 * theta;
+    const double theta8 = theta4 * theta4, theta9 = theta8 * theta;
+
+    const double f  = theta + theta3 * p[4] + theta5 * p[5] + theta7 * p[6] + theta9 * p[7];
+    const double fd = 1 + 3 * p[4] * theta2 + 5 * p[5] * theta4 + 7 * p[6] * theta6
+                    + 9 * p[7] * theta8;
+
+    const double xy = fd * v3D[2] * v3D[1] * v3D[0] / (r2 * (r2 + z2)) - f * v3D[1] * v3D[0] / r3;
+
+    Eigen::Matrix<double, 2, 3> Jac;
+    Jac(0, 0) = p[0] * (fd * v3D[2] * x2 / (r2 * (r2 + z2)) + f * y2 / r3);
+    Jac(1, 0) = p[1] * xy;
+
+    Jac(0, 1) = p[0] * xy;
+    Jac(1, 1) = p[1] * (fd * v3D[2] * y2 / (r2 * (r2 + z2)) + f * x2 / r3);
+
+    Jac(0, 2) = -p[0] * fd * v3D[0] / (r2 + z2);
+    Jac(1, 2) = -p[1] * fd * v3D[1] / (r2 + z2);
+
+    return Jac;
+  }
+
+  static Eigen::Vector2d Project(GeometricCamera* pCamera, const Eigen::Vector3d& v3D) {
+    return Project(pCamera->parameterData(), v3D);
+  }
+
+  static Eigen::Matrix<double, 2, 3> ProjectJac(
+    GeometricCamera* pCamera, const Eigen::Vector3d& v3D
+  ) {
+    return ProjectJac(pCamera->parameterData(), v3D);
+  }
+};
+
+// Edge whose camera model is known when it is created, evaluating its error and Jacobians through
+// the projection policy Projection. Edge provides computeErrorAs and linearizeOplusAs templated on
+// the policy.
+template <class Edge, class Projection>
+class CameraModelEdge : public Edge {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  using Edge::Edge;
+
+  void computeError() override {
+    this->template computeErrorAs<Projection>();
+  }
+
+  void linearizeOplus() override {
+    this->template linearizeOplusAs<Projection>();
+  }
+};
+
+// New Edge constructed from args, specialized for the model of pCamera when the model has a
+// projection policy. Observations of a camera of any other model get a plain Edge.
+template <class Edge, class... Args>
+Edge* NewCameraModelEdge(GeometricCamera* pCamera, Args&&... args) {
+  switch (pCamera->GetType()) {
+    case GeometricCamera::CAM_PINHOLE:
+      return new CameraModelEdge<Edge, PinholeProjection>(std::forward<Args>(args)...);
+    case GeometricCamera::CAM_FISHEYE:
+      return new CameraModelEdge<Edge, KannalaBrandt8Projection>(std::forward<Args>(args)...);
+    default:
+      return new Edge(std::forward<Args>(args)...);
+  }
+}
+
+} // namespace ORB_SLAM3
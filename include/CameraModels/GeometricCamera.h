@@ -58,6 +58,24 @@ public:
 
   virtual Eigen::Matrix<double, 2, 3> projectJac(const Eigen::Vector3d& v3D) = 0;
 
+  // Batched project, unprojectEig and projectJac over n points in structure of arrays layout, so
+  // that camera models can process several points per instruction. The default implementations
+  // call the per point functions.
+  virtual void projectBatch(
+    const float* x, const float* y, const float* z, const int n, float* u, float* v
+  );
+  virtual void unprojectBatch(
+    const float* u, const float* v, const int n, float* x, float* y, float* z
+  );
+  // jac[(3 * r + c) * n + i] receives the derivative of coordinate r of the projection of point i
+  // with respect to its coordinate c
+  virtual void projectJacBatch(
+    const float* x, const float* y, const float* z, const int n, float* jac
+  );
+
+  // Bearings of the n keypoints at pKeys into pBearings, through unprojectBatch
+  void unprojectKeyPoints(const cv::KeyPoint* pKeys, const int n, Eigen::Vector3f* pBearings);
+
   virtual bool ReconstructWithTwoViews(
     const std::vector<cv::KeyPoint>& vKeys1,
     const std::vector<cv::KeyPoint>& vKeys2,
@@ -80,6 +98,20 @@ public:
     const float            unc
   ) = 0;
 
+  // epipolarConstrain for keypoints whose bearings r1 and r2, as given by unprojectEig, are already
+  // known. The default implementation does not need them.
+  virtual bool epipolarConstrain(
+    GeometricCamera*       otherCamera,
+    const cv::KeyPoint&    kp1,
+    const cv::KeyPoint&    kp2,
+    const Eigen::Vector3f& r1,
+    const Eigen::Vector3f& r2,
+    const Eigen::Matrix3f& R12,
+    const Eigen::Vector3f& t12,
+    const float            sigmaLevel,
+    const float            unc
+  );
+
   float getParameter(const int i) {
     return mvParameters[i];
   }
@@ -95,6 +127,11 @@ public:
     return mvParameters;
   }
 
+  // The parameters in place, valid as long as the camera lives
+  const float* parameterData() const {
+    return mvParameters.data();
+  }
+
   virtual bool matchAndtriangulate(
     const cv::KeyPoint& kp1,
     const cv::KeyPoint& kp2,
@@ -20,6 +20,7 @@
 #ifndef CAMERAMODELS_KANNALABRANDT8_H
 #define CAMERAMODELS_KANNALABRANDT8_H
 
+#include <array>
 #include <fstream>
 #include <vector>
 #include <Eigen/Core>
@@ -40,6 +41,9 @@ class KannalaBrandt8 : public GeometricCamera {
   void serialize(Archive& ar, const unsigned int version) {
     ar& boost::serialization::base_object<GeometricCamera>(*this);
     ar& const_cast<float&>(precision);
+    if (Archive::is_loading::value) {
+      BuildThetaTable();
+    }
   }
 
 public:
@@ -60,6 +64,12 @@ public:
 
   Eigen::Matrix<double, 2, 3> projectJac(const Eigen::Vector3d& v3D);
 
+  void projectBatch(
+    const float* x, const float* y, const float* z, const int n, float* u, float* v
+  );
+  void unprojectBatch(const float* u, const float* v, const int n, float* x, float* y, float* z);
+  void projectJacBatch(const float* x, const float* y, const float* z, const int n, float* jac);
+
   bool ReconstructWithTwoViews(
     const std::vector<cv::KeyPoint>& vKeys1,
     const std::vector<cv::KeyPoint>& vKeys2,
@@ -81,6 +91,17 @@ public:
     const float            sigmaLevel,
     const float            unc
   );
+  bool epipolarConstrain(
+    GeometricCamera*       pCamera2,
+    const cv::KeyPoint&    kp1,
+    const cv::KeyPoint&    kp2,
+    const Eigen::Vector3f& r1,
+    const Eigen::Vector3f& r2,
+    const Eigen::Matrix3f& R12,
+    const Eigen::Vector3f& t12,
+    const float            sigmaLevel,
+    const float            unc
+  );
 
   float TriangulateMatches(
     GeometricCamera*       pCamera2,
@@ -93,6 +114,21 @@ public:
     Eigen::Vector3f&       p3D
   );
 
+  // Same as TriangulateMatches, with the bearings r1 and r2 of kp1 and kp2 already computed by
+  // unprojectEig.
+  float TriangulateBearings(
+    GeometricCamera*       pCamera2,
+    const cv::KeyPoint&    kp1,
+    const cv::KeyPoint&    kp2,
+    const Eigen::Vector3f& r1,
+    const Eigen::Vector3f& r2,
+    const Eigen::Matrix3f& R12,
+    const Eigen::Vector3f& t12,
+    const float            sigmaLevel,
+    const float            unc,
+    Eigen::Vector3f&       p3D
+  );
+
   std::vector<int> mvLappingArea;
 
   bool matchAndtriangulate(
@@ -123,6 +159,20 @@ private:
 
   TwoViewReconstruction* tvr;
 
+  // Undistorted angle theta every mfThetaTableStep of distorted angle over [0, pi / 2], for the
+  // distortion coefficients mvThetaTableK. While those are the coefficients of the camera, the
+  // Newton iterations of unproject start from the table and usually stop after one.
+  std::vector<float>   mvThetaTable;
+  float                mfThetaTableStep = 0.f;
+  std::array<float, 4> mvThetaTableK    = {};
+
+  void BuildThetaTable();
+
+  // Undistorted angle of the distorted angle thetaD, and its interpolation in the table (thetaD
+  // itself when the table is out of date)
+  float UndistortAngle(const float thetaD) const;
+  float GuessUndistortedAngle(const float thetaD) const;
+
   void Triangulate(
     const cv::Point2f&                p1,
     const cv::Point2f&                p2,
@@ -59,6 +59,12 @@ public:
 
   Eigen::Matrix<double, 2, 3> projectJac(const Eigen::Vector3d& v3D);
 
+  void projectBatch(
+    const float* x, const float* y, const float* z, const int n, float* u, float* v
+  );
+  void unprojectBatch(const float* u, const float* v, const int n, float* x, float* y, float* z);
+  void projectJacBatch(const float* x, const float* y, const float* z, const int n, float* jac);
+
   bool ReconstructWithTwoViews(
     const std::vector<cv::KeyPoint>& vKeys1,
     const std::vector<cv::KeyPoint>& vKeys2,
@@ -71,6 +77,7 @@ public:
   cv::Mat         toK();
   Eigen::Matrix3f toK_();
 
+  using GeometricCamera::epipolarConstrain;
   bool epipolarConstrain(
     GeometricCamera*       pCamera2,
     const cv::KeyPoint&    kp1,
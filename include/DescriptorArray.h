@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// One 256-bit ORB descriptor, aligned so that it is read with a single 256-bit load.
+struct alignas(32) Descriptor {
+  static constexpr int kBytes = 32;
+
+  std::array<std::uint64_t, 4> words{};
+
+  const unsigned char* data() const {
+    return reinterpret_cast<const unsigned char*>(words.data());
+  }
+
+  unsigned char* data() {
+    return reinterpret_cast<unsigned char*>(words.data());
+  }
+
+  bool operator==(const Descriptor& other) const {
+    return words == other.words;
+  }
+
+  // Copy of a 1 x 32 CV_8UC1 row.
+  static Descriptor FromMat(const cv::Mat& row);
+
+  // 1 x 32 CV_8UC1 copy of the descriptor.
+  cv::Mat ToMat() const;
+};
+
+static_assert(sizeof(Descriptor) == Descriptor::kBytes, "descriptors must be tightly packed");
+
+// Descriptors of the keypoints of a frame, packed one after another in a single buffer, so that
+// matching reads them through plain pointers instead of cv::Mat row headers. cv::Mat is only used
+// at the boundaries: extraction, bag of words and brute force matching.
+class DescriptorArray {
+public:
+  DescriptorArray() = default;
+
+  // Copy of the rows of a N x 32 CV_8UC1 matrix.
+  explicit DescriptorArray(const cv::Mat& descriptors);
+
+  void Assign(const cv::Mat& descriptors);
+
+  // Append the descriptors of other after those of this array.
+  void Append(const DescriptorArray& other);
+
+  void Resize(const std::size_t n) {
+    mvDescriptors.resize(n);
+  }
+
+  std::size_t size() const {
+    return mvDescriptors.size();
+  }
+
+  bool empty() const {
+    return mvDescriptors.empty();
+  }
+
+  const Descriptor& operator[](const std::size_t i) const {
+    return mvDescriptors[i];
+  }
+
+  Descriptor& operator[](const std::size_t i) {
+    return mvDescriptors[i];
+  }
+
+  const Descriptor* data() const {
+    return mvDescriptors.data();
+  }
+
+  Descriptor* data() {
+    return mvDescriptors.data();
+  }
+
+  // N x 32 CV_8UC1 header on the packed descriptors, without copy. It is only valid while the array
+  // is alive and not resized, and must not be written to.
+  cv::Mat AsMat() const;
+
+  // N x 32 CV_8UC1 copy of the descriptors.
+  cv::Mat ToMat() const;
+
+private:
+  std::vector<Descriptor> mvDescriptors;
+};
+
+} // namespace ORB_SLAM3
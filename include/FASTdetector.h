@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// Compute the FAST-9 score of every pixel in rows [rowBegin, rowEnd) of a CV_8UC1 image. Pixels
+// that are not corners at the given threshold, or whose circle leaves the image, get a score of 0.
+// Corners get the same score as cv::FAST, i.e. the largest threshold at which they still are
+// corners, so a single map computed at the lowest threshold serves every higher threshold as well.
+// The score map must be preallocated with the size of the image and type CV_8UC1.
+void ComputeFASTScores(
+  const cv::Mat& image, cv::Mat& scores, const int threshold, const int rowBegin, const int rowEnd
+);
+
+// Append to keypoints the corners that cv::FAST with non-max suppression would return on the
+// image region cell at the given threshold, using a score map computed by ComputeFASTScores with a
+// threshold lower or equal. Keypoints are expressed relative to the cell origin plus offset.
+// Returns the number of keypoints appended.
+int DetectFASTInCell(
+  const cv::Mat&             scores,
+  const cv::Rect&            cell,
+  const int                  threshold,
+  const cv::Point2f&         offset,
+  std::vector<cv::KeyPoint>& keypoints
+);
+
+} // namespace ORB_SLAM3
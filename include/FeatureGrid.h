@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Keypoint indices bucketed in a grid of image cells, in compressed sparse row storage: a single
+// array of indices sorted by cell and the start of every cell in it. Cell (x, y) is stored at
+// x * rows + y, so the cells of a column are contiguous and a column range is a single span.
+class FeatureGrid {
+public:
+  FeatureGrid() = default;
+
+  // Empty grid of nCols x nRows cells
+  FeatureGrid(const int nCols, const int nRows);
+
+  // Grid with the nested per cell vectors layout, cells[x][y] holding the indices of cell (x, y)
+  static FeatureGrid FromCells(const std::vector<std::vector<std::vector<std::size_t>>>& cells);
+
+  std::vector<std::vector<std::vector<std::size_t>>> ToCells() const;
+
+  int Cols() const {
+    return mnCols;
+  }
+
+  int Rows() const {
+    return mnRows;
+  }
+
+  int CellIndex(const int x, const int y) const {
+    return x * mnRows + y;
+  }
+
+  // Bucket the indices [0, vCells.size()) by cell with a counting sort. vCells[i] is the
+  // CellIndex of index i, or -1 to leave it out. Storage is reused between calls.
+  void Assign(const std::vector<int>& vCells);
+
+  // Indices of the cells (x, minY) to (x, maxY), by cell then in increasing order
+  const std::size_t* ColumnBegin(const int x, const int minY) const {
+    return mvIndices.data() + mvCellStarts[CellIndex(x, minY)];
+  }
+
+  const std::size_t* ColumnEnd(const int x, const int maxY) const {
+    return mvIndices.data() + mvCellStarts[CellIndex(x, maxY) + 1];
+  }
+
+  std::size_t CellSize(const int x, const int y) const {
+    return mvCellStarts[CellIndex(x, y) + 1] - mvCellStarts[CellIndex(x, y)];
+  }
+
+private:
+  int mnCols = 0;
+  int mnRows = 0;
+
+  // Indices of cell c are mvIndices[mvCellStarts[c] .. mvCellStarts[c + 1])
+  std::vector<int>         mvCellStarts = std::vector<int>(1, 0);
+  std::vector<std::size_t> mvIndices;
+};
+
+} // namespace ORB_SLAM3
@@ -29,8 +29,11 @@
 #include <opencv2/features2d.hpp>
 #include <sophus/se3.hpp>
 #include <spdlog/logger.h>
+#include "DescriptorArray.h"
+#include "FeatureGrid.h"
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
+#include "SharedValue.h"
 
 namespace ORB_SLAM3 {
 #define FRAME_GRID_ROWS 48
@@ -40,16 +43,24 @@ class ConstraintPoseImu;
 class GeometricCamera;
 class KeyFrame;
 class MapPoint;
+class BearingCells;
 class ORBextractor;
+class RowBuckets;
+class ThreadPool;
 
 class Frame {
 public:
   Frame();
 
-  // Copy constructor.
+  // Copy constructor. The keypoints, descriptors, grids and bag of words are shared with frame.
   Frame(const Frame& frame);
 
-  // Constructor for stereo cameras.
+  Frame(Frame&& frame)                 = default;
+  Frame& operator=(const Frame& frame) = default;
+  Frame& operator=(Frame&& frame)      = default;
+
+  // Constructor for stereo cameras. Stereo matches are searched on the threads of pThreadPool, or
+  // on the calling thread when null, bucketing the right keypoints in pRowBuckets when given.
   Frame(
     const cv::Mat&    imLeft,
     const cv::Mat&    imRight,
@@ -62,8 +73,10 @@ public:
     const float&      bf,
     const float&      thDepth,
     GeometricCamera*  pCamera,
-    Frame*            pPrevF   = static_cast<Frame*>(NULL),
-    const IMU::Calib& ImuCalib = IMU::Calib()
+    Frame*            pPrevF      = static_cast<Frame*>(NULL),
+    const IMU::Calib& ImuCalib    = IMU::Calib(),
+    ThreadPool*       pThreadPool = nullptr,
+    RowBuckets*       pRowBuckets = nullptr
   );
 
   // Constructor for RGB-D cameras.
@@ -133,6 +146,12 @@ public:
   // and fill variables of the MapPoint to be used by the tracking
   bool isInFrustum(MapPoint* pMP, float viewingCosLimit);
 
+  // isInFrustum over all of vpMPs, projecting them with one batched call per camera. vbInFrustum[i]
+  // receives the result for vpMPs[i].
+  void isInFrustum(
+    const std::vector<MapPoint*>& vpMPs, float viewingCosLimit, std::vector<bool>& vbInFrustum
+  );
+
   bool ProjectPointDistort(MapPoint* pMP, cv::Point2f& kp, float& u, float& v);
 
   Eigen::Vector3f inRefCoordinates(Eigen::Vector3f pCw);
@@ -149,10 +168,22 @@ public:
     const bool   bRight   = false
   ) const;
 
+  // Same as above, writing into vIndices to reuse its storage
+  void GetFeaturesInArea(
+    const float&              x,
+    const float&              y,
+    const float&              r,
+    const int                 minLevel,
+    const int                 maxLevel,
+    const bool                bRight,
+    std::vector<std::size_t>& vIndices
+  ) const;
+
   // Search a match for each keypoint in the left image to a keypoint in the right image.
   // If there is a match, depth is computed and the right coordinate associated to the left keypoint
-  // is stored.
-  void ComputeStereoMatches();
+  // is stored. Keypoints are matched on the threads of pThreadPool, when given. The right keypoints
+  // are bucketed in pRowBuckets, reusing its storage, or in a table of their own when null.
+  void ComputeStereoMatches(ThreadPool* pThreadPool = nullptr, RowBuckets* pRowBuckets = nullptr);
 
   // Associate a "right" coordinate to a keypoint if there is valid depth in the depthmap.
   void ComputeStereoFromRGBD(const cv::Mat& imDepth);
@@ -262,21 +293,23 @@ public:
   // Vector of keypoints (original for visualization) and undistorted (actually used by the system).
   // In the stereo case, mvKeysUn is redundant as images must be rectified.
   // In the RGB-D case, RGB images can be distorted.
-  std::vector<cv::KeyPoint> mvKeys, mvKeysRight;
-  std::vector<cv::KeyPoint> mvKeysUn;
+  // The feature payload (keypoints, stereo, descriptors, bag of words and grids) is immutable once
+  // computed and shared with the copies of the frame and with its keyframe.
+  SharedValue<std::vector<cv::KeyPoint>> mvKeys, mvKeysRight;
+  SharedValue<std::vector<cv::KeyPoint>> mvKeysUn;
 
   // Corresponding stereo coordinate and depth for each keypoint.
   std::vector<MapPoint*> mvpMapPoints;
   // "Monocular" keypoints have a negative value.
-  std::vector<float> mvuRight;
-  std::vector<float> mvDepth;
+  SharedValue<std::vector<float>> mvuRight;
+  SharedValue<std::vector<float>> mvDepth;
 
   // Bag of Words Vector structures.
-  DBoW2::BowVector     mBowVec;
-  DBoW2::FeatureVector mFeatVec;
+  SharedValue<DBoW2::BowVector>     mBowVec;
+  SharedValue<DBoW2::FeatureVector> mFeatVec;
 
-  // ORB descriptor, each row associated to a keypoint.
-  cv::Mat mDescriptors, mDescriptorsRight;
+  // ORB descriptor, each one associated to a keypoint.
+  SharedValue<DescriptorArray> mDescriptors, mDescriptorsRight;
 
   // MapPoints associated to keypoints, NULL pointer if no association.
   // Flag to identify outlier associations.
@@ -287,7 +320,7 @@ public:
   // MapPoints.
   static float             mfGridElementWidthInv;
   static float             mfGridElementHeightInv;
-  std::vector<std::size_t> mGrid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+  SharedValue<FeatureGrid> mGrid;
 
   IMU::Bias mPredBias;
 
@@ -370,15 +403,12 @@ public:
   // For stereo matching
   std::vector<int> mvLeftToRightMatch, mvRightToLeftMatch;
 
-  // For stereo fisheye matching
-  static cv::BFMatcher BFmatcher;
-
   // Triangulated stereo observations using as reference the left camera. These are
   // computed during ComputeStereoFishEyeMatches
   std::vector<Eigen::Vector3f> mvStereo3Dpoints;
 
   // Grid for the right image
-  std::vector<std::size_t> mGridRight[FRAME_GRID_COLS][FRAME_GRID_ROWS];
+  SharedValue<FeatureGrid> mGridRight;
 
   Frame(
     const cv::Mat&    imLeft,
@@ -394,18 +424,39 @@ public:
     GeometricCamera*  pCamera,
     GeometricCamera*  pCamera2,
     Sophus::SE3f&     Tlr,
-    Frame*            pPrevF   = static_cast<Frame*>(NULL),
-    const IMU::Calib& ImuCalib = IMU::Calib()
+    Frame*            pPrevF        = static_cast<Frame*>(NULL),
+    const IMU::Calib& ImuCalib      = IMU::Calib(),
+    ThreadPool*       pThreadPool   = nullptr,
+    BearingCells*     pBearingCells = nullptr
   );
 
-  // Stereo fisheye
-  void ComputeStereoFishEyeMatches();
+  // Stereo fisheye, matched on the threads of pThreadPool when given. The right keypoints are
+  // bucketed in pBearingCells, reusing its storage, or in cells of their own when null.
+  void ComputeStereoFishEyeMatches(
+    ThreadPool* pThreadPool = nullptr, BearingCells* pBearingCells = nullptr
+  );
 
   bool isInFrustumChecks(MapPoint* pMP, float viewingCosLimit, bool bRight = false);
 
-  Eigen::Vector3f UnprojectStereoFishEye(const int& i);
+  // Checks of isInFrustum and isInFrustumChecks for the point P, at Pc in the camera and projected
+  // at uv
+  bool isInFrustumProjected(
+    MapPoint*              pMP,
+    const Eigen::Vector3f& P,
+    const Eigen::Vector3f& Pc,
+    const Eigen::Vector2f& uv,
+    float                  viewingCosLimit
+  );
+  bool isInFrustumChecks(
+    MapPoint*              pMP,
+    const Eigen::Vector3f& P,
+    const Eigen::Vector3f& Pc,
+    const Eigen::Vector2f& uv,
+    float                  viewingCosLimit,
+    bool                   bRight
+  );
 
-  cv::Mat imgLeft, imgRight;
+  Eigen::Vector3f UnprojectStereoFishEye(const int& i);
 
   Sophus::SE3<double> T_test;
 
@@ -28,6 +28,7 @@
 #include <Thirdparty/g2o/g2o/core/base_unary_edge.h>
 #include <Thirdparty/g2o/g2o/core/base_vertex.h>
 #include <Thirdparty/g2o/g2o/types/types_sba.h>
+#include "CameraModels/CameraProjection.h"
 #include "ImuTypes.h"
 
 namespace ORB_SLAM3 {
@@ -91,6 +92,24 @@ public:
   Eigen::Vector3d ProjectStereo(const Eigen::Vector3d& Xw, int cam_idx = 0) const; // Stereo
   bool            isDepthPositive(const Eigen::Vector3d& Xw, int cam_idx = 0) const;
 
+  // Project and ProjectStereo through the projection policy Projection of CameraProjection.h
+  template <class Projection>
+  Eigen::Vector2d ProjectAs(const Eigen::Vector3d& Xw, int cam_idx = 0) const {
+    Eigen::Vector3d Xc = Rcw[cam_idx] * Xw + tcw[cam_idx];
+
+    return Projection::Project(pCamera[cam_idx], Xc);
+  }
+
+  template <class Projection>
+  Eigen::Vector3d ProjectStereoAs(const Eigen::Vector3d& Xw, int cam_idx = 0) const {
+    Eigen::Vector3d Pc = Rcw[cam_idx] * Xw + tcw[cam_idx];
+    Eigen::Vector3d pc;
+    double          invZ = 1 / Pc(2);
+    pc.head(2)           = Projection::Project(pCamera[cam_idx], Pc);
+    pc(2)                = pc(0) - bf * invZ;
+    return pc;
+  }
+
 public:
   // For IMU
   Eigen::Matrix3d Rwb;
@@ -363,6 +382,10 @@ public:
   }
 };
 
+// The visual edges below project through the virtual functions of the camera cam_idx of the pose.
+// Like the edges of OptimizableTypes.h, CameraModelEdge specializes them for a camera model, and
+// linearizeOplusAs is instantiated for every projection policy in G2oTypes.cc.
+
 class EdgeMono
   : public g2o::BaseBinaryEdge<2, Eigen::Vector2d, g2o::VertexSBAPointXYZ, VertexPose> {
 public:
@@ -379,13 +402,12 @@ public:
   }
 
   void computeError() {
-    const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
-    const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
-    const Eigen::Vector2d         obs(_measurement);
-    _error = obs - VPose->estimate().Project(VPoint->estimate(), cam_idx);
+    computeErrorAs<GeometricCameraProjection>();
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   bool isDepthPositive() {
     const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
@@ -411,6 +433,18 @@ public:
 
 public:
   const int cam_idx;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
+    const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
+    const Eigen::Vector2d         obs(_measurement);
+    _error = obs - VPose->estimate().ProjectAs<Projection>(VPoint->estimate(), cam_idx);
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeMonoOnlyPose : public g2o::BaseUnaryEdge<2, Eigen::Vector2d, VertexPose> {
@@ -429,12 +463,12 @@ public:
   }
 
   void computeError() {
-    const VertexPose*     VPose = static_cast<const VertexPose*>(_vertices[0]);
-    const Eigen::Vector2d obs(_measurement);
-    _error = obs - VPose->estimate().Project(Xw, cam_idx);
+    computeErrorAs<GeometricCameraProjection>();
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   bool isDepthPositive() {
     const VertexPose* VPose = static_cast<const VertexPose*>(_vertices[0]);
@@ -449,6 +483,17 @@ public:
 public:
   const Eigen::Vector3d Xw;
   const int             cam_idx;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const VertexPose*     VPose = static_cast<const VertexPose*>(_vertices[0]);
+    const Eigen::Vector2d obs(_measurement);
+    _error = obs - VPose->estimate().ProjectAs<Projection>(Xw, cam_idx);
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeStereo
@@ -467,13 +512,12 @@ public:
   }
 
   void computeError() {
-    const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
-    const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
-    const Eigen::Vector3d         obs(_measurement);
-    _error = obs - VPose->estimate().ProjectStereo(VPoint->estimate(), cam_idx);
+    computeErrorAs<GeometricCameraProjection>();
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   Eigen::Matrix<double, 3, 9> GetJacobian() {
     linearizeOplus();
@@ -493,6 +537,18 @@ public:
 
 public:
   const int cam_idx;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
+    const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
+    const Eigen::Vector3d         obs(_measurement);
+    _error = obs - VPose->estimate().ProjectStereoAs<Projection>(VPoint->estimate(), cam_idx);
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeStereoOnlyPose : public g2o::BaseUnaryEdge<3, Eigen::Vector3d, VertexPose> {
@@ -511,12 +567,12 @@ public:
   }
 
   void computeError() {
-    const VertexPose*     VPose = static_cast<const VertexPose*>(_vertices[0]);
-    const Eigen::Vector3d obs(_measurement);
-    _error = obs - VPose->estimate().ProjectStereo(Xw, cam_idx);
+    computeErrorAs<GeometricCameraProjection>();
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   Eigen::Matrix<double, 6, 6> GetHessian() {
     linearizeOplus();
@@ -526,6 +582,17 @@ public:
 public:
   const Eigen::Vector3d Xw; // 3D point coordinates
   const int             cam_idx;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const VertexPose*     VPose = static_cast<const VertexPose*>(_vertices[0]);
+    const Eigen::Vector3d obs(_measurement);
+    _error = obs - VPose->estimate().ProjectStereoAs<Projection>(Xw, cam_idx);
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeInertial : public g2o::BaseMultiEdge<9, Vector9d> {
@@ -43,6 +43,21 @@ public:
     Eigen::Vector3f&            x3D
   );
 
+  // Triangulate n pairs of rays as the midpoints of their closest points. The rays of pair i leave
+  // the camera centers O1 and O2 along world directions, not necessarily unit, stored as planes:
+  // component k at rays1[k * n + i] and rays2[k * n + i]. Writes the cosine of the parallax of
+  // every pair to cosParallax and the point to x3D, in the same layout. Pairs of parallel rays
+  // give points that are not finite.
+  static void TriangulateBatch(
+    const Eigen::Vector3f& O1,
+    const Eigen::Vector3f& O2,
+    const float*           rays1,
+    const float*           rays2,
+    const int              n,
+    float*                 cosParallax,
+    float*                 x3D
+  );
+
   template <int rows, int cols>
   static bool CheckMatrices(const cv::Mat& cvMat, const Eigen::Matrix<float, rows, cols>& eigMat) {
     const float epsilon = 1e-3;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace ORB_SLAM3 {
+
+// Hamming distance between two 256-bit ORB descriptors.
+inline int HammingDistance(const unsigned char* a, const unsigned char* b) {
+  int dist = 0;
+  for (int i = 0; i < 4; i++) {
+    std::uint64_t va, vb;
+    std::memcpy(&va, a + 8 * i, sizeof(va));
+    std::memcpy(&vb, b + 8 * i, sizeof(vb));
+    dist += __builtin_popcountll(va ^ vb);
+  }
+  return dist;
+}
+
+// Best and second best distances of a batch, indices are positions in the batch or -1.
+struct HammingMatch {
+  int bestDist;
+  int bestIdx;
+  int secondDist;
+  int secondIdx;
+};
+
+// Compute the Hamming distances from the query to the n 256-bit descriptors pointed to by
+// candidates. The kernel (AVX-512 VPOPCNTDQ, AVX2, hardware popcount or portable bit counting) is
+// selected once at runtime from what the CPU supports.
+void HammingDistances(
+  const unsigned char* query, const unsigned char* const* candidates, const int n, int* distances
+);
+
+// Same as above for n descriptors stored every stride bytes from candidates, e.g. the rows of a
+// descriptor matrix.
+void HammingDistances(
+  const unsigned char* query,
+  const unsigned char* candidates,
+  const std::size_t    stride,
+  const int            n,
+  int*                 distances
+);
+
+// Best and second best of n distances, starting from distance 256. Ties keep the earliest candidate
+// as best, as in the matcher loops.
+HammingMatch BestHammingMatch(const int* distances, const int n);
+
+// Best and second best matches of the query among the candidates, starting from distance 256.
+HammingMatch FindBestHamming(
+  const unsigned char* query, const unsigned char* const* candidates, const int n
+);
+
+// Name of the kernel selected for this CPU: "avx512", "avx2", "popcnt" or "scalar".
+const char* HammingBackend();
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// Geometric conditioning of the input images of a camera before feature extraction: rectification,
+// which also scales to the size of its maps, or a plain resize. The output is written into storage
+// of the caller, e.g. the interior of the bordered level 0 of an extractor pyramid, so that the
+// conditioned image is never copied again.
+class ImageConditioner {
+public:
+  // Rectification through the maps of cv::initUndistortRectifyMap, kept as fixed point CV_16SC2
+  // and CV_16UC1 maps so that remapping runs on integer arithmetic. Float maps are converted.
+  ImageConditioner(const cv::Mat& map1, const cv::Mat& map2);
+
+  // Bilinear resize to size
+  explicit ImageConditioner(const cv::Size& size);
+
+  cv::Size OutputSize() const {
+    return mSize;
+  }
+
+  // Condition src into dst, which must have OutputSize and the type of src. dst may be a view of a
+  // larger image, only its pixels are written.
+  void Apply(const cv::Mat& src, cv::Mat& dst) const;
+
+private:
+  cv::Size mSize;
+
+  // Fixed point rectification maps, empty for a plain resize
+  cv::Mat mMap1, mMap2;
+};
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// Image owned by the caller, e.g. a frame of a camera driver in shared memory, that the system reads
+// in place instead of copying it. The pixels must stay valid and unchanged until release, if set,
+// is called. It is called once the pixels are no longer read, at the latest before the call that
+// took the view returns, and the system keeps no use of them afterwards.
+struct ImageView {
+  enum Format {
+    GRAY8,   // CV_8UC1
+    RGB8,    // CV_8UC3
+    BGR8,    // CV_8UC3
+    RGBA8,   // CV_8UC4
+    BGRA8,   // CV_8UC4
+    DEPTH16, // CV_16UC1, depth maps only
+    DEPTH32F // CV_32FC1, depth maps only
+  };
+
+  const void* data   = nullptr;
+  int         width  = 0;
+  int         height = 0;
+  // Bytes between the starts of two rows
+  std::size_t step   = 0;
+  Format      format = GRAY8;
+
+  std::function<void()> release;
+
+  int Type() const {
+    switch (format) {
+      case RGB8:
+      case BGR8:
+        return CV_8UC3;
+      case RGBA8:
+      case BGRA8:
+        return CV_8UC4;
+      case DEPTH16:
+        return CV_16UC1;
+      case DEPTH32F:
+        return CV_32FC1;
+      default:
+        return CV_8UC1;
+    }
+  }
+
+  // Header over the pixels, which are not copied and must not be written through it
+  cv::Mat Mat() const {
+    return cv::Mat(height, width, Type(), const_cast<void*>(data), step);
+  }
+};
+
+// Calls the release callback of an image view once, when asked or at the latest on destruction, so
+// that the view is released on every return or exception path of the call that took it.
+class ViewRelease {
+public:
+  explicit ViewRelease(const ImageView& view)
+    : mView(view)
+    , mbReleased(false) {}
+
+  ~ViewRelease() {
+    Release();
+  }
+
+  void Release() {
+    if (!mbReleased && mView.release) {
+      mView.release();
+    }
+    mbReleased = true;
+  }
+
+private:
+  const ImageView& mView;
+  bool             mbReleased;
+};
+
+// Grayscale image of view: a header over its pixels when gray, otherwise its conversion into
+// buffer, after which the view is released. Throws std::invalid_argument for depth maps.
+cv::Mat ViewToGray(const ImageView& view, cv::Mat& buffer, ViewRelease& release);
+
+} // namespace ORB_SLAM3
@@ -35,9 +35,12 @@
 #include <opencv2/core.hpp>
 #include <sophus/se3.hpp>
 #include <spdlog/logger.h>
+#include "DescriptorArray.h"
+#include "FeatureGrid.h"
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
 #include "SerializationUtils.h"
+#include "SharedValue.h"
 
 namespace ORB_SLAM3 {
 
@@ -119,12 +122,12 @@ class KeyFrame {
     // KeyPoints
     serializeVectorKeyPoints<Archive>(ar, mvKeys, version);
     serializeVectorKeyPoints<Archive>(ar, mvKeysUn, version);
-    ar& const_cast<std::vector<float>&>(mvuRight);
-    ar& const_cast<std::vector<float>&>(mvDepth);
-    serializeMatrix<Archive>(ar, mDescriptors, version);
+    serializeSharedValue(ar, mvuRight, version);
+    serializeSharedValue(ar, mvDepth, version);
+    serializeDescriptors<Archive>(ar, mDescriptors, version);
     // BOW
-    ar& mBowVec;
-    ar& mFeatVec;
+    serializeSharedValue(ar, mBowVec, version);
+    serializeSharedValue(ar, mFeatVec, version);
     // Pose relative to parent
     serializeSophusSE3<Archive>(ar, mTcp, version);
     // Scale
@@ -145,7 +148,7 @@ class KeyFrame {
     // MapPointsId associated to keypoints
     ar& mvBackupMapPointsId;
     // Grid
-    ar& mGrid;
+    serializeFeatureGrid(ar, mGrid, version);
     // Connected KeyFrameWeight
     ar& mBackupConnectedKeyFrameIdWeights;
     // Spanning Tree and Loop Edges
@@ -174,7 +177,7 @@ class KeyFrame {
     ar& const_cast<int&>(NRight);
     serializeSophusSE3<Archive>(ar, mTlr, version);
     serializeVectorKeyPoints<Archive>(ar, mvKeysRight, version);
-    ar& mGridRight;
+    serializeFeatureGrid(ar, mGridRight, version);
 
     // Inertial variables
     ar& mImuBias;
@@ -213,6 +216,9 @@ public:
   // Bag of Words Representation
   void ComputeBoW();
 
+  // Unproject every keypoint into mvBearings
+  void ComputeBearings();
+
   // Covisibility graph functions
   void AddConnection(KeyFrame* pKF, const int& weight);
   void EraseConnection(KeyFrame* pKF);
@@ -257,6 +263,14 @@ public:
   std::vector<std::size_t> GetFeaturesInArea(
     const float& x, const float& y, const float& r, const bool bRight = false
   ) const;
+  // Same as above, writing into vIndices to reuse its storage
+  void GetFeaturesInArea(
+    const float&              x,
+    const float&              y,
+    const float&              r,
+    const bool                bRight,
+    std::vector<std::size_t>& vIndices
+  ) const;
   bool UnprojectStereo(int i, Eigen::Vector3f& x3D);
 
   // Image
@@ -378,16 +392,21 @@ public:
   // Number of KeyPoints
   const int N;
 
-  // KeyPoints, stereo coordinate and descriptors (all associated by an index)
-  const std::vector<cv::KeyPoint> mvKeys;
-  const std::vector<cv::KeyPoint> mvKeysUn;
-  const std::vector<float>        mvuRight; // negative value for monocular points
-  const std::vector<float>        mvDepth;  // negative value for monocular points
-  const cv::Mat                   mDescriptors;
+  // KeyPoints, stereo coordinate and descriptors (all associated by an index), shared with the
+  // frame the keyframe was created from
+  const SharedValue<std::vector<cv::KeyPoint>> mvKeys;
+  const SharedValue<std::vector<cv::KeyPoint>> mvKeysUn;
+  const SharedValue<std::vector<float>>        mvuRight; // negative value for monocular points
+  const SharedValue<std::vector<float>>        mvDepth;  // negative value for monocular points
+  const SharedValue<DescriptorArray>           mDescriptors;
+
+  // Bearing of every keypoint as given by unprojectEig of its camera: of mvKeysUn with a single
+  // camera, and of mvKeys then mvKeysRight with two
+  SharedValue<std::vector<Eigen::Vector3f>> mvBearings;
 
   // BoW
-  DBoW2::BowVector     mBowVec;
-  DBoW2::FeatureVector mFeatVec;
+  SharedValue<DBoW2::BowVector>     mBowVec;
+  SharedValue<DBoW2::FeatureVector> mFeatVec;
 
   // Pose relative to parent (this is computed when bad flag is activated)
   Sophus::SE3f mTcp;
@@ -456,7 +475,7 @@ protected:
   ORBVocabulary*    mpORBvocabulary;
 
   // Grid over the image to speed up feature matching
-  std::vector<std::vector<std::vector<std::size_t>>> mGrid;
+  SharedValue<FeatureGrid> mGrid;
 
   std::map<KeyFrame*, int> mConnectedKeyFrameWeights;
   std::vector<KeyFrame*>   mvpOrderedConnectedKeyFrames;
@@ -514,11 +533,11 @@ public:
   Sophus::SE3f GetRelativePoseTlr();
 
   // KeyPoints in the right image (for stereo fisheye, coordinates are needed)
-  const std::vector<cv::KeyPoint> mvKeysRight;
+  const SharedValue<std::vector<cv::KeyPoint>> mvKeysRight;
 
   const int NLeft, NRight;
 
-  std::vector<std::vector<std::vector<std::size_t>>> mGridRight;
+  SharedValue<FeatureGrid> mGridRight;
 
   Sophus::SE3<float> GetRightPose();
   Sophus::SE3<float> GetRightPoseInverse();
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <Thirdparty/g2o/g2o/core/sparse_optimizer.h>
+
+namespace g2o {
+class EdgeStereoSE3ProjectXYZ;
+class OptimizationAlgorithm;
+class VertexSBAPointXYZ;
+class VertexSE3Expmap;
+} // namespace g2o
+
+namespace ORB_SLAM3 {
+
+class EdgeAccRW;
+class EdgeGyroRW;
+class EdgeInertial;
+class EdgeMono;
+class EdgeSE3ProjectXYZ;
+class EdgeSE3ProjectXYZToBody;
+class EdgeStereo;
+class GeometricCamera;
+class VertexAccBias;
+class VertexGyroBias;
+class VertexPose;
+class VertexVelocity;
+
+namespace IMU {
+class Preintegrated;
+} // namespace IMU
+
+// Optimization graph of successive windows that share most of their vertices and edges, as the
+// local bundle adjustments of LocalMapping. The graph is kept between windows: the vertices and
+// edges requested again keep their place in the optimizer, those of the previous window that are
+// not are removed when the window ends, and removed objects are recycled for the vertices and
+// edges entering later windows. The optimizer and its solvers persist as well, so the symbolic
+// analysis of the system is reused while its pattern does not change.
+//
+// The vertices and edges are identified by the ids of what they stand for only; the caller sets
+// their estimates, measurements and parameters in every window.
+class WindowGraph {
+public:
+  // Observation of a map point by a keyframe
+  enum eObservation {
+    MONOCULAR = 0,
+    STEREO    = 1,
+    RIGHT     = 2 // by the second camera of a keyframe with two
+  };
+
+  WindowGraph(const WindowGraph&)            = delete;
+  WindowGraph& operator=(const WindowGraph&) = delete;
+
+  g2o::SparseOptimizer& Optimizer() {
+    return mOptimizer;
+  }
+
+  // Start the next window. Everything of the previous window that is not requested again before
+  // EndWindow is removed from the graph then.
+  void BeginWindow();
+  void EndWindow();
+
+  // Remove everything from the graph
+  void Clear();
+
+  std::size_t NumVertices() const {
+    return mOptimizer.vertices().size();
+  }
+
+  std::size_t NumEdges() const {
+    return mOptimizer.edges().size();
+  }
+
+protected:
+  struct EdgeKey {
+    int id0; // vertex ids
+    int id1;
+    int kind;
+
+    bool operator==(const EdgeKey& other) const {
+      return id0 == other.id0 && id1 == other.id1 && kind == other.kind;
+    }
+  };
+
+  // Recycled edges are only reused for the same kind and camera model
+  typedef std::pair<int, unsigned int> EdgeModel;
+
+  // Owns pAlgorithm
+  explicit WindowGraph(g2o::OptimizationAlgorithm* pAlgorithm);
+  ~WindowGraph();
+
+  // Vertex of id in the window: the one kept, or one recycled or new and added to the graph
+  template <class Vertex>
+  Vertex* WindowVertex(const int id);
+
+  // Edge of key in the window between vpVertices, in their order: the one kept when it has the
+  // model, otherwise one recycled or made by newEdge and added to the graph. Edges that are not
+  // bRecycled are deleted when they leave the graph.
+  g2o::OptimizableGraph::Edge* WindowEdge(
+    const EdgeKey&                                        key,
+    const EdgeModel&                                      model,
+    const bool                                            bRecycled,
+    std::initializer_list<g2o::OptimizableGraph::Vertex*> vpVertices,
+    const std::function<g2o::OptimizableGraph::Edge*()>&  newEdge
+  );
+
+  // Edge of key in the graph, or nullptr
+  g2o::OptimizableGraph::Edge* KeptEdge(const EdgeKey& key) const;
+
+  // Remove the edge of key from the graph, if any
+  void DropEdge(const EdgeKey& key);
+
+  // Whether the vertex of id was requested in the window
+  bool InWindow(const int id) const;
+
+private:
+  struct VertexEntry {
+    g2o::OptimizableGraph::Vertex* pVertex;
+    std::type_index                type;
+    unsigned long                  nWindow;
+  };
+
+  struct EdgeKeyHash {
+    std::size_t operator()(const EdgeKey& key) const;
+  };
+
+  struct EdgeEntry {
+    g2o::OptimizableGraph::Edge* pEdge;
+    EdgeModel                    model;
+    bool                         bRecycled;
+    unsigned long                nWindow;
+  };
+
+  // Remove the edge from the graph, into the free edges or deleted
+  void RemoveEdge(const EdgeEntry& entry);
+
+  g2o::SparseOptimizer mOptimizer;
+  unsigned long        mnWindow;
+
+  std::unordered_map<int, VertexEntry>                mmVertices;
+  std::unordered_map<EdgeKey, EdgeEntry, EdgeKeyHash> mmEdges;
+
+  // Objects removed from the graph, owned by it until they are reused
+  std::unordered_map<std::type_index, std::vector<g2o::OptimizableGraph::Vertex*>> mmFreeVertices;
+  std::map<EdgeModel, std::vector<g2o::OptimizableGraph::Edge*>>                 mmFreeEdges;
+};
+
+// Graph of the visual local bundle adjustment: a Levenberg-Marquardt optimizer with a
+// BlockSolver_6_3 and a sparse Cholesky solver.
+class LocalBAGraph : public WindowGraph {
+public:
+  LocalBAGraph();
+
+  // Vertex of the keyframe or map point in the window, marginalized for the map points
+  g2o::VertexSE3Expmap*   KeyFrameVertex(const long unsigned int nKFId);
+  g2o::VertexSBAPointXYZ* MapPointVertex(const long unsigned int nMPId);
+
+  // Edge of an observation between vertices of the window, with a Huber kernel. The camera models
+  // of the keyframes select the type of the new edges, see NewCameraModelEdge.
+  EdgeSE3ProjectXYZ* MonocularEdge(
+    g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF, GeometricCamera* pCamera
+  );
+  g2o::EdgeStereoSE3ProjectXYZ* StereoEdge(
+    g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF
+  );
+  EdgeSE3ProjectXYZToBody* RightEdge(
+    g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF, GeometricCamera* pCamera2
+  );
+};
+
+// Graph of the local inertial bundle adjustment: a Levenberg-Marquardt optimizer with a
+// BlockSolverX and a sparse Cholesky solver.
+//
+// The inertial edge of a keyframe holds the Jacobians and information of the preintegration from
+// its previous keyframe. It is kept while the keyframe has the same previous keyframe and
+// preintegration, and deleted when it leaves the graph. A preintegration that is integrated again
+// in place, as on the initialization of the IMU, leaves the edge stale: the graph must be cleared
+// then.
+class LocalInertialBAGraph : public WindowGraph {
+public:
+  LocalInertialBAGraph();
+
+  // Vertices of the keyframe or map point in the window, marginalized for the map points
+  VertexPose*             PoseVertex(const long unsigned int nKFId);
+  VertexVelocity*         VelocityVertex(const long unsigned int nKFId);
+  VertexGyroBias*         GyroBiasVertex(const long unsigned int nKFId);
+  VertexAccBias*          AccBiasVertex(const long unsigned int nKFId);
+  g2o::VertexSBAPointXYZ* MapPointVertex(const long unsigned int nMPId);
+
+  // Whether the velocity and biases of the keyframe were requested in the window
+  bool HasInertialVertices(const long unsigned int nKFId) const;
+
+  // Edge of an observation between vertices of the window, with a Huber kernel. The camera models
+  // select the type of the new edges.
+  EdgeMono* MonocularEdge(
+    g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera
+  );
+  EdgeStereo* StereoEdge(
+    g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera
+  );
+  EdgeMono* RightEdge(
+    g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera2
+  );
+
+  // Edges of the preintegration pInt from keyframe nPrevKFId to nKFId, whose vertices must be in
+  // the window. The inertial edge has the information of pInt and no robust kernel, whatever the
+  // previous windows set.
+  EdgeInertial* InertialEdge(
+    const long unsigned int nPrevKFId, const long unsigned int nKFId, IMU::Preintegrated* pInt
+  );
+  EdgeGyroRW* GyroRandomWalkEdge(const long unsigned int nPrevKFId, const long unsigned int nKFId);
+  EdgeAccRW*  AccRandomWalkEdge(const long unsigned int nPrevKFId, const long unsigned int nKFId);
+};
+
+} // namespace ORB_SLAM3
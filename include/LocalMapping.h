@@ -33,10 +33,13 @@ namespace ORB_SLAM3 {
 
 class Atlas;
 class KeyFrame;
+class LocalBAGraph;
+class LocalInertialBAGraph;
 class LoopClosing;
 class Map;
 class MapPoint;
 class System;
+class ThreadPool;
 class Tracking;
 
 class LocalMapping {
@@ -47,9 +50,12 @@ public:
     Atlas*             pAtlas,
     const float        bMonocular,
     bool               bInertial,
-    const std::string& _strSeqName = std::string()
+    const std::string& _strSeqName = std::string(),
+    const int          nThreads    = 1
   );
 
+  ~LocalMapping();
+
   void SetLoopCloser(LoopClosing* pLoopCloser);
 
   void SetTracker(Tracking* pTracker);
@@ -139,6 +145,20 @@ protected:
   void ProcessNewKeyFrame();
   void CreateNewMapPoints();
 
+  // Map point triangulated from keypoint idx1 of the current keyframe and idx2 of a neighbor
+  struct NewMapPoint {
+    std::size_t     idx1;
+    std::size_t     idx2;
+    Eigen::Vector3f x3D;
+  };
+
+  // Match the current keyframe with pKF2 and triangulate the matches that pass the parallax, depth,
+  // reprojection and scale checks into vNewMapPoints. Only reads the keyframes, so that neighbors
+  // can be processed concurrently.
+  void TriangulateMatches(
+    KeyFrame* pKF2, const bool bCoarse, std::vector<NewMapPoint>& vNewMapPoints
+  );
+
   void MapPointCulling();
   void SearchInNeighbors();
   void KeyFrameCulling();
@@ -165,6 +185,13 @@ protected:
   LoopClosing* mpLoopCloser;
   Tracking*    mpTracker;
 
+  // Workers of the map point fusion
+  std::unique_ptr<ThreadPool> mpThreadPool;
+
+  // Graphs of the local bundle adjustments, kept from one window to the next
+  std::unique_ptr<LocalBAGraph>         mpLocalBAGraph;
+  std::unique_ptr<LocalInertialBAGraph> mpLocalInertialBAGraph;
+
   std::list<KeyFrame*> mlNewKeyFrames;
 
   KeyFrame* mpCurrentKeyFrame;
@@ -43,6 +43,7 @@ class KeyFrameDatabase;
 class LocalMapping;
 class Map;
 class MapPoint;
+class ThreadPool;
 class Tracking;
 class Viewer;
 
@@ -62,9 +63,12 @@ public:
     KeyFrameDatabase* pDB,
     ORBVocabulary*    pVoc,
     const bool        bFixScale,
-    const bool        bActiveLC
+    const bool        bActiveLC,
+    const int         nThreads = 1
   );
 
+  ~LoopClosing();
+
   void SetTracker(Tracking* pTracker);
 
   void SetLocalMapper(LocalMapping* pLocalMapper);
@@ -198,6 +202,9 @@ protected:
 
   LocalMapping* mpLocalMapper;
 
+  // Workers of the map point fusion
+  std::unique_ptr<ThreadPool> mpThreadPool;
+
   std::list<KeyFrame*> mlpLoopKeyFrameQueue;
 
   std::mutex mMutexLoopQueue;
@@ -31,6 +31,7 @@
 #include <boost/serialization/map.hpp>
 #include <opencv2/core.hpp>
 #include <spdlog/logger.h>
+#include "DescriptorArray.h"
 #include "SerializationUtils.h"
 
 namespace ORB_SLAM3 {
@@ -84,7 +85,7 @@ class MapPoint {
     // ar & mObservations;
     ar& mBackupObservationsId1;
     ar& mBackupObservationsId2;
-    serializeMatrix(ar, mDescriptor, version);
+    serializeDescriptor(ar, mDescriptor, version);
     ar& mBackupRefKFId;
     // ar & mnVisible;
     // ar & mnFound;
@@ -138,7 +139,7 @@ public:
 
   void ComputeDistinctiveDescriptors();
 
-  cv::Mat GetDescriptor();
+  Descriptor GetDescriptor();
 
   void UpdateNormalAndDepth();
 
@@ -215,7 +216,7 @@ protected:
   Eigen::Vector3f mNormalVector;
 
   // Best descriptor to fast matching
-  cv::Mat mDescriptor;
+  Descriptor mDescriptor;
 
   // Reference KeyFrame
   KeyFrame*         mpRefKF;
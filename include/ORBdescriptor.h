@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// Set the angle of every keypoint to the intensity centroid orientation of its circular patch,
+// umax[v] being the half width of the patch at row v. Results are identical to the scalar
+// IC_Angle, the patch rows masks are only built once for the whole batch.
+void ComputeOrientations(
+  const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& umax
+);
+
+// Compute the 256-bit rotated BRIEF descriptor of every keypoint into a keypoints.size() x 32
+// CV_8UC1 matrix. The sampling pattern is rotated by the exact keypoint angle, so the descriptors
+// are bit-exact with the scalar per-keypoint implementation.
+void ComputeDescriptors(
+  const cv::Mat&                   image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const std::vector<cv::Point>&    pattern,
+  cv::Mat&                         descriptors
+);
+
+// Rotate the sampling pattern to the center angle of each of nAngleBins bins covering [0, 360),
+// the rotated copies are stored one after another.
+std::vector<cv::Point> ComputeRotatedPatterns(
+  const std::vector<cv::Point>& pattern, const int nAngleBins
+);
+
+// Same as ComputeDescriptors, but the keypoint angle is quantized to the closest of the bins of
+// rotatedPatterns. Faster, but descriptors may differ by a few bits from the exact ones.
+void ComputeDescriptorsBinned(
+  const cv::Mat&                   image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const std::vector<cv::Point>&    rotatedPatterns,
+  const int                        nAngleBins,
+  cv::Mat&                         descriptors
+);
+
+} // namespace ORB_SLAM3
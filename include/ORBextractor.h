@@ -20,22 +20,37 @@
 #ifndef ORBEXTRACTOR_H
 #define ORBEXTRACTOR_H
 
-#include <list>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <opencv2/core.hpp>
 
 namespace ORB_SLAM3 {
 
-class ExtractorNode {
-public:
-  ExtractorNode();
+class ImageConditioner;
+class ThreadPool;
+
+// Quadtree node of DistributeOctTree, covering the region [UL, BR). Nodes live in an
+// ExtractorNodeArena, where they form a doubly linked list by index and reference the keypoints
+// they contain as the index range [begin, end) of the arena key indices.
+struct ExtractorNode {
+  cv::Point2i UL, BR;
+  int         begin, end;
+  int         prev, next;
+  bool        bNoMore;
+};
+
+// Storage reused by DistributeOctTree from frame to frame, one per pyramid level.
+struct ExtractorNodeArena {
+  std::vector<ExtractorNode> vNodes;
+  int                        head;
+  int                        nNodes;
 
-  void DivideNode(ExtractorNode& n1, ExtractorNode& n2, ExtractorNode& n3, ExtractorNode& n4);
+  std::vector<int> vKeyIndices;
+  std::vector<int> vScratch;
 
-  std::vector<cv::KeyPoint>          vKeys;
-  cv::Point2i                        UL, UR, BL, BR;
-  std::list<ExtractorNode>::iterator lit;
-  bool                               bNoMore;
+  std::vector<std::pair<int, int>> vSizeAndNode;
+  std::vector<std::pair<int, int>> vPrevSizeAndNode;
 };
 
 class ORBextractor {
@@ -45,7 +60,19 @@ public:
     FAST_SCORE   = 1
   };
 
-  ORBextractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAST, int minThFAST);
+  // Pyramid levels, and row bands of the large ones, are processed on the threads of pThreadPool,
+  // not owned, or on the calling thread when null. With nAngleBins > 0 descriptors use the sampling
+  // pattern pre-rotated to the closest of nAngleBins angles instead of the exact keypoint angle,
+  // which is faster but not bit-exact.
+  ORBextractor(
+    int         nfeatures,
+    float       scaleFactor,
+    int         nlevels,
+    int         iniThFAST,
+    int         minThFAST,
+    ThreadPool* pThreadPool = nullptr,
+    int         nAngleBins  = 0
+  );
 
   ~ORBextractor();
 
@@ -84,29 +111,42 @@ public:
     return mvInvLevelSigma2;
   }
 
+  // Condition the input images through pConditioner, not owned, while building level 0 of the
+  // pyramid, so that it is written straight into its bordered buffer. Keypoints are then in the
+  // coordinates of the conditioned image. Null to use the input images as they are.
+  void SetInputConditioner(const ImageConditioner* pConditioner) {
+    mpConditioner = pConditioner;
+  }
+
   std::vector<cv::Mat> mvImagePyramid;
 
 protected:
   void ComputePyramid(cv::Mat image);
   void ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint>>& allKeypoints);
-  std::vector<cv::KeyPoint> DistributeOctTree(
+  void ComputeKeyPointsOctTreeLevel(const int level, std::vector<cv::KeyPoint>& keypoints);
+  // Keeps the strongest keypoint of each quadtree cell, at most about nFeatures of them, in
+  // vResultKeys
+  void DistributeOctTree(
     const std::vector<cv::KeyPoint>& vToDistributeKeys,
     const int&                       minX,
     const int&                       maxX,
     const int&                       minY,
     const int&                       maxY,
     const int&                       nFeatures,
-    const int&                       level
+    const int&                       level,
+    std::vector<cv::KeyPoint>&       vResultKeys
   );
   void ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint>>& allKeypoints);
 
   std::vector<cv::Point> pattern;
+  std::vector<cv::Point> mvRotatedPatterns;
 
   int    nfeatures;
   double scaleFactor;
   int    nlevels;
   int    iniThFAST;
   int    minThFAST;
+  int    nAngleBins;
 
   std::vector<int> mnFeaturesPerLevel;
 
@@ -116,6 +156,24 @@ protected:
   std::vector<float> mvInvScaleFactor;
   std::vector<float> mvLevelSigma2;
   std::vector<float> mvInvLevelSigma2;
+
+  // Per-level FAST score maps, candidate keypoints and retained keypoints, reused from frame to
+  // frame.
+  std::vector<cv::Mat>                   mvFASTScores;
+  std::vector<std::vector<cv::KeyPoint>> mvToDistributeKeys;
+  std::vector<std::vector<cv::KeyPoint>> mvAllKeypoints;
+
+  // Per-level bordered images (mvImagePyramid views their interior), blurred images and descriptor
+  // storage, reused from frame to frame.
+  std::vector<cv::Mat> mvPyramidBuffers;
+  std::vector<cv::Mat> mvBlurredPyramid;
+  std::vector<cv::Mat> mvLevelDescriptors;
+
+  std::vector<ExtractorNodeArena> mvNodeArenas;
+
+  ThreadPool* mpThreadPool;
+
+  const ImageConditioner* mpConditioner = nullptr;
 };
 
 } // namespace ORB_SLAM3
@@ -25,12 +25,15 @@
 #include <Eigen/Core>
 #include <opencv2/core.hpp>
 #include <sophus/sim3.hpp>
+#include "DescriptorArray.h"
+#include "HammingDistance.h"
 
 namespace ORB_SLAM3 {
 
 class Frame;
 class KeyFrame;
 class MapPoint;
+class ThreadPool;
 
 class ORBmatcher {
 public:
@@ -39,14 +42,20 @@ public:
   // Computes the Hamming distance between two ORB descriptors
   static int DescriptorDistance(const cv::Mat& a, const cv::Mat& b);
 
+  static int DescriptorDistance(const Descriptor& a, const Descriptor& b) {
+    return HammingDistance(a.data(), b.data());
+  }
+
   // Search matches between Frame keypoints and projected MapPoints. Returns number of matches
-  // Used to track the local map (Tracking)
+  // Used to track the local map (Tracking). With a thread pool, the points are matched in parallel
+  // and the associations are the same as with the serial search.
   int SearchByProjection(
     Frame&                        F,
     const std::vector<MapPoint*>& vpMapPoints,
     const float                   th          = 3,
     const bool                    bFarPoints  = false,
-    const float                   thFarPoints = 50.0f
+    const float                   thFarPoints = 50.0f,
+    ThreadPool*                   pThreadPool = nullptr
   );
 
   // Project MapPoints tracked in last frame into the current frame and search matches.
@@ -125,21 +134,34 @@ public:
     const float             th
   );
 
-  // Project MapPoints into KeyFrame and search for duplicated MapPoints.
+  // Project MapPoints into KeyFrame and search for duplicated MapPoints. With a thread pool, the
+  // points are matched in parallel and fused in the same way as with the serial search.
   int Fuse(
     KeyFrame*                     pKF,
     const std::vector<MapPoint*>& vpMapPoints,
-    const float                   th     = 3.0,
-    const bool                    bRight = false
+    const float                   th          = 3.0,
+    const bool                    bRight      = false,
+    ThreadPool*                   pThreadPool = nullptr
   );
 
-  // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints.
+  // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints. With a
+  // thread pool, the points are matched in parallel.
   int Fuse(
     KeyFrame*                     pKF,
     Sophus::Sim3f&                Scw,
     const std::vector<MapPoint*>& vpPoints,
     float                         th,
-    std::vector<MapPoint*>&       vpReplacePoint
+    std::vector<MapPoint*>&       vpReplacePoint,
+    ThreadPool*                   pThreadPool = nullptr
+  );
+
+  // Replace every vpReplacePoint[i] found by the Sim3 Fuse by vpPoints[i] and return the number of
+  // replacements. Replacements touching disjoint points run in parallel with a thread pool, and
+  // leave the map as replacing them in order does.
+  static int ReplaceFusedPoints(
+    const std::vector<MapPoint*>& vpPoints,
+    const std::vector<MapPoint*>& vpReplacePoint,
+    ThreadPool*                   pThreadPool = nullptr
   );
 
 public:
@@ -25,10 +25,16 @@
 #include <Thirdparty/g2o/g2o/core/base_unary_edge.h>
 #include <Thirdparty/g2o/g2o/types/sim3.h>
 #include <Thirdparty/g2o/g2o/types/types_six_dof_expmap.h>
+#include "CameraModels/CameraProjection.h"
 #include "CameraModels/GeometricCamera.h"
 
 namespace ORB_SLAM3 {
 
+// The reprojection edges below project through the virtual functions of pCamera. CameraModelEdge
+// specializes them for a camera model through computeErrorAs and linearizeOplusAs, which take a
+// projection policy of CameraProjection.h. linearizeOplusAs is instantiated for every policy in
+// OptimizableTypes.cpp.
+
 class EdgeSE3ProjectXYZOnlyPose
   : public g2o::BaseUnaryEdge<2, Eigen::Vector2d, g2o::VertexSE3Expmap> {
 public:
@@ -42,9 +48,7 @@ public:
   bool write(std::ostream& os) const;
 
   void computeError() {
-    const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
-    Eigen::Vector2d             obs(_measurement);
-    _error = obs - pCamera->project(v1->estimate().map(Xw));
+    computeErrorAs<GeometricCameraProjection>();
   }
 
   bool isDepthPositive() {
@@ -52,10 +56,23 @@ public:
     return (v1->estimate().map(Xw))(2) > 0.0;
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   Eigen::Vector3d  Xw;
   GeometricCamera* pCamera;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
+    Eigen::Vector2d             obs(_measurement);
+    _error = obs - Projection::Project(pCamera, v1->estimate().map(Xw));
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeSE3ProjectXYZOnlyPoseToBody
@@ -71,9 +88,7 @@ public:
   bool write(std::ostream& os) const;
 
   void computeError() {
-    const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
-    Eigen::Vector2d             obs(_measurement);
-    _error = obs - pCamera->project((mTrl * v1->estimate()).map(Xw));
+    computeErrorAs<GeometricCameraProjection>();
   }
 
   bool isDepthPositive() {
@@ -81,12 +96,25 @@ public:
     return ((mTrl * v1->estimate()).map(Xw))(2) > 0.0;
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   Eigen::Vector3d  Xw;
   GeometricCamera* pCamera;
 
   g2o::SE3Quat mTrl;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSE3Expmap* v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[0]);
+    Eigen::Vector2d             obs(_measurement);
+    _error = obs - Projection::Project(pCamera, (mTrl * v1->estimate()).map(Xw));
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeSE3ProjectXYZ
@@ -101,10 +129,7 @@ public:
   bool write(std::ostream& os) const;
 
   void computeError() {
-    const g2o::VertexSE3Expmap*   v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
-    const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
-    Eigen::Vector2d               obs(_measurement);
-    _error = obs - pCamera->project(v1->estimate().map(v2->estimate()));
+    computeErrorAs<GeometricCameraProjection>();
   }
 
   bool isDepthPositive() {
@@ -113,9 +138,23 @@ public:
     return ((v1->estimate().map(v2->estimate()))(2) > 0.0);
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   GeometricCamera* pCamera;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSE3Expmap*   v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
+    const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
+    Eigen::Vector2d               obs(_measurement);
+    _error = obs - Projection::Project(pCamera, v1->estimate().map(v2->estimate()));
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class EdgeSE3ProjectXYZToBody
@@ -130,10 +169,7 @@ public:
   bool write(std::ostream& os) const;
 
   void computeError() {
-    const g2o::VertexSE3Expmap*   v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
-    const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
-    Eigen::Vector2d               obs(_measurement);
-    _error = obs - pCamera->project((mTrl * v1->estimate()).map(v2->estimate()));
+    computeErrorAs<GeometricCameraProjection>();
   }
 
   bool isDepthPositive() {
@@ -142,10 +178,24 @@ public:
     return ((mTrl * v1->estimate()).map(v2->estimate()))(2) > 0.0;
   }
 
-  virtual void linearizeOplus();
+  virtual void linearizeOplus() {
+    linearizeOplusAs<GeometricCameraProjection>();
+  }
 
   GeometricCamera* pCamera;
   g2o::SE3Quat     mTrl;
+
+protected:
+  template <class Projection>
+  void computeErrorAs() {
+    const g2o::VertexSE3Expmap*   v1 = static_cast<const g2o::VertexSE3Expmap*>(_vertices[1]);
+    const g2o::VertexSBAPointXYZ* v2 = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
+    Eigen::Vector2d               obs(_measurement);
+    _error = obs - Projection::Project(pCamera, (mTrl * v1->estimate()).map(v2->estimate()));
+  }
+
+  template <class Projection>
+  void linearizeOplusAs();
 };
 
 class VertexSim3Expmap : public g2o::BaseVertex<7, g2o::Sim3> {
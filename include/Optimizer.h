@@ -31,52 +31,84 @@ namespace ORB_SLAM3 {
 
 class Frame;
 class KeyFrame;
+class LocalBAGraph;
+class LocalInertialBAGraph;
 class Map;
 class MapPoint;
+class PoseSolver;
+class ThreadPool;
 
 class Optimizer {
 public:
+  // Linear solvers for the camera block of the bundle adjustments. The sparse Cholesky
+  // factorization fills in as the map grows, while the conjugate gradients preconditioned by the
+  // inverse camera blocks only touch the non-zero blocks, which pays off on large maps.
+  enum eLinearSolver {
+    CHOLESKY = 0,
+    PCG      = 1
+  };
+
+  // The bundle adjustments taking pThreadPool evaluate and linearize their edges on its threads,
+  // when given. The global ones solve their steps with linearSolverType.
   void static BundleAdjustment(
     const std::vector<KeyFrame*>& vpKF,
     const std::vector<MapPoint*>& vpMP,
-    int                           nIterations = 5,
-    bool*                         pbStopFlag  = NULL,
-    const unsigned long           nLoopKF     = 0,
-    const bool                    bRobust     = true
+    int                           nIterations      = 5,
+    bool*                         pbStopFlag       = NULL,
+    const unsigned long           nLoopKF          = 0,
+    const bool                    bRobust          = true,
+    ThreadPool*                   pThreadPool      = nullptr,
+    eLinearSolver                 linearSolverType = CHOLESKY
   );
   void static GlobalBundleAdjustemnt(
     Map*                pMap,
-    int                 nIterations = 5,
-    bool*               pbStopFlag  = NULL,
-    const unsigned long nLoopKF     = 0,
-    const bool          bRobust     = true
+    int                 nIterations      = 5,
+    bool*               pbStopFlag       = NULL,
+    const unsigned long nLoopKF          = 0,
+    const bool          bRobust          = true,
+    ThreadPool*         pThreadPool      = nullptr,
+    eLinearSolver       linearSolverType = CHOLESKY
   );
   void static FullInertialBA(
     Map*                pMap,
     int                 its,
-    const bool          bFixLocal  = false,
-    const unsigned long nLoopKF    = 0,
-    bool*               pbStopFlag = NULL,
-    bool                bInit      = false,
-    float               priorG     = 1e2,
-    float               priorA     = 1e6,
-    Eigen::VectorXd*    vSingVal   = NULL,
-    bool*               bHess      = NULL
+    const bool          bFixLocal        = false,
+    const unsigned long nLoopKF          = 0,
+    bool*               pbStopFlag       = NULL,
+    bool                bInit            = false,
+    float               priorG           = 1e2,
+    float               priorA           = 1e6,
+    Eigen::VectorXd*    vSingVal         = NULL,
+    bool*               bHess            = NULL,
+    ThreadPool*         pThreadPool      = nullptr,
+    eLinearSolver       linearSolverType = CHOLESKY
   );
 
+  // Optimizes the window on pGraph when given, which then keeps it for the next windows
   void static LocalBundleAdjustment(
-    KeyFrame* pKF,
-    bool*     pbStopFlag,
-    Map*      pMap,
-    int&      num_fixedKF,
-    int&      num_OptKF,
-    int&      num_MPs,
-    int&      num_edges
+    KeyFrame*     pKF,
+    bool*         pbStopFlag,
+    Map*          pMap,
+    int&          num_fixedKF,
+    int&          num_OptKF,
+    int&          num_MPs,
+    int&          num_edges,
+    ThreadPool*   pThreadPool = nullptr,
+    LocalBAGraph* pGraph      = nullptr
   );
 
-  int static PoseOptimization(Frame* pFrame);
-  int static PoseInertialOptimizationLastKeyFrame(Frame* pFrame, bool bRecInit = false);
-  int static PoseInertialOptimizationLastFrame(Frame* pFrame, bool bRecInit = false);
+  // Optimizes the pose of pFrame with pSolver when given, which then keeps its buffers for the next
+  // frames
+  int static PoseOptimization(Frame* pFrame, PoseSolver* pSolver = nullptr);
+  // Optimizes the IMU state of pFrame tied to the last key frame or, with its marginalization
+  // prior, to the last frame, on pSolver when given. When the last frame has no prior (mpcpi not
+  // set), its state is held fixed as the one of the last key frame is.
+  int static PoseInertialOptimizationLastKeyFrame(
+    Frame* pFrame, bool bRecInit = false, PoseSolver* pSolver = nullptr
+  );
+  int static PoseInertialOptimizationLastFrame(
+    Frame* pFrame, bool bRecInit = false, PoseSolver* pSolver = nullptr
+  );
 
   // if bFixScale is true, 6DoF optimization (stereo,rgbd), 7DoF otherwise (mono)
   void static OptimizeEssentialGraph(
@@ -120,16 +152,19 @@ public:
 
   // For inertial systems
 
+  // Optimizes the window on pGraph when given, which then keeps it for the next windows
   void static LocalInertialBA(
-    KeyFrame* pKF,
-    bool*     pbStopFlag,
-    Map*      pMap,
-    int&      num_fixedKF,
-    int&      num_OptKF,
-    int&      num_MPs,
-    int&      num_edges,
-    bool      bLarge   = false,
-    bool      bRecInit = false
+    KeyFrame*             pKF,
+    bool*                 pbStopFlag,
+    Map*                  pMap,
+    int&                  num_fixedKF,
+    int&                  num_OptKF,
+    int&                  num_MPs,
+    int&                  num_edges,
+    bool                  bLarge      = false,
+    bool                  bRecInit    = false,
+    ThreadPool*           pThreadPool = nullptr,
+    LocalInertialBAGraph* pGraph      = nullptr
   );
   void static MergeInertialBA(
     KeyFrame*                     pCurrKF,
@@ -25,6 +25,9 @@
 #include <boost/serialization/array_wrapper.hpp>
 #include <opencv2/core.hpp>
 #include <sophus/se3.hpp>
+#include "DescriptorArray.h"
+#include "FeatureGrid.h"
+#include "SharedValue.h"
 
 namespace ORB_SLAM3 {
 
@@ -108,9 +111,71 @@ void serializeMatrix(Archive& ar, const cv::Mat& mat, const unsigned int version
   }
 }
 
+// Shared values are stored as the value they hold. Loading assigns a new value instead of writing
+// into the one shared with other copies.
+template <class Archive, class T>
+void serializeSharedValue(Archive& ar, const SharedValue<T>& value, const unsigned int version) {
+  T valueAux;
+  if (Archive::is_saving::value) {
+    valueAux = value;
+  }
+
+  ar& valueAux;
+
+  if (Archive::is_loading::value) {
+    const_cast<SharedValue<T>&>(value) = std::move(valueAux);
+  }
+}
+
+// Descriptors are stored as their N x 32 matrix, so that saved maps keep the same layout
+template <class Archive>
+void serializeDescriptors(
+  Archive& ar, const SharedValue<DescriptorArray>& descriptors, const unsigned int version
+) {
+  cv::Mat mat;
+  if (Archive::is_saving::value) {
+    mat = descriptors->AsMat();
+  }
+
+  serializeMatrix(ar, mat, version);
+
+  if (Archive::is_loading::value) {
+    const_cast<SharedValue<DescriptorArray>&>(descriptors) = DescriptorArray(mat);
+  }
+}
+
+template <class Archive>
+void serializeDescriptor(Archive& ar, Descriptor& descriptor, const unsigned int version) {
+  cv::Mat mat;
+  if (Archive::is_saving::value) {
+    mat = descriptor.ToMat();
+  }
+
+  serializeMatrix(ar, mat, version);
+
+  if (Archive::is_loading::value) {
+    descriptor = mat.empty() ? Descriptor() : Descriptor::FromMat(mat);
+  }
+}
+
+// Grids are stored as their nested per cell vectors, so that saved maps keep the same layout
+template <class Archive>
+void serializeFeatureGrid(Archive& ar, SharedValue<FeatureGrid>& grid, const unsigned int version) {
+  std::vector<std::vector<std::vector<std::size_t>>> cells;
+  if (Archive::is_saving::value) {
+    cells = grid->ToCells();
+  }
+
+  ar& cells;
+
+  if (Archive::is_loading::value) {
+    grid = FeatureGrid::FromCells(cells);
+  }
+}
+
 template <class Archive>
 void serializeVectorKeyPoints(
-  Archive& ar, const std::vector<cv::KeyPoint>& vKP, const unsigned int version
+  Archive& ar, const SharedValue<std::vector<cv::KeyPoint>>& vKP, const unsigned int version
 ) {
   int NumEl;
 
@@ -150,9 +215,7 @@ void serializeVectorKeyPoints(
   }
 
   if (Archive::is_loading::value) {
-    std::vector<cv::KeyPoint>* ptr;
-    ptr  = (std::vector<cv::KeyPoint>*)(&vKP);
-    *ptr = vKPaux;
+    const_cast<SharedValue<std::vector<cv::KeyPoint>>&>(vKP) = std::move(vKPaux);
   }
 }
 
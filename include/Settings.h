@@ -155,6 +155,12 @@ public:
   float scaleFactor() {
     return scaleFactor_;
   }
+  int nExtractorThreads() {
+    return nExtractorThreads_;
+  }
+  int nDescriptorAngleBins() {
+    return nDescriptorAngleBins_;
+  }
 
   float keyFrameSize() {
     return keyFrameSize_;
@@ -296,6 +302,8 @@ private:
   float scaleFactor_;
   int   nLevels_;
   int   initThFAST_, minThFAST_;
+  int   nExtractorThreads_;
+  int   nDescriptorAngleBins_;
 
   /*
    * Viewer stuff
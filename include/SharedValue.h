@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace ORB_SLAM3 {
+
+// Immutable value shared by its copies, so that copying it only copies a pointer. The value is
+// never modified in place: writers compute a new value and assign it, which leaves the copies made
+// before with the old one. Reads go through the implicit conversion to const T&.
+template <class T>
+class SharedValue {
+public:
+  SharedValue() = default;
+
+  SharedValue(T value) : mpValue(std::make_shared<const T>(std::move(value))) {
+  }
+
+  SharedValue& operator=(T value) {
+    mpValue = std::make_shared<const T>(std::move(value));
+    return *this;
+  }
+
+  // The value, or an empty T when none has been assigned
+  const T& get() const {
+    if (!mpValue) {
+      static const T empty{};
+      return empty;
+    }
+    return *mpValue;
+  }
+
+  operator const T&() const {
+    return get();
+  }
+
+  const T* operator->() const {
+    return &get();
+  }
+
+  template <class Index>
+  decltype(auto) operator[](const Index& i) const {
+    return get()[i];
+  }
+
+  std::size_t size() const {
+    return get().size();
+  }
+
+  bool empty() const {
+    return get().empty();
+  }
+
+  auto begin() const {
+    return get().begin();
+  }
+
+  auto end() const {
+    return get().end();
+  }
+
+  // Whether this and other share the same value
+  bool SharesWith(const SharedValue& other) const {
+    return mpValue == other.mpValue;
+  }
+
+private:
+  std::shared_ptr<const T> mpValue;
+};
+
+} // namespace ORB_SLAM3
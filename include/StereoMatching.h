@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+
+namespace ORB_SLAM3 {
+
+// Keypoints of a rectified image bucketed by the rows they may match, in compressed sparse row
+// storage. A keypoint at level l covers the rows within 2 * scale(l) pixels of its own. Storage is
+// reused from frame to frame.
+class RowBuckets {
+public:
+  // Bucket vKeys over the rows [0, nRows), vScaleFactors holding the scale of every level. Within a
+  // row the keypoints are kept in increasing index order.
+  void Assign(
+    const std::vector<cv::KeyPoint>& vKeys, const std::vector<float>& vScaleFactors, const int nRows
+  );
+
+  int Rows() const {
+    return static_cast<int>(mvRowStarts.size()) - 1;
+  }
+
+  const std::size_t* RowBegin(const int row) const {
+    return mvIndices.data() + mvRowStarts[row];
+  }
+
+  const std::size_t* RowEnd(const int row) const {
+    return mvIndices.data() + mvRowStarts[row + 1];
+  }
+
+private:
+  // Keypoints of row r are mvIndices[mvRowStarts[r] .. mvRowStarts[r + 1])
+  std::vector<int>         mvRowStarts = std::vector<int>(1, 0);
+  std::vector<std::size_t> mvIndices;
+
+  // First and last row covered by every keypoint
+  std::vector<int> mvMinRows, mvMaxRows;
+};
+
+// Keypoints of an image bucketed in square cells, each cell bounded by a cone around the mean
+// bearing of its keypoints. Finds the keypoints whose bearing is close to a plane through the
+// camera center, e.g. an epipolar plane, testing only the keypoints of the cells the plane may
+// reach. Storage is reused from frame to frame.
+class BearingCells {
+public:
+  // Bucket the keypoints at vPoints, with bearings vBearings (not necessarily unit) and angular
+  // tolerances vTolerances, in cells of cellSize pixels.
+  void Assign(
+    const std::vector<cv::Point2f>&     vPoints,
+    const std::vector<Eigen::Vector3f>& vBearings,
+    const std::vector<float>&           vTolerances,
+    const int                           cellSize
+  );
+
+  // Indices of the keypoints whose bearing is within its tolerance plus tolerance of the plane
+  // with unit normal n, in increasing order.
+  void Query(const Eigen::Vector3f& n, const float tolerance, std::vector<int>& vIndices) const;
+
+private:
+  // Keypoints of cell c are mvIndices[mvCellStarts[c] .. mvCellStarts[c + 1]). Only the cells
+  // holding keypoints are stored.
+  std::vector<int> mvCellStarts = std::vector<int>(1, 0);
+  std::vector<int> mvIndices;
+
+  // Unit bearing and sine and cosine of the angular tolerance of every keypoint
+  std::vector<Eigen::Vector3f> mvUnitBearings;
+  std::vector<float>           mvSinTolerances, mvCosTolerances;
+
+  // Mean bearing of every cell, and sine and cosine of the cone half angle plus the largest
+  // tolerance of its keypoints
+  std::vector<Eigen::Vector3f> mvCellCenters;
+  std::vector<float>           mvCellSinBounds, mvCellCosBounds;
+
+  std::vector<int> mvCells;
+};
+
+// Position of the candidate matching the descriptor query among the n candidates of its epipolar
+// band, or -1. The best candidate must be within thDist and closer than ratio times the second
+// best. A lone candidate has no second best to reject it, so it must be within thLoneDist instead.
+int MatchInBand(
+  const unsigned char*        query,
+  const unsigned char* const* candidates,
+  const int                   n,
+  const float                 ratio,
+  const int                   thDist,
+  const int                   thLoneDist
+);
+
+// Sums of absolute differences between the (2w + 1) x (2w + 1) patch of left centered at (xL, y)
+// and the patches of right centered at (xR + d, y), for every d in [-L, L], into
+// distances[0 .. 2L]. Both images are CV_8UC1 and every patch must lie inside its image. Patches up
+// to 16 pixels wide with sweeps up to 32 pixels wide use SSE2, others a scalar loop.
+void PatchSADSweep(
+  const cv::Mat& left,
+  const cv::Mat& right,
+  const int      xL,
+  const int      xR,
+  const int      y,
+  const int      w,
+  const int      L,
+  int*           distances
+);
+
+// Whether the sweep of PatchSADSweep around column xR, which reads the columns [xR - L - w,
+// xR + L + w], lies inside an image cols pixels wide. The last column is kept out of reach, as the
+// stereo matching always did.
+bool PatchSADSweepFits(const int xR, const int w, const int L, const int cols);
+
+} // namespace ORB_SLAM3
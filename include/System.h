@@ -29,6 +29,7 @@
 #include <opencv2/core.hpp>
 #include <sophus/se3.hpp>
 #include <spdlog/spdlog.h>
+#include "ImageView.h"
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
 
@@ -109,6 +110,30 @@ public:
     std::string                    filename = ""
   );
 
+  // TrackStereo, TrackRGBD and TrackMonocular on images owned by the caller, which are read in
+  // place. Color images are converted to grayscale according to their format, into buffers reused
+  // from frame to frame, and released right after. Depth maps must be DEPTH16 or DEPTH32F.
+  Sophus::SE3f TrackStereo(
+    const ImageView&               left,
+    const ImageView&               right,
+    const double&                  timestamp,
+    const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(),
+    std::string                    filename = ""
+  );
+  Sophus::SE3f TrackRGBD(
+    const ImageView&               im,
+    const ImageView&               depthmap,
+    const double&                  timestamp,
+    const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(),
+    std::string                    filename = ""
+  );
+  Sophus::SE3f TrackMonocular(
+    const ImageView&               im,
+    const double&                  timestamp,
+    const std::vector<IMU::Point>& vImuMeas = std::vector<IMU::Point>(),
+    std::string                    filename = ""
+  );
+
   // This stops local mapping thread (map building) and performs only camera tracking.
   void ActivateLocalizationMode();
   // This resumes local mapping thread and performs SLAM again.
@@ -250,6 +275,9 @@ private:
 
   Settings* settings_;
 
+  // Grayscale conversions of the color images given as views, reused from frame to frame
+  cv::Mat mvViewGrayBuffers[2];
+
   std::shared_ptr<spdlog::logger> _logger;
 };
 
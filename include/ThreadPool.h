@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM3 {
+
+// Fixed set of worker threads running index-parallel loops. The calling thread takes part in the
+// work, so a pool of one thread runs everything inline and never spawns a worker.
+class ThreadPool {
+public:
+  explicit ThreadPool(const int nThreads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&)            = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int NumThreads() const {
+    return static_cast<int>(mvWorkers.size()) + 1;
+  }
+
+  // Call fn(i) for every i in [begin, end) and wait until all calls returned. Indices are handed
+  // out one at a time in increasing order, so put the most expensive items first. Calls for
+  // distinct indices may run concurrently; fn must not call ParallelFor on the same pool.
+  void ParallelFor(const int begin, const int end, const std::function<void(int)>& fn);
+
+private:
+  void WorkerLoop();
+
+  void RunJob();
+
+  std::vector<std::thread> mvWorkers;
+
+  // Serializes ParallelFor calls issued from different threads.
+  std::mutex mMutexCaller;
+
+  std::mutex              mMutex;
+  std::condition_variable mcvWork;
+  std::condition_variable mcvDone;
+
+  const std::function<void(int)>* mpJob;
+  std::atomic<int>                mnNext;
+  int                             mnEnd;
+  int                             mnBusy;
+  unsigned long                   mnGeneration;
+  bool                            mbStop;
+};
+
+// Call fn(i) for every i in [begin, end) on the threads of pThreadPool, or in increasing order on
+// the calling thread when pThreadPool is null.
+void ParallelFor(
+  ThreadPool* pThreadPool, const int begin, const int end, const std::function<void(int)>& fn
+);
+
+} // namespace ORB_SLAM3
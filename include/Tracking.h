@@ -33,20 +33,24 @@
 #include "Frame.h"
 #include "ImuTypes.h"
 #include "ORBVocabulary.h"
+#include "StereoMatching.h"
 
 namespace ORB_SLAM3 {
 
 class Atlas;
 class FrameDrawer;
 class GeometricCamera;
+class ImageConditioner;
 class KeyFrameDatabase;
 class LocalMapping;
 class LoopClosing;
 class Map;
 class MapDrawer;
 class ORBextractor;
+class PoseSolver;
 class Settings;
 class System;
+class ThreadPool;
 class Viewer;
 
 class Tracking {
@@ -62,7 +66,8 @@ public:
     const std::string& strSettingPath,
     const int          sensor,
     Settings*          settings,
-    const std::string& _nameSeq = std::string()
+    const std::string& _nameSeq = std::string(),
+    const int          nThreads = 1
   );
 
   ~Tracking();
@@ -150,6 +155,10 @@ public:
   Frame mCurrentFrame;
   Frame mLastFrame;
 
+  // Gray input of the last grab, and right input of the last stereo grab. They may be headers over
+  // the caller's pixels rather than copies, e.g. those of an ImageView that has been released since
+  // the grab returned, so they must only be read while a grab runs (the frame drawer copies them
+  // then).
   cv::Mat mImGray;
 
   // Initialization Variables (Monocular)
@@ -204,6 +213,10 @@ public:
 #endif
 
 protected:
+  // Grayscale version of im: im itself when already gray, otherwise converted into buffer, which is
+  // reused from frame to frame. The input images are only read.
+  cv::Mat ToGray(const cv::Mat& im, cv::Mat& buffer);
+
   // Main tracking function. It is independent of the input sensor.
   void Track();
 
@@ -267,10 +280,31 @@ protected:
   LocalMapping* mpLocalMapper;
   LoopClosing*  mpLoopClosing;
 
+  // Threads of feature extraction, stereo matching, the local map search and the initial bundle
+  // adjustments, shared by the extractors
+  std::unique_ptr<ThreadPool> mpThreadPool;
+
   // ORB
   ORBextractor *mpORBextractorLeft, *mpORBextractorRight;
   ORBextractor* mpIniORBextractor;
 
+  // Rectification or resize of the stereo input, run by the extractors while building their
+  // pyramids. Null when the input is used as it is.
+  std::unique_ptr<ImageConditioner> mpConditionerLeft, mpConditionerRight;
+
+  // Grayscale conversions of the left and right color images, and float conversion of the depth
+  // maps, reused from frame to frame
+  cv::Mat mvGrayBuffers[2];
+  cv::Mat mDepthBuffer;
+
+  // Right keypoints of the stereo frames bucketed by rows, or by bearing cells with two cameras,
+  // reused from frame to frame
+  RowBuckets   mRowBuckets;
+  BearingCells mBearingCells;
+
+  // Motion-only bundle adjustment of the current frame, its buffers reused from frame to frame
+  std::unique_ptr<PoseSolver> mpPoseSolver;
+
   // BoW
   ORBVocabulary*    mpORBVocabulary;
   KeyFrameDatabase* mpKeyFrameDB;
@@ -379,6 +413,7 @@ protected:
 #endif
 
 public:
+  // See mImGray
   cv::Mat mImRight;
 };
 
@@ -0,0 +1,67 @@
+#include "GeometricCamera.h"
+
+namespace ORB_SLAM3 {
+
+void GeometricCamera::projectBatch(
+  const float* x, const float* y, const float* z, const int n, float* u, float* v
+) {
+  for (int i = 0; i < n; i++) {
+    const Eigen::Vector2f uv = project(Eigen::Vector3f(x[i], y[i], z[i]));
+    u[i]                     = uv(0);
+    v[i]                     = uv(1);
+  }
+}
+
+void GeometricCamera::unprojectBatch(
+  const float* u, const float* v, const int n, float* x, float* y, float* z
+) {
+  for (int i = 0; i < n; i++) {
+    const Eigen::Vector3f ray = unprojectEig(cv::Point2f(u[i], v[i]));
+    x[i]                      = ray(0);
+    y[i]                      = ray(1);
+    z[i]                      = ray(2);
+  }
+}
+
+void GeometricCamera::projectJacBatch(
+  const float* x, const float* y, const float* z, const int n, float* jac
+) {
+  for (int i = 0; i < n; i++) {
+    const Eigen::Matrix<double, 2, 3> J = projectJac(Eigen::Vector3d(x[i], y[i], z[i]));
+    for (int r = 0; r < 2; r++) {
+      for (int c = 0; c < 3; c++) {
+        jac[(3 * r + c) * n + i] = static_cast<float>(J(r, c));
+      }
+    }
+  }
+}
+
+void GeometricCamera::unprojectKeyPoints(
+  const cv::KeyPoint* pKeys, const int n, Eigen::Vector3f* pBearings
+) {
+  std::vector<float> vu(n), vv(n), vx(n), vy(n), vz(n);
+  for (int i = 0; i < n; i++) {
+    vu[i] = pKeys[i].pt.x;
+    vv[i] = pKeys[i].pt.y;
+  }
+  unprojectBatch(vu.data(), vv.data(), n, vx.data(), vy.data(), vz.data());
+  for (int i = 0; i < n; i++) {
+    pBearings[i] = Eigen::Vector3f(vx[i], vy[i], vz[i]);
+  }
+}
+
+bool GeometricCamera::epipolarConstrain(
+  GeometricCamera*       otherCamera,
+  const cv::KeyPoint&    kp1,
+  const cv::KeyPoint&    kp2,
+  const Eigen::Vector3f& r1,
+  const Eigen::Vector3f& r2,
+  const Eigen::Matrix3f& R12,
+  const Eigen::Vector3f& t12,
+  const float            sigmaLevel,
+  const float            unc
+) {
+  return epipolarConstrain(otherCamera, kp1, kp2, R12, t12, sigmaLevel, unc);
+}
+
+} // namespace ORB_SLAM3
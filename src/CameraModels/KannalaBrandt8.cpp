@@ -18,8 +18,14 @@
  */
 
 #include "KannalaBrandt8.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <opencv2/calib3d.hpp>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "CameraProjection.h"
 #include "TwoViewReconstruction.h"
 
 // BOOST_CLASS_EXPORT_IMPLEMENT(ORB_SLAM3::KannalaBrandt8)
@@ -27,16 +33,117 @@
 namespace ORB_SLAM3 {
 // BOOST_CLASS_EXPORT_GUID(KannalaBrandt8, "KannalaBrandt8")
 
+namespace {
+
+// atan2(r, z) for r >= 0, with the minimax polynomial of the Cephes atanf on [0, tan(pi / 8)] after
+// range reduction, accurate to float precision. Unlike atan2f it only needs arithmetic and selects,
+// so the batched functions evaluate it on four points at a time.
+inline float Atan2Positive(const float r, const float z) {
+  const float az = std::abs(z);
+  const float a  = std::min(r, az);
+  const float b  = std::max(r, az);
+  float       t  = b > 0.f ? a / b : 0.f;
+
+  float base = 0.f;
+  if (t > 0.41421356f) {
+    base = static_cast<float>(CV_PI / 4);
+    t    = (t - 1.f) / (t + 1.f);
+  }
+
+  const float t2 = t * t;
+  float       p  = 8.05374449538e-2f * t2 - 1.38776856032e-1f;
+  p              = p * t2 + 1.99777106478e-1f;
+  p              = p * t2 - 3.33329491539e-1f;
+  float theta    = base + (p * t2 * t + t);
+
+  if (r > az) {
+    theta = static_cast<float>(CV_PI / 2) - theta;
+  }
+  if (z < 0.f) {
+    theta = static_cast<float>(CV_PI) - theta;
+  }
+  return theta;
+}
+
+// Distorted angle theta + k0 theta^3 + k1 theta^5 + k2 theta^7 + k3 theta^9, and its derivative
+inline float Distort(const float* k, const float theta) {
+  const float t2 = theta * theta;
+  return theta * (1.f + t2 * (k[0] + t2 * (k[1] + t2 * (k[2] + t2 * k[3]))));
+}
+
+inline float DistortDerivative(const float* k, const float theta) {
+  const float t2 = theta * theta;
+  return 1.f + t2 * (3.f * k[0] + t2 * (5.f * k[1] + t2 * (7.f * k[2] + t2 * (9.f * k[3]))));
+}
+
+#if defined(__SSE2__)
+
+inline __m128 Select(const __m128 mask, const __m128 a, const __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 Abs(const __m128 a) {
+  return _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+}
+
+inline __m128 Atan2Positive(const __m128 r, const __m128 z) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one  = _mm_set1_ps(1.f);
+  const __m128 az   = Abs(z);
+  const __m128 a    = _mm_min_ps(r, az);
+  const __m128 b    = _mm_max_ps(r, az);
+  __m128       t    = _mm_and_ps(_mm_cmpgt_ps(b, zero), _mm_div_ps(a, b));
+
+  const __m128 reduce = _mm_cmpgt_ps(t, _mm_set1_ps(0.41421356f));
+  const __m128 base   = _mm_and_ps(reduce, _mm_set1_ps(static_cast<float>(CV_PI / 4)));
+  t = Select(reduce, _mm_div_ps(_mm_sub_ps(t, one), _mm_add_ps(t, one)), t);
+
+  const __m128 t2 = _mm_mul_ps(t, t);
+  __m128       p  = _mm_mul_ps(_mm_set1_ps(8.05374449538e-2f), t2);
+  p               = _mm_sub_ps(p, _mm_set1_ps(1.38776856032e-1f));
+  p               = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(1.99777106478e-1f));
+  p               = _mm_sub_ps(_mm_mul_ps(p, t2), _mm_set1_ps(3.33329491539e-1f));
+  __m128 theta    = _mm_add_ps(base, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, t2), t), t));
+
+  const __m128 halfPi = _mm_set1_ps(static_cast<float>(CV_PI / 2));
+  const __m128 pi     = _mm_set1_ps(static_cast<float>(CV_PI));
+  theta               = Select(_mm_cmpgt_ps(r, az), _mm_sub_ps(halfPi, theta), theta);
+  theta               = Select(_mm_cmplt_ps(z, zero), _mm_sub_ps(pi, theta), theta);
+  return theta;
+}
+
+inline __m128 Distort(const float* k, const __m128 theta) {
+  const __m128 t2 = _mm_mul_ps(theta, theta);
+  __m128       p  = _mm_add_ps(_mm_set1_ps(k[2]), _mm_mul_ps(t2, _mm_set1_ps(k[3])));
+  p               = _mm_add_ps(_mm_set1_ps(k[1]), _mm_mul_ps(t2, p));
+  p               = _mm_add_ps(_mm_set1_ps(k[0]), _mm_mul_ps(t2, p));
+  return _mm_mul_ps(theta, _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(t2, p)));
+}
+
+inline __m128 DistortDerivative(const float* k, const __m128 theta) {
+  const __m128 t2 = _mm_mul_ps(theta, theta);
+  __m128       p  = _mm_add_ps(_mm_set1_ps(7.f * k[2]), _mm_mul_ps(t2, _mm_set1_ps(9.f * k[3])));
+  p               = _mm_add_ps(_mm_set1_ps(5.f * k[1]), _mm_mul_ps(t2, p));
+  p               = _mm_add_ps(_mm_set1_ps(3.f * k[0]), _mm_mul_ps(t2, p));
+  return _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(t2, p));
+}
+
+#endif
+
+} // namespace
+
 KannalaBrandt8::KannalaBrandt8() : precision(1e-6) {
   mvParameters.resize(8);
   mnId   = nNextId++;
   mnType = CAM_FISHEYE;
+  BuildThetaTable();
 }
 KannalaBrandt8::KannalaBrandt8(const std::vector<float> _vParameters)
   : GeometricCamera(_vParameters), precision(1e-6), mvLappingArea(2, 0), tvr(nullptr) {
   assert(mvParameters.size() == 8);
   mnId   = nNextId++;
   mnType = CAM_FISHEYE;
+  BuildThetaTable();
 }
 
 KannalaBrandt8::KannalaBrandt8(const std::vector<float> _vParameters, const float _precision)
@@ -44,6 +151,7 @@ KannalaBrandt8::KannalaBrandt8(const std::vector<float> _vParameters, const floa
   assert(mvParameters.size() == 8);
   mnId   = nNextId++;
   mnType = CAM_FISHEYE;
+  BuildThetaTable();
 }
 KannalaBrandt8::KannalaBrandt8(KannalaBrandt8* pKannala)
   : GeometricCamera(pKannala->mvParameters)
@@ -53,6 +161,7 @@ KannalaBrandt8::KannalaBrandt8(KannalaBrandt8* pKannala)
   assert(mvParameters.size() == 8);
   mnId   = nNextId++;
   mnType = CAM_FISHEYE;
+  BuildThetaTable();
 }
 
 cv::Point2f KannalaBrandt8::project(const cv::Point3f& p3D) {
@@ -75,23 +184,7 @@ cv::Point2f KannalaBrandt8::project(const cv::Point3f& p3D) {
 }
 
 Eigen::Vector2d KannalaBrandt8::project(const Eigen::Vector3d& v3D) {
-  const double x2_plus_y2 = v3D[0] * v3D[0] + v3D[1] * v3D[1];
-  const double theta      = atan2f(sqrtf(x2_plus_y2), v3D[2]);
-  const double psi        = atan2f(v3D[1], v3D[0]);
-
-  const double theta2 = theta * theta;
-  const double theta3 = theta * theta2;
-  const double theta5 = theta3 * theta2;
-  const double theta7 = theta5 * theta2;
-  const double theta9 = theta7 * theta2;
-  const double r      = theta + mvParameters[4] * theta3 + mvParameters[5] * theta5
-                 + mvParameters[6] * theta7 + mvParameters[7] * theta9;
-
-  Eigen::Vector2d res;
-  res[0] = mvParameters[0] * r * cos(psi) + mvParameters[2];
-  res[1] = mvParameters[1] * r * sin(psi) + mvParameters[3];
-
-  return res;
+  return KannalaBrandt8Projection::Project(mvParameters.data(), v3D);
 }
 
 Eigen::Vector2f KannalaBrandt8::project(const Eigen::Vector3f& v3D) {
@@ -143,7 +236,6 @@ Eigen::Vector3f KannalaBrandt8::unprojectEig(const cv::Point2f& p2D) {
 }
 
 cv::Point3f KannalaBrandt8::unproject(const cv::Point2f& p2D) {
-  // Use Newthon method to solve for theta with good precision (err ~ e-6)
   cv::Point2f pw(
     (p2D.x - mvParameters[2]) / mvParameters[0],
     (p2D.y - mvParameters[3]) / mvParameters[1]
@@ -153,58 +245,251 @@ cv::Point3f KannalaBrandt8::unproject(const cv::Point2f& p2D) {
   theta_d       = fminf(fmaxf(-CV_PI / 2.f, theta_d), CV_PI / 2.f);
 
   if (theta_d > 1e-8) {
-    // Compensate distortion iteratively
-    float theta = theta_d;
-
-    for (int j = 0; j < 10; j++) {
-      float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2,
-            theta8    = theta4 * theta4;
-      float k0_theta2 = mvParameters[4] * theta2, k1_theta4 = mvParameters[5] * theta4;
-      float k2_theta6 = mvParameters[6] * theta6, k3_theta8 = mvParameters[7] * theta8;
-      float theta_fix = (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - theta_d)
-                      / (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
-      theta = theta - theta_fix;
-      if (fabsf(theta_fix) < precision) {
-        break;
-      }
-    }
     // scale = theta - theta_d;
-    scale = std::tan(theta) / theta_d;
+    scale = std::tan(UndistortAngle(theta_d)) / theta_d;
   }
 
   return cv::Point3f(pw.x * scale, pw.y * scale, 1.f);
 }
 
-Eigen::Matrix<double, 2, 3> KannalaBrandt8::projectJac(const Eigen::Vector3d& v3D) {
-  double x2 = v3D[0] * v3D[0], y2 = v3D[1] * v3D[1], z2 = v3D[2] * v3D[2];
-  double r2    = x2 + y2;
-  double r     = sqrt(r2);
-  double r3    = r2 * r;
-  double theta = atan2(r, v3D[2]);
+float KannalaBrandt8::UndistortAngle(const float thetaD) const {
+  const float* k = &mvParameters[4];
+
+  // Use Newthon method to solve for theta with good precision (err ~ e-6). Starting from the table
+  // a single iteration is usually enough.
+  float theta = GuessUndistortedAngle(thetaD);
+  for (int j = 0; j < 10; j++) {
+    float theta2 = theta * theta, theta4 = theta2 * theta2, theta6 = theta4 * theta2,
+          theta8    = theta4 * theta4;
+    float k0_theta2 = k[0] * theta2, k1_theta4 = k[1] * theta4;
+    float k2_theta6 = k[2] * theta6, k3_theta8 = k[3] * theta8;
+    float theta_fix = (theta * (1 + k0_theta2 + k1_theta4 + k2_theta6 + k3_theta8) - thetaD)
+                    / (1 + 3 * k0_theta2 + 5 * k1_theta4 + 7 * k2_theta6 + 9 * k3_theta8);
+    theta = theta - theta_fix;
+    if (fabsf(theta_fix) < precision) {
+      break;
+    }
+  }
+  return theta;
+}
 
-  double theta2 = theta * theta, theta3 = theta2 * theta;
-  double theta4 = theta2 * theta2, theta5 = theta4 * theta;
-  double theta6 = theta2 * theta4, theta7 = theta6 * theta;
-  double theta8 = theta4 * theta4, theta9 = theta8 * theta;
+float KannalaBrandt8::GuessUndistortedAngle(const float thetaD) const {
+  if (mvThetaTable.empty()
+      || !std::equal(mvThetaTableK.begin(), mvThetaTableK.end(), mvParameters.begin() + 4)) {
+    return thetaD;
+  }
+  const float x = thetaD / mfThetaTableStep;
+  const int   i = std::min(static_cast<int>(x), static_cast<int>(mvThetaTable.size()) - 2);
+  return mvThetaTable[i] + (x - i) * (mvThetaTable[i + 1] - mvThetaTable[i]);
+}
 
-  double f = theta + theta3 * mvParameters[4] + theta5 * mvParameters[5] + theta7 * mvParameters[6]
-           + theta9 * mvParameters[7];
-  double fd = 1 + 3 * mvParameters[4] * theta2 + 5 * mvParameters[5] * theta4
-            + 7 * mvParameters[6] * theta6 + 9 * mvParameters[7] * theta8;
+void KannalaBrandt8::BuildThetaTable() {
+  // Steps of about 0.09 degrees, over which theta is close to linear
+  const int    kTableSize = 1025;
+  const double step       = CV_PI / 2 / (kTableSize - 1);
 
-  Eigen::Matrix<double, 2, 3> JacGood;
-  JacGood(0, 0) = mvParameters[0] * (fd * v3D[2] * x2 / (r2 * (r2 + z2)) + f * y2 / r3);
-  JacGood(1, 0) = mvParameters[1]
-                * (fd * v3D[2] * v3D[1] * v3D[0] / (r2 * (r2 + z2)) - f * v3D[1] * v3D[0] / r3);
+  const double k0 = mvParameters[4], k1 = mvParameters[5];
+  const double k2 = mvParameters[6], k3 = mvParameters[7];
 
-  JacGood(0, 1) = mvParameters[0]
-                * (fd * v3D[2] * v3D[1] * v3D[0] / (r2 * (r2 + z2)) - f * v3D[1] * v3D[0] / r3);
-  JacGood(1, 1) = mvParameters[1] * (fd * v3D[2] * y2 / (r2 * (r2 + z2)) + f * x2 / r3);
+  mfThetaTableStep = static_cast<float>(step);
+  mvThetaTable.resize(kTableSize);
+  for (int i = 0; i < 4; i++) {
+    mvThetaTableK[i] = mvParameters[4 + i];
+  }
 
-  JacGood(0, 2) = -mvParameters[0] * fd * v3D[0] / (r2 + z2);
-  JacGood(1, 2) = -mvParameters[1] * fd * v3D[1] / (r2 + z2);
+  // Newton iterations in double, starting from the angle of the previous step
+  double theta = 0.0;
+  for (int i = 0; i < kTableSize; i++) {
+    const double thetaD = i * step;
+    for (int j = 0; j < 20; j++) {
+      const double t2  = theta * theta;
+      const double f   = theta * (1 + t2 * (k0 + t2 * (k1 + t2 * (k2 + t2 * k3))));
+      const double df  = 1 + t2 * (3 * k0 + t2 * (5 * k1 + t2 * (7 * k2 + t2 * 9 * k3)));
+      const double fix = (f - thetaD) / df;
+      theta -= fix;
+      if (std::abs(fix) < 1e-12) {
+        break;
+      }
+    }
+    mvThetaTable[i] = static_cast<float>(theta);
+  }
+}
+
+Eigen::Matrix<double, 2, 3> KannalaBrandt8::projectJac(const Eigen::Vector3d& v3D) {
+  return KannalaBrandt8Projection::ProjectJac(mvParameters.data(), v3D);
+}
+
+void KannalaBrandt8::projectBatch(
+  const float* x, const float* y, const float* z, const int n, float* u, float* v
+) {
+  const float  fx = mvParameters[0], fy = mvParameters[1];
+  const float  cx = mvParameters[2], cy = mvParameters[3];
+  const float* k  = &mvParameters[4];
+
+  // The point is at angle theta from the optical axis and r * (cos(psi), sin(psi)) = (x, y), so
+  // the projection scales (x, y) by the distorted angle over r
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 vfx = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 vx    = _mm_loadu_ps(x + i);
+    const __m128 vy    = _mm_loadu_ps(y + i);
+    const __m128 r     = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+    const __m128 theta = Atan2Positive(r, _mm_loadu_ps(z + i));
+    const __m128 scale
+      = _mm_and_ps(_mm_cmpgt_ps(r, _mm_setzero_ps()), _mm_div_ps(Distort(k, theta), r));
+    _mm_storeu_ps(u + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(vfx, scale), vx), vcx));
+    _mm_storeu_ps(v + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(vfy, scale), vy), vcy));
+  }
+#endif
+  for (; i < n; i++) {
+    const float r     = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+    const float theta = Atan2Positive(r, z[i]);
+    const float scale = r > 0.f ? Distort(k, theta) / r : 0.f;
+    u[i]              = fx * scale * x[i] + cx;
+    v[i]              = fy * scale * y[i] + cy;
+  }
+}
+
+void KannalaBrandt8::unprojectBatch(
+  const float* u, const float* v, const int n, float* x, float* y, float* z
+) {
+  int i = 0;
+#if defined(__SSE2__)
+  const float  fx = mvParameters[0], fy = mvParameters[1];
+  const float  cx = mvParameters[2], cy = mvParameters[3];
+  const float* k  = &mvParameters[4];
+
+  const __m128 vfx = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy);
+  const __m128 vk0 = _mm_set1_ps(k[0]), vk1 = _mm_set1_ps(k[1]);
+  const __m128 vk2 = _mm_set1_ps(k[2]), vk3 = _mm_set1_ps(k[3]);
+  const __m128 one = _mm_set1_ps(1.f);
+
+  alignas(16) float vPwx[4], vPwy[4], vThetaD[4], vTheta[4];
+  for (; i + 4 <= n; i += 4) {
+    const __m128 pwx    = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(u + i), vcx), vfx);
+    const __m128 pwy    = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(v + i), vcy), vfy);
+    const __m128 thetaD = _mm_min_ps(
+      _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(pwx, pwx), _mm_mul_ps(pwy, pwy))),
+      _mm_set1_ps(static_cast<float>(CV_PI / 2))
+    );
+
+    // Same Newton iterations as unproject, a lane stops being updated once it has converged
+    _mm_store_ps(vThetaD, thetaD);
+    for (int l = 0; l < 4; l++) {
+      vTheta[l] = GuessUndistortedAngle(vThetaD[l]);
+    }
+    __m128 theta  = _mm_load_ps(vTheta);
+    __m128 active = _mm_cmpgt_ps(thetaD, _mm_set1_ps(1e-8f));
+    for (int j = 0; j < 10 && _mm_movemask_ps(active); j++) {
+      const __m128 theta2    = _mm_mul_ps(theta, theta);
+      const __m128 theta4    = _mm_mul_ps(theta2, theta2);
+      const __m128 theta6    = _mm_mul_ps(theta4, theta2);
+      const __m128 theta8    = _mm_mul_ps(theta4, theta4);
+      const __m128 k0_theta2 = _mm_mul_ps(vk0, theta2);
+      const __m128 k1_theta4 = _mm_mul_ps(vk1, theta4);
+      const __m128 k2_theta6 = _mm_mul_ps(vk2, theta6);
+      const __m128 k3_theta8 = _mm_mul_ps(vk3, theta8);
+
+      __m128 num = _mm_add_ps(_mm_add_ps(one, k0_theta2), k1_theta4);
+      num        = _mm_add_ps(_mm_add_ps(num, k2_theta6), k3_theta8);
+      num        = _mm_sub_ps(_mm_mul_ps(theta, num), thetaD);
+      __m128 den = _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(3.f), k0_theta2));
+      den        = _mm_add_ps(den, _mm_mul_ps(_mm_set1_ps(5.f), k1_theta4));
+      den        = _mm_add_ps(den, _mm_mul_ps(_mm_set1_ps(7.f), k2_theta6));
+      den        = _mm_add_ps(den, _mm_mul_ps(_mm_set1_ps(9.f), k3_theta8));
+
+      const __m128 theta_fix = _mm_div_ps(num, den);
+      theta  = _mm_sub_ps(theta, _mm_and_ps(active, theta_fix));
+      active = _mm_and_ps(active, _mm_cmpge_ps(Abs(theta_fix), _mm_set1_ps(precision)));
+    }
 
-  return JacGood;
+    _mm_store_ps(vPwx, pwx);
+    _mm_store_ps(vPwy, pwy);
+    _mm_store_ps(vTheta, theta);
+    for (int l = 0; l < 4; l++) {
+      const float scale = vThetaD[l] > 1e-8f ? std::tan(vTheta[l]) / vThetaD[l] : 1.f;
+      x[i + l]          = vPwx[l] * scale;
+      y[i + l]          = vPwy[l] * scale;
+      z[i + l]          = 1.f;
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    const cv::Point3f ray = KannalaBrandt8::unproject(cv::Point2f(u[i], v[i]));
+    x[i]                  = ray.x;
+    y[i]                  = ray.y;
+    z[i]                  = ray.z;
+  }
+}
+
+void KannalaBrandt8::projectJacBatch(
+  const float* x, const float* y, const float* z, const int n, float* jac
+) {
+  const float  fx = mvParameters[0], fy = mvParameters[1];
+  const float* k  = &mvParameters[4];
+
+  float* J00 = jac;
+  float* J01 = jac + n;
+  float* J02 = jac + 2 * n;
+  float* J10 = jac + 3 * n;
+  float* J11 = jac + 4 * n;
+  float* J12 = jac + 5 * n;
+
+  // Same terms as projectJac: with a = fd z / (r2 (r2 + z2)), b = f / r3 and c = fd / (r2 + z2),
+  // du/dx = fx (a x2 + b y2), du/dy = fx xy (a - b) and du/dz = -fx c x, and likewise for v
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 vfx  = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vnfx = _mm_set1_ps(-fx), vnfy = _mm_set1_ps(-fy);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 vx    = _mm_loadu_ps(x + i);
+    const __m128 vy    = _mm_loadu_ps(y + i);
+    const __m128 vz    = _mm_loadu_ps(z + i);
+    const __m128 x2    = _mm_mul_ps(vx, vx);
+    const __m128 y2    = _mm_mul_ps(vy, vy);
+    const __m128 xy    = _mm_mul_ps(vx, vy);
+    const __m128 r2    = _mm_add_ps(x2, y2);
+    const __m128 r     = _mm_sqrt_ps(r2);
+    const __m128 d2    = _mm_add_ps(r2, _mm_mul_ps(vz, vz));
+    const __m128 theta = Atan2Positive(r, vz);
+    const __m128 fd    = DistortDerivative(k, theta);
+
+    const __m128 a  = _mm_div_ps(_mm_mul_ps(fd, vz), _mm_mul_ps(r2, d2));
+    const __m128 b  = _mm_div_ps(Distort(k, theta), _mm_mul_ps(r2, r));
+    const __m128 c  = _mm_div_ps(fd, d2);
+    const __m128 ab = _mm_mul_ps(xy, _mm_sub_ps(a, b));
+    _mm_storeu_ps(J00 + i, _mm_mul_ps(vfx, _mm_add_ps(_mm_mul_ps(a, x2), _mm_mul_ps(b, y2))));
+    _mm_storeu_ps(J01 + i, _mm_mul_ps(vfx, ab));
+    _mm_storeu_ps(J02 + i, _mm_mul_ps(_mm_mul_ps(vnfx, c), vx));
+    _mm_storeu_ps(J10 + i, _mm_mul_ps(vfy, ab));
+    _mm_storeu_ps(J11 + i, _mm_mul_ps(vfy, _mm_add_ps(_mm_mul_ps(a, y2), _mm_mul_ps(b, x2))));
+    _mm_storeu_ps(J12 + i, _mm_mul_ps(_mm_mul_ps(vnfy, c), vy));
+  }
+#endif
+  for (; i < n; i++) {
+    const float x2    = x[i] * x[i];
+    const float y2    = y[i] * y[i];
+    const float xy    = x[i] * y[i];
+    const float r2    = x2 + y2;
+    const float r     = std::sqrt(r2);
+    const float d2    = r2 + z[i] * z[i];
+    const float theta = Atan2Positive(r, z[i]);
+    const float fd    = DistortDerivative(k, theta);
+
+    const float a  = fd * z[i] / (r2 * d2);
+    const float b  = Distort(k, theta) / (r2 * r);
+    const float c  = fd / d2;
+    const float ab = xy * (a - b);
+    J00[i]         = fx * (a * x2 + b * y2);
+    J01[i]         = fx * ab;
+    J02[i]         = -fx * c * x[i];
+    J10[i]         = fy * ab;
+    J11[i]         = fy * (a * y2 + b * x2);
+    J12[i]         = -fy * c * y[i];
+  }
 }
 
 bool KannalaBrandt8::ReconstructWithTwoViews(
@@ -272,6 +557,22 @@ bool KannalaBrandt8::epipolarConstrain(
   return this->TriangulateMatches(pCamera2, kp1, kp2, R12, t12, sigmaLevel, unc, p3D) > 0.0001f;
 }
 
+bool KannalaBrandt8::epipolarConstrain(
+  GeometricCamera*       pCamera2,
+  const cv::KeyPoint&    kp1,
+  const cv::KeyPoint&    kp2,
+  const Eigen::Vector3f& r1,
+  const Eigen::Vector3f& r2,
+  const Eigen::Matrix3f& R12,
+  const Eigen::Vector3f& t12,
+  const float            sigmaLevel,
+  const float            unc
+) {
+  Eigen::Vector3f p3D;
+  return this->TriangulateBearings(pCamera2, kp1, kp2, r1, r2, R12, t12, sigmaLevel, unc, p3D)
+       > 0.0001f;
+}
+
 bool KannalaBrandt8::matchAndtriangulate(
   const cv::KeyPoint& kp1,
   const cv::KeyPoint& kp2,
@@ -371,9 +672,24 @@ float KannalaBrandt8::TriangulateMatches(
   const float            unc,
   Eigen::Vector3f&       p3D
 ) {
-  Eigen::Vector3f r1 = this->unprojectEig(kp1.pt);
-  Eigen::Vector3f r2 = pCamera2->unprojectEig(kp2.pt);
+  const Eigen::Vector3f r1 = this->unprojectEig(kp1.pt);
+  const Eigen::Vector3f r2 = pCamera2->unprojectEig(kp2.pt);
 
+  return TriangulateBearings(pCamera2, kp1, kp2, r1, r2, R12, t12, sigmaLevel, unc, p3D);
+}
+
+float KannalaBrandt8::TriangulateBearings(
+  GeometricCamera*       pCamera2,
+  const cv::KeyPoint&    kp1,
+  const cv::KeyPoint&    kp2,
+  const Eigen::Vector3f& r1,
+  const Eigen::Vector3f& r2,
+  const Eigen::Matrix3f& R12,
+  const Eigen::Vector3f& t12,
+  const float            sigmaLevel,
+  const float            unc,
+  Eigen::Vector3f&       p3D
+) {
   // Check parallax
   Eigen::Vector3f r21 = R12 * r2;
 
@@ -453,6 +769,7 @@ std::istream& operator>>(std::istream& is, KannalaBrandt8& kb) {
     is >> nextParam;
     kb.mvParameters[i] = nextParam;
   }
+  kb.BuildThetaTable();
   return is;
 }
 
@@ -19,6 +19,10 @@
 
 #include "Pinhole.h"
 #include <cassert>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "CameraProjection.h"
 #include "TwoViewReconstruction.h"
 
 // BOOST_CLASS_EXPORT_IMPLEMENT(ORB_SLAM3::Pinhole)
@@ -60,11 +64,7 @@ cv::Point2f Pinhole::project(const cv::Point3f& p3D) {
 }
 
 Eigen::Vector2d Pinhole::project(const Eigen::Vector3d& v3D) {
-  Eigen::Vector2d res;
-  res[0] = mvParameters[0] * v3D[0] / v3D[2] + mvParameters[2];
-  res[1] = mvParameters[1] * v3D[1] / v3D[2] + mvParameters[3];
-
-  return res;
+  return PinholeProjection::Project(mvParameters.data(), v3D);
 }
 
 Eigen::Vector2f Pinhole::project(const Eigen::Vector3f& v3D) {
@@ -101,15 +101,92 @@ cv::Point3f Pinhole::unproject(const cv::Point2f& p2D) {
 }
 
 Eigen::Matrix<double, 2, 3> Pinhole::projectJac(const Eigen::Vector3d& v3D) {
-  Eigen::Matrix<double, 2, 3> Jac;
-  Jac(0, 0) = mvParameters[0] / v3D[2];
-  Jac(0, 1) = 0.f;
-  Jac(0, 2) = -mvParameters[0] * v3D[0] / (v3D[2] * v3D[2]);
-  Jac(1, 0) = 0.f;
-  Jac(1, 1) = mvParameters[1] / v3D[2];
-  Jac(1, 2) = -mvParameters[1] * v3D[1] / (v3D[2] * v3D[2]);
-
-  return Jac;
+  return PinholeProjection::ProjectJac(mvParameters.data(), v3D);
+}
+
+void Pinhole::projectBatch(
+  const float* x, const float* y, const float* z, const int n, float* u, float* v
+) {
+  const float fx = mvParameters[0], fy = mvParameters[1];
+  const float cx = mvParameters[2], cy = mvParameters[3];
+
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 vfx = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 vz = _mm_loadu_ps(z + i);
+    _mm_storeu_ps(u + i, _mm_add_ps(_mm_div_ps(_mm_mul_ps(vfx, _mm_loadu_ps(x + i)), vz), vcx));
+    _mm_storeu_ps(v + i, _mm_add_ps(_mm_div_ps(_mm_mul_ps(vfy, _mm_loadu_ps(y + i)), vz), vcy));
+  }
+#endif
+  for (; i < n; i++) {
+    u[i] = fx * x[i] / z[i] + cx;
+    v[i] = fy * y[i] / z[i] + cy;
+  }
+}
+
+void Pinhole::unprojectBatch(
+  const float* u, const float* v, const int n, float* x, float* y, float* z
+) {
+  const float fx = mvParameters[0], fy = mvParameters[1];
+  const float cx = mvParameters[2], cy = mvParameters[3];
+
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 vfx = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vcx = _mm_set1_ps(cx), vcy = _mm_set1_ps(cy);
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(x + i, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(u + i), vcx), vfx));
+    _mm_storeu_ps(y + i, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(v + i), vcy), vfy));
+    _mm_storeu_ps(z + i, _mm_set1_ps(1.f));
+  }
+#endif
+  for (; i < n; i++) {
+    x[i] = (u[i] - cx) / fx;
+    y[i] = (v[i] - cy) / fy;
+    z[i] = 1.f;
+  }
+}
+
+void Pinhole::projectJacBatch(
+  const float* x, const float* y, const float* z, const int n, float* jac
+) {
+  const float fx = mvParameters[0], fy = mvParameters[1];
+
+  float* J00 = jac;
+  float* J01 = jac + n;
+  float* J02 = jac + 2 * n;
+  float* J10 = jac + 3 * n;
+  float* J11 = jac + 4 * n;
+  float* J12 = jac + 5 * n;
+
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 vfx  = _mm_set1_ps(fx), vfy = _mm_set1_ps(fy);
+  const __m128 vnfx = _mm_set1_ps(-fx), vnfy = _mm_set1_ps(-fy);
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= n; i += 4) {
+    const __m128 invz  = _mm_div_ps(_mm_set1_ps(1.f), _mm_loadu_ps(z + i));
+    const __m128 invz2 = _mm_mul_ps(invz, invz);
+    _mm_storeu_ps(J00 + i, _mm_mul_ps(vfx, invz));
+    _mm_storeu_ps(J01 + i, zero);
+    _mm_storeu_ps(J02 + i, _mm_mul_ps(_mm_mul_ps(vnfx, _mm_loadu_ps(x + i)), invz2));
+    _mm_storeu_ps(J10 + i, zero);
+    _mm_storeu_ps(J11 + i, _mm_mul_ps(vfy, invz));
+    _mm_storeu_ps(J12 + i, _mm_mul_ps(_mm_mul_ps(vnfy, _mm_loadu_ps(y + i)), invz2));
+  }
+#endif
+  for (; i < n; i++) {
+    const float invz  = 1.f / z[i];
+    const float invz2 = invz * invz;
+    J00[i]            = fx * invz;
+    J01[i]            = 0.f;
+    J02[i]            = -fx * x[i] * invz2;
+    J10[i]            = 0.f;
+    J11[i]            = fy * invz;
+    J12[i]            = -fy * y[i] * invz2;
+  }
 }
 
 bool Pinhole::ReconstructWithTwoViews(
@@ -0,0 +1,62 @@
+#include "DescriptorArray.h"
+#include <cstring>
+
+namespace ORB_SLAM3 {
+
+Descriptor Descriptor::FromMat(const cv::Mat& row) {
+  CV_Assert(row.type() == CV_8UC1 && row.rows == 1 && row.cols == kBytes);
+  Descriptor descriptor;
+  std::memcpy(descriptor.data(), row.ptr<unsigned char>(), kBytes);
+  return descriptor;
+}
+
+cv::Mat Descriptor::ToMat() const {
+  cv::Mat row(1, kBytes, CV_8UC1);
+  std::memcpy(row.ptr<unsigned char>(), data(), kBytes);
+  return row;
+}
+
+DescriptorArray::DescriptorArray(const cv::Mat& descriptors) {
+  Assign(descriptors);
+}
+
+void DescriptorArray::Assign(const cv::Mat& descriptors) {
+  if (descriptors.empty()) {
+    mvDescriptors.clear();
+    return;
+  }
+
+  CV_Assert(descriptors.type() == CV_8UC1 && descriptors.cols == Descriptor::kBytes);
+  mvDescriptors.resize(descriptors.rows);
+  if (descriptors.isContinuous()) {
+    std::memcpy(
+      mvDescriptors.data(), descriptors.ptr<unsigned char>(), descriptors.rows * Descriptor::kBytes
+    );
+  } else {
+    for (int i = 0; i < descriptors.rows; i++) {
+      std::memcpy(mvDescriptors[i].data(), descriptors.ptr<unsigned char>(i), Descriptor::kBytes);
+    }
+  }
+}
+
+void DescriptorArray::Append(const DescriptorArray& other) {
+  mvDescriptors.insert(mvDescriptors.end(), other.mvDescriptors.begin(), other.mvDescriptors.end());
+}
+
+cv::Mat DescriptorArray::AsMat() const {
+  if (mvDescriptors.empty()) {
+    return cv::Mat();
+  }
+  return cv::Mat(
+    static_cast<int>(mvDescriptors.size()),
+    Descriptor::kBytes,
+    CV_8UC1,
+    const_cast<unsigned char*>(mvDescriptors.front().data())
+  );
+}
+
+cv::Mat DescriptorArray::ToMat() const {
+  return AsMat().clone();
+}
+
+} // namespace ORB_SLAM3
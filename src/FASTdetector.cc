@@ -0,0 +1,315 @@
+#include "FASTdetector.h"
+#include <algorithm>
+#include <climits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+// Bresenham circle of radius 3, in the same order as cv::FAST.
+const int kCircle[16][2] = {
+  { 0,  3},
+  { 1,  3},
+  { 2,  2},
+  { 3,  1},
+  { 3,  0},
+  { 3, -1},
+  { 2, -2},
+  { 1, -3},
+  { 0, -3},
+  {-1, -3},
+  {-2, -2},
+  {-3, -1},
+  {-3,  0},
+  {-3,  1},
+  {-2,  2},
+  {-1,  3}
+};
+
+void MakeOffsets(int offsets[16], const int step) {
+  for (int k = 0; k < 16; k++) {
+    offsets[k] = kCircle[k][0] + kCircle[k][1] * step;
+  }
+}
+
+// Largest contrast m such that an arc of 9 contiguous circle pixels is entirely more than m - 1
+// darker or brighter than the center. The pixel is a corner at threshold t iff m > t, and its
+// cv::FAST score is then m - 1.
+int ArcContrast(const uchar* ptr, const int offsets[16]) {
+  const int v = ptr[0];
+  int       d[25];
+  for (int k = 0; k < 16; k++) {
+    d[k] = v - ptr[offsets[k]];
+  }
+  for (int k = 16; k < 25; k++) {
+    d[k] = d[k - 16];
+  }
+
+  int a0 = INT_MIN, b0 = INT_MAX;
+  for (int k = 0; k < 16; k++) {
+    int a = d[k], b = d[k];
+    for (int j = 1; j < 9; j++) {
+      a = std::min(a, d[k + j]);
+      b = std::max(b, d[k + j]);
+    }
+    a0 = std::max(a0, a);
+    b0 = std::min(b0, b);
+  }
+
+  return std::max(a0, -b0);
+}
+
+inline uchar Score(const uchar* ptr, const int offsets[16], const int threshold) {
+  const int m = ArcContrast(ptr, offsets);
+  return m > threshold ? static_cast<uchar>(m - 1) : 0;
+}
+
+void ScoreRowScalar(
+  const uchar* row, uchar* out, int x, const int xEnd, const int offsets[16], const int threshold
+) {
+  for (; x < xEnd; x++) {
+    const uchar* ptr = row + x;
+    const int    vHi = ptr[0] + threshold;
+    const int    vLo = ptr[0] - threshold;
+
+    // Any arc of 9 pixels covers two consecutive compass points.
+    const int p0 = ptr[offsets[0]], p4 = ptr[offsets[4]];
+    const int p8 = ptr[offsets[8]], p12 = ptr[offsets[12]];
+    const bool bBright = (p0 > vHi || p8 > vHi) && (p4 > vHi || p12 > vHi);
+    const bool bDark   = (p0 < vLo || p8 < vLo) && (p4 < vLo || p12 < vLo);
+
+    out[x] = (bBright || bDark) ? Score(ptr, offsets, threshold) : 0;
+  }
+}
+
+#if defined(__AVX2__)
+
+inline __m256i Arc9(const __m256i m[16]) {
+  __m256i a2[16], a4[16];
+  for (int k = 0; k < 16; k++) {
+    a2[k] = _mm256_and_si256(m[k], m[(k + 1) & 15]);
+  }
+  for (int k = 0; k < 16; k++) {
+    a4[k] = _mm256_and_si256(a2[k], a2[(k + 2) & 15]);
+  }
+  __m256i r = _mm256_setzero_si256();
+  for (int k = 0; k < 16; k++) {
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_and_si256(a4[k], a4[(k + 4) & 15]), m[(k + 8) & 15]));
+  }
+  return r;
+}
+
+// Process 32 pixels per iteration. Returns the first column left for the scalar path.
+int ScoreRowAVX2(
+  const uchar* row, uchar* out, int x, const int xEnd, const int offsets[16], const int threshold
+) {
+  const __m256i delta = _mm256_set1_epi8(static_cast<char>(-128));
+  const __m256i t     = _mm256_set1_epi8(static_cast<char>(threshold));
+
+  for (; x + 32 <= xEnd; x += 32) {
+    const uchar*  ptr = row + x;
+    const __m256i v0  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+    const __m256i vHi = _mm256_xor_si256(_mm256_adds_epu8(v0, t), delta);
+    const __m256i vLo = _mm256_xor_si256(_mm256_subs_epu8(v0, t), delta);
+
+    __m256i bright[16], dark[16];
+    auto    compare = [&](const int k) {
+      const __m256i p = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + offsets[k])),
+        delta
+      );
+      bright[k] = _mm256_cmpgt_epi8(p, vHi);
+      dark[k]   = _mm256_cmpgt_epi8(vLo, p);
+    };
+
+    for (int k = 0; k < 16; k += 4) {
+      compare(k);
+    }
+    const __m256i quick = _mm256_or_si256(
+      _mm256_and_si256(_mm256_or_si256(bright[0], bright[8]), _mm256_or_si256(bright[4], bright[12])),
+      _mm256_and_si256(_mm256_or_si256(dark[0], dark[8]), _mm256_or_si256(dark[4], dark[12]))
+    );
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_setzero_si256());
+    if (_mm256_movemask_epi8(quick) == 0) {
+      continue;
+    }
+
+    for (int k = 0; k < 16; k++) {
+      if (k % 4 != 0) {
+        compare(k);
+      }
+    }
+    unsigned int mask = static_cast<unsigned int>(
+      _mm256_movemask_epi8(_mm256_or_si256(Arc9(bright), Arc9(dark)))
+    );
+    while (mask) {
+      const int lane   = __builtin_ctz(mask);
+      out[x + lane]    = Score(ptr + lane, offsets, threshold);
+      mask            &= mask - 1;
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+#if defined(__SSE2__)
+
+inline __m128i Arc9(const __m128i m[16]) {
+  __m128i a2[16], a4[16];
+  for (int k = 0; k < 16; k++) {
+    a2[k] = _mm_and_si128(m[k], m[(k + 1) & 15]);
+  }
+  for (int k = 0; k < 16; k++) {
+    a4[k] = _mm_and_si128(a2[k], a2[(k + 2) & 15]);
+  }
+  __m128i r = _mm_setzero_si128();
+  for (int k = 0; k < 16; k++) {
+    r = _mm_or_si128(r, _mm_and_si128(_mm_and_si128(a4[k], a4[(k + 4) & 15]), m[(k + 8) & 15]));
+  }
+  return r;
+}
+
+// Process 16 pixels per iteration. Returns the first column left for the scalar path.
+int ScoreRowSSE2(
+  const uchar* row, uchar* out, int x, const int xEnd, const int offsets[16], const int threshold
+) {
+  const __m128i delta = _mm_set1_epi8(static_cast<char>(-128));
+  const __m128i t     = _mm_set1_epi8(static_cast<char>(threshold));
+
+  for (; x + 16 <= xEnd; x += 16) {
+    const uchar*  ptr = row + x;
+    const __m128i v0  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const __m128i vHi = _mm_xor_si128(_mm_adds_epu8(v0, t), delta);
+    const __m128i vLo = _mm_xor_si128(_mm_subs_epu8(v0, t), delta);
+
+    __m128i bright[16], dark[16];
+    auto    compare = [&](const int k) {
+      const __m128i p
+        = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + offsets[k])), delta);
+      bright[k] = _mm_cmpgt_epi8(p, vHi);
+      dark[k]   = _mm_cmpgt_epi8(vLo, p);
+    };
+
+    for (int k = 0; k < 16; k += 4) {
+      compare(k);
+    }
+    const __m128i quick = _mm_or_si128(
+      _mm_and_si128(_mm_or_si128(bright[0], bright[8]), _mm_or_si128(bright[4], bright[12])),
+      _mm_and_si128(_mm_or_si128(dark[0], dark[8]), _mm_or_si128(dark[4], dark[12]))
+    );
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_setzero_si128());
+    if (_mm_movemask_epi8(quick) == 0) {
+      continue;
+    }
+
+    for (int k = 0; k < 16; k++) {
+      if (k % 4 != 0) {
+        compare(k);
+      }
+    }
+    unsigned int mask
+      = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(Arc9(bright), Arc9(dark))));
+    while (mask) {
+      const int lane   = __builtin_ctz(mask);
+      out[x + lane]    = Score(ptr + lane, offsets, threshold);
+      mask            &= mask - 1;
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+} // namespace
+
+void ComputeFASTScores(
+  const cv::Mat& image, cv::Mat& scores, const int threshold, const int rowBegin, const int rowEnd
+) {
+  CV_Assert(image.type() == CV_8UC1 && scores.type() == CV_8UC1 && scores.size() == image.size());
+
+  const int th   = std::clamp(threshold, 1, 255);
+  const int rows = image.rows;
+  const int cols = image.cols;
+
+  int offsets[16];
+  MakeOffsets(offsets, static_cast<int>(image.step));
+
+  for (int y = std::max(rowBegin, 0); y < std::min(rowEnd, rows); y++) {
+    uchar* out = scores.ptr<uchar>(y);
+    if (y < 3 || y >= rows - 3 || cols < 7) {
+      std::fill(out, out + cols, 0);
+      continue;
+    }
+
+    const uchar* row = image.ptr<uchar>(y);
+    std::fill(out, out + 3, 0);
+    std::fill(out + cols - 3, out + cols, 0);
+
+    int x = 3;
+#if defined(__AVX2__)
+    x = ScoreRowAVX2(row, out, x, cols - 3, offsets, th);
+#endif
+#if defined(__SSE2__)
+    x = ScoreRowSSE2(row, out, x, cols - 3, offsets, th);
+#endif
+    ScoreRowScalar(row, out, x, cols - 3, offsets, th);
+  }
+}
+
+int DetectFASTInCell(
+  const cv::Mat&             scores,
+  const cv::Rect&            cell,
+  const int                  threshold,
+  const cv::Point2f&         offset,
+  std::vector<cv::KeyPoint>& keypoints
+) {
+  // cv::FAST only detects corners whose circle fits in the region, and suppresses non-maxima
+  // against neighbours of that same area.
+  const int x0 = std::max(cell.x, 0) + 3;
+  const int y0 = std::max(cell.y, 0) + 3;
+  const int x1 = std::min(cell.x + cell.width, scores.cols) - 3;
+  const int y1 = std::min(cell.y + cell.height, scores.rows) - 3;
+  const int th = std::clamp(threshold, 1, 255);
+
+  const auto neighbour = [&](const int y, const int x) -> int {
+    if (y < y0 || y >= y1 || x < x0 || x >= x1) {
+      return 0;
+    }
+    const int s = scores.ptr<uchar>(y)[x];
+    return s >= th ? s : 0;
+  };
+
+  const std::size_t nIni = keypoints.size();
+  for (int y = y0; y < y1; y++) {
+    const uchar* row = scores.ptr<uchar>(y);
+    for (int x = x0; x < x1; x++) {
+      const int s = row[x];
+      if (s < th) {
+        continue;
+      }
+
+      if (s > neighbour(y - 1, x - 1) && s > neighbour(y - 1, x) && s > neighbour(y - 1, x + 1)
+          && s > neighbour(y, x - 1) && s > neighbour(y, x + 1) && s > neighbour(y + 1, x - 1)
+          && s > neighbour(y + 1, x) && s > neighbour(y + 1, x + 1)) {
+        keypoints.emplace_back(
+          cv::Point2f(
+            static_cast<float>(x - cell.x) + offset.x, static_cast<float>(y - cell.y) + offset.y
+          ),
+          7.f,
+          -1.f,
+          static_cast<float>(s)
+        );
+      }
+    }
+  }
+
+  return static_cast<int>(keypoints.size() - nIni);
+}
+
+} // namespace ORB_SLAM3
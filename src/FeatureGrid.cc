@@ -0,0 +1,79 @@
+#include "FeatureGrid.h"
+#include <algorithm>
+
+namespace ORB_SLAM3 {
+
+FeatureGrid::FeatureGrid(const int nCols, const int nRows)
+  : mnCols(nCols), mnRows(nRows), mvCellStarts(nCols * nRows + 1, 0) {
+}
+
+FeatureGrid FeatureGrid::FromCells(
+  const std::vector<std::vector<std::vector<std::size_t>>>& cells
+) {
+  const int   nCols = static_cast<int>(cells.size());
+  const int   nRows = nCols > 0 ? static_cast<int>(cells[0].size()) : 0;
+  FeatureGrid grid(nCols, nRows);
+
+  std::size_t n = 0;
+  for (const std::vector<std::vector<std::size_t>>& column : cells) {
+    for (const std::vector<std::size_t>& cell : column) {
+      for (const std::size_t idx : cell) {
+        n = std::max(n, idx + 1);
+      }
+    }
+  }
+
+  std::vector<int> vCells(n, -1);
+  for (int x = 0; x < nCols; x++) {
+    for (int y = 0; y < nRows; y++) {
+      for (const std::size_t idx : cells[x][y]) {
+        vCells[idx] = grid.CellIndex(x, y);
+      }
+    }
+  }
+  grid.Assign(vCells);
+  return grid;
+}
+
+std::vector<std::vector<std::vector<std::size_t>>> FeatureGrid::ToCells() const {
+  std::vector<std::vector<std::vector<std::size_t>>> cells(
+    mnCols, std::vector<std::vector<std::size_t>>(mnRows)
+  );
+  for (int x = 0; x < mnCols; x++) {
+    for (int y = 0; y < mnRows; y++) {
+      cells[x][y].assign(ColumnBegin(x, y), ColumnEnd(x, y));
+    }
+  }
+  return cells;
+}
+
+void FeatureGrid::Assign(const std::vector<int>& vCells) {
+  const int nCells = mnCols * mnRows;
+
+  // Count the indices of each cell, then turn the counts into cell ends
+  mvCellStarts.assign(nCells + 1, 0);
+  for (const int cell : vCells) {
+    if (cell >= 0) {
+      mvCellStarts[cell + 1]++;
+    }
+  }
+  for (int c = 0; c < nCells; c++) {
+    mvCellStarts[c + 1] += mvCellStarts[c];
+  }
+
+  // Place the indices backwards from the cell ends, which keeps the indices of a cell in increasing
+  // order and leaves the start of cell c in mvCellStarts[c + 1]
+  const int n = mvCellStarts[nCells];
+  mvIndices.resize(n);
+  for (int i = static_cast<int>(vCells.size()) - 1; i >= 0; i--) {
+    if (vCells[i] >= 0) {
+      mvIndices[--mvCellStarts[vCells[i] + 1]] = i;
+    }
+  }
+  for (int c = 0; c < nCells; c++) {
+    mvCellStarts[c] = mvCellStarts[c + 1];
+  }
+  mvCellStarts[nCells] = n;
+}
+
+} // namespace ORB_SLAM3
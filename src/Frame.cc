@@ -26,10 +26,13 @@
 #include <opencv2/imgproc.hpp>
 #include "Converter.h"
 #include "GeometricCamera.h"
+#include "HammingDistance.h"
 #include "LoggingUtils.h"
 #include "MapPoint.h"
 #include "ORBextractor.h"
 #include "ORBmatcher.h"
+#include "StereoMatching.h"
+#include "ThreadPool.h"
 
 namespace ORB_SLAM3 {
 
@@ -39,9 +42,6 @@ float             Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Fram
 float             Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
 float             Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
 
-// For stereo fisheye matching
-cv::BFMatcher Frame::BFmatcher = cv::BFMatcher(cv::NORM_HAMMING);
-
 Frame::Frame()
   : mpcpi(NULL)
   , mpImuPreintegrated(NULL)
@@ -80,12 +80,13 @@ Frame::Frame(const Frame& frame)
   , mvDepth(frame.mvDepth)
   , mBowVec(frame.mBowVec)
   , mFeatVec(frame.mFeatVec)
-  , mDescriptors(frame.mDescriptors.clone())
-  , mDescriptorsRight(frame.mDescriptorsRight.clone())
+  , mDescriptors(frame.mDescriptors)
+  , mDescriptorsRight(frame.mDescriptorsRight)
   , mvpMapPoints(frame.mvpMapPoints)
   , mvbOutlier(frame.mvbOutlier)
   , mImuCalib(frame.mImuCalib)
   , mnCloseMPs(frame.mnCloseMPs)
+  , mGrid(frame.mGrid)
   , mpImuPreintegrated(frame.mpImuPreintegrated)
   , mpImuPreintegratedFrame(frame.mpImuPreintegratedFrame)
   , mImuBias(frame.mImuBias)
@@ -114,6 +115,7 @@ Frame::Frame(const Frame& frame)
   , mvLeftToRightMatch(frame.mvLeftToRightMatch)
   , mvRightToLeftMatch(frame.mvRightToLeftMatch)
   , mvStereo3Dpoints(frame.mvStereo3Dpoints)
+  , mGridRight(frame.mGridRight)
   , mTlr(frame.mTlr)
   , mRlr(frame.mRlr)
   , mtlr(frame.mtlr)
@@ -121,15 +123,6 @@ Frame::Frame(const Frame& frame)
   , mTcw(frame.mTcw)
   , mbHasPose(false)
   , mbHasVelocity(false) {
-  for (int i = 0; i < FRAME_GRID_COLS; i++) {
-    for (int j = 0; j < FRAME_GRID_ROWS; j++) {
-      mGrid[i][j] = frame.mGrid[i][j];
-      if (frame.Nleft > 0) {
-        mGridRight[i][j] = frame.mGridRight[i][j];
-      }
-    }
-  }
-
   if (frame.mbHasPose) {
     SetPose(frame.GetPose());
   }
@@ -160,7 +153,9 @@ Frame::Frame(
   const float&      thDepth,
   GeometricCamera*  pCamera,
   Frame*            pPrevF,
-  const IMU::Calib& ImuCalib
+  const IMU::Calib& ImuCalib,
+  ThreadPool*       pThreadPool,
+  RowBuckets*       pRowBuckets
 )
   : mpcpi(NULL)
   , mpORBvocabulary(voc)
@@ -222,7 +217,7 @@ Frame::Frame(
 #ifdef REGISTER_TIMES
   std::chrono::steady_clock::time_point time_StartStereoMatches = std::chrono::steady_clock::now();
 #endif
-  ComputeStereoMatches();
+  ComputeStereoMatches(pThreadPool, pRowBuckets);
 #ifdef REGISTER_TIMES
   std::chrono::steady_clock::time_point time_EndStereoMatches = std::chrono::steady_clock::now();
 
@@ -239,7 +234,8 @@ Frame::Frame(
 
   // This is done only for the first Frame (or after a change in the calibration)
   if (mbInitialComputations) {
-    ComputeImageBounds(imLeft);
+    // Level 0 holds the image the keypoints were extracted from, conditioned by the extractor
+    ComputeImageBounds(mpORBextractorLeft->mvImagePyramid[0]);
 
     mfGridElementWidthInv  = static_cast<float>(FRAME_GRID_COLS) / (mnMaxX - mnMinX);
     mfGridElementHeightInv = static_cast<float>(FRAME_GRID_ROWS) / (mnMaxY - mnMinY);
@@ -522,19 +518,13 @@ Frame::Frame(
 }
 
 void Frame::AssignFeaturesToGrid() {
-  // Fill matrix with points
-  const int nCells = FRAME_GRID_COLS * FRAME_GRID_ROWS;
-
-  int nReserve = 0.5f * N / (nCells);
+  FeatureGrid grid(FRAME_GRID_COLS, FRAME_GRID_ROWS);
+  FeatureGrid gridRight(FRAME_GRID_COLS, FRAME_GRID_ROWS);
 
-  for (unsigned int i = 0; i < FRAME_GRID_COLS; i++) {
-    for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++) {
-      mGrid[i][j].reserve(nReserve);
-      if (Nleft != -1) {
-        mGridRight[i][j].reserve(nReserve);
-      }
-    }
-  }
+  // Cell of every keypoint, then bucket them all at once
+  const int        nLeft = (Nleft == -1) ? N : Nleft;
+  std::vector<int> vCells(nLeft, -1);
+  std::vector<int> vCellsRight(N - nLeft, -1);
 
   for (int i = 0; i < N; i++) {
     const cv::KeyPoint& kp = (Nleft == -1) ? mvKeysUn[i]
@@ -543,21 +533,32 @@ void Frame::AssignFeaturesToGrid() {
 
     int nGridPosX, nGridPosY;
     if (PosInGrid(kp, nGridPosX, nGridPosY)) {
-      if (Nleft == -1 || i < Nleft) {
-        mGrid[nGridPosX][nGridPosY].push_back(i);
+      if (i < nLeft) {
+        vCells[i] = grid.CellIndex(nGridPosX, nGridPosY);
       } else {
-        mGridRight[nGridPosX][nGridPosY].push_back(i - Nleft);
+        vCellsRight[i - nLeft] = gridRight.CellIndex(nGridPosX, nGridPosY);
       }
     }
   }
+
+  grid.Assign(vCells);
+  gridRight.Assign(vCellsRight);
+  mGrid      = std::move(grid);
+  mGridRight = std::move(gridRight);
 }
 
 void Frame::ExtractORB(int flag, const cv::Mat& im, const int x0, const int x1) {
-  std::vector<int> vLapping = {x0, x1};
+  std::vector<int>          vLapping = {x0, x1};
+  std::vector<cv::KeyPoint> vKeys;
+  cv::Mat                   descriptors;
   if (flag == 0) {
-    monoLeft = (*mpORBextractorLeft)(im, cv::Mat(), mvKeys, mDescriptors, vLapping);
+    monoLeft     = (*mpORBextractorLeft)(im, cv::Mat(), vKeys, descriptors, vLapping);
+    mvKeys       = std::move(vKeys);
+    mDescriptors = DescriptorArray(descriptors);
   } else {
-    monoRight = (*mpORBextractorRight)(im, cv::Mat(), mvKeysRight, mDescriptorsRight, vLapping);
+    monoRight         = (*mpORBextractorRight)(im, cv::Mat(), vKeys, descriptors, vLapping);
+    mvKeysRight       = std::move(vKeys);
+    mDescriptorsRight = DescriptorArray(descriptors);
   }
 }
 
@@ -648,76 +649,142 @@ bool Frame::isInFrustum(MapPoint* pMP, float viewingCosLimit) {
     pMP->mTrackProjY   = -1;
 
     // 3D in absolute coordinates
-    Eigen::Matrix<float, 3, 1> P = pMP->GetWorldPos();
+    const Eigen::Vector3f P = pMP->GetWorldPos();
 
     // 3D in camera coordinates
-    const Eigen::Matrix<float, 3, 1> Pc      = mRcw * P + mtcw;
-    const float                      Pc_dist = Pc.norm();
-
-    // Check positive depth
-    const float& PcZ  = Pc(2);
-    const float  invz = 1.0f / PcZ;
-    if (PcZ < 0.0f) {
-      return false;
-    }
+    const Eigen::Vector3f Pc = mRcw * P + mtcw;
 
-    const Eigen::Vector2f uv = mpCamera->project(Pc);
+    return isInFrustumProjected(pMP, P, Pc, mpCamera->project(Pc), viewingCosLimit);
+  } else {
+    pMP->mbTrackInView      = false;
+    pMP->mbTrackInViewR     = false;
+    pMP->mnTrackScaleLevel  = -1;
+    pMP->mnTrackScaleLevelR = -1;
 
-    if (uv(0) < mnMinX || uv(0) > mnMaxX) {
-      return false;
-    }
-    if (uv(1) < mnMinY || uv(1) > mnMaxY) {
-      return false;
-    }
+    pMP->mbTrackInView  = isInFrustumChecks(pMP, viewingCosLimit);
+    pMP->mbTrackInViewR = isInFrustumChecks(pMP, viewingCosLimit, true);
 
-    pMP->mTrackProjX = uv(0);
-    pMP->mTrackProjY = uv(1);
+    return pMP->mbTrackInView || pMP->mbTrackInViewR;
+  }
+}
 
-    // Check distance is in the scale invariance region of the MapPoint
-    const float           maxDistance = pMP->GetMaxDistanceInvariance();
-    const float           minDistance = pMP->GetMinDistanceInvariance();
-    const Eigen::Vector3f PO          = P - mOw;
-    const float           dist        = PO.norm();
+void Frame::isInFrustum(
+  const std::vector<MapPoint*>& vpMPs, float viewingCosLimit, std::vector<bool>& vbInFrustum
+) {
+  const int n = static_cast<int>(vpMPs.size());
+  vbInFrustum.assign(n, false);
 
-    if (dist < minDistance || dist > maxDistance) {
-      return false;
+  // 3D in absolute coordinates
+  std::vector<Eigen::Vector3f> vP(n);
+  for (int i = 0; i < n; i++) {
+    vP[i] = vpMPs[i]->GetWorldPos();
+  }
+
+  // Project in the left camera, and then in the right one for a fisheye stereo pair
+  std::vector<float> vx(n), vy(n), vz(n), vu(n), vv(n);
+  const int          nCameras = Nleft == -1 ? 1 : 2;
+  for (int cam = 0; cam < nCameras; cam++) {
+    const bool      bRight = cam == 1;
+    Eigen::Matrix3f R      = mRcw;
+    Eigen::Vector3f t      = mtcw;
+    if (bRight) {
+      const Eigen::Matrix3f Rrl = mTrl.rotationMatrix();
+      R                         = Rrl * mRcw;
+      t                         = Rrl * mtcw + mTrl.translation();
     }
 
-    // Check viewing angle
-    Eigen::Vector3f Pn = pMP->GetNormal();
+    for (int i = 0; i < n; i++) {
+      const Eigen::Vector3f Pc = R * vP[i] + t;
+      vx[i]                    = Pc(0);
+      vy[i]                    = Pc(1);
+      vz[i]                    = Pc(2);
+    }
+    GeometricCamera* pCamera = bRight ? mpCamera2 : mpCamera;
+    pCamera->projectBatch(vx.data(), vy.data(), vz.data(), n, vu.data(), vv.data());
+
+    for (int i = 0; i < n; i++) {
+      MapPoint*             pMP = vpMPs[i];
+      const Eigen::Vector3f Pc(vx[i], vy[i], vz[i]);
+      const Eigen::Vector2f uv(vu[i], vv[i]);
+      if (Nleft == -1) {
+        pMP->mbTrackInView = false;
+        pMP->mTrackProjX   = -1;
+        pMP->mTrackProjY   = -1;
+        vbInFrustum[i]     = isInFrustumProjected(pMP, vP[i], Pc, uv, viewingCosLimit);
+      } else if (!bRight) {
+        pMP->mbTrackInViewR     = false;
+        pMP->mnTrackScaleLevel  = -1;
+        pMP->mnTrackScaleLevelR = -1;
+
+        pMP->mbTrackInView = isInFrustumChecks(pMP, vP[i], Pc, uv, viewingCosLimit, false);
+      } else {
+        pMP->mbTrackInViewR = isInFrustumChecks(pMP, vP[i], Pc, uv, viewingCosLimit, true);
+        vbInFrustum[i]      = pMP->mbTrackInView || pMP->mbTrackInViewR;
+      }
+    }
+  }
+}
 
-    const float viewCos = PO.dot(Pn) / dist;
+bool Frame::isInFrustumProjected(
+  MapPoint*              pMP,
+  const Eigen::Vector3f& P,
+  const Eigen::Vector3f& Pc,
+  const Eigen::Vector2f& uv,
+  float                  viewingCosLimit
+) {
+  const float Pc_dist = Pc.norm();
 
-    if (viewCos < viewingCosLimit) {
-      return false;
-    }
+  // Check positive depth
+  const float& PcZ  = Pc(2);
+  const float  invz = 1.0f / PcZ;
+  if (PcZ < 0.0f) {
+    return false;
+  }
 
-    // Predict scale in the image
-    const int nPredictedLevel = pMP->PredictScale(dist, this);
+  if (uv(0) < mnMinX || uv(0) > mnMaxX) {
+    return false;
+  }
+  if (uv(1) < mnMinY || uv(1) > mnMaxY) {
+    return false;
+  }
 
-    // Data used by the tracking
-    pMP->mbTrackInView = true;
-    pMP->mTrackProjX   = uv(0);
-    pMP->mTrackProjXR  = uv(0) - mbf * invz;
+  pMP->mTrackProjX = uv(0);
+  pMP->mTrackProjY = uv(1);
 
-    pMP->mTrackDepth = Pc_dist;
+  // Check distance is in the scale invariance region of the MapPoint
+  const float           maxDistance = pMP->GetMaxDistanceInvariance();
+  const float           minDistance = pMP->GetMinDistanceInvariance();
+  const Eigen::Vector3f PO          = P - mOw;
+  const float           dist        = PO.norm();
 
-    pMP->mTrackProjY       = uv(1);
-    pMP->mnTrackScaleLevel = nPredictedLevel;
-    pMP->mTrackViewCos     = viewCos;
+  if (dist < minDistance || dist > maxDistance) {
+    return false;
+  }
 
-    return true;
-  } else {
-    pMP->mbTrackInView      = false;
-    pMP->mbTrackInViewR     = false;
-    pMP->mnTrackScaleLevel  = -1;
-    pMP->mnTrackScaleLevelR = -1;
+  // Check viewing angle
+  Eigen::Vector3f Pn = pMP->GetNormal();
 
-    pMP->mbTrackInView  = isInFrustumChecks(pMP, viewingCosLimit);
-    pMP->mbTrackInViewR = isInFrustumChecks(pMP, viewingCosLimit, true);
+  const float viewCos = PO.dot(Pn) / dist;
 
-    return pMP->mbTrackInView || pMP->mbTrackInViewR;
+  if (viewCos < viewingCosLimit) {
+    return false;
   }
+
+  // Predict scale in the image
+  const int nPredictedLevel = pMP->PredictScale(dist, this);
+
+  // Data used by the tracking
+  pMP->mbTrackInView = true;
+  pMP->mTrackProjX   = uv(0);
+  pMP->mTrackProjXR  = uv(0) - mbf * invz;
+
+  pMP->mTrackDepth = Pc_dist;
+
+  pMP->mTrackProjY       = uv(1);
+  pMP->mnTrackScaleLevel = nPredictedLevel;
+  pMP->mTrackViewCos     = viewCos;
+
+  return true;
 }
 
 bool Frame::ProjectPointDistort(MapPoint* pMP, cv::Point2f& kp, float& u, float& v) {
@@ -794,7 +861,20 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(
   const bool   bRight
 ) const {
   std::vector<std::size_t> vIndices;
-  vIndices.reserve(N);
+  GetFeaturesInArea(x, y, r, minLevel, maxLevel, bRight, vIndices);
+  return vIndices;
+}
+
+void Frame::GetFeaturesInArea(
+  const float&              x,
+  const float&              y,
+  const float&              r,
+  const int                 minLevel,
+  const int                 maxLevel,
+  const bool                bRight,
+  std::vector<std::size_t>& vIndices
+) const {
+  vIndices.clear();
 
   float factorX = r;
   float factorY = r;
@@ -802,7 +882,7 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(
   const int nMinCellX
     = std::max(0, (int)std::floor((x - mnMinX - factorX) * mfGridElementWidthInv));
   if (nMinCellX >= FRAME_GRID_COLS) {
-    return vIndices;
+    return;
   }
 
   const int nMaxCellX = std::min(
@@ -810,13 +890,13 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(
     (int)std::ceil((x - mnMinX + factorX) * mfGridElementWidthInv)
   );
   if (nMaxCellX < 0) {
-    return vIndices;
+    return;
   }
 
   const int nMinCellY
     = std::max(0, (int)std::floor((y - mnMinY - factorY) * mfGridElementHeightInv));
   if (nMinCellY >= FRAME_GRID_ROWS) {
-    return vIndices;
+    return;
   }
 
   const int nMaxCellY = std::min(
@@ -824,44 +904,39 @@ std::vector<std::size_t> Frame::GetFeaturesInArea(
     (int)std::ceil((y - mnMinY + factorY) * mfGridElementHeightInv)
   );
   if (nMaxCellY < 0) {
-    return vIndices;
+    return;
   }
 
   const bool bCheckLevels = (minLevel > 0) || (maxLevel >= 0);
 
+  // The cells of a column are contiguous in the grid
+  const FeatureGrid& grid = (!bRight) ? mGrid : mGridRight;
   for (int ix = nMinCellX; ix <= nMaxCellX; ix++) {
-    for (int iy = nMinCellY; iy <= nMaxCellY; iy++) {
-      const std::vector<std::size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-      if (vCell.empty()) {
-        continue;
-      }
-
-      for (std::size_t j = 0, jend = vCell.size(); j < jend; j++) {
-        const cv::KeyPoint& kpUn = (Nleft == -1) ? mvKeysUn[vCell[j]]
-                                 : (!bRight)     ? mvKeys[vCell[j]]
-                                                 : mvKeysRight[vCell[j]];
-        if (bCheckLevels) {
-          if (kpUn.octave < minLevel) {
+    const std::size_t* pEnd = grid.ColumnEnd(ix, nMaxCellY);
+    for (const std::size_t* pIdx = grid.ColumnBegin(ix, nMinCellY); pIdx != pEnd; pIdx++) {
+      const std::size_t   idx  = *pIdx;
+      const cv::KeyPoint& kpUn = (Nleft == -1) ? mvKeysUn[idx]
+                               : (!bRight)     ? mvKeys[idx]
+                                               : mvKeysRight[idx];
+      if (bCheckLevels) {
+        if (kpUn.octave < minLevel) {
+          continue;
+        }
+        if (maxLevel >= 0) {
+          if (kpUn.octave > maxLevel) {
             continue;
           }
-          if (maxLevel >= 0) {
-            if (kpUn.octave > maxLevel) {
-              continue;
-            }
-          }
         }
+      }
 
-        const float distx = kpUn.pt.x - x;
-        const float disty = kpUn.pt.y - y;
+      const float distx = kpUn.pt.x - x;
+      const float disty = kpUn.pt.y - y;
 
-        if (std::fabs(distx) < factorX && std::fabs(disty) < factorY) {
-          vIndices.push_back(vCell[j]);
-        }
+      if (std::fabs(distx) < factorX && std::fabs(disty) < factorY) {
+        vIndices.push_back(idx);
       }
     }
   }
-
-  return vIndices;
 }
 
 bool Frame::PosInGrid(const cv::KeyPoint& kp, int& posX, int& posY) {
@@ -878,8 +953,12 @@ bool Frame::PosInGrid(const cv::KeyPoint& kp, int& posX, int& posY) {
 
 void Frame::ComputeBoW() {
   if (mBowVec.empty()) {
-    std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-    mpORBvocabulary->transform(vCurrentDesc, mBowVec, mFeatVec, 4);
+    std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors->AsMat());
+    DBoW2::BowVector     bowVec;
+    DBoW2::FeatureVector featVec;
+    mpORBvocabulary->transform(vCurrentDesc, bowVec, featVec, 4);
+    mBowVec  = std::move(bowVec);
+    mFeatVec = std::move(featVec);
   }
 }
 
@@ -903,13 +982,14 @@ void Frame::UndistortKeyPoints() {
   mat = mat.reshape(1);
 
   // Fill undistorted keypoint vector
-  mvKeysUn.resize(N);
+  std::vector<cv::KeyPoint> vKeysUn(N);
   for (int i = 0; i < N; i++) {
     cv::KeyPoint kp = mvKeys[i];
     kp.pt.x         = mat.at<float>(i, 0);
     kp.pt.y         = mat.at<float>(i, 1);
-    mvKeysUn[i]     = kp;
+    vKeysUn[i]      = kp;
   }
+  mvKeysUn = std::move(vKeysUn);
 }
 
 void Frame::ComputeImageBounds(const cv::Mat& imLeft) {
@@ -941,129 +1021,120 @@ void Frame::ComputeImageBounds(const cv::Mat& imLeft) {
   }
 }
 
-void Frame::ComputeStereoMatches() {
-  mvuRight = std::vector<float>(N, -1.0f);
-  mvDepth  = std::vector<float>(N, -1.0f);
+void Frame::ComputeStereoMatches(ThreadPool* pThreadPool, RowBuckets* pRowBuckets) {
+  std::vector<float> vuRight(N, -1.0f);
+  std::vector<float> vDepth(N, -1.0f);
 
   const int thOrbDist = (ORBmatcher::TH_HIGH + ORBmatcher::TH_LOW) / 2;
 
   const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
-  // Assign keypoints to row table
-  std::vector<std::vector<std::size_t>> vRowIndices(nRows, std::vector<std::size_t>());
-
-  for (int i = 0; i < nRows; i++) {
-    vRowIndices[i].reserve(200);
-  }
-
-  const int Nr = mvKeysRight.size();
-
-  for (int iR = 0; iR < Nr; iR++) {
-    const cv::KeyPoint& kp   = mvKeysRight[iR];
-    const float&        kpY  = kp.pt.y;
-    const float         r    = 2.0f * mvScaleFactors[mvKeysRight[iR].octave];
-    const int           maxr = std::ceil(kpY + r);
-    const int           minr = std::floor(kpY - r);
-
-    for (int yi = minr; yi <= maxr; yi++) {
-      vRowIndices[yi].push_back(iR);
-    }
-  }
+  // Assign keypoints to row table, reusing the storage of the previous frames when given
+  RowBuckets  ownRowBuckets;
+  RowBuckets& rowBuckets = pRowBuckets ? *pRowBuckets : ownRowBuckets;
+  rowBuckets.Assign(mvKeysRight, mvScaleFactors, nRows);
 
   // Set limits for search
   const float minZ = mb;
   const float minD = 0;
   const float maxD = mbf / minZ;
 
-  // For each left keypoint search a match in the right image
-  std::vector<std::pair<int, int>> vDistIdx;
-  vDistIdx.reserve(N);
+  // Half size of the correlation window and half range of its sliding search
+  const int w = 5;
+  const int L = 5;
 
-  for (int iL = 0; iL < N; iL++) {
-    const cv::KeyPoint& kpL    = mvKeys[iL];
-    const int&          levelL = kpL.octave;
-    const float&        vL     = kpL.pt.y;
-    const float&        uL     = kpL.pt.x;
+  // Correlation distance of the match of every left keypoint, -1 if it has none
+  std::vector<int> vMatchDist(N, -1);
 
-    const std::vector<std::size_t>& vCandidates = vRowIndices[vL];
+  // For each left keypoint search a match in the right image. Keypoints are matched independently,
+  // in blocks spread over the threads of pThreadPool.
+  const int  kBlockSize = 64;
+  const auto MatchBlock = [&](const int block) {
+    std::vector<const unsigned char*> vpCandidates;
+    std::vector<std::size_t>          vCandidateIndices;
 
-    if (vCandidates.empty()) {
-      continue;
-    }
+    const int end = std::min(N, (block + 1) * kBlockSize);
+    for (int iL = block * kBlockSize; iL < end; iL++) {
+      const cv::KeyPoint& kpL    = mvKeys[iL];
+      const int&          levelL = kpL.octave;
+      const float&        vL     = kpL.pt.y;
+      const float&        uL     = kpL.pt.x;
 
-    const float minU = uL - maxD;
-    const float maxU = uL - minD;
+      const float minU = uL - maxD;
+      const float maxU = uL - minD;
 
-    if (maxU < 0) {
-      continue;
-    }
+      if (maxU < 0) {
+        continue;
+      }
 
-    int         bestDist = ORBmatcher::TH_HIGH;
-    std::size_t bestIdxR = 0;
+      // Right keypoints in the same rows, within one level and in the disparity range
+      vpCandidates.clear();
+      vCandidateIndices.clear();
+      const int row = static_cast<int>(vL);
+      for (const std::size_t* it = rowBuckets.RowBegin(row); it != rowBuckets.RowEnd(row); ++it) {
+        const cv::KeyPoint& kpR = mvKeysRight[*it];
 
-    const cv::Mat& dL = mDescriptors.row(iL);
+        if (kpR.octave < levelL - 1 || kpR.octave > levelL + 1) {
+          continue;
+        }
 
-    // Compare descriptor to right keypoints
-    for (std::size_t iC = 0; iC < vCandidates.size(); iC++) {
-      const std::size_t   iR  = vCandidates[iC];
-      const cv::KeyPoint& kpR = mvKeysRight[iR];
+        const float& uR = kpR.pt.x;
 
-      if (kpR.octave < levelL - 1 || kpR.octave > levelL + 1) {
-        continue;
+        if (uR >= minU && uR <= maxU) {
+          vpCandidates.push_back(mDescriptorsRight[*it].data());
+          vCandidateIndices.push_back(*it);
+        }
       }
 
-      const float& uR = kpR.pt.x;
+      if (vpCandidates.empty()) {
+        continue;
+      }
 
-      if (uR >= minU && uR <= maxU) {
-        const cv::Mat& dR   = mDescriptorsRight.row(iR);
-        const int      dist = ORBmatcher::DescriptorDistance(dL, dR);
+      // Compare descriptor to right keypoints
+      const HammingMatch match = FindBestHamming(
+        mDescriptors[iL].data(), vpCandidates.data(), static_cast<int>(vpCandidates.size())
+      );
 
-        if (dist < bestDist) {
-          bestDist = dist;
-          bestIdxR = iR;
-        }
+      // Subpixel match by correlation
+      if (match.bestDist >= thOrbDist) {
+        continue;
       }
-    }
 
-    // Subpixel match by correlation
-    if (bestDist < thOrbDist) {
       // coordinates in image pyramid at keypoint scale
-      const float uR0         = mvKeysRight[bestIdxR].pt.x;
-      const float scaleFactor = mvInvScaleFactors[kpL.octave];
-      const float scaleduL    = std::round(kpL.pt.x * scaleFactor);
-      const float scaledvL    = std::round(kpL.pt.y * scaleFactor);
-      const float scaleduR0   = std::round(uR0 * scaleFactor);
+      const std::size_t bestIdxR    = vCandidateIndices[match.bestIdx];
+      const float       uR0         = mvKeysRight[bestIdxR].pt.x;
+      const float       scaleFactor = mvInvScaleFactors[kpL.octave];
+      const float       scaleduL    = std::round(kpL.pt.x * scaleFactor);
+      const float       scaledvL    = std::round(kpL.pt.y * scaleFactor);
+      const float       scaleduR0   = std::round(uR0 * scaleFactor);
 
       // sliding window search
-      const int w  = 5;
-      cv::Mat   IL = mpORBextractorLeft->mvImagePyramid[kpL.octave]
-                     .rowRange(scaledvL - w, scaledvL + w + 1)
-                     .colRange(scaleduL - w, scaleduL + w + 1);
-
-      int                bestDist = INT_MAX;
-      int                bestincR = 0;
-      const int          L        = 5;
-      std::vector<float> vDists;
-      vDists.resize(2 * L + 1);
-
-      const float iniu = scaleduR0 + L - w;
-      const float endu = scaleduR0 + L + w + 1;
-      if (iniu < 0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols) {
+      const cv::Mat& imLeft  = mpORBextractorLeft->mvImagePyramid[kpL.octave];
+      const cv::Mat& imRight = mpORBextractorRight->mvImagePyramid[kpL.octave];
+
+      if (!PatchSADSweepFits(static_cast<int>(scaleduR0), w, L, imRight.cols)) {
         continue;
       }
 
-      for (int incR = -L; incR <= +L; incR++) {
-        cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave]
-                       .rowRange(scaledvL - w, scaledvL + w + 1)
-                       .colRange(scaleduR0 + incR - w, scaleduR0 + incR + w + 1);
+      int vDists[2 * L + 1];
+      PatchSADSweep(
+        imLeft,
+        imRight,
+        static_cast<int>(scaleduL),
+        static_cast<int>(scaleduR0),
+        static_cast<int>(scaledvL),
+        w,
+        L,
+        vDists
+      );
 
-        float dist = cv::norm(IL, IR, cv::NORM_L1);
-        if (dist < bestDist) {
-          bestDist = dist;
+      int bestDist = INT_MAX;
+      int bestincR = 0;
+      for (int incR = -L; incR <= +L; incR++) {
+        if (vDists[L + incR] < bestDist) {
+          bestDist = vDists[L + incR];
           bestincR = incR;
         }
-
-        vDists[L + incR] = dist;
       }
 
       if (bestincR == -L || bestincR == L) {
@@ -1091,30 +1162,45 @@ void Frame::ComputeStereoMatches() {
           disparity = 0.01;
           bestuR    = uL - 0.01;
         }
-        mvDepth[iL]  = mbf / disparity;
-        mvuRight[iL] = bestuR;
-        vDistIdx.push_back(std::pair<int, int>(bestDist, iL));
+        vDepth[iL]     = mbf / disparity;
+        vuRight[iL]    = bestuR;
+        vMatchDist[iL] = bestDist;
       }
     }
+  };
+  const int nBlocks = (N + kBlockSize - 1) / kBlockSize;
+  ParallelFor(pThreadPool, 0, nBlocks, MatchBlock);
+
+  std::vector<std::pair<int, int>> vDistIdx;
+  vDistIdx.reserve(N);
+  for (int iL = 0; iL < N; iL++) {
+    if (vMatchDist[iL] >= 0) {
+      vDistIdx.push_back(std::pair<int, int>(vMatchDist[iL], iL));
+    }
   }
 
-  std::sort(vDistIdx.begin(), vDistIdx.end());
-  const float median = vDistIdx[vDistIdx.size() / 2].first;
-  const float thDist = 1.5f * 1.4f * median;
+  if (!vDistIdx.empty()) {
+    std::sort(vDistIdx.begin(), vDistIdx.end());
+    const float median = vDistIdx[vDistIdx.size() / 2].first;
+    const float thDist = 1.5f * 1.4f * median;
 
-  for (int i = vDistIdx.size() - 1; i >= 0; i--) {
-    if (vDistIdx[i].first < thDist) {
-      break;
-    } else {
-      mvuRight[vDistIdx[i].second] = -1;
-      mvDepth[vDistIdx[i].second]  = -1;
+    for (int i = vDistIdx.size() - 1; i >= 0; i--) {
+      if (vDistIdx[i].first < thDist) {
+        break;
+      } else {
+        vuRight[vDistIdx[i].second] = -1;
+        vDepth[vDistIdx[i].second]  = -1;
+      }
     }
   }
+
+  mvuRight = std::move(vuRight);
+  mvDepth  = std::move(vDepth);
 }
 
 void Frame::ComputeStereoFromRGBD(const cv::Mat& imDepth) {
-  mvuRight = std::vector<float>(N, -1);
-  mvDepth  = std::vector<float>(N, -1);
+  std::vector<float> vuRight(N, -1);
+  std::vector<float> vDepth(N, -1);
 
   for (int i = 0; i < N; i++) {
     const cv::KeyPoint& kp  = mvKeys[i];
@@ -1126,10 +1212,13 @@ void Frame::ComputeStereoFromRGBD(const cv::Mat& imDepth) {
     const float d = imDepth.at<float>(v, u);
 
     if (d > 0) {
-      mvDepth[i]  = d;
-      mvuRight[i] = kpU.pt.x - mbf / d;
+      vDepth[i]  = d;
+      vuRight[i] = kpU.pt.x - mbf / d;
     }
   }
+
+  mvuRight = std::move(vuRight);
+  mvDepth  = std::move(vDepth);
 }
 
 bool Frame::UnprojectStereo(const int& i, Eigen::Vector3f& x3D) {
@@ -1172,7 +1261,9 @@ Frame::Frame(
   GeometricCamera*  pCamera2,
   Sophus::SE3f&     Tlr,
   Frame*            pPrevF,
-  const IMU::Calib& ImuCalib
+  const IMU::Calib& ImuCalib,
+  ThreadPool*       pThreadPool,
+  BearingCells*     pBearingCells
 )
   : mpcpi(NULL)
   , mpORBvocabulary(voc)
@@ -1196,9 +1287,6 @@ Frame::Frame(
   , mbHasVelocity(false)
 
 {
-  imgLeft  = imLeft.clone();
-  imgRight = imRight.clone();
-
   // Frame ID
   mnId = nNextId++;
 
@@ -1252,7 +1340,8 @@ Frame::Frame(
 
   // This is done only for the first Frame (or after a change in the calibration)
   if (mbInitialComputations) {
-    ComputeImageBounds(imLeft);
+    // Level 0 holds the image the keypoints were extracted from, conditioned by the extractor
+    ComputeImageBounds(mpORBextractorLeft->mvImagePyramid[0]);
 
     mfGridElementWidthInv  = static_cast<float>(FRAME_GRID_COLS) / (mnMaxX - mnMinX);
     mfGridElementHeightInv = static_cast<float>(FRAME_GRID_ROWS) / (mnMaxY - mnMinY);
@@ -1278,7 +1367,7 @@ Frame::Frame(
 #ifdef REGISTER_TIMES
   std::chrono::steady_clock::time_point time_StartStereoMatches = std::chrono::steady_clock::now();
 #endif
-  ComputeStereoFishEyeMatches();
+  ComputeStereoFishEyeMatches(pThreadPool, pBearingCells);
 #ifdef REGISTER_TIMES
   std::chrono::steady_clock::time_point time_EndStereoMatches = std::chrono::steady_clock::now();
 
@@ -1289,7 +1378,9 @@ Frame::Frame(
 #endif
 
   // Put all descriptors in the same matrix
-  cv::vconcat(mDescriptors, mDescriptorsRight, mDescriptors);
+  DescriptorArray descriptors = mDescriptors;
+  descriptors.Append(mDescriptorsRight);
+  mDescriptors = std::move(descriptors);
 
   mvpMapPoints = std::vector<MapPoint*>(N, static_cast<MapPoint*>(nullptr));
   mvbOutlier   = std::vector<bool>(N, false);
@@ -1301,57 +1392,127 @@ Frame::Frame(
   UndistortKeyPoints();
 }
 
-void Frame::ComputeStereoFishEyeMatches() {
-  // Speed it up by matching keypoints in the lapping area
-  std::vector<cv::KeyPoint> stereoLeft(mvKeys.begin() + monoLeft, mvKeys.end());
-  std::vector<cv::KeyPoint> stereoRight(mvKeysRight.begin() + monoRight, mvKeysRight.end());
-
-  cv::Mat stereoDescLeft  = mDescriptors.rowRange(monoLeft, mDescriptors.rows);
-  cv::Mat stereoDescRight = mDescriptorsRight.rowRange(monoRight, mDescriptorsRight.rows);
-
+void Frame::ComputeStereoFishEyeMatches(ThreadPool* pThreadPool, BearingCells* pBearingCells) {
   mvLeftToRightMatch = std::vector<int>(Nleft, -1);
   mvRightToLeftMatch = std::vector<int>(Nright, -1);
-  mvDepth            = std::vector<float>(Nleft, -1.0f);
-  mvuRight           = std::vector<float>(Nleft, -1);
   mvStereo3Dpoints   = std::vector<Eigen::Vector3f>(Nleft);
   mnCloseMPs         = 0;
 
-  // Perform a brute force between Keypoint in the left and right image
-  std::vector<std::vector<cv::DMatch>> matches;
-
-  BFmatcher.knnMatch(stereoDescLeft, stereoDescRight, matches, 2);
+  std::vector<float> vDepth(Nleft, -1.0f);
+
+  // Speed it up by matching keypoints in the lapping area. A left keypoint is only compared to the
+  // right keypoints whose bearing lies close to its epipolar plane, within kEpipolarBand pixels at
+  // the scale of each keypoint, which are found by cells of kCellSize pixels.
+  const float kEpipolarBand = 3.0f;
+  const int   kCellSize     = 32;
+
+  KannalaBrandt8* pCamera      = static_cast<KannalaBrandt8*>(mpCamera);
+  const float     fx           = mpCamera->toK_()(0, 0);
+  const float     fxRight      = mpCamera2->toK_()(0, 0);
+  const int       nStereoLeft  = Nleft - monoLeft;
+  const int       nStereoRight = Nright - monoRight;
+
+  std::vector<cv::Point2f>     vRightPoints(nStereoRight);
+  std::vector<Eigen::Vector3f> vRightBearings(nStereoRight);
+  std::vector<float>           vRightTolerances(nStereoRight);
+  for (int i = 0; i < nStereoRight; i++) {
+    const cv::KeyPoint& kp = mvKeysRight[monoRight + i];
+    vRightPoints[i]        = kp.pt;
+    vRightTolerances[i]    = kEpipolarBand * mvScaleFactors[kp.octave] / fxRight;
+  }
+  mpCamera2->unprojectKeyPoints(
+    mvKeysRight->data() + monoRight, nStereoRight, vRightBearings.data()
+  );
 
-  int nMatches    = 0;
-  int descMatches = 0;
+  std::vector<Eigen::Vector3f> vLeftBearings(nStereoLeft);
+  mpCamera->unprojectKeyPoints(mvKeys->data() + monoLeft, nStereoLeft, vLeftBearings.data());
+
+  // Bucket the right keypoints, reusing the storage of the previous frames when given
+  BearingCells  ownCells;
+  BearingCells& cells = pBearingCells ? *pBearingCells : ownCells;
+  cells.Assign(vRightPoints, vRightBearings, vRightTolerances, kCellSize);
+
+  // Left keypoints are processed in blocks spread over the threads of pThreadPool
+  const int kBlockSize = 64;
+  const int nBlocks    = (nStereoLeft + kBlockSize - 1) / kBlockSize;
+
+  // Match every left keypoint within its band, checking Lowe's ratio and an absolute distance. A
+  // band with a single candidate has no second best to check the ratio against, its candidate
+  // must be as close as the tight matching threshold.
+  std::vector<int> vMatches(nStereoLeft, -1);
+  ParallelFor(pThreadPool, 0, nBlocks, [&](const int block) {
+    std::vector<int>                  vCandidates;
+    std::vector<const unsigned char*> vpDescriptors;
+
+    const int end = std::min(nStereoLeft, (block + 1) * kBlockSize);
+    for (int i = block * kBlockSize; i < end; i++) {
+      const cv::KeyPoint& kp = mvKeys[monoLeft + i];
+
+      // Normal of the epipolar plane, in the right camera
+      const Eigen::Vector3f n = (mRlr.transpose() * vLeftBearings[i].cross(mtlr)).normalized();
+      cells.Query(n, kEpipolarBand * mvScaleFactors[kp.octave] / fx, vCandidates);
+      if (vCandidates.empty()) {
+        continue;
+      }
 
-  // Check matches using Lowe's ratio
-  for (std::vector<std::vector<cv::DMatch>>::iterator it = matches.begin(); it != matches.end();
-       ++it) {
-    if ((*it).size() >= 2 && (*it)[0].distance < (*it)[1].distance * 0.7) {
-      // For every good match, check parallax and reprojection error to discard spurious matches
-      Eigen::Vector3f p3D;
-      descMatches++;
-      float sigma1 = mvLevelSigma2[mvKeys[(*it)[0].queryIdx + monoLeft].octave],
-            sigma2 = mvLevelSigma2[mvKeysRight[(*it)[0].trainIdx + monoRight].octave];
-      float depth  = static_cast<KannalaBrandt8*>(mpCamera)->TriangulateMatches(
+      vpDescriptors.clear();
+      for (const int c : vCandidates) {
+        vpDescriptors.push_back(mDescriptorsRight[monoRight + c].data());
+      }
+      const int best = MatchInBand(
+        mDescriptors[monoLeft + i].data(),
+        vpDescriptors.data(),
+        static_cast<int>(vCandidates.size()),
+        0.7f,
+        ORBmatcher::TH_HIGH,
+        ORBmatcher::TH_LOW
+      );
+      if (best >= 0) {
+        vMatches[i] = vCandidates[best];
+      }
+    }
+  });
+
+  // Triangulate the matches in batch, checking parallax and reprojection error to discard spurious
+  // matches
+  std::vector<float>           vMatchDepths(nStereoLeft, -1.0f);
+  std::vector<Eigen::Vector3f> vMatchPoints(nStereoLeft);
+  ParallelFor(pThreadPool, 0, nBlocks, [&](const int block) {
+    const int end = std::min(nStereoLeft, (block + 1) * kBlockSize);
+    for (int i = block * kBlockSize; i < end; i++) {
+      if (vMatches[i] < 0) {
+        continue;
+      }
+      const cv::KeyPoint& kpL = mvKeys[monoLeft + i];
+      const cv::KeyPoint& kpR = mvKeysRight[monoRight + vMatches[i]];
+      vMatchDepths[i]         = pCamera->TriangulateBearings(
         mpCamera2,
-        mvKeys[(*it)[0].queryIdx + monoLeft],
-        mvKeysRight[(*it)[0].trainIdx + monoRight],
+        kpL,
+        kpR,
+        vLeftBearings[i],
+        vRightBearings[vMatches[i]],
         mRlr,
         mtlr,
-        sigma1,
-        sigma2,
-        p3D
+        mvLevelSigma2[kpL.octave],
+        mvLevelSigma2[kpR.octave],
+        vMatchPoints[i]
       );
-      if (depth > 0.0001f) {
-        mvLeftToRightMatch[(*it)[0].queryIdx + monoLeft]  = (*it)[0].trainIdx + monoRight;
-        mvRightToLeftMatch[(*it)[0].trainIdx + monoRight] = (*it)[0].queryIdx + monoLeft;
-        mvStereo3Dpoints[(*it)[0].queryIdx + monoLeft]    = p3D;
-        mvDepth[(*it)[0].queryIdx + monoLeft]             = depth;
-        nMatches++;
-      }
+    }
+  });
+
+  for (int i = 0; i < nStereoLeft; i++) {
+    if (vMatchDepths[i] > 0.0001f) {
+      const int iL           = monoLeft + i;
+      const int iR           = monoRight + vMatches[i];
+      mvLeftToRightMatch[iL] = iR;
+      mvRightToLeftMatch[iR] = iL;
+      mvStereo3Dpoints[iL]   = vMatchPoints[i];
+      vDepth[iL]             = vMatchDepths[i];
     }
   }
+
+  mvDepth  = std::move(vDepth);
+  mvuRight = std::vector<float>(Nleft, -1);
 }
 
 bool Frame::isInFrustumChecks(MapPoint* pMP, float viewingCosLimit, bool bRight) {
@@ -1359,30 +1520,21 @@ bool Frame::isInFrustumChecks(MapPoint* pMP, float viewingCosLimit, bool bRight)
   Eigen::Vector3f P = pMP->GetWorldPos();
 
   Eigen::Matrix3f mR;
-  Eigen::Vector3f mt, twc;
+  Eigen::Vector3f mt;
   if (bRight) {
     Eigen::Matrix3f Rrl = mTrl.rotationMatrix();
     Eigen::Vector3f trl = mTrl.translation();
     mR                  = Rrl * mRcw;
     mt                  = Rrl * mtcw + trl;
-    twc                 = mRwc * mTlr.translation() + mOw;
   } else {
-    mR  = mRcw;
-    mt  = mtcw;
-    twc = mOw;
+    mR = mRcw;
+    mt = mtcw;
   }
 
   // 3D in camera coordinates
-  Eigen::Vector3f Pc      = mR * P + mt;
-  const float     Pc_dist = Pc.norm();
-  const float&    PcZ     = Pc(2);
-
-  // Check positive depth
-  if (PcZ < 0.0f) {
-    return false;
-  }
+  Eigen::Vector3f Pc = mR * P + mt;
 
-  // Project in image and check it is not outside
+  // Project in image
   Eigen::Vector2f uv;
   if (bRight) {
     uv = mpCamera2->project(Pc);
@@ -1390,6 +1542,27 @@ bool Frame::isInFrustumChecks(MapPoint* pMP, float viewingCosLimit, bool bRight)
     uv = mpCamera->project(Pc);
   }
 
+  return isInFrustumChecks(pMP, P, Pc, uv, viewingCosLimit, bRight);
+}
+
+bool Frame::isInFrustumChecks(
+  MapPoint*              pMP,
+  const Eigen::Vector3f& P,
+  const Eigen::Vector3f& Pc,
+  const Eigen::Vector2f& uv,
+  float                  viewingCosLimit,
+  bool                   bRight
+) {
+  const Eigen::Vector3f twc     = bRight ? Eigen::Vector3f(mRwc * mTlr.translation() + mOw) : mOw;
+  const float           Pc_dist = Pc.norm();
+  const float&          PcZ     = Pc(2);
+
+  // Check positive depth
+  if (PcZ < 0.0f) {
+    return false;
+  }
+
+  // Check it is not outside the image
   if (uv(0) < mnMinX || uv(0) > mnMaxX) {
     return false;
   }
@@ -172,18 +172,11 @@ void ImuCamPose::SetParam(
 }
 
 Eigen::Vector2d ImuCamPose::Project(const Eigen::Vector3d& Xw, int cam_idx) const {
-  Eigen::Vector3d Xc = Rcw[cam_idx] * Xw + tcw[cam_idx];
-
-  return pCamera[cam_idx]->project(Xc);
+  return ProjectAs<GeometricCameraProjection>(Xw, cam_idx);
 }
 
 Eigen::Vector3d ImuCamPose::ProjectStereo(const Eigen::Vector3d& Xw, int cam_idx) const {
-  Eigen::Vector3d Pc = Rcw[cam_idx] * Xw + tcw[cam_idx];
-  Eigen::Vector3d pc;
-  double          invZ = 1 / Pc(2);
-  pc.head(2)           = pCamera[cam_idx]->project(Pc);
-  pc(2)                = pc(0) - bf * invZ;
-  return pc;
+  return ProjectStereoAs<GeometricCameraProjection>(Xw, cam_idx);
 }
 
 bool ImuCamPose::isDepthPositive(const Eigen::Vector3d& Xw, int cam_idx) const {
@@ -342,7 +335,8 @@ bool VertexPose::write(std::ostream& os) const {
   return os.good();
 }
 
-void EdgeMono::linearizeOplus() {
+template <class Projection>
+void EdgeMono::linearizeOplusAs() {
   const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
   const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
 
@@ -352,8 +346,9 @@ void EdgeMono::linearizeOplus() {
   const Eigen::Vector3d  Xb  = VPose->estimate().Rbc[cam_idx] * Xc + VPose->estimate().tbc[cam_idx];
   const Eigen::Matrix3d& Rcb = VPose->estimate().Rcb[cam_idx];
 
-  const Eigen::Matrix<double, 2, 3> proj_jac = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
-  _jacobianOplusXi                           = -proj_jac * Rcw;
+  const Eigen::Matrix<double, 2, 3> proj_jac
+    = Projection::ProjectJac(VPose->estimate().pCamera[cam_idx], Xc);
+  _jacobianOplusXi = -proj_jac * Rcw;
 
   Eigen::Matrix<double, 3, 6> SE3deriv;
   double                      x = Xb(0);
@@ -365,7 +360,12 @@ void EdgeMono::linearizeOplus() {
   _jacobianOplusXj = proj_jac * Rcb * SE3deriv; // TODO optimize this product
 }
 
-void EdgeMonoOnlyPose::linearizeOplus() {
+template void EdgeMono::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeMono::linearizeOplusAs<PinholeProjection>();
+template void EdgeMono::linearizeOplusAs<KannalaBrandt8Projection>();
+
+template <class Projection>
+void EdgeMonoOnlyPose::linearizeOplusAs() {
   const VertexPose* VPose = static_cast<const VertexPose*>(_vertices[0]);
 
   const Eigen::Matrix3d& Rcw = VPose->estimate().Rcw[cam_idx];
@@ -374,7 +374,8 @@ void EdgeMonoOnlyPose::linearizeOplus() {
   const Eigen::Vector3d  Xb  = VPose->estimate().Rbc[cam_idx] * Xc + VPose->estimate().tbc[cam_idx];
   const Eigen::Matrix3d& Rcb = VPose->estimate().Rcb[cam_idx];
 
-  Eigen::Matrix<double, 2, 3> proj_jac = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+  Eigen::Matrix<double, 2, 3> proj_jac
+    = Projection::ProjectJac(VPose->estimate().pCamera[cam_idx], Xc);
 
   Eigen::Matrix<double, 3, 6> SE3deriv;
   double                      x = Xb(0);
@@ -384,7 +385,12 @@ void EdgeMonoOnlyPose::linearizeOplus() {
   _jacobianOplusXi = proj_jac * Rcb * SE3deriv; // symbol different becasue of update mode
 }
 
-void EdgeStereo::linearizeOplus() {
+template void EdgeMonoOnlyPose::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeMonoOnlyPose::linearizeOplusAs<PinholeProjection>();
+template void EdgeMonoOnlyPose::linearizeOplusAs<KannalaBrandt8Projection>();
+
+template <class Projection>
+void EdgeStereo::linearizeOplusAs() {
   const VertexPose*             VPose  = static_cast<const VertexPose*>(_vertices[1]);
   const g2o::VertexSBAPointXYZ* VPoint = static_cast<const g2o::VertexSBAPointXYZ*>(_vertices[0]);
 
@@ -397,7 +403,7 @@ void EdgeStereo::linearizeOplus() {
   const double           inv_z2 = 1.0 / (Xc(2) * Xc(2));
 
   Eigen::Matrix<double, 3, 3> proj_jac;
-  proj_jac.block<2, 3>(0, 0) = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+  proj_jac.block<2, 3>(0, 0) = Projection::ProjectJac(VPose->estimate().pCamera[cam_idx], Xc);
   proj_jac.block<1, 3>(2, 0) = proj_jac.block<1, 3>(0, 0);
   proj_jac(2, 2)             += bf * inv_z2;
 
@@ -413,7 +419,12 @@ void EdgeStereo::linearizeOplus() {
   _jacobianOplusXj = proj_jac * Rcb * SE3deriv;
 }
 
-void EdgeStereoOnlyPose::linearizeOplus() {
+template void EdgeStereo::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeStereo::linearizeOplusAs<PinholeProjection>();
+template void EdgeStereo::linearizeOplusAs<KannalaBrandt8Projection>();
+
+template <class Projection>
+void EdgeStereoOnlyPose::linearizeOplusAs() {
   const VertexPose* VPose = static_cast<const VertexPose*>(_vertices[0]);
 
   const Eigen::Matrix3d& Rcw = VPose->estimate().Rcw[cam_idx];
@@ -425,7 +436,7 @@ void EdgeStereoOnlyPose::linearizeOplus() {
   const double           inv_z2 = 1.0 / (Xc(2) * Xc(2));
 
   Eigen::Matrix<double, 3, 3> proj_jac;
-  proj_jac.block<2, 3>(0, 0) = VPose->estimate().pCamera[cam_idx]->projectJac(Xc);
+  proj_jac.block<2, 3>(0, 0) = Projection::ProjectJac(VPose->estimate().pCamera[cam_idx], Xc);
   proj_jac.block<1, 3>(2, 0) = proj_jac.block<1, 3>(0, 0);
   proj_jac(2, 2)             += bf * inv_z2;
 
@@ -437,6 +448,10 @@ void EdgeStereoOnlyPose::linearizeOplus() {
   _jacobianOplusXi = proj_jac * Rcb * SE3deriv;
 }
 
+template void EdgeStereoOnlyPose::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeStereoOnlyPose::linearizeOplusAs<PinholeProjection>();
+template void EdgeStereoOnlyPose::linearizeOplusAs<KannalaBrandt8Projection>();
+
 VertexVelocity::VertexVelocity(KeyFrame* pKF) {
   setEstimate(pKF->GetVelocity().cast<double>());
 }
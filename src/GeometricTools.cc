@@ -18,6 +18,11 @@
  */
 
 #include "GeometricTools.h"
+#include <cmath>
+#include <Eigen/Geometry>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "GeometricCamera.h"
 #include "KeyFrame.h"
 
@@ -70,4 +75,96 @@ bool GeometricTools::Triangulate(
   return true;
 }
 
+void GeometricTools::TriangulateBatch(
+  const Eigen::Vector3f& O1,
+  const Eigen::Vector3f& O2,
+  const float*           rays1,
+  const float*           rays2,
+  const int              n,
+  float*                 cosParallax,
+  float*                 x3D
+) {
+  // The closest points are O1 + s * d1 and O2 + t * d2 with, for w = O1 - O2 and m = d1 x d2,
+  // s = m.(d2 x w) / |m|^2 and t = m.(d1 x w) / |m|^2. Cross products keep the precision at low
+  // parallax, where the dot product form of the normal equations cancels.
+  const Eigen::Vector3f w = O1 - O2;
+  const Eigen::Vector3f o = 0.5f * (O1 + O2);
+
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 wx = _mm_set1_ps(w(0)), wy = _mm_set1_ps(w(1)), wz = _mm_set1_ps(w(2));
+  const __m128 ox = _mm_set1_ps(o(0)), oy = _mm_set1_ps(o(1)), oz = _mm_set1_ps(o(2));
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 d1x = _mm_loadu_ps(rays1 + i);
+    const __m128 d1y = _mm_loadu_ps(rays1 + n + i);
+    const __m128 d1z = _mm_loadu_ps(rays1 + 2 * n + i);
+    const __m128 d2x = _mm_loadu_ps(rays2 + i);
+    const __m128 d2y = _mm_loadu_ps(rays2 + n + i);
+    const __m128 d2z = _mm_loadu_ps(rays2 + 2 * n + i);
+
+    const __m128 a = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(d1x, d1x), _mm_mul_ps(d1y, d1y)), _mm_mul_ps(d1z, d1z)
+    );
+    const __m128 b = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(d1x, d2x), _mm_mul_ps(d1y, d2y)), _mm_mul_ps(d1z, d2z)
+    );
+    const __m128 c = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(d2x, d2x), _mm_mul_ps(d2y, d2y)), _mm_mul_ps(d2z, d2z)
+    );
+    _mm_storeu_ps(cosParallax + i, _mm_div_ps(b, _mm_sqrt_ps(_mm_mul_ps(a, c))));
+
+    const __m128 mx = _mm_sub_ps(_mm_mul_ps(d1y, d2z), _mm_mul_ps(d1z, d2y));
+    const __m128 my = _mm_sub_ps(_mm_mul_ps(d1z, d2x), _mm_mul_ps(d1x, d2z));
+    const __m128 mz = _mm_sub_ps(_mm_mul_ps(d1x, d2y), _mm_mul_ps(d1y, d2x));
+
+    // m.(d x w) = d.(w x m), with w x m shared by both
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(wy, mz), _mm_mul_ps(wz, my));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(wz, mx), _mm_mul_ps(wx, mz));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(wx, my), _mm_mul_ps(wy, mx));
+
+    const __m128 mm = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(mz, mz)
+    );
+    const __m128 halfInvMM = _mm_div_ps(half, mm);
+    const __m128 s         = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(d2x, qx), _mm_mul_ps(d2y, qy)), _mm_mul_ps(d2z, qz)),
+      halfInvMM
+    );
+    const __m128 t = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(d1x, qx), _mm_mul_ps(d1y, qy)), _mm_mul_ps(d1z, qz)),
+      halfInvMM
+    );
+
+    _mm_storeu_ps(
+      x3D + i, _mm_add_ps(ox, _mm_add_ps(_mm_mul_ps(s, d1x), _mm_mul_ps(t, d2x)))
+    );
+    _mm_storeu_ps(
+      x3D + n + i, _mm_add_ps(oy, _mm_add_ps(_mm_mul_ps(s, d1y), _mm_mul_ps(t, d2y)))
+    );
+    _mm_storeu_ps(
+      x3D + 2 * n + i, _mm_add_ps(oz, _mm_add_ps(_mm_mul_ps(s, d1z), _mm_mul_ps(t, d2z)))
+    );
+  }
+#endif
+
+  for (; i < n; i++) {
+    const Eigen::Vector3f d1(rays1[i], rays1[n + i], rays1[2 * n + i]);
+    const Eigen::Vector3f d2(rays2[i], rays2[n + i], rays2[2 * n + i]);
+
+    cosParallax[i] = d1.dot(d2) / std::sqrt(d1.squaredNorm() * d2.squaredNorm());
+
+    const Eigen::Vector3f m         = d1.cross(d2);
+    const Eigen::Vector3f q         = w.cross(m);
+    const float           halfInvMM = 0.5f / m.squaredNorm();
+    const float           s         = d2.dot(q) * halfInvMM;
+    const float           t         = d1.dot(q) * halfInvMM;
+
+    const Eigen::Vector3f p = o + s * d1 + t * d2;
+    x3D[i]                  = p(0);
+    x3D[n + i]              = p(1);
+    x3D[2 * n + i]          = p(2);
+  }
+}
+
 } // namespace ORB_SLAM3
@@ -0,0 +1,254 @@
+#include "HammingDistance.h"
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ORB_SLAM3_HAMMING_X86
+#endif
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+struct PointerCandidates {
+  const unsigned char* const* ptrs;
+
+  const unsigned char* operator()(const int i) const {
+    return ptrs[i];
+  }
+};
+
+struct StridedCandidates {
+  const unsigned char* base;
+  std::size_t          stride;
+
+  const unsigned char* operator()(const int i) const {
+    return base + i * stride;
+  }
+};
+
+// Parallel bit count, as formerly used by ORBmatcher::DescriptorDistance
+template <class Candidates>
+void DistancesScalar(
+  const unsigned char* query, const Candidates candidates, const int n, int* distances
+) {
+  for (int i = 0; i < n; i++) {
+    const unsigned char* c    = candidates(i);
+    int                  dist = 0;
+    for (int k = 0; k < 8; k++) {
+      std::uint32_t va, vb;
+      std::memcpy(&va, query + 4 * k, sizeof(va));
+      std::memcpy(&vb, c + 4 * k, sizeof(vb));
+      std::uint32_t v = va ^ vb;
+      v               = v - ((v >> 1) & 0x55555555);
+      v               = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+      dist            += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+    }
+    distances[i] = dist;
+  }
+}
+
+#if defined(ORB_SLAM3_HAMMING_X86)
+template <class Candidates>
+__attribute__((target("popcnt"))) void DistancesPopcnt(
+  const unsigned char* query, const Candidates candidates, const int n, int* distances
+) {
+  std::uint64_t q[4];
+  std::memcpy(q, query, sizeof(q));
+  for (int i = 0; i < n; i++) {
+    std::uint64_t c[4];
+    std::memcpy(c, candidates(i), sizeof(c));
+    distances[i] = static_cast<int>(
+      _mm_popcnt_u64(q[0] ^ c[0]) + _mm_popcnt_u64(q[1] ^ c[1]) + _mm_popcnt_u64(q[2] ^ c[2])
+      + _mm_popcnt_u64(q[3] ^ c[3])
+    );
+  }
+}
+
+// Sum the four 64-bit lanes of each of s0..s3, which are all below 2^32, into four integers.
+__attribute__((target("avx2"))) inline __m128i ReduceLanes(
+  const __m256i s0, const __m256i s1, const __m256i s2, const __m256i s3
+) {
+  const __m256i u = _mm256_or_si256(s0, _mm256_slli_epi64(s1, 32));
+  const __m256i v = _mm256_or_si256(s2, _mm256_slli_epi64(s3, 32));
+  const __m256i w = _mm256_add_epi32(_mm256_unpacklo_epi64(u, v), _mm256_unpackhi_epi64(u, v));
+  return _mm_add_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1));
+}
+
+// Bit count of each 64-bit lane of a ^ b, with the nibble lookup table method
+__attribute__((target("avx2"))) inline __m256i PopcountXor(const __m256i a, const __m256i b) {
+  const __m256i lut = _mm256_setr_epi8(
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+  );
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  const __m256i v   = _mm256_xor_si256(a, b);
+  const __m256i lo  = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+  const __m256i hi  = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) inline __m256i Load256(const unsigned char* ptr) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+}
+
+template <class Candidates>
+__attribute__((target("avx2"))) void DistancesAVX2(
+  const unsigned char* query, const Candidates candidates, const int n, int* distances
+) {
+  const __m256i q = Load256(query);
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i s[4];
+    for (int k = 0; k < 4; k++) {
+      s[k] = PopcountXor(q, Load256(candidates(i + k)));
+    }
+    const __m128i d = ReduceLanes(s[0], s[1], s[2], s[3]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + i), d);
+  }
+  for (; i < n; i++) {
+    const __m256i s = PopcountXor(q, Load256(candidates(i)));
+    const __m128i t = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    distances[i]    = _mm_cvtsi128_si32(_mm_add_epi64(t, _mm_unpackhi_epi64(t, t)));
+  }
+}
+
+// Two 256-bit descriptors in one register
+__attribute__((target("avx512f"))) inline __m512i
+  Load2(const unsigned char* a, const unsigned char* b) {
+  return _mm512_inserti64x4(
+    _mm512_castsi256_si512(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a))),
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b)),
+    1
+  );
+}
+
+// The AVX-512 headers of GCC 12 trip its own uninitialized warnings on the undefined pass-through
+// operands of the unmasked intrinsics (GCC PR105593).
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+template <class Candidates>
+__attribute__((target("avx512f,avx512vpopcntdq"))) void DistancesAVX512(
+  const unsigned char* query, const Candidates candidates, const int n, int* distances
+) {
+  const __m512i q = Load2(query, query);
+
+  alignas(64) std::uint64_t counts[8];
+
+  // Four candidates at a time, the lane sums of candidates i + 2 and i + 3 are shifted in the upper
+  // halves of those of i and i + 1, then the lanes of each candidate are folded together.
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m512i c01 = Load2(candidates(i), candidates(i + 1));
+    const __m512i c23 = Load2(candidates(i + 2), candidates(i + 3));
+    const __m512i p01 = _mm512_popcnt_epi64(_mm512_xor_si512(q, c01));
+    const __m512i p23 = _mm512_popcnt_epi64(_mm512_xor_si512(q, c23));
+    __m512i       u   = _mm512_or_si512(p01, _mm512_slli_epi64(p23, 32));
+    u                 = _mm512_add_epi64(u, _mm512_shuffle_epi32(u, _MM_PERM_BADC));
+    u                 = _mm512_add_epi64(u, _mm512_shuffle_i64x2(u, u, _MM_SHUFFLE(2, 3, 0, 1)));
+    // Lane 0 holds candidates i and i + 2, lane 4 candidates i + 1 and i + 3
+    const __m512i d = _mm512_permutexvar_epi32(
+      _mm512_setr_epi32(0, 8, 1, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0), u
+    );
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + i), _mm512_castsi512_si128(d));
+  }
+  for (; i < n; i++) {
+    const __m512i c = _mm512_maskz_loadu_epi64(0x0F, candidates(i));
+    _mm512_store_si512(counts, _mm512_maskz_popcnt_epi64(0x0F, _mm512_xor_si512(q, c)));
+    distances[i] = static_cast<int>(counts[0] + counts[1] + counts[2] + counts[3]);
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 12
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+struct Backend {
+  const char* name;
+  void (*pointers)(const unsigned char*, PointerCandidates, int, int*);
+  void (*strided)(const unsigned char*, StridedCandidates, int, int*);
+};
+
+Backend SelectBackend() {
+#if defined(ORB_SLAM3_HAMMING_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+    return {"avx512", DistancesAVX512<PointerCandidates>, DistancesAVX512<StridedCandidates>};
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return {"avx2", DistancesAVX2<PointerCandidates>, DistancesAVX2<StridedCandidates>};
+  }
+  if (__builtin_cpu_supports("popcnt")) {
+    return {"popcnt", DistancesPopcnt<PointerCandidates>, DistancesPopcnt<StridedCandidates>};
+  }
+#endif
+  return {"scalar", DistancesScalar<PointerCandidates>, DistancesScalar<StridedCandidates>};
+}
+
+const Backend& GetBackend() {
+  static const Backend backend = SelectBackend();
+  return backend;
+}
+
+void UpdateMatch(HammingMatch& match, const int* distances, const int n, const int offset) {
+  for (int i = 0; i < n; i++) {
+    const int dist = distances[i];
+    if (dist < match.bestDist) {
+      match.secondDist = match.bestDist;
+      match.secondIdx  = match.bestIdx;
+      match.bestDist   = dist;
+      match.bestIdx    = offset + i;
+    } else if (dist < match.secondDist) {
+      match.secondDist = dist;
+      match.secondIdx  = offset + i;
+    }
+  }
+}
+
+} // namespace
+
+void HammingDistances(
+  const unsigned char* query, const unsigned char* const* candidates, const int n, int* distances
+) {
+  GetBackend().pointers(query, PointerCandidates{candidates}, n, distances);
+}
+
+void HammingDistances(
+  const unsigned char* query,
+  const unsigned char* candidates,
+  const std::size_t    stride,
+  const int            n,
+  int*                 distances
+) {
+  GetBackend().strided(query, StridedCandidates{candidates, stride}, n, distances);
+}
+
+HammingMatch BestHammingMatch(const int* distances, const int n) {
+  HammingMatch match{256, -1, 256, -1};
+  UpdateMatch(match, distances, n, 0);
+  return match;
+}
+
+HammingMatch FindBestHamming(
+  const unsigned char* query, const unsigned char* const* candidates, const int n
+) {
+  const int    kChunk = 64;
+  int          distances[kChunk];
+  HammingMatch match{256, -1, 256, -1};
+  for (int begin = 0; begin < n; begin += kChunk) {
+    const int size = std::min(kChunk, n - begin);
+    HammingDistances(query, candidates + begin, size, distances);
+    UpdateMatch(match, distances, size, begin);
+  }
+  return match;
+}
+
+const char* HammingBackend() {
+  return GetBackend().name;
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,30 @@
+#include "ImageConditioner.h"
+#include <opencv2/imgproc.hpp>
+
+namespace ORB_SLAM3 {
+
+ImageConditioner::ImageConditioner(const cv::Mat& map1, const cv::Mat& map2)
+  : mSize(map1.size()) {
+  if (map1.type() == CV_16SC2) {
+    mMap1 = map1;
+    mMap2 = map2;
+  } else {
+    cv::convertMaps(map1, map2, mMap1, mMap2, CV_16SC2);
+  }
+}
+
+ImageConditioner::ImageConditioner(const cv::Size& size)
+  : mSize(size) {}
+
+void ImageConditioner::Apply(const cv::Mat& src, cv::Mat& dst) const {
+  CV_Assert(dst.size() == mSize && dst.type() == src.type());
+
+  // Both write into the existing pixels of dst, as its size and type already match
+  if (!mMap1.empty()) {
+    cv::remap(src, dst, mMap1, mMap2, cv::INTER_LINEAR);
+  } else {
+    cv::resize(src, dst, mSize, 0, 0, cv::INTER_LINEAR);
+  }
+}
+
+} // namespace ORB_SLAM3
@@ -0,0 +1,30 @@
+#include "ImageView.h"
+#include <stdexcept>
+#include <opencv2/imgproc.hpp>
+
+namespace ORB_SLAM3 {
+
+cv::Mat ViewToGray(const ImageView& view, cv::Mat& buffer, ViewRelease& release) {
+  switch (view.format) {
+    case ImageView::GRAY8:
+      return view.Mat();
+    case ImageView::RGB8:
+      cv::cvtColor(view.Mat(), buffer, cv::COLOR_RGB2GRAY);
+      break;
+    case ImageView::BGR8:
+      cv::cvtColor(view.Mat(), buffer, cv::COLOR_BGR2GRAY);
+      break;
+    case ImageView::RGBA8:
+      cv::cvtColor(view.Mat(), buffer, cv::COLOR_RGBA2GRAY);
+      break;
+    case ImageView::BGRA8:
+      cv::cvtColor(view.Mat(), buffer, cv::COLOR_BGRA2GRAY);
+      break;
+    default:
+      throw std::invalid_argument("Invalid image format, it should be grayscale or color");
+  }
+  release.Release();
+  return buffer;
+}
+
+} // namespace ORB_SLAM3
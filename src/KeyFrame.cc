@@ -133,7 +133,7 @@ KeyFrame::KeyFrame(Frame& F, Map* pMap, KeyFrameDatabase* pKFDB)
   , mvKeysUn(F.mvKeysUn)
   , mvuRight(F.mvuRight)
   , mvDepth(F.mvDepth)
-  , mDescriptors(F.mDescriptors.clone())
+  , mDescriptors(F.mDescriptors)
   , mBowVec(F.mBowVec)
   , mFeatVec(F.mFeatVec)
   , mnScaleLevels(F.mnScaleLevels)
@@ -180,21 +180,9 @@ KeyFrame::KeyFrame(Frame& F, Map* pMap, KeyFrameDatabase* pKFDB)
   , _logger(logging::CreateModuleLogger("KeyFrame")) {
   mnId = nNextId++;
 
-  mGrid.resize(mnGridCols);
+  mGrid = F.mGrid;
   if (F.Nleft != -1) {
-    mGridRight.resize(mnGridCols);
-  }
-  for (int i = 0; i < mnGridCols; i++) {
-    mGrid[i].resize(mnGridRows);
-    if (F.Nleft != -1) {
-      mGridRight[i].resize(mnGridRows);
-    }
-    for (int j = 0; j < mnGridRows; j++) {
-      mGrid[i][j] = F.mGrid[i][j];
-      if (F.Nleft != -1) {
-        mGridRight[i][j] = F.mGridRight[i][j];
-      }
-    }
+    mGridRight = F.mGridRight;
   }
 
   if (!F.HasVelocity()) {
@@ -209,17 +197,34 @@ KeyFrame::KeyFrame(Frame& F, Map* pMap, KeyFrameDatabase* pKFDB)
   SetPose(F.GetPose());
 
   mnOriginMapId = pMap->GetId();
+
+  ComputeBearings();
 }
 
 void KeyFrame::ComputeBoW() {
   if (mBowVec.empty() || mFeatVec.empty()) {
-    std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
+    std::vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors->AsMat());
     // Feature vector associate features with nodes in the 4th level (from leaves up)
     // We assume the vocabulary tree has 6 levels, change the 4 otherwise
-    mpORBvocabulary->transform(vCurrentDesc, mBowVec, mFeatVec, 4);
+    DBoW2::BowVector     bowVec;
+    DBoW2::FeatureVector featVec;
+    mpORBvocabulary->transform(vCurrentDesc, bowVec, featVec, 4);
+    mBowVec  = std::move(bowVec);
+    mFeatVec = std::move(featVec);
   }
 }
 
+void KeyFrame::ComputeBearings() {
+  std::vector<Eigen::Vector3f> vBearings(N);
+  if (NLeft == -1) {
+    mpCamera->unprojectKeyPoints(mvKeysUn->data(), N, vBearings.data());
+  } else {
+    mpCamera->unprojectKeyPoints(mvKeys->data(), NLeft, vBearings.data());
+    mpCamera2->unprojectKeyPoints(mvKeysRight->data(), NRight, vBearings.data() + NLeft);
+  }
+  mvBearings = std::move(vBearings);
+}
+
 void KeyFrame::SetPose(const Sophus::SE3f& Tcw) {
   std::unique_lock<std::mutex> lock(mMutexPose);
 
@@ -781,7 +786,18 @@ std::vector<std::size_t> KeyFrame::GetFeaturesInArea(
   const float& x, const float& y, const float& r, const bool bRight
 ) const {
   std::vector<std::size_t> vIndices;
-  vIndices.reserve(N);
+  GetFeaturesInArea(x, y, r, bRight, vIndices);
+  return vIndices;
+}
+
+void KeyFrame::GetFeaturesInArea(
+  const float&              x,
+  const float&              y,
+  const float&              r,
+  const bool                bRight,
+  std::vector<std::size_t>& vIndices
+) const {
+  vIndices.clear();
 
   float factorX = r;
   float factorY = r;
@@ -789,19 +805,19 @@ std::vector<std::size_t> KeyFrame::GetFeaturesInArea(
   const int nMinCellX
     = std::max(0, (int)std::floor((x - mnMinX - factorX) * mfGridElementWidthInv));
   if (nMinCellX >= mnGridCols) {
-    return vIndices;
+    return;
   }
 
   const int nMaxCellX
     = std::min((int)mnGridCols - 1, (int)std::ceil((x - mnMinX + factorX) * mfGridElementWidthInv));
   if (nMaxCellX < 0) {
-    return vIndices;
+    return;
   }
 
   const int nMinCellY
     = std::max(0, (int)std::floor((y - mnMinY - factorY) * mfGridElementHeightInv));
   if (nMinCellY >= mnGridRows) {
-    return vIndices;
+    return;
   }
 
   const int nMaxCellY = std::min(
@@ -809,27 +825,26 @@ std::vector<std::size_t> KeyFrame::GetFeaturesInArea(
     (int)std::ceil((y - mnMinY + factorY) * mfGridElementHeightInv)
   );
   if (nMaxCellY < 0) {
-    return vIndices;
+    return;
   }
 
+  // The cells of a column are contiguous in the grid
+  const FeatureGrid& grid = (!bRight) ? mGrid : mGridRight;
   for (int ix = nMinCellX; ix <= nMaxCellX; ix++) {
-    for (int iy = nMinCellY; iy <= nMaxCellY; iy++) {
-      const std::vector<std::size_t> vCell = (!bRight) ? mGrid[ix][iy] : mGridRight[ix][iy];
-      for (std::size_t j = 0, jend = vCell.size(); j < jend; j++) {
-        const cv::KeyPoint& kpUn  = (NLeft == -1) ? mvKeysUn[vCell[j]]
-                                  : (!bRight)     ? mvKeys[vCell[j]]
-                                                  : mvKeysRight[vCell[j]];
-        const float         distx = kpUn.pt.x - x;
-        const float         disty = kpUn.pt.y - y;
-
-        if (std::fabs(distx) < r && std::fabs(disty) < r) {
-          vIndices.push_back(vCell[j]);
-        }
+    const std::size_t* pEnd = grid.ColumnEnd(ix, nMaxCellY);
+    for (const std::size_t* pIdx = grid.ColumnBegin(ix, nMinCellY); pIdx != pEnd; pIdx++) {
+      const std::size_t   idx   = *pIdx;
+      const cv::KeyPoint& kpUn  = (NLeft == -1) ? mvKeysUn[idx]
+                                : (!bRight)     ? mvKeys[idx]
+                                                : mvKeysRight[idx];
+      const float         distx = kpUn.pt.x - x;
+      const float         disty = kpUn.pt.y - y;
+
+      if (std::fabs(distx) < r && std::fabs(disty) < r) {
+        vIndices.push_back(idx);
       }
     }
   }
-
-  return vIndices;
 }
 
 bool KeyFrame::IsInImage(const float& x, const float& y) const {
@@ -1081,6 +1096,7 @@ void KeyFrame::PostLoad(
   if (mnBackupIdCamera2 >= 0) {
     mpCamera2 = mpCamId[mnBackupIdCamera2];
   }
+  ComputeBearings();
 
   // Inertial data
   if (mBackupPrevKFId != -1) {
@@ -0,0 +1,386 @@
+#include "LocalBAGraph.h"
+#include <Thirdparty/g2o/g2o/core/block_solver.h>
+#include <Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <Thirdparty/g2o/g2o/core/robust_kernel_impl.h>
+#include <Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h>
+#include <Thirdparty/g2o/g2o/types/types_six_dof_expmap.h>
+#include "CameraModels/CameraProjection.h"
+#include "G2oTypes.h"
+#include "OptimizableTypes.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+// Levenberg-Marquardt with BlockSolver and a sparse Cholesky solver
+template <class BlockSolver>
+g2o::OptimizationAlgorithm* NewLevenberg() {
+  typename BlockSolver::LinearSolverType* linearSolver
+    = new g2o::LinearSolverEigen<typename BlockSolver::PoseMatrixType>();
+  return new g2o::OptimizationAlgorithmLevenberg(new BlockSolver(linearSolver));
+}
+
+template <class Edge>
+Edge* WithHuberKernel(Edge* pEdge) {
+  pEdge->setRobustKernel(new g2o::RobustKernelHuber);
+  return pEdge;
+}
+
+// Vertex ids of the keyframes and map points of LocalBAGraph, which are numbered separately. They
+// do not depend on the window, so that the cameras keep their order in the camera system.
+int KeyFrameVertexId(const long unsigned int nKFId) {
+  return static_cast<int>(2 * nKFId);
+}
+
+int MapPointVertexId(const long unsigned int nMPId) {
+  return static_cast<int>(2 * nMPId + 1);
+}
+
+// Vertex ids of LocalInertialBAGraph: the pose, velocity and biases of each keyframe, then each
+// map point
+enum eInertialVertex { POSE = 0, VELOCITY = 1, GYRO_BIAS = 2, ACC_BIAS = 3, MAP_POINT = 4 };
+
+int InertialVertexId(const long unsigned int nId, const eInertialVertex vertex) {
+  return static_cast<int>(5 * nId + vertex);
+}
+
+// Kinds of the edges of LocalInertialBAGraph past the observations
+enum eInertialEdge { INERTIAL = 3, GYRO_RW = 4, ACC_RW = 5 };
+
+// Inertial edge that keeps the information of its preintegration, for the windows after one that
+// changed it
+class WindowEdgeInertial : public EdgeInertial {
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  WindowEdgeInertial(IMU::Preintegrated* pInt)
+    : EdgeInertial(pInt)
+    , mPreintegrationInformation(information()) {
+  }
+
+  const InformationType mPreintegrationInformation;
+};
+
+} // namespace
+
+std::size_t WindowGraph::EdgeKeyHash::operator()(const EdgeKey& key) const {
+  std::size_t h = std::hash<int>()(key.id0);
+  h             = h * 31 + std::hash<int>()(key.id1);
+  return h * 7 + key.kind;
+}
+
+WindowGraph::WindowGraph(g2o::OptimizationAlgorithm* pAlgorithm) : mnWindow(0) {
+  mOptimizer.setAlgorithm(pAlgorithm);
+  mOptimizer.setVerbose(false);
+}
+
+WindowGraph::~WindowGraph() {
+  for (std::pair<const std::type_index, std::vector<g2o::OptimizableGraph::Vertex*>>& free :
+       mmFreeVertices) {
+    for (g2o::OptimizableGraph::Vertex* pVertex : free.second) {
+      delete pVertex;
+    }
+  }
+  for (std::pair<const EdgeModel, std::vector<g2o::OptimizableGraph::Edge*>>& free : mmFreeEdges) {
+    for (g2o::OptimizableGraph::Edge* pEdge : free.second) {
+      delete pEdge;
+    }
+  }
+}
+
+void WindowGraph::BeginWindow() {
+  mnWindow++;
+}
+
+void WindowGraph::EndWindow() {
+  // The edges first: the stale vertices are then left without any
+  for (std::unordered_map<EdgeKey, EdgeEntry, EdgeKeyHash>::iterator it = mmEdges.begin();
+       it != mmEdges.end();) {
+    if (it->second.nWindow == mnWindow) {
+      ++it;
+      continue;
+    }
+    RemoveEdge(it->second);
+    it = mmEdges.erase(it);
+  }
+
+  for (std::unordered_map<int, VertexEntry>::iterator it = mmVertices.begin();
+       it != mmVertices.end();) {
+    if (it->second.nWindow == mnWindow) {
+      ++it;
+      continue;
+    }
+    mOptimizer.removeVertex(it->second.pVertex, true);
+    mmFreeVertices[it->second.type].push_back(it->second.pVertex);
+    it = mmVertices.erase(it);
+  }
+}
+
+void WindowGraph::Clear() {
+  BeginWindow();
+  EndWindow();
+}
+
+void WindowGraph::RemoveEdge(const EdgeEntry& entry) {
+  mOptimizer.removeEdge(entry.pEdge, true);
+  if (entry.bRecycled) {
+    mmFreeEdges[entry.model].push_back(entry.pEdge);
+  } else {
+    delete entry.pEdge;
+  }
+}
+
+template <class Vertex>
+Vertex* WindowGraph::WindowVertex(const int id) {
+  const std::type_index type(typeid(Vertex));
+  const std::pair<std::unordered_map<int, VertexEntry>::iterator, bool> inserted
+    = mmVertices.emplace(id, VertexEntry{nullptr, type, mnWindow});
+  VertexEntry& entry = inserted.first->second;
+  entry.nWindow      = mnWindow;
+  if (!inserted.second) {
+    return static_cast<Vertex*>(entry.pVertex);
+  }
+
+  std::vector<g2o::OptimizableGraph::Vertex*>& vpFree = mmFreeVertices[type];
+  if (vpFree.empty()) {
+    entry.pVertex = new Vertex();
+  } else {
+    entry.pVertex = vpFree.back();
+    vpFree.pop_back();
+  }
+  entry.pVertex->setId(id);
+  mOptimizer.addVertex(entry.pVertex);
+  return static_cast<Vertex*>(entry.pVertex);
+}
+
+g2o::OptimizableGraph::Edge* WindowGraph::WindowEdge(
+  const EdgeKey&                                        key,
+  const EdgeModel&                                      model,
+  const bool                                            bRecycled,
+  std::initializer_list<g2o::OptimizableGraph::Vertex*> vpVertices,
+  const std::function<g2o::OptimizableGraph::Edge*()>&  newEdge
+) {
+  std::unordered_map<EdgeKey, EdgeEntry, EdgeKeyHash>::iterator it = mmEdges.find(key);
+  if (it != mmEdges.end()) {
+    if (it->second.model == model) {
+      it->second.nWindow = mnWindow;
+      return it->second.pEdge;
+    }
+    // What the key stands for has another model now
+    RemoveEdge(it->second);
+    mmEdges.erase(it);
+  }
+
+  g2o::OptimizableGraph::Edge*               pEdge;
+  std::vector<g2o::OptimizableGraph::Edge*>& vpFree = mmFreeEdges[model];
+  if (vpFree.empty()) {
+    pEdge = newEdge();
+  } else {
+    pEdge = vpFree.back();
+    vpFree.pop_back();
+  }
+  int i = 0;
+  for (g2o::OptimizableGraph::Vertex* pVertex : vpVertices) {
+    pEdge->setVertex(i++, pVertex);
+  }
+  mOptimizer.addEdge(pEdge);
+
+  const EdgeEntry entry = {pEdge, model, bRecycled, mnWindow};
+  mmEdges.emplace(key, entry);
+  return pEdge;
+}
+
+g2o::OptimizableGraph::Edge* WindowGraph::KeptEdge(const EdgeKey& key) const {
+  std::unordered_map<EdgeKey, EdgeEntry, EdgeKeyHash>::const_iterator it = mmEdges.find(key);
+  return it != mmEdges.end() ? it->second.pEdge : nullptr;
+}
+
+void WindowGraph::DropEdge(const EdgeKey& key) {
+  std::unordered_map<EdgeKey, EdgeEntry, EdgeKeyHash>::iterator it = mmEdges.find(key);
+  if (it != mmEdges.end()) {
+    RemoveEdge(it->second);
+    mmEdges.erase(it);
+  }
+}
+
+bool WindowGraph::InWindow(const int id) const {
+  std::unordered_map<int, VertexEntry>::const_iterator it = mmVertices.find(id);
+  return it != mmVertices.end() && it->second.nWindow == mnWindow;
+}
+
+LocalBAGraph::LocalBAGraph() : WindowGraph(NewLevenberg<g2o::BlockSolver_6_3>()) {
+}
+
+g2o::VertexSE3Expmap* LocalBAGraph::KeyFrameVertex(const long unsigned int nKFId) {
+  return WindowVertex<g2o::VertexSE3Expmap>(KeyFrameVertexId(nKFId));
+}
+
+g2o::VertexSBAPointXYZ* LocalBAGraph::MapPointVertex(const long unsigned int nMPId) {
+  g2o::VertexSBAPointXYZ* vPoint = WindowVertex<g2o::VertexSBAPointXYZ>(MapPointVertexId(nMPId));
+  vPoint->setMarginalized(true);
+  return vPoint;
+}
+
+EdgeSE3ProjectXYZ* LocalBAGraph::MonocularEdge(
+  g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF, GeometricCamera* pCamera
+) {
+  return static_cast<EdgeSE3ProjectXYZ*>(WindowEdge(
+    {vPoint->id(), vKF->id(), MONOCULAR},
+    std::make_pair(static_cast<int>(MONOCULAR), pCamera->GetType()),
+    true,
+    {vPoint, vKF},
+    [pCamera]() { return WithHuberKernel(NewCameraModelEdge<EdgeSE3ProjectXYZ>(pCamera)); }
+  ));
+}
+
+g2o::EdgeStereoSE3ProjectXYZ* LocalBAGraph::StereoEdge(
+  g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF
+) {
+  return static_cast<g2o::EdgeStereoSE3ProjectXYZ*>(WindowEdge(
+    {vPoint->id(), vKF->id(), STEREO},
+    std::make_pair(static_cast<int>(STEREO), 0u),
+    true,
+    {vPoint, vKF},
+    []() { return WithHuberKernel(new g2o::EdgeStereoSE3ProjectXYZ()); }
+  ));
+}
+
+EdgeSE3ProjectXYZToBody* LocalBAGraph::RightEdge(
+  g2o::VertexSBAPointXYZ* vPoint, g2o::VertexSE3Expmap* vKF, GeometricCamera* pCamera2
+) {
+  return static_cast<EdgeSE3ProjectXYZToBody*>(WindowEdge(
+    {vPoint->id(), vKF->id(), RIGHT},
+    std::make_pair(static_cast<int>(RIGHT), pCamera2->GetType()),
+    true,
+    {vPoint, vKF},
+    [pCamera2]() {
+      return WithHuberKernel(NewCameraModelEdge<EdgeSE3ProjectXYZToBody>(pCamera2));
+    }
+  ));
+}
+
+LocalInertialBAGraph::LocalInertialBAGraph() : WindowGraph(NewLevenberg<g2o::BlockSolverX>()) {
+}
+
+VertexPose* LocalInertialBAGraph::PoseVertex(const long unsigned int nKFId) {
+  return WindowVertex<VertexPose>(InertialVertexId(nKFId, POSE));
+}
+
+VertexVelocity* LocalInertialBAGraph::VelocityVertex(const long unsigned int nKFId) {
+  return WindowVertex<VertexVelocity>(InertialVertexId(nKFId, VELOCITY));
+}
+
+VertexGyroBias* LocalInertialBAGraph::GyroBiasVertex(const long unsigned int nKFId) {
+  return WindowVertex<VertexGyroBias>(InertialVertexId(nKFId, GYRO_BIAS));
+}
+
+VertexAccBias* LocalInertialBAGraph::AccBiasVertex(const long unsigned int nKFId) {
+  return WindowVertex<VertexAccBias>(InertialVertexId(nKFId, ACC_BIAS));
+}
+
+g2o::VertexSBAPointXYZ* LocalInertialBAGraph::MapPointVertex(const long unsigned int nMPId) {
+  g2o::VertexSBAPointXYZ* vPoint
+    = WindowVertex<g2o::VertexSBAPointXYZ>(InertialVertexId(nMPId, MAP_POINT));
+  vPoint->setMarginalized(true);
+  return vPoint;
+}
+
+bool LocalInertialBAGraph::HasInertialVertices(const long unsigned int nKFId) const {
+  return InWindow(InertialVertexId(nKFId, VELOCITY)) && InWindow(InertialVertexId(nKFId, GYRO_BIAS))
+      && InWindow(InertialVertexId(nKFId, ACC_BIAS));
+}
+
+EdgeMono* LocalInertialBAGraph::MonocularEdge(
+  g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera
+) {
+  return static_cast<EdgeMono*>(WindowEdge(
+    {vPoint->id(), vKF->id(), MONOCULAR},
+    std::make_pair(static_cast<int>(MONOCULAR), pCamera->GetType()),
+    true,
+    {vPoint, vKF},
+    [pCamera]() { return WithHuberKernel(NewCameraModelEdge<EdgeMono>(pCamera, 0)); }
+  ));
+}
+
+EdgeStereo* LocalInertialBAGraph::StereoEdge(
+  g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera
+) {
+  return static_cast<EdgeStereo*>(WindowEdge(
+    {vPoint->id(), vKF->id(), STEREO},
+    std::make_pair(static_cast<int>(STEREO), pCamera->GetType()),
+    true,
+    {vPoint, vKF},
+    [pCamera]() { return WithHuberKernel(NewCameraModelEdge<EdgeStereo>(pCamera, 0)); }
+  ));
+}
+
+EdgeMono* LocalInertialBAGraph::RightEdge(
+  g2o::VertexSBAPointXYZ* vPoint, VertexPose* vKF, GeometricCamera* pCamera2
+) {
+  return static_cast<EdgeMono*>(WindowEdge(
+    {vPoint->id(), vKF->id(), RIGHT},
+    std::make_pair(static_cast<int>(RIGHT), pCamera2->GetType()),
+    true,
+    {vPoint, vKF},
+    [pCamera2]() { return WithHuberKernel(NewCameraModelEdge<EdgeMono>(pCamera2, 1)); }
+  ));
+}
+
+EdgeInertial* LocalInertialBAGraph::InertialEdge(
+  const long unsigned int nPrevKFId, const long unsigned int nKFId, IMU::Preintegrated* pInt
+) {
+  const EdgeKey key = {
+    InertialVertexId(nKFId, POSE), InertialVertexId(nPrevKFId, POSE), INERTIAL
+  };
+  const EdgeInertial* pKept = static_cast<const EdgeInertial*>(KeptEdge(key));
+  if (pKept && pKept->mpInt != pInt) {
+    // A new preintegration between the keyframes: the edge must be made from it
+    DropEdge(key);
+  }
+
+  WindowEdgeInertial* e = static_cast<WindowEdgeInertial*>(WindowEdge(
+    key,
+    std::make_pair(static_cast<int>(INERTIAL), 0u),
+    false,
+    {PoseVertex(nPrevKFId),
+     VelocityVertex(nPrevKFId),
+     GyroBiasVertex(nPrevKFId),
+     AccBiasVertex(nPrevKFId),
+     PoseVertex(nKFId),
+     VelocityVertex(nKFId)},
+    [pInt]() { return new WindowEdgeInertial(pInt); }
+  ));
+  e->setInformation(e->mPreintegrationInformation);
+  e->setRobustKernel(nullptr);
+  return e;
+}
+
+EdgeGyroRW* LocalInertialBAGraph::GyroRandomWalkEdge(
+  const long unsigned int nPrevKFId, const long unsigned int nKFId
+) {
+  VertexGyroBias* VG1 = GyroBiasVertex(nPrevKFId);
+  VertexGyroBias* VG2 = GyroBiasVertex(nKFId);
+  return static_cast<EdgeGyroRW*>(WindowEdge(
+    {VG2->id(), VG1->id(), GYRO_RW},
+    std::make_pair(static_cast<int>(GYRO_RW), 0u),
+    true,
+    {VG1, VG2},
+    []() { return new EdgeGyroRW(); }
+  ));
+}
+
+EdgeAccRW* LocalInertialBAGraph::AccRandomWalkEdge(
+  const long unsigned int nPrevKFId, const long unsigned int nKFId
+) {
+  VertexAccBias* VA1 = AccBiasVertex(nPrevKFId);
+  VertexAccBias* VA2 = AccBiasVertex(nKFId);
+  return static_cast<EdgeAccRW*>(WindowEdge(
+    {VA2->id(), VA1->id(), ACC_RW},
+    std::make_pair(static_cast<int>(ACC_RW), 0u),
+    true,
+    {VA1, VA2},
+    []() { return new EdgeAccRW(); }
+  ));
+}
+
+} // namespace ORB_SLAM3
@@ -26,6 +26,7 @@
 #include "Atlas.h"
 #include "GeometricTools.h"
 #include "KeyFrame.h"
+#include "LocalBAGraph.h"
 #include "LoggingUtils.h"
 #include "LoopClosing.h"
 #include "Map.h"
@@ -33,6 +34,7 @@
 #include "ORBmatcher.h"
 #include "Optimizer.h"
 #include "System.h"
+#include "ThreadPool.h"
 #include "Tracking.h"
 
 namespace ORB_SLAM3 {
@@ -42,7 +44,8 @@ LocalMapping::LocalMapping(
   Atlas*             pAtlas,
   const float        bMonocular,
   bool               bInertial,
-  const std::string& _strSeqName
+  const std::string& _strSeqName,
+  const int          nThreads
 )
   : mpSystem(pSys)
   , mbMonocular(bMonocular)
@@ -64,6 +67,9 @@ LocalMapping::LocalMapping(
   , mbNotBA1(true)
   , mbNotBA2(true)
   , mIdxIteration(0)
+  , mpThreadPool(std::make_unique<ThreadPool>(nThreads))
+  , mpLocalBAGraph(std::make_unique<LocalBAGraph>())
+  , mpLocalInertialBAGraph(std::make_unique<LocalInertialBAGraph>())
   , infoInertial(Eigen::MatrixXd::Zero(9, 9))
   , _logger(logging::CreateModuleLogger("LocalMapping")) {
   mnMatchesInliers = 0;
@@ -81,6 +87,8 @@ LocalMapping::LocalMapping(
 #endif
 }
 
+LocalMapping::~LocalMapping() = default;
+
 void LocalMapping::SetLoopCloser(LoopClosing* pLoopCloser) {
   mpLoopCloser = pLoopCloser;
 }
@@ -190,7 +198,9 @@ void LocalMapping::Run() {
               num_MPs_BA,
               num_edges_BA,
               bLarge,
-              !mpCurrentKeyFrame->GetMap()->GetIniertialBA2()
+              !mpCurrentKeyFrame->GetMap()->GetIniertialBA2(),
+              mpThreadPool.get(),
+              mpLocalInertialBAGraph.get()
             );
             b_doneLBA = true;
           } else {
@@ -201,7 +211,9 @@ void LocalMapping::Run() {
               num_FixedKF_BA,
               num_OptKF_BA,
               num_MPs_BA,
-              num_edges_BA
+              num_edges_BA,
+              mpThreadPool.get(),
+              mpLocalBAGraph.get()
             );
             b_doneLBA = true;
           }
@@ -436,271 +448,280 @@ void LocalMapping::CreateNewMapPoints() {
     }
   }
 
-  float th = 0.6f;
-
-  ORBmatcher matcher(th, false);
-
-  Sophus::SE3<float>         sophTcw1 = mpCurrentKeyFrame->GetPose();
-  Eigen::Matrix<float, 3, 4> eigTcw1  = sophTcw1.matrix3x4();
-  Eigen::Matrix<float, 3, 3> Rcw1     = eigTcw1.block<3, 3>(0, 0);
-  Eigen::Matrix<float, 3, 3> Rwc1     = Rcw1.transpose();
-  Eigen::Vector3f            tcw1     = sophTcw1.translation();
-  Eigen::Vector3f            Ow1      = mpCurrentKeyFrame->GetCameraCenter();
-
-  const float& fx1    = mpCurrentKeyFrame->fx;
-  const float& fy1    = mpCurrentKeyFrame->fy;
-  const float& cx1    = mpCurrentKeyFrame->cx;
-  const float& cy1    = mpCurrentKeyFrame->cy;
-  const float& invfx1 = mpCurrentKeyFrame->invfx;
-  const float& invfy1 = mpCurrentKeyFrame->invfy;
-
-  const float ratioFactor         = 1.5f * mpCurrentKeyFrame->mfScaleFactor;
-  int         countStereo         = 0;
-  int         countStereoGoodProj = 0;
-  int         countStereoAttempt  = 0;
-  int         totalStereoPts      = 0;
-  // Search matches with epipolar restriction and triangulate
-  for (std::size_t i = 0; i < vpNeighKFs.size(); i++) {
+  const bool bCoarse = mbInertial && mpTracker->mState == Tracking::RECENTLY_LOST
+                    && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
+
+  // Search matches with epipolar restriction and triangulate, every neighbor on its own
+  const int                             nNeighs = static_cast<int>(vpNeighKFs.size());
+  std::vector<std::vector<NewMapPoint>> vvNewMapPoints(nNeighs);
+  mpThreadPool->ParallelFor(0, nNeighs, [&](const int i) {
     if (i > 0 && CheckNewKeyFrames()) {
       return;
     }
+    TriangulateMatches(vpNeighKFs[i], bCoarse, vvNewMapPoints[i]);
+  });
 
-    KeyFrame* pKF2 = vpNeighKFs[i];
-
-    GeometricCamera *pCamera1 = mpCurrentKeyFrame->mpCamera, *pCamera2 = pKF2->mpCamera;
-
-    // Check first that baseline is not too short
-    Eigen::Vector3f Ow2       = pKF2->GetCameraCenter();
-    Eigen::Vector3f vBaseline = Ow2 - Ow1;
-    const float     baseline  = vBaseline.norm();
+  // Create the map points in neighbor order. A keypoint of the current keyframe triangulated with
+  // several neighbors keeps the point of the first one.
+  for (int i = 0; i < nNeighs; i++) {
+    if (i > 0 && CheckNewKeyFrames()) {
+      return;
+    }
 
-    if (!mbMonocular) {
-      if (baseline < pKF2->mb) {
+    KeyFrame* pKF2 = vpNeighKFs[i];
+    for (const NewMapPoint& newMapPoint : vvNewMapPoints[i]) {
+      const std::size_t idx1 = newMapPoint.idx1;
+      const std::size_t idx2 = newMapPoint.idx2;
+      if (mpCurrentKeyFrame->GetMapPoint(idx1)) {
         continue;
       }
-    } else {
-      const float medianDepthKF2     = pKF2->ComputeSceneMedianDepth(2);
-      const float ratioBaselineDepth = baseline / medianDepthKF2;
 
-      if (ratioBaselineDepth < 0.01) {
-        continue;
-      }
-    }
+      MapPoint* pMP = new MapPoint(newMapPoint.x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
 
-    // Search matches that fullfil epipolar constraint
-    std::vector<std::pair<std::size_t, std::size_t>> vMatchedIndices;
-    bool bCoarse = mbInertial && mpTracker->mState == Tracking::RECENTLY_LOST
-                && mpCurrentKeyFrame->GetMap()->GetIniertialBA2();
-
-    matcher.SearchForTriangulation(mpCurrentKeyFrame, pKF2, vMatchedIndices, false, bCoarse);
-
-    Sophus::SE3<float>         sophTcw2 = pKF2->GetPose();
-    Eigen::Matrix<float, 3, 4> eigTcw2  = sophTcw2.matrix3x4();
-    Eigen::Matrix<float, 3, 3> Rcw2     = eigTcw2.block<3, 3>(0, 0);
-    Eigen::Matrix<float, 3, 3> Rwc2     = Rcw2.transpose();
-    Eigen::Vector3f            tcw2     = sophTcw2.translation();
-
-    const float& fx2    = pKF2->fx;
-    const float& fy2    = pKF2->fy;
-    const float& cx2    = pKF2->cx;
-    const float& cy2    = pKF2->cy;
-    const float& invfx2 = pKF2->invfx;
-    const float& invfy2 = pKF2->invfy;
-
-    // Triangulate each match
-    const int nmatches = vMatchedIndices.size();
-    for (int ikp = 0; ikp < nmatches; ikp++) {
-      const int& idx1 = vMatchedIndices[ikp].first;
-      const int& idx2 = vMatchedIndices[ikp].second;
-
-      const cv::KeyPoint& kp1 = (mpCurrentKeyFrame->NLeft == -1) ? mpCurrentKeyFrame->mvKeysUn[idx1]
-                              : (idx1 < mpCurrentKeyFrame->NLeft)
-                                ? mpCurrentKeyFrame->mvKeys[idx1]
-                                : mpCurrentKeyFrame->mvKeysRight[idx1 - mpCurrentKeyFrame->NLeft];
-      const float         kp1_ur   = mpCurrentKeyFrame->mvuRight[idx1];
-      bool                bStereo1 = (!mpCurrentKeyFrame->mpCamera2 && kp1_ur >= 0);
-      const bool          bRight1
-        = (mpCurrentKeyFrame->NLeft == -1 || idx1 < mpCurrentKeyFrame->NLeft) ? false : true;
+      pMP->AddObservation(mpCurrentKeyFrame, idx1);
+      pMP->AddObservation(pKF2, idx2);
 
-      const cv::KeyPoint& kp2 = (pKF2->NLeft == -1)  ? pKF2->mvKeysUn[idx2]
-                              : (idx2 < pKF2->NLeft) ? pKF2->mvKeys[idx2]
-                                                     : pKF2->mvKeysRight[idx2 - pKF2->NLeft];
+      mpCurrentKeyFrame->AddMapPoint(pMP, idx1);
+      pKF2->AddMapPoint(pMP, idx2);
 
-      const float kp2_ur   = pKF2->mvuRight[idx2];
-      bool        bStereo2 = (!pKF2->mpCamera2 && kp2_ur >= 0);
-      const bool  bRight2  = (pKF2->NLeft == -1 || idx2 < pKF2->NLeft) ? false : true;
+      pMP->ComputeDistinctiveDescriptors();
 
-      if (mpCurrentKeyFrame->mpCamera2 && pKF2->mpCamera2) {
-        if (bRight1 && bRight2) {
-          sophTcw1 = mpCurrentKeyFrame->GetRightPose();
-          Ow1      = mpCurrentKeyFrame->GetRightCameraCenter();
+      pMP->UpdateNormalAndDepth();
 
-          sophTcw2 = pKF2->GetRightPose();
-          Ow2      = pKF2->GetRightCameraCenter();
+      mpAtlas->AddMapPoint(pMP);
+      mlpRecentAddedMapPoints.push_back(pMP);
+    }
+  }
+}
 
-          pCamera1 = mpCurrentKeyFrame->mpCamera2;
-          pCamera2 = pKF2->mpCamera2;
-        } else if (bRight1 && !bRight2) {
-          sophTcw1 = mpCurrentKeyFrame->GetRightPose();
-          Ow1      = mpCurrentKeyFrame->GetRightCameraCenter();
+void LocalMapping::TriangulateMatches(
+  KeyFrame* pKF2, const bool bCoarse, std::vector<NewMapPoint>& vNewMapPoints
+) {
+  KeyFrame* pKF1 = mpCurrentKeyFrame;
 
-          sophTcw2 = pKF2->GetPose();
-          Ow2      = pKF2->GetCameraCenter();
+  // Check first that baseline is not too short
+  const Eigen::Vector3f vBaseline = pKF2->GetCameraCenter() - pKF1->GetCameraCenter();
+  const float           baseline  = vBaseline.norm();
 
-          pCamera1 = mpCurrentKeyFrame->mpCamera2;
-          pCamera2 = pKF2->mpCamera;
-        } else if (!bRight1 && bRight2) {
-          sophTcw1 = mpCurrentKeyFrame->GetPose();
-          Ow1      = mpCurrentKeyFrame->GetCameraCenter();
+  if (!mbMonocular) {
+    if (baseline < pKF2->mb) {
+      return;
+    }
+  } else {
+    const float medianDepthKF2     = pKF2->ComputeSceneMedianDepth(2);
+    const float ratioBaselineDepth = baseline / medianDepthKF2;
 
-          sophTcw2 = pKF2->GetRightPose();
-          Ow2      = pKF2->GetRightCameraCenter();
+    if (ratioBaselineDepth < 0.01) {
+      return;
+    }
+  }
 
-          pCamera1 = mpCurrentKeyFrame->mpCamera;
-          pCamera2 = pKF2->mpCamera2;
-        } else {
-          sophTcw1 = mpCurrentKeyFrame->GetPose();
-          Ow1      = mpCurrentKeyFrame->GetCameraCenter();
+  // Search matches that fullfil epipolar constraint
+  ORBmatcher                                       matcher(0.6f, false);
+  std::vector<std::pair<std::size_t, std::size_t>> vMatchedIndices;
+  matcher.SearchForTriangulation(pKF1, pKF2, vMatchedIndices, false, bCoarse);
+
+  // Left and right views of both keyframes. The right ones are used when both keyframes have two
+  // cameras, matches being grouped by the pair of views their keypoints lie in.
+  const bool bTwoCameras = pKF1->mpCamera2 && pKF2->mpCamera2;
+
+  Sophus::SE3f     vTcw1[2]      = {pKF1->GetPose(), Sophus::SE3f()};
+  Sophus::SE3f     vTcw2[2]      = {pKF2->GetPose(), Sophus::SE3f()};
+  Eigen::Vector3f  vOw1[2]       = {pKF1->GetCameraCenter(), Eigen::Vector3f::Zero()};
+  Eigen::Vector3f  vOw2[2]       = {pKF2->GetCameraCenter(), Eigen::Vector3f::Zero()};
+  GeometricCamera* vpCameras1[2] = {pKF1->mpCamera, pKF1->mpCamera2};
+  GeometricCamera* vpCameras2[2] = {pKF2->mpCamera, pKF2->mpCamera2};
+  if (bTwoCameras) {
+    vTcw1[1] = pKF1->GetRightPose();
+    vTcw2[1] = pKF2->GetRightPose();
+    vOw1[1]  = pKF1->GetRightCameraCenter();
+    vOw2[1]  = pKF2->GetRightCameraCenter();
+  }
 
-          sophTcw2 = pKF2->GetPose();
-          Ow2      = pKF2->GetCameraCenter();
+  std::vector<int> vGroups[4];
+  for (int ikp = 0, nmatches = vMatchedIndices.size(); ikp < nmatches; ikp++) {
+    const int  idx1    = vMatchedIndices[ikp].first;
+    const int  idx2    = vMatchedIndices[ikp].second;
+    const bool bRight1 = bTwoCameras && idx1 >= pKF1->NLeft;
+    const bool bRight2 = bTwoCameras && idx2 >= pKF2->NLeft;
+    vGroups[2 * bRight1 + bRight2].push_back(ikp);
+  }
 
-          pCamera1 = mpCurrentKeyFrame->mpCamera;
-          pCamera2 = pKF2->mpCamera;
-        }
-        eigTcw1 = sophTcw1.matrix3x4();
-        Rcw1    = eigTcw1.block<3, 3>(0, 0);
-        Rwc1    = Rcw1.transpose();
-        tcw1    = sophTcw1.translation();
-
-        eigTcw2 = sophTcw2.matrix3x4();
-        Rcw2    = eigTcw2.block<3, 3>(0, 0);
-        Rwc2    = Rcw2.transpose();
-        tcw2    = sophTcw2.translation();
-      }
+  const std::vector<Eigen::Vector3f>& vBearings1 = pKF1->mvBearings;
+  const std::vector<Eigen::Vector3f>& vBearings2 = pKF2->mvBearings;
 
-      // Check parallax between rays
-      Eigen::Vector3f xn1 = pCamera1->unprojectEig(kp1.pt);
-      Eigen::Vector3f xn2 = pCamera2->unprojectEig(kp2.pt);
+  const float ratioFactor = 1.5f * pKF1->mfScaleFactor;
+  const float maxCosRays  = mbInertial ? 0.9996f : 0.9998f;
 
-      Eigen::Vector3f ray1            = Rwc1 * xn1;
-      Eigen::Vector3f ray2            = Rwc2 * xn2;
-      const float     cosParallaxRays = ray1.dot(ray2) / (ray1.norm() * ray2.norm());
+  for (int g = 0; g < 4; g++) {
+    const std::vector<int>& vGroup = vGroups[g];
+    const int               n      = vGroup.size();
+    if (n == 0) {
+      continue;
+    }
 
-      float cosParallaxStereo  = cosParallaxRays + 1;
-      float cosParallaxStereo1 = cosParallaxStereo;
-      float cosParallaxStereo2 = cosParallaxStereo;
+    const Eigen::Matrix3f  Rcw1     = vTcw1[g / 2].rotationMatrix();
+    const Eigen::Vector3f  tcw1     = vTcw1[g / 2].translation();
+    const Eigen::Vector3f& Ow1      = vOw1[g / 2];
+    GeometricCamera*       pCamera1 = vpCameras1[g / 2];
+    const Eigen::Matrix3f  Rcw2     = vTcw2[g % 2].rotationMatrix();
+    const Eigen::Vector3f  tcw2     = vTcw2[g % 2].translation();
+    const Eigen::Vector3f& Ow2      = vOw2[g % 2];
+    GeometricCamera*       pCamera2 = vpCameras2[g % 2];
+
+    // World rays of the cached bearings, triangulated all at once
+    std::vector<float> vRays1(3 * n), vRays2(3 * n), vCosParallaxRays(n), vTriangulated(3 * n);
+    for (int k = 0; k < n; k++) {
+      const Eigen::Vector3f ray1 = Rcw1.transpose() * vBearings1[vMatchedIndices[vGroup[k]].first];
+      const Eigen::Vector3f ray2 = Rcw2.transpose() * vBearings2[vMatchedIndices[vGroup[k]].second];
+      for (int c = 0; c < 3; c++) {
+        vRays1[c * n + k] = ray1(c);
+        vRays2[c * n + k] = ray2(c);
+      }
+    }
+    GeometricTools::TriangulateBatch(
+      Ow1, Ow2, vRays1.data(), vRays2.data(), n, vCosParallaxRays.data(), vTriangulated.data()
+    );
+
+    // Pick the triangulated point or the stereo one of the keyframe with the largest parallax, and
+    // keep the points in front of both cameras
+    std::vector<int>             vKept;
+    std::vector<Eigen::Vector3f> vx3D;
+    std::vector<float>           vPoints1(3 * n), vPoints2(3 * n);
+    vKept.reserve(n);
+    vx3D.reserve(n);
+    for (int k = 0; k < n; k++) {
+      const std::size_t idx1 = vMatchedIndices[vGroup[k]].first;
+      const std::size_t idx2 = vMatchedIndices[vGroup[k]].second;
+
+      const bool bStereo1 = !pKF1->mpCamera2 && pKF1->mvuRight[idx1] >= 0;
+      const bool bStereo2 = !pKF2->mpCamera2 && pKF2->mvuRight[idx2] >= 0;
+
+      const float cosParallaxRays    = vCosParallaxRays[k];
+      float       cosParallaxStereo1 = cosParallaxRays + 1;
+      float       cosParallaxStereo2 = cosParallaxRays + 1;
 
       if (bStereo1) {
-        cosParallaxStereo1
-          = cos(2 * atan2(mpCurrentKeyFrame->mb / 2, mpCurrentKeyFrame->mvDepth[idx1]));
+        cosParallaxStereo1 = cos(2 * atan2(pKF1->mb / 2, pKF1->mvDepth[idx1]));
       } else if (bStereo2) {
         cosParallaxStereo2 = cos(2 * atan2(pKF2->mb / 2, pKF2->mvDepth[idx2]));
       }
 
-      if (bStereo1 || bStereo2) {
-        totalStereoPts++;
-      }
-
-      cosParallaxStereo = min(cosParallaxStereo1, cosParallaxStereo2);
+      const float cosParallaxStereo = std::min(cosParallaxStereo1, cosParallaxStereo2);
 
       Eigen::Vector3f x3D;
-
-      bool goodProj     = false;
-      bool bPointStereo = false;
-      if (cosParallaxRays < cosParallaxStereo && cosParallaxRays > 0 && (bStereo1 || bStereo2 || (cosParallaxRays < 0.9996 && mbInertial) || (cosParallaxRays < 0.9998 && !mbInertial))) {
-        goodProj = GeometricTools::Triangulate(xn1, xn2, eigTcw1, eigTcw2, x3D);
-        if (!goodProj) {
+      if (cosParallaxRays < cosParallaxStereo && cosParallaxRays > 0
+          && (bStereo1 || bStereo2 || cosParallaxRays < maxCosRays)) {
+        x3D = Eigen::Vector3f(vTriangulated[k], vTriangulated[n + k], vTriangulated[2 * n + k]);
+        if (!x3D.allFinite()) {
           continue;
         }
       } else if (bStereo1 && cosParallaxStereo1 < cosParallaxStereo2) {
-        countStereoAttempt++;
-        bPointStereo = true;
-        goodProj     = mpCurrentKeyFrame->UnprojectStereo(idx1, x3D);
+        if (!pKF1->UnprojectStereo(idx1, x3D)) {
+          continue;
+        }
       } else if (bStereo2 && cosParallaxStereo2 < cosParallaxStereo1) {
-        countStereoAttempt++;
-        bPointStereo = true;
-        goodProj     = pKF2->UnprojectStereo(idx2, x3D);
+        if (!pKF2->UnprojectStereo(idx2, x3D)) {
+          continue;
+        }
       } else {
         continue; // No stereo and very low parallax
       }
 
-      if (goodProj && bPointStereo) {
-        countStereoGoodProj++;
-      }
-
-      if (!goodProj) {
+      // Check triangulation in front of cameras
+      const Eigen::Vector3f x3Dc1 = Rcw1 * x3D + tcw1;
+      if (x3Dc1(2) <= 0) {
         continue;
       }
 
-      // Check triangulation in front of cameras
-      float z1 = Rcw1.row(2).dot(x3D) + tcw1(2);
-      if (z1 <= 0) {
+      const Eigen::Vector3f x3Dc2 = Rcw2 * x3D + tcw2;
+      if (x3Dc2(2) <= 0) {
         continue;
       }
 
-      float z2 = Rcw2.row(2).dot(x3D) + tcw2(2);
-      if (z2 <= 0) {
-        continue;
+      const int kept = vKept.size();
+      for (int c = 0; c < 3; c++) {
+        vPoints1[c * n + kept] = x3Dc1(c);
+        vPoints2[c * n + kept] = x3Dc2(c);
       }
+      vKept.push_back(k);
+      vx3D.push_back(x3D);
+    }
+
+    // Check reprojection error in both keyframes, projecting the kept points all at once
+    const int          nKept = vKept.size();
+    std::vector<float> vu1(nKept), vv1(nKept), vu2(nKept), vv2(nKept);
+    pCamera1->projectBatch(
+      vPoints1.data(), vPoints1.data() + n, vPoints1.data() + 2 * n, nKept, vu1.data(), vv1.data()
+    );
+    pCamera2->projectBatch(
+      vPoints2.data(), vPoints2.data() + n, vPoints2.data() + 2 * n, nKept, vu2.data(), vv2.data()
+    );
+
+    for (int j = 0; j < nKept; j++) {
+      const std::size_t idx1 = vMatchedIndices[vGroup[vKept[j]]].first;
+      const std::size_t idx2 = vMatchedIndices[vGroup[vKept[j]]].second;
+
+      const cv::KeyPoint& kp1 = (pKF1->NLeft == -1)  ? pKF1->mvKeysUn[idx1]
+                              : (idx1 < pKF1->NLeft) ? pKF1->mvKeys[idx1]
+                                                     : pKF1->mvKeysRight[idx1 - pKF1->NLeft];
+      const cv::KeyPoint& kp2 = (pKF2->NLeft == -1)  ? pKF2->mvKeysUn[idx2]
+                              : (idx2 < pKF2->NLeft) ? pKF2->mvKeys[idx2]
+                                                     : pKF2->mvKeysRight[idx2 - pKF2->NLeft];
 
-      // Check reprojection error in first keyframe
-      const float& sigmaSquare1 = mpCurrentKeyFrame->mvLevelSigma2[kp1.octave];
-      const float  x1           = Rcw1.row(0).dot(x3D) + tcw1(0);
-      const float  y1           = Rcw1.row(1).dot(x3D) + tcw1(1);
-      const float  invz1        = 1.0 / z1;
+      const float kp1_ur = pKF1->mvuRight[idx1];
+      const float kp2_ur = pKF2->mvuRight[idx2];
 
-      if (!bStereo1) {
-        cv::Point2f uv1   = pCamera1->project(cv::Point3f(x1, y1, z1));
-        float       errX1 = uv1.x - kp1.pt.x;
-        float       errY1 = uv1.y - kp1.pt.y;
+      const bool bStereo1 = !pKF1->mpCamera2 && kp1_ur >= 0;
+      const bool bStereo2 = !pKF2->mpCamera2 && kp2_ur >= 0;
 
+      const float& sigmaSquare1 = pKF1->mvLevelSigma2[kp1.octave];
+      const float  x1           = vPoints1[j];
+      const float  y1           = vPoints1[n + j];
+      const float  invz1        = 1.0 / vPoints1[2 * n + j];
+      if (!bStereo1) {
+        const float errX1 = vu1[j] - kp1.pt.x;
+        const float errY1 = vv1[j] - kp1.pt.y;
         if ((errX1 * errX1 + errY1 * errY1) > 5.991 * sigmaSquare1) {
           continue;
         }
-
       } else {
-        float u1      = fx1 * x1 * invz1 + cx1;
-        float u1_r    = u1 - mpCurrentKeyFrame->mbf * invz1;
-        float v1      = fy1 * y1 * invz1 + cy1;
-        float errX1   = u1 - kp1.pt.x;
-        float errY1   = v1 - kp1.pt.y;
-        float errX1_r = u1_r - kp1_ur;
+        const float u1      = pKF1->fx * x1 * invz1 + pKF1->cx;
+        const float u1_r    = u1 - pKF1->mbf * invz1;
+        const float v1      = pKF1->fy * y1 * invz1 + pKF1->cy;
+        const float errX1   = u1 - kp1.pt.x;
+        const float errY1   = v1 - kp1.pt.y;
+        const float errX1_r = u1_r - kp1_ur;
         if ((errX1 * errX1 + errY1 * errY1 + errX1_r * errX1_r) > 7.8 * sigmaSquare1) {
           continue;
         }
       }
 
-      // Check reprojection error in second keyframe
       const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
-      const float x2           = Rcw2.row(0).dot(x3D) + tcw2(0);
-      const float y2           = Rcw2.row(1).dot(x3D) + tcw2(1);
-      const float invz2        = 1.0 / z2;
+      const float x2           = vPoints2[j];
+      const float y2           = vPoints2[n + j];
+      const float invz2        = 1.0 / vPoints2[2 * n + j];
       if (!bStereo2) {
-        cv::Point2f uv2   = pCamera2->project(cv::Point3f(x2, y2, z2));
-        float       errX2 = uv2.x - kp2.pt.x;
-        float       errY2 = uv2.y - kp2.pt.y;
+        const float errX2 = vu2[j] - kp2.pt.x;
+        const float errY2 = vv2[j] - kp2.pt.y;
         if ((errX2 * errX2 + errY2 * errY2) > 5.991 * sigmaSquare2) {
           continue;
         }
       } else {
-        float u2      = fx2 * x2 * invz2 + cx2;
-        float u2_r    = u2 - mpCurrentKeyFrame->mbf * invz2;
-        float v2      = fy2 * y2 * invz2 + cy2;
-        float errX2   = u2 - kp2.pt.x;
-        float errY2   = v2 - kp2.pt.y;
-        float errX2_r = u2_r - kp2_ur;
+        const float u2      = pKF2->fx * x2 * invz2 + pKF2->cx;
+        const float u2_r    = u2 - pKF1->mbf * invz2;
+        const float v2      = pKF2->fy * y2 * invz2 + pKF2->cy;
+        const float errX2   = u2 - kp2.pt.x;
+        const float errY2   = v2 - kp2.pt.y;
+        const float errX2_r = u2_r - kp2_ur;
         if ((errX2 * errX2 + errY2 * errY2 + errX2_r * errX2_r) > 7.8 * sigmaSquare2) {
           continue;
         }
       }
 
       // Check scale consistency
-      Eigen::Vector3f normal1 = x3D - Ow1;
-      float           dist1   = normal1.norm();
-
-      Eigen::Vector3f normal2 = x3D - Ow2;
-      float           dist2   = normal2.norm();
+      const float dist1 = (vx3D[j] - Ow1).norm();
+      const float dist2 = (vx3D[j] - Ow2).norm();
 
       if (dist1 == 0 || dist2 == 0) {
         continue;
@@ -710,32 +731,15 @@ void LocalMapping::CreateNewMapPoints() {
         continue;
       }
 
-      const float ratioDist = dist2 / dist1;
-      const float ratioOctave
-        = mpCurrentKeyFrame->mvScaleFactors[kp1.octave] / pKF2->mvScaleFactors[kp2.octave];
+      const float ratioDist   = dist2 / dist1;
+      const float ratioOctave = pKF1->mvScaleFactors[kp1.octave] / pKF2->mvScaleFactors[kp2.octave];
 
       if (ratioDist * ratioFactor < ratioOctave || ratioDist > ratioOctave * ratioFactor) {
         continue;
       }
 
       // Triangulation is succesfull
-      MapPoint* pMP = new MapPoint(x3D, mpCurrentKeyFrame, mpAtlas->GetCurrentMap());
-      if (bPointStereo) {
-        countStereo++;
-      }
-
-      pMP->AddObservation(mpCurrentKeyFrame, idx1);
-      pMP->AddObservation(pKF2, idx2);
-
-      mpCurrentKeyFrame->AddMapPoint(pMP, idx1);
-      pKF2->AddMapPoint(pMP, idx2);
-
-      pMP->ComputeDistinctiveDescriptors();
-
-      pMP->UpdateNormalAndDepth();
-
-      mpAtlas->AddMapPoint(pMP);
-      mlpRecentAddedMapPoints.push_back(pMP);
+      vNewMapPoints.push_back({idx1, idx2, vx3D[j]});
     }
   }
 }
@@ -794,6 +798,8 @@ void LocalMapping::SearchInNeighbors() {
     }
   }
 
+  ThreadPool* pThreadPool = mpThreadPool->NumThreads() > 1 ? mpThreadPool.get() : nullptr;
+
   // Search matches by projection from current KF in target KFs
   ORBmatcher             matcher;
   std::vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
@@ -802,9 +808,9 @@ void LocalMapping::SearchInNeighbors() {
        vit++) {
     KeyFrame* pKFi = *vit;
 
-    matcher.Fuse(pKFi, vpMapPointMatches);
+    matcher.Fuse(pKFi, vpMapPointMatches, 3.0, false, pThreadPool);
     if (pKFi->NLeft != -1) {
-      matcher.Fuse(pKFi, vpMapPointMatches, true);
+      matcher.Fuse(pKFi, vpMapPointMatches, 3.0, true, pThreadPool);
     }
   }
 
@@ -839,9 +845,9 @@ void LocalMapping::SearchInNeighbors() {
     }
   }
 
-  matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates);
+  matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates, 3.0, false, pThreadPool);
   if (mpCurrentKeyFrame->NLeft != -1) {
-    matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates, true);
+    matcher.Fuse(mpCurrentKeyFrame, vpFuseCandidates, 3.0, true, pThreadPool);
   }
 
   // Update points
@@ -894,6 +900,10 @@ void LocalMapping::Release() {
   if (mbFinished) {
     return;
   }
+  if (mbStopped) {
+    // The map changed while stopped, preintegrations integrated again included
+    mpLocalInertialBAGraph->Clear();
+  }
   mbStopped       = false;
   mbStopRequested = false;
   for (std::list<KeyFrame*>::iterator lit = mlNewKeyFrames.begin(), lend = mlNewKeyFrames.end();
@@ -1160,6 +1170,8 @@ void LocalMapping::ResetIfRequested() {
     }
   }
   if (executed_reset) {
+    // The IMU is initialized again from the next keyframes
+    mpLocalInertialBAGraph->Clear();
     _logger->info("Reset completed, releasing mutex...");
   }
 }
@@ -1290,6 +1302,8 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA) {
     priorG,
     priorA
   );
+  // The preintegrations were integrated again with the new biases
+  mpLocalInertialBAGraph->Clear();
 
   std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
 
@@ -1335,7 +1349,10 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA) {
         NULL,
         true,
         priorG,
-        priorA
+        priorA,
+        NULL,
+        NULL,
+        mpThreadPool.get()
       );
     } else {
       Optimizer::FullInertialBA(
@@ -1344,7 +1361,12 @@ void LocalMapping::InitializeIMU(float priorG, float priorA, bool bFIBA) {
         false,
         mpCurrentKeyFrame->mnId,
         NULL,
-        false
+        false,
+        1e2,
+        1e6,
+        NULL,
+        NULL,
+        mpThreadPool.get()
       );
     }
   }
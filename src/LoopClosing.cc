@@ -18,6 +18,7 @@
  */
 
 #include "LoopClosing.h"
+#include <algorithm>
 #include "Atlas.h"
 #include "Converter.h"
 #include "G2oTypes.h"
@@ -29,6 +30,7 @@
 #include "Optimizer.h"
 #include "Sim3Solver.h"
 #include "System.h"
+#include "ThreadPool.h"
 #include "Tracking.h"
 
 namespace ORB_SLAM3 {
@@ -38,7 +40,8 @@ LoopClosing::LoopClosing(
   KeyFrameDatabase* pDB,
   ORBVocabulary*    pVoc,
   const bool        bFixScale,
-  const bool        bActiveLC
+  const bool        bActiveLC,
+  const int         nThreads
 )
   : mbResetRequested(false)
   , mbResetActiveMapRequested(false)
@@ -47,6 +50,7 @@ LoopClosing::LoopClosing(
   , mpAtlas(pAtlas)
   , mpKeyFrameDB(pDB)
   , mpORBVocabulary(pVoc)
+  , mpThreadPool(std::make_unique<ThreadPool>(nThreads))
   , mpMatchedKF(NULL)
   , mLastLoopKFid(0)
   , mbRunningGBA(false)
@@ -99,6 +103,8 @@ LoopClosing::LoopClosing(
   mnCorrectionGBA   = 0;
 }
 
+LoopClosing::~LoopClosing() = default;
+
 void LoopClosing::SetTracker(Tracking* pTracker) {
   mpTracker = pTracker;
 }
@@ -2175,7 +2181,8 @@ void LoopClosing::CheckObservations(
 void LoopClosing::SearchAndFuse(
   const KeyFrameAndPose& CorrectedPosesMap, std::vector<MapPoint*>& vpMapPoints
 ) {
-  ORBmatcher matcher(0.8);
+  ORBmatcher  matcher(0.8);
+  ThreadPool* pThreadPool = mpThreadPool->NumThreads() > 1 ? mpThreadPool.get() : nullptr;
 
   int total_replaces = 0;
 
@@ -2191,18 +2198,11 @@ void LoopClosing::SearchAndFuse(
     Sophus::Sim3f Scw    = Converter::toSophus(g2oScw);
 
     std::vector<MapPoint*> vpReplacePoints(vpMapPoints.size(), static_cast<MapPoint*>(NULL));
-    int                    numFused = matcher.Fuse(pKFi, Scw, vpMapPoints, 4, vpReplacePoints);
+    int numFused = matcher.Fuse(pKFi, Scw, vpMapPoints, 4, vpReplacePoints, pThreadPool);
 
     // Get Map Mutex
     std::unique_lock<std::mutex> lock(pMap->mMutexMapUpdate);
-    const int                    nLP = vpMapPoints.size();
-    for (int i = 0; i < nLP; i++) {
-      MapPoint* pRep = vpReplacePoints[i];
-      if (pRep) {
-        num_replaces += 1;
-        pRep->Replace(vpMapPoints[i]);
-      }
-    }
+    num_replaces = ORBmatcher::ReplaceFusedPoints(vpMapPoints, vpReplacePoints, pThreadPool);
 
     total_replaces += num_replaces;
   }
@@ -2211,7 +2211,8 @@ void LoopClosing::SearchAndFuse(
 void LoopClosing::SearchAndFuse(
   const std::vector<KeyFrame*>& vConectedKFs, std::vector<MapPoint*>& vpMapPoints
 ) {
-  ORBmatcher matcher(0.8);
+  ORBmatcher  matcher(0.8);
+  ThreadPool* pThreadPool = mpThreadPool->NumThreads() > 1 ? mpThreadPool.get() : nullptr;
 
   int total_replaces = 0;
 
@@ -2226,18 +2227,11 @@ void LoopClosing::SearchAndFuse(
     //              Scw.translation()    = Tcw.translation()
     //              Scw.scale()          = 1
     std::vector<MapPoint*> vpReplacePoints(vpMapPoints.size(), static_cast<MapPoint*>(NULL));
-    matcher.Fuse(pKF, Scw, vpMapPoints, 4, vpReplacePoints);
+    matcher.Fuse(pKF, Scw, vpMapPoints, 4, vpReplacePoints, pThreadPool);
 
     // Get Map Mutex
     std::unique_lock<std::mutex> lock(pMap->mMutexMapUpdate);
-    const int                    nLP = vpMapPoints.size();
-    for (int i = 0; i < nLP; i++) {
-      MapPoint* pRep = vpReplacePoints[i];
-      if (pRep) {
-        num_replaces += 1;
-        pRep->Replace(vpMapPoints[i]);
-      }
-    }
+    num_replaces += ORBmatcher::ReplaceFusedPoints(vpMapPoints, vpReplacePoints, pThreadPool);
   }
 }
 
@@ -2303,6 +2297,15 @@ void LoopClosing::ResetIfRequested() {
   }
 }
 
+namespace {
+
+// Keyframes of a map above which its global bundle adjustment solves the camera system with the
+// conjugate gradients, whose cost grows with the covisibility edges only. Below, the fill-in of
+// the Cholesky factorization is small and its exact steps converge in fewer iterations.
+const unsigned long kMinKFsIterativeGBA = 1000;
+
+} // namespace
+
 void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoopKF) {
   _logger->info("Starting global bundle adjustment...");
 
@@ -2313,12 +2316,29 @@ void LoopClosing::RunGlobalBundleAdjustment(Map* pActiveMap, unsigned long nLoop
   vnGBAMPs.push_back(pActiveMap->GetAllMapPoints().size());
 #endif
 
-  const bool bImuInit = pActiveMap->isImuInitialized();
+  const bool                   bImuInit = pActiveMap->isImuInitialized();
+  const Optimizer::eLinearSolver linearSolverType
+    = pActiveMap->KeyFramesInMap() > kMinKFsIterativeGBA ? Optimizer::PCG : Optimizer::CHOLESKY;
 
   if (!bImuInit) {
-    Optimizer::GlobalBundleAdjustemnt(pActiveMap, 10, &mbStopGBA, nLoopKF, false);
+    Optimizer::GlobalBundleAdjustemnt(
+      pActiveMap, 10, &mbStopGBA, nLoopKF, false, mpThreadPool.get(), linearSolverType
+    );
   } else {
-    Optimizer::FullInertialBA(pActiveMap, 7, false, nLoopKF, &mbStopGBA);
+    Optimizer::FullInertialBA(
+      pActiveMap,
+      7,
+      false,
+      nLoopKF,
+      &mbStopGBA,
+      false,
+      1e2,
+      1e6,
+      NULL,
+      NULL,
+      mpThreadPool.get(),
+      linearSolverType
+    );
   }
 
 #ifdef REGISTER_TIMES
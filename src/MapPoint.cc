@@ -167,7 +167,7 @@ MapPoint::MapPoint(const Eigen::Vector3f& Pos, Map* pMap, Frame* pFrame, const i
   mfMaxDistance = dist * levelScaleFactor;
   mfMinDistance = mfMaxDistance / pFrame->mvScaleFactors[nLevels - 1];
 
-  pFrame->mDescriptors.row(idxF).copyTo(mDescriptor);
+  mDescriptor = pFrame->mDescriptors[idxF];
 
   // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
   std::unique_lock<std::mutex> lock(mpMap->mMutexPointCreation);
@@ -375,7 +375,7 @@ float MapPoint::GetFoundRatio() {
 
 void MapPoint::ComputeDistinctiveDescriptors() {
   // Retrieve all observed descriptors
-  std::vector<cv::Mat> vDescriptors;
+  std::vector<Descriptor> vDescriptors;
 
   std::map<KeyFrame*, std::tuple<int, int>> observations;
 
@@ -404,10 +404,10 @@ void MapPoint::ComputeDistinctiveDescriptors() {
       int                  leftIndex = std::get<0>(indexes), rightIndex = std::get<1>(indexes);
 
       if (leftIndex != -1) {
-        vDescriptors.push_back(pKF->mDescriptors.row(leftIndex));
+        vDescriptors.push_back(pKF->mDescriptors[leftIndex]);
       }
       if (rightIndex != -1) {
-        vDescriptors.push_back(pKF->mDescriptors.row(rightIndex));
+        vDescriptors.push_back(pKF->mDescriptors[rightIndex]);
       }
     }
   }
@@ -445,13 +445,13 @@ void MapPoint::ComputeDistinctiveDescriptors() {
 
   {
     std::unique_lock<std::mutex> lock(mMutexFeatures);
-    mDescriptor = vDescriptors[BestIdx].clone();
+    mDescriptor = vDescriptors[BestIdx];
   }
 }
 
-cv::Mat MapPoint::GetDescriptor() {
+Descriptor MapPoint::GetDescriptor() {
   std::unique_lock<std::mutex> lock(mMutexFeatures);
-  return mDescriptor.clone();
+  return mDescriptor;
 }
 
 std::tuple<int, int> MapPoint::GetIndexInKeyFrame(KeyFrame* pKF) {
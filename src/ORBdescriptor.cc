@@ -0,0 +1,345 @@
+#include "ORBdescriptor.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+const int   HALF_PATCH_SIZE = 15;
+const int   kPatternPoints  = 512;
+const float factorPI        = (float)(CV_PI / 180.f);
+
+#if !defined(__SSE2__)
+float ICAngleScalar(const uchar* center, const int step, const std::vector<int>& umax) {
+  int m_01 = 0, m_10 = 0;
+
+  // Treat the center line differently, v=0
+  for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u) {
+    m_10 += u * center[u];
+  }
+
+  // Go line by line in the circular patch
+  for (int v = 1; v <= HALF_PATCH_SIZE; ++v) {
+    // Proceed over the two lines
+    int v_sum = 0;
+    int d     = umax[v];
+    for (int u = -d; u <= d; ++u) {
+      int val_plus = center[u + v * step], val_minus = center[u - v * step];
+      v_sum += (val_plus - val_minus);
+      m_10  += u * (val_plus + val_minus);
+    }
+    m_01 += v * v_sum;
+  }
+
+  return cv::fastAtan2((float)m_01, (float)m_10);
+}
+#endif
+
+// Rows below the keypoint that the sampling pattern may reach once rotated.
+int PatternReach(const cv::Point* pattern, const int nPoints) {
+  int r2 = 0;
+  for (int i = 0; i < nPoints; i++) {
+    r2 = std::max(r2, pattern[i].x * pattern[i].x + pattern[i].y * pattern[i].y);
+  }
+  return cvCeil(std::sqrt(static_cast<float>(r2))) + 1;
+}
+
+#if !defined(__SSE2__)
+void PackTestsScalar(const uchar* values, uchar* desc) {
+  for (int i = 0; i < 32; i++, values += 16) {
+    int val = 0;
+    for (int j = 0; j < 8; j++) {
+      val |= (values[2 * j] < values[2 * j + 1]) << j;
+    }
+    desc[i] = static_cast<uchar>(val);
+  }
+}
+#endif
+
+#if defined(__SSE2__)
+// Patch rows are read as the 32 pixels u in [-15, 16], widened into four vectors of eight 16-bit
+// lanes. Lanes outside the circular patch are cleared by a per-row mask.
+struct PatchMasks {
+  __m128i weight[4];
+  __m128i row[HALF_PATCH_SIZE + 1][4];
+};
+
+void MakePatchMasks(const std::vector<int>& umax, PatchMasks& masks) {
+  for (int k = 0; k < 4; k++) {
+    alignas(16) short w[8];
+    for (int l = 0; l < 8; l++) {
+      w[l] = static_cast<short>(-HALF_PATCH_SIZE + 8 * k + l);
+    }
+    masks.weight[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(w));
+  }
+
+  for (int v = 0; v <= HALF_PATCH_SIZE; v++) {
+    const int d = v == 0 ? HALF_PATCH_SIZE : umax[v];
+    for (int k = 0; k < 4; k++) {
+      alignas(16) short m[8];
+      for (int l = 0; l < 8; l++) {
+        m[l] = std::abs(-HALF_PATCH_SIZE + 8 * k + l) <= d ? -1 : 0;
+      }
+      masks.row[v][k] = _mm_load_si128(reinterpret_cast<const __m128i*>(m));
+    }
+  }
+}
+
+inline void LoadPatchRow(const uchar* ptr, __m128i out[4]) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr - HALF_PATCH_SIZE));
+  const __m128i hi   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + 1));
+  out[0]             = _mm_unpacklo_epi8(lo, zero);
+  out[1]             = _mm_unpackhi_epi8(lo, zero);
+  out[2]             = _mm_unpacklo_epi8(hi, zero);
+  out[3]             = _mm_unpackhi_epi8(hi, zero);
+}
+
+inline int HorizontalSum(const __m128i v) {
+  __m128i s = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  s         = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+float ICAngleSSE2(const uchar* center, const int step, const PatchMasks& masks) {
+  __m128i acc10 = _mm_setzero_si128();
+  __m128i acc01 = _mm_setzero_si128();
+
+  __m128i r[4];
+  LoadPatchRow(center, r);
+  for (int k = 0; k < 4; k++) {
+    const __m128i rk = _mm_and_si128(r[k], masks.row[0][k]);
+    acc10            = _mm_add_epi32(acc10, _mm_madd_epi16(rk, masks.weight[k]));
+  }
+
+  __m128i p[4], m[4];
+  for (int v = 1; v <= HALF_PATCH_SIZE; v++) {
+    LoadPatchRow(center + v * step, p);
+    LoadPatchRow(center - v * step, m);
+    const __m128i vv = _mm_set1_epi16(static_cast<short>(v));
+    for (int k = 0; k < 4; k++) {
+      const __m128i pk = _mm_and_si128(p[k], masks.row[v][k]);
+      const __m128i mk = _mm_and_si128(m[k], masks.row[v][k]);
+      acc10 = _mm_add_epi32(acc10, _mm_madd_epi16(_mm_add_epi16(pk, mk), masks.weight[k]));
+      acc01 = _mm_add_epi32(acc01, _mm_madd_epi16(_mm_sub_epi16(pk, mk), vv));
+    }
+  }
+
+  return cv::fastAtan2((float)HorizontalSum(acc01), (float)HorizontalSum(acc10));
+}
+
+// Turn four (dx, dy) pairs, as 32-bit integers, into the pixel offsets dx + dy * step.
+inline __m128i PairsToOffsets(const __m128i xy01, const __m128i xy23, const __m128i step1) {
+  return _mm_madd_epi16(_mm_packs_epi32(xy01, xy23), step1);
+}
+
+inline __m128i StepPairs(const int step) {
+  return _mm_set1_epi32(static_cast<int>((static_cast<unsigned>(step) << 16) | 1u));
+}
+
+void PackTestsSSE2(const uchar* values, uchar* desc) {
+  const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+  for (int i = 0; i < kPatternPoints; i += 32) {
+    const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 16));
+    // t0 < t1 for the pairs (2k, 2k + 1), one bit per pair in pattern order
+    const __m128i lt0
+      = _mm_cmpgt_epi16(_mm_srli_epi16(v0, 8), _mm_and_si128(v0, lowBytes));
+    const __m128i lt1
+      = _mm_cmpgt_epi16(_mm_srli_epi16(v1, 8), _mm_and_si128(v1, lowBytes));
+    const int mask   = _mm_movemask_epi8(_mm_packs_epi16(lt0, lt1));
+    desc[i / 16]     = static_cast<uchar>(mask);
+    desc[i / 16 + 1] = static_cast<uchar>(mask >> 8);
+  }
+}
+#endif
+
+// Sample the pixels at the given offsets from center and pack the pairwise tests. The gather may
+// read three bytes past each sample, which the caller allows by setting canOverread.
+void DescribeAtOffsets(
+  const uchar* center, const int* offsets, const bool canOverread, uchar* desc
+) {
+  alignas(32) uchar values[kPatternPoints];
+
+#if defined(__AVX2__)
+  if (canOverread) {
+    const __m256i lowByte = _mm256_set1_epi32(0xFF);
+    const __m256i order   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const int*    base    = reinterpret_cast<const int*>(center);
+    for (int i = 0; i < kPatternPoints; i += 32) {
+      __m256i g[4];
+      for (int k = 0; k < 4; k++) {
+        const __m256i idx
+          = _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets + i + 8 * k));
+        g[k] = _mm256_and_si256(_mm256_i32gather_epi32(base, idx, 1), lowByte);
+      }
+      const __m256i p01 = _mm256_packus_epi32(g[0], g[1]);
+      const __m256i p23 = _mm256_packus_epi32(g[2], g[3]);
+      const __m256i p   = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(p01, p23), order);
+      _mm256_store_si256(reinterpret_cast<__m256i*>(values + i), p);
+    }
+  } else
+#endif
+  {
+    (void)canOverread;
+    for (int i = 0; i < kPatternPoints; i++) {
+      values[i] = center[offsets[i]];
+    }
+  }
+
+#if defined(__SSE2__)
+  PackTestsSSE2(values, desc);
+#else
+  PackTestsScalar(values, desc);
+#endif
+}
+
+inline bool CanOverread(const cv::Mat& image, const cv::KeyPoint& kpt, const int reach) {
+  return cvRound(kpt.pt.y) + reach < image.rows;
+}
+
+} // namespace
+
+void ComputeOrientations(
+  const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& umax
+) {
+  const int step = (int)image.step1();
+
+#if defined(__SSE2__)
+  PatchMasks masks;
+  MakePatchMasks(umax, masks);
+#endif
+
+  for (cv::KeyPoint& keypoint : keypoints) {
+    const uchar* center = &image.at<uchar>(cvRound(keypoint.pt.y), cvRound(keypoint.pt.x));
+#if defined(__SSE2__)
+    keypoint.angle = ICAngleSSE2(center, step, masks);
+#else
+    keypoint.angle = ICAngleScalar(center, step, umax);
+#endif
+  }
+}
+
+void ComputeDescriptors(
+  const cv::Mat&                   image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const std::vector<cv::Point>&    pattern,
+  cv::Mat&                         descriptors
+) {
+  descriptors.create((int)keypoints.size(), 32, CV_8UC1);
+
+  const int step  = (int)image.step;
+  const int reach = PatternReach(pattern.data(), kPatternPoints);
+
+  alignas(32) int offsets[kPatternPoints];
+  for (std::size_t n = 0; n < keypoints.size(); n++) {
+    const cv::KeyPoint& kpt = keypoints[n];
+
+    float angle = (float)kpt.angle * factorPI;
+    float a = (float)std::cos(angle), b = (float)std::sin(angle);
+
+#if defined(__SSE2__)
+    if (step <= SHRT_MAX) {
+      const __m128  va    = _mm_set1_ps(a);
+      const __m128  vb    = _mm_set1_ps(b);
+      const __m128i step1 = StepPairs(step);
+      const int*    xy    = reinterpret_cast<const int*>(pattern.data());
+      for (int i = 0; i < kPatternPoints; i += 4) {
+        // Split four (x, y) points into x and y vectors
+        const __m128 q0
+          = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 2 * i)));
+        const __m128 q1
+          = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 2 * i + 4)));
+        const __m128i xi = _mm_castps_si128(_mm_shuffle_ps(q0, q1, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i yi = _mm_castps_si128(_mm_shuffle_ps(q0, q1, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128  x  = _mm_cvtepi32_ps(xi);
+        const __m128  y  = _mm_cvtepi32_ps(yi);
+
+        // Same float expressions and round-to-nearest-even as cvRound in the scalar version
+        const __m128i dx = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, va), _mm_mul_ps(y, vb)));
+        const __m128i dy = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, vb), _mm_mul_ps(y, va)));
+
+        _mm_store_si128(
+          reinterpret_cast<__m128i*>(offsets + i),
+          PairsToOffsets(_mm_unpacklo_epi32(dx, dy), _mm_unpackhi_epi32(dx, dy), step1)
+        );
+      }
+    } else
+#endif
+    {
+      for (int i = 0; i < kPatternPoints; i++) {
+        offsets[i] = cvRound(pattern[i].x * b + pattern[i].y * a) * step
+                   + cvRound(pattern[i].x * a - pattern[i].y * b);
+      }
+    }
+
+    const uchar* center = &image.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+    DescribeAtOffsets(center, offsets, CanOverread(image, kpt, reach), descriptors.ptr((int)n));
+  }
+}
+
+std::vector<cv::Point> ComputeRotatedPatterns(
+  const std::vector<cv::Point>& pattern, const int nAngleBins
+) {
+  std::vector<cv::Point> rotated;
+  rotated.reserve(nAngleBins * pattern.size());
+  for (int bin = 0; bin < nAngleBins; bin++) {
+    const float angle = (360.f * bin / nAngleBins) * factorPI;
+    const float a = (float)std::cos(angle), b = (float)std::sin(angle);
+    for (const cv::Point& p : pattern) {
+      rotated.emplace_back(cvRound(p.x * a - p.y * b), cvRound(p.x * b + p.y * a));
+    }
+  }
+  return rotated;
+}
+
+void ComputeDescriptorsBinned(
+  const cv::Mat&                   image,
+  const std::vector<cv::KeyPoint>& keypoints,
+  const std::vector<cv::Point>&    rotatedPatterns,
+  const int                        nAngleBins,
+  cv::Mat&                         descriptors
+) {
+  descriptors.create((int)keypoints.size(), 32, CV_8UC1);
+
+  const int step = (int)image.step;
+  int       reach = 0;
+  for (const cv::Point& p : rotatedPatterns) {
+    reach = std::max(reach, std::abs(p.y) + 1);
+  }
+
+  alignas(32) int offsets[kPatternPoints];
+  for (std::size_t n = 0; n < keypoints.size(); n++) {
+    const cv::KeyPoint& kpt = keypoints[n];
+
+    const int        bin     = cvRound(kpt.angle * nAngleBins / 360.f) % nAngleBins;
+    const cv::Point* pattern = &rotatedPatterns[bin * kPatternPoints];
+
+#if defined(__SSE2__)
+    if (step <= SHRT_MAX) {
+      const __m128i step1 = StepPairs(step);
+      const int*    xy    = reinterpret_cast<const int*>(pattern);
+      for (int i = 0; i < kPatternPoints; i += 4) {
+        const __m128i xy01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 2 * i));
+        const __m128i xy23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xy + 2 * i + 4));
+        _mm_store_si128(reinterpret_cast<__m128i*>(offsets + i), PairsToOffsets(xy01, xy23, step1));
+      }
+    } else
+#endif
+    {
+      for (int i = 0; i < kPatternPoints; i++) {
+        offsets[i] = pattern[i].y * step + pattern[i].x;
+      }
+    }
+
+    const uchar* center = &image.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+    DescribeAtOffsets(center, offsets, CanOverread(image, kpt, reach), descriptors.ptr((int)n));
+  }
+}
+
+} // namespace ORB_SLAM3
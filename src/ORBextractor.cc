@@ -53,9 +53,14 @@
  */
 
 #include "ORBextractor.h"
+#include <array>
 #include <iostream>
 #include <opencv2/features2d.hpp>
 #include <opencv2/imgproc.hpp>
+#include "FASTdetector.h"
+#include "ImageConditioner.h"
+#include "ORBdescriptor.h"
+#include "ThreadPool.h"
 
 namespace ORB_SLAM3 {
 
@@ -63,81 +68,6 @@ const int PATCH_SIZE      = 31;
 const int HALF_PATCH_SIZE = 15;
 const int EDGE_THRESHOLD  = 19;
 
-static float IC_Angle(const cv::Mat& image, cv::Point2f pt, const std::vector<int>& u_max) {
-  int m_01 = 0, m_10 = 0;
-
-  const uchar* center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
-
-  // Treat the center line differently, v=0
-  for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u) {
-    m_10 += u * center[u];
-  }
-
-  // Go line by line in the circuI853lar patch
-  int step = (int)image.step1();
-  for (int v = 1; v <= HALF_PATCH_SIZE; ++v) {
-    // Proceed over the two lines
-    int v_sum = 0;
-    int d     = u_max[v];
-    for (int u = -d; u <= d; ++u) {
-      int val_plus = center[u + v * step], val_minus = center[u - v * step];
-      v_sum += (val_plus - val_minus);
-      m_10  += u * (val_plus + val_minus);
-    }
-    m_01 += v * v_sum;
-  }
-
-  return cv::fastAtan2((float)m_01, (float)m_10);
-}
-
-const float factorPI = (float)(CV_PI / 180.f);
-static void computeOrbDescriptor(
-  const cv::KeyPoint& kpt, const cv::Mat& img, const cv::Point* pattern, uchar* desc
-) {
-  float angle = (float)kpt.angle * factorPI;
-  float a = (float)std::cos(angle), b = (float)std::sin(angle);
-
-  const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
-  const int    step   = (int)img.step;
-
-#define GET_VALUE(idx)                                       \
-  center                                                     \
-    [cvRound(pattern[idx].x * b + pattern[idx].y * a) * step \
-     + cvRound(pattern[idx].x * a - pattern[idx].y * b)]
-
-  for (int i = 0; i < 32; ++i, pattern += 16) {
-    int t0, t1, val;
-    t0  = GET_VALUE(0);
-    t1  = GET_VALUE(1);
-    val = t0 < t1;
-    t0  = GET_VALUE(2);
-    t1  = GET_VALUE(3);
-    val |= (t0 < t1) << 1;
-    t0  = GET_VALUE(4);
-    t1  = GET_VALUE(5);
-    val |= (t0 < t1) << 2;
-    t0  = GET_VALUE(6);
-    t1  = GET_VALUE(7);
-    val |= (t0 < t1) << 3;
-    t0  = GET_VALUE(8);
-    t1  = GET_VALUE(9);
-    val |= (t0 < t1) << 4;
-    t0  = GET_VALUE(10);
-    t1  = GET_VALUE(11);
-    val |= (t0 < t1) << 5;
-    t0  = GET_VALUE(12);
-    t1  = GET_VALUE(13);
-    val |= (t0 < t1) << 6;
-    t0  = GET_VALUE(14);
-    t1  = GET_VALUE(15);
-    val |= (t0 < t1) << 7;
-
-    desc[i] = (uchar)val;
-  }
-
-#undef GET_VALUE
-}
-
 static int bit_pattern_31_[256 * 4] = {
   8,   -3,  9,   5 /*mean (0), correlation (0)*/,
   4,   2,   7,   -12 /*mean (1.12461e-05), correlation (0.0437584)*/,
@@ -397,17 +327,22 @@ static int bit_pattern_31_[256 * 4] = {
   -1,  -6,  0,   -11 /*mean (0.127148), correlation (0.547401)*/
 };
 
-ExtractorNode::ExtractorNode() : bNoMore(false) {
-}
-
 ORBextractor::ORBextractor(
-  int _nfeatures, float _scaleFactor, int _nlevels, int _iniThFAST, int _minThFAST
+  int         _nfeatures,
+  float       _scaleFactor,
+  int         _nlevels,
+  int         _iniThFAST,
+  int         _minThFAST,
+  ThreadPool* pThreadPool,
+  int         _nAngleBins
 )
   : nfeatures(_nfeatures)
   , scaleFactor(_scaleFactor)
   , nlevels(_nlevels)
   , iniThFAST(_iniThFAST)
-  , minThFAST(_minThFAST) {
+  , minThFAST(_minThFAST)
+  , nAngleBins(std::max(_nAngleBins, 0))
+  , mpThreadPool(pThreadPool) {
   mvScaleFactor.resize(nlevels);
   mvLevelSigma2.resize(nlevels);
   mvScaleFactor[0] = 1.0f;
@@ -425,6 +360,17 @@ ORBextractor::ORBextractor(
   }
 
   mvImagePyramid.resize(nlevels);
+  mvPyramidBuffers.resize(nlevels);
+  mvBlurredPyramid.resize(nlevels);
+  mvLevelDescriptors.resize(nlevels);
+  mvNodeArenas.resize(nlevels);
+  mvFASTScores.resize(nlevels);
+  mvToDistributeKeys.resize(nlevels);
+  mvAllKeypoints.resize(nlevels);
+  for (int level = 0; level < nlevels; level++) {
+    mvToDistributeKeys[level].reserve(nfeatures * 10);
+    mvAllKeypoints[level].reserve(nfeatures);
+  }
 
   mnFeaturesPerLevel.resize(nlevels);
   float factor = 1.0f / scaleFactor;
@@ -442,6 +388,9 @@ ORBextractor::ORBextractor(
   const int        npoints  = 512;
   const cv::Point* pattern0 = (const cv::Point*)bit_pattern_31_;
   std::copy(pattern0, pattern0 + npoints, std::back_inserter(pattern));
+  if (nAngleBins > 0) {
+    mvRotatedPatterns = ComputeRotatedPatterns(pattern, nAngleBins);
+  }
 
   // This is for orientation
   //  pre-compute the end of a row in a circular patch
@@ -467,264 +416,220 @@ ORBextractor::ORBextractor(
 ORBextractor::~ORBextractor() {
 }
 
-static void computeOrientation(
-  const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const std::vector<int>& umax
-) {
-  for (std::vector<cv::KeyPoint>::iterator keypoint    = keypoints.begin(),
-                                           keypointEnd = keypoints.end();
-       keypoint != keypointEnd;
-       ++keypoint) {
-    keypoint->angle = IC_Angle(image, keypoint->pt, umax);
+namespace {
+
+void PushFrontNode(ExtractorNodeArena& arena, const int idx) {
+  ExtractorNode& node = arena.vNodes[idx];
+  node.prev           = -1;
+  node.next           = arena.head;
+  if (arena.head >= 0) {
+    arena.vNodes[arena.head].prev = idx;
   }
+  arena.head = idx;
+  arena.nNodes++;
 }
 
-void ExtractorNode::DivideNode(
-  ExtractorNode& n1, ExtractorNode& n2, ExtractorNode& n3, ExtractorNode& n4
-) {
-  const int halfX = std::ceil(static_cast<float>(UR.x - UL.x) / 2);
-  const int halfY = std::ceil(static_cast<float>(BR.y - UL.y) / 2);
+void EraseNode(ExtractorNodeArena& arena, const int idx) {
+  const ExtractorNode& node = arena.vNodes[idx];
+  if (node.prev >= 0) {
+    arena.vNodes[node.prev].next = node.next;
+  } else {
+    arena.head = node.next;
+  }
+  if (node.next >= 0) {
+    arena.vNodes[node.next].prev = node.prev;
+  }
+  arena.nNodes--;
+}
 
-  // Define boundaries of childs
-  n1.UL = UL;
-  n1.UR = cv::Point2i(UL.x + halfX, UL.y);
-  n1.BL = cv::Point2i(UL.x, UL.y + halfY);
-  n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
-  n1.vKeys.reserve(vKeys.size());
-
-  n2.UL = n1.UR;
-  n2.UR = UR;
-  n2.BL = n1.BR;
-  n2.BR = cv::Point2i(UR.x, UL.y + halfY);
-  n2.vKeys.reserve(vKeys.size());
-
-  n3.UL = n1.BL;
-  n3.UR = n1.BR;
-  n3.BL = BL;
-  n3.BR = cv::Point2i(n1.BR.x, BL.y);
-  n3.vKeys.reserve(vKeys.size());
-
-  n4.UL = n3.UR;
-  n4.UR = n2.BR;
-  n4.BL = n3.BR;
-  n4.BR = BR;
-  n4.vKeys.reserve(vKeys.size());
+// Split a node into its four quadrants n1 (top left), n2 (top right), n3 (bottom left) and n4
+// (bottom right), stably partitioning its key indices, and push the non-empty ones to the front of
+// the list in that order. The indices of the pushed children are appended to vSizeAndNode along
+// with their size when they hold more than one key. Returns the number of those.
+int DivideNode(ExtractorNodeArena& arena, const std::vector<cv::KeyPoint>& vKeys, const int idx) {
+  const ExtractorNode parent = arena.vNodes[idx];
+
+  const int halfX = std::ceil(static_cast<float>(parent.BR.x - parent.UL.x) / 2);
+  const int halfY = std::ceil(static_cast<float>(parent.BR.y - parent.UL.y) / 2);
+  const int midX  = parent.UL.x + halfX;
+  const int midY  = parent.UL.y + halfY;
 
   // Associate points to childs
-  for (std::size_t i = 0; i < vKeys.size(); i++) {
-    const cv::KeyPoint& kp = vKeys[i];
-    if (kp.pt.x < n1.UR.x) {
-      if (kp.pt.y < n1.BR.y) {
-        n1.vKeys.push_back(kp);
-      } else {
-        n3.vKeys.push_back(kp);
-      }
-    } else if (kp.pt.y < n1.BR.y) {
-      n2.vKeys.push_back(kp);
-    } else {
-      n4.vKeys.push_back(kp);
-    }
+  int* const indices = arena.vKeyIndices.data();
+  int* const scratch = arena.vScratch.data();
+
+  int counts[4] = {0, 0, 0, 0};
+  for (int i = parent.begin; i < parent.end; i++) {
+    const cv::KeyPoint& kp = vKeys[indices[i]];
+    const int quadrant = (kp.pt.x < midX ? 0 : 1) + (kp.pt.y < midY ? 0 : 2);
+    scratch[i]         = quadrant;
+    counts[quadrant]++;
   }
 
-  if (n1.vKeys.size() == 1) {
-    n1.bNoMore = true;
-  }
-  if (n2.vKeys.size() == 1) {
-    n2.bNoMore = true;
-  }
-  if (n3.vKeys.size() == 1) {
-    n3.bNoMore = true;
+  int starts[5] = {parent.begin};
+  for (int q = 0; q < 4; q++) {
+    starts[q + 1] = starts[q] + counts[q];
   }
-  if (n4.vKeys.size() == 1) {
-    n4.bNoMore = true;
+
+  // Scatter through the tail of the scratch buffer, then copy back in place
+  int* const sorted = scratch + arena.vKeyIndices.size();
+  int        pos[4] = {starts[0], starts[1], starts[2], starts[3]};
+  for (int i = parent.begin; i < parent.end; i++) {
+    sorted[pos[scratch[i]]++] = indices[i];
   }
-}
+  std::copy(sorted + parent.begin, sorted + parent.end, indices + parent.begin);
 
-static bool compareNodes(std::pair<int, ExtractorNode*>& e1, std::pair<int, ExtractorNode*>& e2) {
-  if (e1.first < e2.first) {
-    return true;
-  } else if (e1.first > e2.first) {
-    return false;
-  } else {
-    if (e1.second->UL.x < e2.second->UL.x) {
-      return true;
-    } else {
-      return false;
+  // Define boundaries of childs
+  const cv::Point2i ULs[4] = {
+    parent.UL,
+    cv::Point2i(midX, parent.UL.y),
+    cv::Point2i(parent.UL.x, midY),
+    cv::Point2i(midX, midY),
+  };
+  const cv::Point2i BRs[4] = {
+    cv::Point2i(midX, midY),
+    cv::Point2i(parent.BR.x, midY),
+    cv::Point2i(midX, parent.BR.y),
+    parent.BR,
+  };
+
+  int nToExpand = 0;
+  for (int q = 0; q < 4; q++) {
+    if (counts[q] == 0) {
+      continue;
+    }
+
+    ExtractorNode child;
+    child.UL      = ULs[q];
+    child.BR      = BRs[q];
+    child.begin   = starts[q];
+    child.end     = starts[q + 1];
+    child.bNoMore = counts[q] == 1;
+
+    const int childIdx = static_cast<int>(arena.vNodes.size());
+    arena.vNodes.push_back(child);
+    PushFrontNode(arena, childIdx);
+
+    if (counts[q] > 1) {
+      arena.vSizeAndNode.emplace_back(counts[q], childIdx);
+      nToExpand++;
     }
   }
+
+  return nToExpand;
 }
 
-std::vector<cv::KeyPoint> ORBextractor::DistributeOctTree(
+} // namespace
+
+void ORBextractor::DistributeOctTree(
   const std::vector<cv::KeyPoint>& vToDistributeKeys,
   const int&                       minX,
   const int&                       maxX,
   const int&                       minY,
   const int&                       maxY,
   const int&                       N,
-  const int&                       level
+  const int&                       level,
+  std::vector<cv::KeyPoint>&       vResultKeys
 ) {
+  ExtractorNodeArena& arena = mvNodeArenas[level];
+  arena.vNodes.clear();
+  arena.head   = -1;
+  arena.nNodes = 0;
+
+  const int nKeys = static_cast<int>(vToDistributeKeys.size());
+  arena.vKeyIndices.resize(nKeys);
+  arena.vScratch.resize(2 * nKeys);
+
   // Compute how many initial nodes
   const int nIni = std::round(static_cast<float>(maxX - minX) / (maxY - minY));
 
   const float hX = static_cast<float>(maxX - minX) / nIni;
 
-  std::list<ExtractorNode> lNodes;
-
-  std::vector<ExtractorNode*> vpIniNodes;
-  vpIniNodes.resize(nIni);
-
+  arena.vNodes.resize(nIni);
   for (int i = 0; i < nIni; i++) {
-    ExtractorNode ni;
-    ni.UL = cv::Point2i(hX * static_cast<float>(i), 0);
-    ni.UR = cv::Point2i(hX * static_cast<float>(i + 1), 0);
-    ni.BL = cv::Point2i(ni.UL.x, maxY - minY);
-    ni.BR = cv::Point2i(ni.UR.x, maxY - minY);
-    ni.vKeys.reserve(vToDistributeKeys.size());
-
-    lNodes.push_back(ni);
-    vpIniNodes[i] = &lNodes.back();
+    ExtractorNode& ni = arena.vNodes[i];
+    ni.UL             = cv::Point2i(hX * static_cast<float>(i), 0);
+    ni.BR             = cv::Point2i(hX * static_cast<float>(i + 1), maxY - minY);
+    ni.begin          = 0;
   }
 
-  // Associate points to childs
-  for (std::size_t i = 0; i < vToDistributeKeys.size(); i++) {
-    const cv::KeyPoint& kp = vToDistributeKeys[i];
-    vpIniNodes[kp.pt.x / hX]->vKeys.push_back(kp);
+  // Associate points to childs, as contiguous index ranges that keep the key order
+  std::vector<int>& vIniNode = arena.vScratch;
+  for (int i = 0; i < nKeys; i++) {
+    vIniNode[i] = static_cast<int>(vToDistributeKeys[i].pt.x / hX);
+    arena.vNodes[vIniNode[i]].begin++;
+  }
+  for (int i = 0, offset = 0; i < nIni; i++) {
+    ExtractorNode& ni = arena.vNodes[i];
+    offset            += ni.begin;
+    ni.begin          = offset - ni.begin;
+    ni.end            = ni.begin;
+  }
+  for (int i = 0; i < nKeys; i++) {
+    arena.vKeyIndices[arena.vNodes[vIniNode[i]].end++] = i;
   }
 
-  std::list<ExtractorNode>::iterator lit = lNodes.begin();
-
-  while (lit != lNodes.end()) {
-    if (lit->vKeys.size() == 1) {
-      lit->bNoMore = true;
-      lit++;
-    } else if (lit->vKeys.empty()) {
-      lit = lNodes.erase(lit);
-    } else {
-      lit++;
+  // Link the non-empty initial nodes in order
+  for (int i = nIni - 1; i >= 0; i--) {
+    ExtractorNode& ni = arena.vNodes[i];
+    if (ni.end > ni.begin) {
+      ni.bNoMore = ni.end - ni.begin == 1;
+      PushFrontNode(arena, i);
     }
   }
 
   bool bFinish = false;
 
-  int iteration = 0;
+  std::vector<std::pair<int, int>>& vSizeAndNode     = arena.vSizeAndNode;
+  std::vector<std::pair<int, int>>& vPrevSizeAndNode = arena.vPrevSizeAndNode;
 
-  std::vector<std::pair<int, ExtractorNode*>> vSizeAndPointerToNode;
-  vSizeAndPointerToNode.reserve(lNodes.size() * 4);
+  // Larger nodes last, ties broken by the left border
+  const auto compareNodes = [&](const std::pair<int, int>& e1, const std::pair<int, int>& e2) {
+    if (e1.first != e2.first) {
+      return e1.first < e2.first;
+    }
+    return arena.vNodes[e1.second].UL.x < arena.vNodes[e2.second].UL.x;
+  };
 
   while (!bFinish) {
-    iteration++;
-
-    int prevSize = lNodes.size();
-
-    lit = lNodes.begin();
+    int prevSize = arena.nNodes;
 
     int nToExpand = 0;
 
-    vSizeAndPointerToNode.clear();
-
-    while (lit != lNodes.end()) {
-      if (lit->bNoMore) {
-        // If node only contains one point do not subdivide and continue
-        lit++;
-        continue;
-      } else {
-        // If more than one point, subdivide
-        ExtractorNode n1, n2, n3, n4;
-        lit->DivideNode(n1, n2, n3, n4);
-
-        // Add childs if they contain points
-        if (n1.vKeys.size() > 0) {
-          lNodes.push_front(n1);
-          if (n1.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(std::make_pair(n1.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n2.vKeys.size() > 0) {
-          lNodes.push_front(n2);
-          if (n2.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(std::make_pair(n2.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n3.vKeys.size() > 0) {
-          lNodes.push_front(n3);
-          if (n3.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(std::make_pair(n3.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n4.vKeys.size() > 0) {
-          lNodes.push_front(n4);
-          if (n4.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(std::make_pair(n4.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
+    vSizeAndNode.clear();
 
-        lit = lNodes.erase(lit);
-        continue;
+    for (int idx = arena.head; idx >= 0;) {
+      const int next = arena.vNodes[idx].next;
+      // If node only contains one point do not subdivide and continue
+      if (!arena.vNodes[idx].bNoMore) {
+        nToExpand += DivideNode(arena, vToDistributeKeys, idx);
+        EraseNode(arena, idx);
       }
+      idx = next;
     }
 
     // Finish if there are more nodes than required features
     // or all nodes contain just one point
-    if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
+    if (arena.nNodes >= N || arena.nNodes == prevSize) {
       bFinish = true;
-    } else if (((int)lNodes.size() + nToExpand * 3) > N) {
+    } else if ((arena.nNodes + nToExpand * 3) > N) {
       while (!bFinish) {
-        prevSize = lNodes.size();
-
-        std::vector<std::pair<int, ExtractorNode*>> vPrevSizeAndPointerToNode
-          = vSizeAndPointerToNode;
-        vSizeAndPointerToNode.clear();
-
-        std::sort(vPrevSizeAndPointerToNode.begin(), vPrevSizeAndPointerToNode.end(), compareNodes);
-        for (int j = vPrevSizeAndPointerToNode.size() - 1; j >= 0; j--) {
-          ExtractorNode n1, n2, n3, n4;
-          vPrevSizeAndPointerToNode[j].second->DivideNode(n1, n2, n3, n4);
-
-          // Add childs if they contain points
-          if (n1.vKeys.size() > 0) {
-            lNodes.push_front(n1);
-            if (n1.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(std::make_pair(n1.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n2.vKeys.size() > 0) {
-            lNodes.push_front(n2);
-            if (n2.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(std::make_pair(n2.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n3.vKeys.size() > 0) {
-            lNodes.push_front(n3);
-            if (n3.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(std::make_pair(n3.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n4.vKeys.size() > 0) {
-            lNodes.push_front(n4);
-            if (n4.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(std::make_pair(n4.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
+        prevSize = arena.nNodes;
+
+        std::swap(vPrevSizeAndNode, vSizeAndNode);
+        vSizeAndNode.clear();
 
-          lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
+        std::sort(vPrevSizeAndNode.begin(), vPrevSizeAndNode.end(), compareNodes);
+        for (int j = vPrevSizeAndNode.size() - 1; j >= 0; j--) {
+          DivideNode(arena, vToDistributeKeys, vPrevSizeAndNode[j].second);
+          EraseNode(arena, vPrevSizeAndNode[j].second);
 
-          if ((int)lNodes.size() >= N) {
+          if (arena.nNodes >= N) {
             break;
           }
         }
 
-        if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
+        if (arena.nNodes >= N || arena.nNodes == prevSize) {
           bFinish = true;
         }
       }
@@ -732,152 +637,141 @@ std::vector<cv::KeyPoint> ORBextractor::DistributeOctTree(
   }
 
   // Retain the best point in each node
-  std::vector<cv::KeyPoint> vResultKeys;
-  vResultKeys.reserve(nfeatures);
-  for (std::list<ExtractorNode>::iterator lit = lNodes.begin(); lit != lNodes.end(); lit++) {
-    std::vector<cv::KeyPoint>& vNodeKeys   = lit->vKeys;
-    cv::KeyPoint*              pKP         = &vNodeKeys[0];
-    float                      maxResponse = pKP->response;
-
-    for (std::size_t k = 1; k < vNodeKeys.size(); k++) {
-      if (vNodeKeys[k].response > maxResponse) {
-        pKP         = &vNodeKeys[k];
-        maxResponse = vNodeKeys[k].response;
+  vResultKeys.clear();
+  for (int idx = arena.head; idx >= 0; idx = arena.vNodes[idx].next) {
+    const ExtractorNode& node = arena.vNodes[idx];
+
+    int   best        = arena.vKeyIndices[node.begin];
+    float maxResponse = vToDistributeKeys[best].response;
+    for (int k = node.begin + 1; k < node.end; k++) {
+      const int i = arena.vKeyIndices[k];
+      if (vToDistributeKeys[i].response > maxResponse) {
+        best        = i;
+        maxResponse = vToDistributeKeys[i].response;
       }
     }
 
-    vResultKeys.push_back(*pKP);
+    vResultKeys.push_back(vToDistributeKeys[best]);
   }
-
-  return vResultKeys;
 }
 
 void ORBextractor::ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint>>& allKeypoints) {
   allKeypoints.resize(nlevels);
 
-  const float W = 35;
-
+  // Score every level at the lowest threshold. Levels are cut into row bands proportional to their
+  // area so that the large bottom levels are shared among the workers.
+  const int                       nThreads = mpThreadPool ? mpThreadPool->NumThreads() : 1;
+  std::vector<std::array<int, 3>> vBands;
+  vBands.reserve(nlevels * nThreads);
   for (int level = 0; level < nlevels; ++level) {
-    const int minBorderX = EDGE_THRESHOLD - 3;
-    const int minBorderY = minBorderX;
-    const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
-    const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
+    mvFASTScores[level].create(mvImagePyramid[level].size(), CV_8UC1);
 
-    std::vector<cv::KeyPoint> vToDistributeKeys;
-    vToDistributeKeys.reserve(nfeatures * 10);
+    const int rows   = mvImagePyramid[level].rows;
+    const int nBands = std::min(std::max(1, cvRound(nThreads * mvInvLevelSigma2[level])), rows);
+    for (int band = 0; band < nBands; band++) {
+      vBands.push_back({level, band * rows / nBands, (band + 1) * rows / nBands});
+    }
+  }
 
-    const float width  = (maxBorderX - minBorderX);
-    const float height = (maxBorderY - minBorderY);
+  ParallelFor(mpThreadPool, 0, static_cast<int>(vBands.size()), [&](const int i) {
+    const int level = vBands[i][0];
+    ComputeFASTScores(
+      mvImagePyramid[level],
+      mvFASTScores[level],
+      std::min(iniThFAST, minThFAST),
+      vBands[i][1],
+      vBands[i][2]
+    );
+  });
 
-    const int nCols = width / W;
-    const int nRows = height / W;
-    const int wCell = std::ceil(width / nCols);
-    const int hCell = std::ceil(height / nRows);
+  // Select, distribute and orient the keypoints of every level independently
+  ParallelFor(mpThreadPool, 0, nlevels, [&](const int level) {
+    ComputeKeyPointsOctTreeLevel(level, allKeypoints[level]);
+  });
+}
 
-    for (int i = 0; i < nRows; i++) {
-      const float iniY = minBorderY + i * hCell;
-      float       maxY = iniY + hCell + 6;
+void ORBextractor::ComputeKeyPointsOctTreeLevel(
+  const int level, std::vector<cv::KeyPoint>& keypoints
+) {
+  const float W = 35;
 
-      if (iniY >= maxBorderY - 3) {
-        continue;
-      }
-      if (maxY > maxBorderY) {
-        maxY = maxBorderY;
-      }
+  const int minBorderX = EDGE_THRESHOLD - 3;
+  const int minBorderY = minBorderX;
+  const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
+  const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
 
-      for (int j = 0; j < nCols; j++) {
-        const float iniX = minBorderX + j * wCell;
-        float       maxX = iniX + wCell + 6;
-        if (iniX >= maxBorderX - 6) {
-          continue;
-        }
-        if (maxX > maxBorderX) {
-          maxX = maxBorderX;
-        }
+  const cv::Mat& scores = mvFASTScores[level];
 
-        std::vector<cv::KeyPoint> vKeysCell;
+  std::vector<cv::KeyPoint>& vToDistributeKeys = mvToDistributeKeys[level];
+  vToDistributeKeys.clear();
 
-        cv::FAST(
-          mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-          vKeysCell,
-          iniThFAST,
-          true
-        );
+  const float width  = (maxBorderX - minBorderX);
+  const float height = (maxBorderY - minBorderY);
 
-        /*if(bRight && j <= 13){
-            cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                 vKeysCell,10,true);
-        }
-        else if(!bRight && j >= 16){
-            cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                 vKeysCell,10,true);
-        }
-        else{
-            cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                 vKeysCell,iniThFAST,true);
-        }*/
-
-        if (vKeysCell.empty()) {
-          cv::FAST(
-            mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-            vKeysCell,
-            minThFAST,
-            true
-          );
-          /*if(bRight && j <= 13){
-              cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                   vKeysCell,5,true);
-          }
-          else if(!bRight && j >= 16){
-              cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                   vKeysCell,5,true);
-          }
-          else{
-              cv::FAST(mvImagePyramid[level].rowRange(iniY,maxY).colRange(iniX,maxX),
-                   vKeysCell,minThFAST,true);
-          }*/
-        }
+  const int nCols = width / W;
+  const int nRows = height / W;
+  const int wCell = std::ceil(width / nCols);
+  const int hCell = std::ceil(height / nRows);
 
-        if (!vKeysCell.empty()) {
-          for (std::vector<cv::KeyPoint>::iterator vit = vKeysCell.begin(); vit != vKeysCell.end();
-               vit++) {
-            (*vit).pt.x += j * wCell;
-            (*vit).pt.y += i * hCell;
-            vToDistributeKeys.push_back(*vit);
-          }
-        }
-      }
+  for (int i = 0; i < nRows; i++) {
+    const float iniY = minBorderY + i * hCell;
+    float       maxY = iniY + hCell + 6;
+
+    if (iniY >= maxBorderY - 3) {
+      continue;
+    }
+    if (maxY > maxBorderY) {
+      maxY = maxBorderY;
     }
 
-    std::vector<cv::KeyPoint>& keypoints = allKeypoints[level];
-    keypoints.reserve(nfeatures);
-
-    keypoints = DistributeOctTree(
-      vToDistributeKeys,
-      minBorderX,
-      maxBorderX,
-      minBorderY,
-      maxBorderY,
-      mnFeaturesPerLevel[level],
-      level
-    );
+    for (int j = 0; j < nCols; j++) {
+      const float iniX = minBorderX + j * wCell;
+      float       maxX = iniX + wCell + 6;
+      if (iniX >= maxBorderX - 6) {
+        continue;
+      }
+      if (maxX > maxBorderX) {
+        maxX = maxBorderX;
+      }
 
-    const int scaledPatchSize = PATCH_SIZE * mvScaleFactor[level];
+      const cv::Rect cell(
+        static_cast<int>(iniX),
+        static_cast<int>(iniY),
+        static_cast<int>(maxX) - static_cast<int>(iniX),
+        static_cast<int>(maxY) - static_cast<int>(iniY)
+      );
+      const cv::Point2f offset(j * wCell, i * hCell);
 
-    // Add border to coordinates and scale information
-    const int nkps = keypoints.size();
-    for (int i = 0; i < nkps; i++) {
-      keypoints[i].pt.x   += minBorderX;
-      keypoints[i].pt.y   += minBorderY;
-      keypoints[i].octave = level;
-      keypoints[i].size   = scaledPatchSize;
+      if (DetectFASTInCell(scores, cell, iniThFAST, offset, vToDistributeKeys) == 0) {
+        DetectFASTInCell(scores, cell, minThFAST, offset, vToDistributeKeys);
+      }
     }
   }
 
-  // compute orientations
-  for (int level = 0; level < nlevels; ++level) {
-    computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+  DistributeOctTree(
+    vToDistributeKeys,
+    minBorderX,
+    maxBorderX,
+    minBorderY,
+    maxBorderY,
+    mnFeaturesPerLevel[level],
+    level,
+    keypoints
+  );
+
+  const int scaledPatchSize = PATCH_SIZE * mvScaleFactor[level];
+
+  // Add border to coordinates and scale information
+  const int nkps = keypoints.size();
+  for (int i = 0; i < nkps; i++) {
+    keypoints[i].pt.x   += minBorderX;
+    keypoints[i].pt.y   += minBorderY;
+    keypoints[i].octave = level;
+    keypoints[i].size   = scaledPatchSize;
   }
+
+  // compute orientations
+  ComputeOrientations(mvImagePyramid[level], keypoints, umax);
 }
 
 void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint>>& allKeypoints) {
@@ -1001,6 +895,7 @@ void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint>>& a
     }
 
     std::vector<cv::KeyPoint>& keypoints = allKeypoints[level];
+    keypoints.clear();
     keypoints.reserve(nDesiredFeatures * 2);
 
     const int scaledPatchSize = PATCH_SIZE * mvScaleFactor[level];
@@ -1032,20 +927,7 @@ void ORBextractor::ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint>>& a
 
   // and compute orientations
   for (int level = 0; level < nlevels; ++level) {
-    computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
-  }
-}
-
-static void computeDescriptors(
-  const cv::Mat&                image,
-  std::vector<cv::KeyPoint>&    keypoints,
-  cv::Mat&                      descriptors,
-  const std::vector<cv::Point>& pattern
-) {
-  descriptors = cv::Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
-
-  for (std::size_t i = 0; i < keypoints.size(); i++) {
-    computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i));
+    ComputeOrientations(mvImagePyramid[level], allKeypoints[level], umax);
   }
 }
 
@@ -1067,10 +949,43 @@ int ORBextractor::operator()(
   // Pre-compute the scale pyramid
   ComputePyramid(image);
 
-  std::vector<std::vector<cv::KeyPoint>> allKeypoints;
+  std::vector<std::vector<cv::KeyPoint>>& allKeypoints = mvAllKeypoints;
   ComputeKeyPointsOctTree(allKeypoints);
   // ComputeKeyPointsOld(allKeypoints);
 
+  // Blur and describe every level independently, the merge below keeps the serial layout. The
+  // level is blurred isolated from its border, as if it had been cloned, into a persistent image,
+  // and descriptors are written into persistent buffers that only grow.
+  ParallelFor(mpThreadPool, 0, nlevels, [&](const int level) {
+    std::vector<cv::KeyPoint>& keypoints = allKeypoints[level];
+    if (keypoints.empty()) {
+      return;
+    }
+
+    cv::Mat& workingMat = mvBlurredPyramid[level];
+    cv::GaussianBlur(
+      mvImagePyramid[level],
+      workingMat,
+      cv::Size(7, 7),
+      2,
+      2,
+      cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED
+    );
+
+    const int nkeypointsLevel = static_cast<int>(keypoints.size());
+    if (mvLevelDescriptors[level].rows < nkeypointsLevel) {
+      mvLevelDescriptors[level].create(nkeypointsLevel, 32, CV_8U);
+    }
+    cv::Mat desc = mvLevelDescriptors[level].rowRange(0, nkeypointsLevel);
+
+    // Compute the descriptors
+    if (nAngleBins > 0) {
+      ComputeDescriptorsBinned(workingMat, keypoints, mvRotatedPatterns, nAngleBins, desc);
+    } else {
+      ComputeDescriptors(workingMat, keypoints, pattern, desc);
+    }
+  });
+
   cv::Mat descriptors;
 
   int nkeypoints = 0;
@@ -1084,9 +999,8 @@ int ORBextractor::operator()(
     descriptors = _descriptors.getMat();
   }
 
-  //_keypoints.clear();
-  //_keypoints.reserve(nkeypoints);
-  _keypoints = std::vector<cv::KeyPoint>(nkeypoints);
+  // Every entry is written below, a reused output vector keeps its storage
+  _keypoints.resize(nkeypoints);
 
   int offset = 0;
   // Modified for speeding up stereo fisheye matching
@@ -1099,14 +1013,7 @@ int ORBextractor::operator()(
       continue;
     }
 
-    // preprocess the resized image
-    cv::Mat workingMat = mvImagePyramid[level].clone();
-    cv::GaussianBlur(workingMat, workingMat, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
-
-    // Compute the descriptors
-    // cv::Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
-    cv::Mat desc = cv::Mat(nkeypointsLevel, 32, CV_8U);
-    computeDescriptors(workingMat, keypoints, desc, pattern);
+    const cv::Mat desc = mvLevelDescriptors[level].rowRange(0, nkeypointsLevel);
 
     offset += nkeypointsLevel;
 
@@ -1138,17 +1045,34 @@ int ORBextractor::operator()(
 }
 
 void ORBextractor::ComputePyramid(cv::Mat image) {
+  const cv::Size imageSize = mpConditioner ? mpConditioner->OutputSize() : image.size();
   for (int level = 0; level < nlevels; ++level) {
     float    scale = mvInvScaleFactor[level];
-    cv::Size sz(cvRound((float)image.cols * scale), cvRound((float)image.rows * scale));
+    cv::Size sz(cvRound((float)imageSize.width * scale), cvRound((float)imageSize.height * scale));
     cv::Size wholeSize(sz.width + EDGE_THRESHOLD * 2, sz.height + EDGE_THRESHOLD * 2);
-    cv::Mat  temp(wholeSize, image.type()), masktemp;
+
+    // Buffers are only reallocated when the input size changes
+    cv::Mat& temp = mvPyramidBuffers[level];
+    temp.create(wholeSize, image.type());
     mvImagePyramid[level] = temp(cv::Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
 
     // Compute the resized image
     if (level != 0) {
       cv::resize(mvImagePyramid[level - 1], mvImagePyramid[level], sz, 0, 0, cv::INTER_LINEAR);
 
+      cv::copyMakeBorder(
+        mvImagePyramid[level],
+        temp,
+        EDGE_THRESHOLD,
+        EDGE_THRESHOLD,
+        EDGE_THRESHOLD,
+        EDGE_THRESHOLD,
+        cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED
+      );
+    } else if (mpConditioner) {
+      // Conditioned in place, as the levels above
+      mpConditioner->Apply(image, mvImagePyramid[level]);
+
       cv::copyMakeBorder(
         mvImagePyramid[level],
         temp,
@@ -18,12 +18,16 @@
  */
 
 #include "ORBmatcher.h"
+#include <algorithm>
+#include <unordered_map>
 #include <utility>
 #include <Thirdparty/DBoW2/DBoW2/FeatureVector.h>
 #include "Frame.h"
 #include "GeometricCamera.h"
+#include "HammingDistance.h"
 #include "KeyFrame.h"
 #include "MapPoint.h"
+#include "ThreadPool.h"
 
 namespace ORB_SLAM3 {
 
@@ -35,193 +39,329 @@ ORBmatcher::ORBmatcher(float nnratio, bool checkOri)
   : mfNNratio(nnratio), mbCheckOrientation(checkOri) {
 }
 
-int ORBmatcher::SearchByProjection(
-  Frame&                        F,
-  const std::vector<MapPoint*>& vpMapPoints,
-  const float                   th,
-  const bool                    bFarPoints,
-  const float                   thFarPoints
+namespace {
+
+// Best and second best keypoints of a map point within its search window in one camera
+struct ProjectionMatch {
+  int bestDist   = 256;
+  int bestLevel  = -1;
+  int bestDist2  = 256;
+  int bestLevel2 = -1;
+  int bestIdx    = -1;
+};
+
+// Scratch buffers of the batched descriptor distances
+struct DistanceBatch {
+  std::vector<std::size_t>          vCandidates;
+  std::vector<const unsigned char*> vpCandidateDescs;
+  std::vector<int>                  vDistances;
+
+  void Clear() {
+    vCandidates.clear();
+    vpCandidateDescs.clear();
+  }
+
+  void Compute(const Descriptor& query) {
+    vDistances.resize(vCandidates.size());
+    HammingDistances(
+      query.data(),
+      vpCandidateDescs.data(),
+      static_cast<int>(vCandidates.size()),
+      vDistances.data()
+    );
+  }
+};
+
+// Local map point projected in the current frame, as seen before any match of the search is made
+struct ProjectionProposal {
+  bool                     bSkip = true;
+  Descriptor               descriptor;
+  float                    rLeft = 0.f;
+  std::vector<std::size_t> vIndicesLeft, vIndicesRight;
+  ProjectionMatch          left, right;
+};
+
+ProjectionMatch MatchInLeftWindow(
+  const Frame&                    F,
+  const MapPoint*                 pMP,
+  const std::vector<std::size_t>& vIndices,
+  const float                     r,
+  const Descriptor&               descriptor,
+  DistanceBatch&                  batch
 ) {
-  int nmatches = 0, left = 0, right = 0;
+  const int nPredictedLevel = pMP->mnTrackScaleLevel;
 
-  const bool bFactor = th != 1.0;
+  batch.Clear();
+  for (const std::size_t idx : vIndices) {
+    if (F.mvpMapPoints[idx]) {
+      if (F.mvpMapPoints[idx]->Observations() > 0) {
+        continue;
+      }
+    }
 
-  for (std::size_t iMP = 0; iMP < vpMapPoints.size(); iMP++) {
-    MapPoint* pMP = vpMapPoints[iMP];
-    if (!pMP->mbTrackInView && !pMP->mbTrackInViewR) {
-      continue;
+    if (F.Nleft == -1 && F.mvuRight[idx] > 0) {
+      const float er = std::fabs(pMP->mTrackProjXR - F.mvuRight[idx]);
+      if (er > r * F.mvScaleFactors[nPredictedLevel]) {
+        continue;
+      }
     }
 
-    if (bFarPoints && pMP->mTrackDepth > thFarPoints) {
-      continue;
+    batch.vCandidates.push_back(idx);
+    batch.vpCandidateDescs.push_back(F.mDescriptors[idx].data());
+  }
+  batch.Compute(descriptor);
+
+  // Get best and second matches with near keypoints
+  ProjectionMatch match;
+  for (std::size_t k = 0; k < batch.vCandidates.size(); k++) {
+    const std::size_t idx   = batch.vCandidates[k];
+    const int         dist  = batch.vDistances[k];
+    const int         level = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
+                            : (idx < F.Nleft) ? F.mvKeys[idx].octave
+                                              : F.mvKeysRight[idx - F.Nleft].octave;
+
+    if (dist < match.bestDist) {
+      match.bestDist2  = match.bestDist;
+      match.bestDist   = dist;
+      match.bestLevel2 = match.bestLevel;
+      match.bestLevel  = level;
+      match.bestIdx    = idx;
+    } else if (dist < match.bestDist2) {
+      match.bestLevel2 = level;
+      match.bestDist2  = dist;
     }
+  }
+  return match;
+}
 
-    if (pMP->isBad()) {
-      continue;
+ProjectionMatch MatchInRightWindow(
+  const Frame&                    F,
+  const std::vector<std::size_t>& vIndices,
+  const Descriptor&               descriptor,
+  DistanceBatch&                  batch
+) {
+  batch.Clear();
+  for (const std::size_t idx : vIndices) {
+    if (F.mvpMapPoints[idx + F.Nleft]) {
+      if (F.mvpMapPoints[idx + F.Nleft]->Observations() > 0) {
+        continue;
+      }
     }
 
-    if (pMP->mbTrackInView) {
-      const int& nPredictedLevel = pMP->mnTrackScaleLevel;
+    batch.vCandidates.push_back(idx);
+    batch.vpCandidateDescs.push_back(F.mDescriptors[idx + F.Nleft].data());
+  }
+  batch.Compute(descriptor);
+
+  // Get best and second matches with near keypoints
+  ProjectionMatch match;
+  for (std::size_t k = 0; k < batch.vCandidates.size(); k++) {
+    const std::size_t idx  = batch.vCandidates[k];
+    const int         dist = batch.vDistances[k];
+
+    if (dist < match.bestDist) {
+      match.bestDist2  = match.bestDist;
+      match.bestDist   = dist;
+      match.bestLevel2 = match.bestLevel;
+      match.bestLevel  = F.mvKeysRight[idx].octave;
+      match.bestIdx    = idx;
+    } else if (dist < match.bestDist2) {
+      match.bestLevel2 = F.mvKeysRight[idx].octave;
+      match.bestDist2  = dist;
+    }
+  }
+  return match;
+}
 
-      // The size of the window will depend on the viewing direction
-      float r = RadiusByViewingCos(pMP->mTrackViewCos);
+// Call fn(begin, end) on consecutive blocks of [0, n), in parallel when a pool is given
+template <class Function>
+void ForEachBlock(const int n, ThreadPool* pThreadPool, Function&& fn) {
+  const int  nBlockSize = 64;
+  const int  nBlocks    = (n + nBlockSize - 1) / nBlockSize;
+  const auto RunBlock   = [&](const int iBlock) {
+    fn(iBlock * nBlockSize, std::min(n, (iBlock + 1) * nBlockSize));
+  };
+
+  if (pThreadPool) {
+    pThreadPool->ParallelFor(0, nBlocks, RunBlock);
+  } else {
+    for (int iBlock = 0; iBlock < nBlocks; iBlock++) {
+      RunBlock(iBlock);
+    }
+  }
+}
 
-      if (bFactor) {
-        r *= th;
-      }
+// Whether one of the keypoints of the window, offset by the given index, was assigned
+bool AnyAssigned(
+  const std::vector<bool>& vbAssigned, const std::vector<std::size_t>& vIndices, const int offset
+) {
+  for (const std::size_t idx : vIndices) {
+    if (vbAssigned[idx + offset]) {
+      return true;
+    }
+  }
+  return false;
+}
 
-      const std::vector<std::size_t> vIndices = F.GetFeaturesInArea(
-        pMP->mTrackProjX,
-        pMP->mTrackProjY,
-        r * F.mvScaleFactors[nPredictedLevel],
-        nPredictedLevel - 1,
-        nPredictedLevel
-      );
-
-      if (!vIndices.empty()) {
-        const cv::Mat MPdescriptor = pMP->GetDescriptor();
-
-        int bestDist   = 256;
-        int bestLevel  = -1;
-        int bestDist2  = 256;
-        int bestLevel2 = -1;
-        int bestIdx    = -1;
-
-        // Get best and second matches with near keypoints
-        for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end();
-             vit != vend;
-             vit++) {
-          const std::size_t idx = *vit;
+} // namespace
 
-          if (F.mvpMapPoints[idx]) {
-            if (F.mvpMapPoints[idx]->Observations() > 0) {
-              continue;
-            }
-          }
+int ORBmatcher::SearchByProjection(
+  Frame&                        F,
+  const std::vector<MapPoint*>& vpMapPoints,
+  const float                   th,
+  const bool                    bFarPoints,
+  const float                   thFarPoints,
+  ThreadPool*                   pThreadPool
+) {
+  int nmatches = 0, left = 0, right = 0;
 
-          if (F.Nleft == -1 && F.mvuRight[idx] > 0) {
-            const float er = std::fabs(pMP->mTrackProjXR - F.mvuRight[idx]);
-            if (er > r * F.mvScaleFactors[nPredictedLevel]) {
-              continue;
-            }
-          }
+  const bool bFactor = th != 1.0;
 
-          const cv::Mat& d = F.mDescriptors.row(idx);
+  // Search windows and best matches of every point are computed independently, possibly in
+  // parallel, against the frame associations before the search.
+  const int                       nMPs = static_cast<int>(vpMapPoints.size());
+  std::vector<ProjectionProposal> vProposals(nMPs);
+
+  ForEachBlock(nMPs, pThreadPool, [&](const int begin, const int end) {
+    DistanceBatch batch;
+    for (int iMP = begin; iMP < end; iMP++) {
+      MapPoint*           pMP      = vpMapPoints[iMP];
+      ProjectionProposal& proposal = vProposals[iMP];
+      if (!pMP->mbTrackInView && !pMP->mbTrackInViewR) {
+        continue;
+      }
 
-          const int dist = DescriptorDistance(MPdescriptor, d);
+      if (bFarPoints && pMP->mTrackDepth > thFarPoints) {
+        continue;
+      }
 
-          if (dist < bestDist) {
-            bestDist2  = bestDist;
-            bestDist   = dist;
-            bestLevel2 = bestLevel;
-            bestLevel  = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                       : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                         : F.mvKeysRight[idx - F.Nleft].octave;
-            bestIdx    = idx;
-          } else if (dist < bestDist2) {
-            bestLevel2 = (F.Nleft == -1) ? F.mvKeysUn[idx].octave
-                       : (idx < F.Nleft) ? F.mvKeys[idx].octave
-                                         : F.mvKeysRight[idx - F.Nleft].octave;
-            bestDist2  = dist;
-          }
-        }
+      if (pMP->isBad()) {
+        continue;
+      }
 
-        // Apply ratio to second match (only if best and second are in the same scale level)
-        if (bestDist <= TH_HIGH) {
-          if (bestLevel == bestLevel2 && bestDist > mfNNratio * bestDist2) {
-            continue;
-          }
+      proposal.bSkip      = false;
+      proposal.descriptor = pMP->GetDescriptor();
 
-          if (bestLevel != bestLevel2 || bestDist <= mfNNratio * bestDist2) {
-            F.mvpMapPoints[bestIdx] = pMP;
+      if (pMP->mbTrackInView) {
+        const int& nPredictedLevel = pMP->mnTrackScaleLevel;
 
-            // Also match with the stereo observation at right camera
-            if (F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1) {
-              F.mvpMapPoints[F.mvLeftToRightMatch[bestIdx] + F.Nleft] = pMP;
-              nmatches++;
-              right++;
-            }
+        // The size of the window will depend on the viewing direction
+        float r = RadiusByViewingCos(pMP->mTrackViewCos);
 
-            nmatches++;
-            left++;
-          }
+        if (bFactor) {
+          r *= th;
         }
-      }
-    }
-
-    if (F.Nleft != -1 && pMP->mbTrackInViewR) {
-      const int& nPredictedLevel = pMP->mnTrackScaleLevelR;
-      if (nPredictedLevel != -1) {
-        float r = RadiusByViewingCos(pMP->mTrackViewCosR);
 
-        const std::vector<std::size_t> vIndices = F.GetFeaturesInArea(
-          pMP->mTrackProjXR,
-          pMP->mTrackProjYR,
+        proposal.rLeft        = r;
+        proposal.vIndicesLeft = F.GetFeaturesInArea(
+          pMP->mTrackProjX,
+          pMP->mTrackProjY,
           r * F.mvScaleFactors[nPredictedLevel],
           nPredictedLevel - 1,
-          nPredictedLevel,
-          true
+          nPredictedLevel
         );
 
-        if (vIndices.empty()) {
-          continue;
+        if (!proposal.vIndicesLeft.empty()) {
+          proposal.left
+            = MatchInLeftWindow(F, pMP, proposal.vIndicesLeft, r, proposal.descriptor, batch);
         }
+      }
 
-        const cv::Mat MPdescriptor = pMP->GetDescriptor();
-
-        int bestDist   = 256;
-        int bestLevel  = -1;
-        int bestDist2  = 256;
-        int bestLevel2 = -1;
-        int bestIdx    = -1;
-
-        // Get best and second matches with near keypoints
-        for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end();
-             vit != vend;
-             vit++) {
-          const std::size_t idx = *vit;
-
-          if (F.mvpMapPoints[idx + F.Nleft]) {
-            if (F.mvpMapPoints[idx + F.Nleft]->Observations() > 0) {
-              continue;
-            }
+      if (F.Nleft != -1 && pMP->mbTrackInViewR) {
+        const int& nPredictedLevel = pMP->mnTrackScaleLevelR;
+        if (nPredictedLevel != -1) {
+          float r = RadiusByViewingCos(pMP->mTrackViewCosR);
+
+          proposal.vIndicesRight = F.GetFeaturesInArea(
+            pMP->mTrackProjXR,
+            pMP->mTrackProjYR,
+            r * F.mvScaleFactors[nPredictedLevel],
+            nPredictedLevel - 1,
+            nPredictedLevel,
+            true
+          );
+
+          if (!proposal.vIndicesRight.empty()) {
+            proposal.right
+              = MatchInRightWindow(F, proposal.vIndicesRight, proposal.descriptor, batch);
           }
+        }
+      }
+    }
+  });
 
-          const cv::Mat& d = F.mDescriptors.row(idx + F.Nleft);
+  // Associations are then made in the order of the points. When a keypoint of the window of a point
+  // has been assigned to a previous point, its match is searched again as the serial search would.
+  std::vector<bool> vbAssigned(F.N, false);
+  DistanceBatch     batch;
 
-          const int dist = DescriptorDistance(MPdescriptor, d);
+  for (int iMP = 0; iMP < nMPs; iMP++) {
+    const ProjectionProposal& proposal = vProposals[iMP];
+    if (proposal.bSkip) {
+      continue;
+    }
+    MapPoint* pMP = vpMapPoints[iMP];
 
-          if (dist < bestDist) {
-            bestDist2  = bestDist;
-            bestDist   = dist;
-            bestLevel2 = bestLevel;
-            bestLevel  = F.mvKeysRight[idx].octave;
-            bestIdx    = idx;
-          } else if (dist < bestDist2) {
-            bestLevel2 = F.mvKeysRight[idx].octave;
-            bestDist2  = dist;
-          }
+    if (pMP->mbTrackInView && !proposal.vIndicesLeft.empty()) {
+      const ProjectionMatch match
+        = AnyAssigned(vbAssigned, proposal.vIndicesLeft, 0)
+          ? MatchInLeftWindow(
+              F, pMP, proposal.vIndicesLeft, proposal.rLeft, proposal.descriptor, batch
+            )
+          : proposal.left;
+      const int bestIdx = match.bestIdx;
+
+      // Apply ratio to second match (only if best and second are in the same scale level)
+      if (match.bestDist <= TH_HIGH) {
+        if (match.bestLevel == match.bestLevel2 && match.bestDist > mfNNratio * match.bestDist2) {
+          continue;
         }
 
-        // Apply ratio to second match (only if best and second are in the same scale level)
-        if (bestDist <= TH_HIGH) {
-          if (bestLevel == bestLevel2 && bestDist > mfNNratio * bestDist2) {
-            continue;
-          }
+        if (match.bestLevel != match.bestLevel2 || match.bestDist <= mfNNratio * match.bestDist2) {
+          F.mvpMapPoints[bestIdx] = pMP;
+          vbAssigned[bestIdx]     = true;
 
           // Also match with the stereo observation at right camera
-          if (F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1) {
-            F.mvpMapPoints[F.mvRightToLeftMatch[bestIdx]] = pMP;
+          if (F.Nleft != -1 && F.mvLeftToRightMatch[bestIdx] != -1) {
+            F.mvpMapPoints[F.mvLeftToRightMatch[bestIdx] + F.Nleft] = pMP;
+            vbAssigned[F.mvLeftToRightMatch[bestIdx] + F.Nleft]     = true;
             nmatches++;
-            left++;
+            right++;
           }
 
-          F.mvpMapPoints[bestIdx + F.Nleft] = pMP;
           nmatches++;
-          right++;
+          left++;
         }
       }
     }
+
+    if (F.Nleft != -1 && pMP->mbTrackInViewR && !proposal.vIndicesRight.empty()) {
+      const ProjectionMatch match
+        = AnyAssigned(vbAssigned, proposal.vIndicesRight, F.Nleft)
+          ? MatchInRightWindow(F, proposal.vIndicesRight, proposal.descriptor, batch)
+          : proposal.right;
+      const int bestIdx = match.bestIdx;
+
+      // Apply ratio to second match (only if best and second are in the same scale level)
+      if (match.bestDist <= TH_HIGH) {
+        if (match.bestLevel == match.bestLevel2 && match.bestDist > mfNNratio * match.bestDist2) {
+          continue;
+        }
+
+        // Also match with the stereo observation at right camera
+        if (F.Nleft != -1 && F.mvRightToLeftMatch[bestIdx] != -1) {
+          F.mvpMapPoints[F.mvRightToLeftMatch[bestIdx]] = pMP;
+          vbAssigned[F.mvRightToLeftMatch[bestIdx]]     = true;
+          nmatches++;
+          left++;
+        }
+
+        F.mvpMapPoints[bestIdx + F.Nleft] = pMP;
+        vbAssigned[bestIdx + F.Nleft]     = true;
+        nmatches++;
+        right++;
+      }
+    }
   }
   return nmatches;
 }
@@ -273,7 +413,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
           continue;
         }
 
-        const cv::Mat& dKF = pKF->mDescriptors.row(realIdxKF);
+        const Descriptor& dKF = pKF->mDescriptors[realIdxKF];
 
         int bestDist1 = 256;
         int bestIdxF  = -1;
@@ -291,7 +431,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
               continue;
             }
 
-            const cv::Mat& dF = F.mDescriptors.row(realIdxF);
+            const Descriptor& dF = F.mDescriptors[realIdxF];
 
             const int dist = DescriptorDistance(dKF, dF);
 
@@ -309,7 +449,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
               continue;
             }
 
-            const cv::Mat& dF = F.mDescriptors.row(realIdxF);
+            const Descriptor& dF = F.mDescriptors[realIdxF];
 
             const int dist = DescriptorDistance(dKF, dF);
 
@@ -341,9 +481,9 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
                                      : pKF->mvKeys[realIdxKF];
 
             if (mbCheckOrientation) {
-              cv::KeyPoint& Fkp = (!pKF->mpCamera2 || F.Nleft == -1) ? F.mvKeys[bestIdxF]
-                                : (bestIdxF >= F.Nleft) ? F.mvKeysRight[bestIdxF - F.Nleft]
-                                                        : F.mvKeys[bestIdxF];
+              const cv::KeyPoint& Fkp = (!pKF->mpCamera2 || F.Nleft == -1) ? F.mvKeys[bestIdxF]
+                                      : (bestIdxF >= F.Nleft) ? F.mvKeysRight[bestIdxF - F.Nleft]
+                                                              : F.mvKeys[bestIdxF];
 
               float rot = kp.angle - Fkp.angle;
               if (rot < 0.0) {
@@ -369,9 +509,10 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
                                        : pKF->mvKeys[realIdxKF];
 
               if (mbCheckOrientation) {
-                cv::KeyPoint& Fkp = (!F.mpCamera2)         ? F.mvKeys[bestIdxFR]
-                                  : (bestIdxFR >= F.Nleft) ? F.mvKeysRight[bestIdxFR - F.Nleft]
-                                                           : F.mvKeys[bestIdxFR];
+                const cv::KeyPoint& Fkp
+                  = (!F.mpCamera2)         ? F.mvKeys[bestIdxFR]
+                  : (bestIdxFR >= F.Nleft) ? F.mvKeysRight[bestIdxFR - F.Nleft]
+                                           : F.mvKeys[bestIdxFR];
 
                 float rot = kp.angle - Fkp.angle;
                 if (rot < 0.0) {
@@ -395,7 +536,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF, Frame& F, std::vector<MapPoint*>& vpM
     } else if (KFit->first < Fit->first) {
       KFit = vFeatVecKF.lower_bound(Fit->first);
     } else {
-      Fit = F.mFeatVec.lower_bound(KFit->first);
+      Fit = F.mFeatVec->lower_bound(KFit->first);
     }
   }
 
@@ -500,7 +641,7 @@ int ORBmatcher::SearchByProjection(
     }
 
     // Match to the most similar keypoint in the radius
-    const cv::Mat dMP = pMP->GetDescriptor();
+    const Descriptor dMP = pMP->GetDescriptor();
 
     int bestDist = 256;
     int bestIdx  = -1;
@@ -518,7 +659,7 @@ int ORBmatcher::SearchByProjection(
         continue;
       }
 
-      const cv::Mat& dKF = pKF->mDescriptors.row(idx);
+      const Descriptor& dKF = pKF->mDescriptors[idx];
 
       const int dist = DescriptorDistance(dMP, dKF);
 
@@ -625,7 +766,7 @@ int ORBmatcher::SearchByProjection(
     }
 
     // Match to the most similar keypoint in the radius
-    const cv::Mat dMP = pMP->GetDescriptor();
+    const Descriptor dMP = pMP->GetDescriptor();
 
     int bestDist = 256;
     int bestIdx  = -1;
@@ -643,7 +784,7 @@ int ORBmatcher::SearchByProjection(
         continue;
       }
 
-      const cv::Mat& dKF = pKF->mDescriptors.row(idx);
+      const Descriptor& dKF = pKF->mDescriptors[idx];
 
       const int dist = DescriptorDistance(dMP, dKF);
 
@@ -696,7 +837,7 @@ int ORBmatcher::SearchForInitialization(
       continue;
     }
 
-    cv::Mat d1 = F1.mDescriptors.row(i1);
+    const Descriptor& d1 = F1.mDescriptors[i1];
 
     int bestDist  = INT_MAX;
     int bestDist2 = INT_MAX;
@@ -706,7 +847,7 @@ int ORBmatcher::SearchForInitialization(
          vit++) {
       std::size_t i2 = *vit;
 
-      cv::Mat d2 = F2.mDescriptors.row(i2);
+      const Descriptor& d2 = F2.mDescriptors[i2];
 
       int dist = DescriptorDistance(d1, d2);
 
@@ -785,12 +926,12 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF1, KeyFrame* pKF2, std::vector<MapPoint
   const std::vector<cv::KeyPoint>& vKeysUn1     = pKF1->mvKeysUn;
   const DBoW2::FeatureVector&      vFeatVec1    = pKF1->mFeatVec;
   const std::vector<MapPoint*>     vpMapPoints1 = pKF1->GetMapPointMatches();
-  const cv::Mat&                   Descriptors1 = pKF1->mDescriptors;
+  const DescriptorArray&           Descriptors1 = pKF1->mDescriptors;
 
   const std::vector<cv::KeyPoint>& vKeysUn2     = pKF2->mvKeysUn;
   const DBoW2::FeatureVector&      vFeatVec2    = pKF2->mFeatVec;
   const std::vector<MapPoint*>     vpMapPoints2 = pKF2->GetMapPointMatches();
-  const cv::Mat&                   Descriptors2 = pKF2->mDescriptors;
+  const DescriptorArray&           Descriptors2 = pKF2->mDescriptors;
 
   vpMatches12 = std::vector<MapPoint*>(vpMapPoints1.size(), static_cast<MapPoint*>(NULL));
   std::vector<bool> vbMatched2(vpMapPoints2.size(), false);
@@ -825,7 +966,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF1, KeyFrame* pKF2, std::vector<MapPoint
           continue;
         }
 
-        const cv::Mat& d1 = Descriptors1.row(idx1);
+        const Descriptor& d1 = Descriptors1[idx1];
 
         int bestDist1 = 256;
         int bestIdx2  = -1;
@@ -848,7 +989,7 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF1, KeyFrame* pKF2, std::vector<MapPoint
             continue;
           }
 
-          const cv::Mat& d2 = Descriptors2.row(idx2);
+          const Descriptor& d2 = Descriptors2[idx2];
 
           int dist = DescriptorDistance(d1, d2);
 
@@ -1001,7 +1142,7 @@ int ORBmatcher::SearchForTriangulation(
 
         const bool bRight1 = (pKF1->NLeft == -1 || idx1 < pKF1->NLeft) ? false : true;
 
-        const cv::Mat& d1 = pKF1->mDescriptors.row(idx1);
+        const Descriptor& d1 = pKF1->mDescriptors[idx1];
 
         int bestDist = TH_LOW;
         int bestIdx2 = -1;
@@ -1024,7 +1165,7 @@ int ORBmatcher::SearchForTriangulation(
             }
           }
 
-          const cv::Mat& d2 = pKF2->mDescriptors.row(idx2);
+          const Descriptor& d2 = pKF2->mDescriptors[idx2];
 
           const int dist = DescriptorDistance(d1, d2);
 
@@ -1077,7 +1218,7 @@ int ORBmatcher::SearchForTriangulation(
             }
           }
 
-          if(bCoarse || pCamera1->epipolarConstrain(pCamera2, kp1, kp2, R12, t12, pKF1->mvLevelSigma2[kp1.octave], pKF2->mvLevelSigma2[kp2.octave])) { // MODIFICATION_2
+          if(bCoarse || pCamera1->epipolarConstrain(pCamera2, kp1, kp2, pKF1->mvBearings[idx1], pKF2->mvBearings[idx2], R12, t12, pKF1->mvLevelSigma2[kp1.octave], pKF2->mvLevelSigma2[kp2.octave])) { // MODIFICATION_2
             bestIdx2 = idx2;
             bestDist = dist;
           }
@@ -1146,182 +1287,287 @@ int ORBmatcher::SearchForTriangulation(
   return nmatches;
 }
 
-int ORBmatcher::Fuse(
-  KeyFrame* pKF, const std::vector<MapPoint*>& vpMapPoints, const float th, const bool bRight
+namespace {
+
+// Keypoint of pKF to fuse a map point with, or -1. Only reads the point and the keyframe features,
+// so it can run for many points in parallel.
+int MatchToFuse(
+  KeyFrame*              pKF,
+  MapPoint*              pMP,
+  const Sophus::SE3f&    Tcw,
+  const Eigen::Vector3f& Ow,
+  GeometricCamera*       pCamera,
+  const float            th,
+  const bool             bRight
 ) {
-  GeometricCamera* pCamera;
-  Sophus::SE3f     Tcw;
-  Eigen::Vector3f  Ow;
+  if (!pMP || pMP->isBad() || pMP->IsInKeyFrame(pKF)) {
+    return -1;
+  }
 
-  if (bRight) {
-    Tcw     = pKF->GetRightPose();
-    Ow      = pKF->GetRightCameraCenter();
-    pCamera = pKF->mpCamera2;
-  } else {
-    Tcw     = pKF->GetPose();
-    Ow      = pKF->GetCameraCenter();
-    pCamera = pKF->mpCamera;
+  Eigen::Vector3f p3Dw = pMP->GetWorldPos();
+  Eigen::Vector3f p3Dc = Tcw * p3Dw;
+
+  // Depth must be positive
+  if (p3Dc(2) < 0.0f) {
+    return -1;
   }
 
-  const float& fx = pKF->fx;
-  const float& fy = pKF->fy;
-  const float& cx = pKF->cx;
-  const float& cy = pKF->cy;
-  const float& bf = pKF->mbf;
+  const float invz = 1 / p3Dc(2);
 
-  int nFused = 0;
+  const Eigen::Vector2f uv = pCamera->project(p3Dc);
 
-  const int nMPs = vpMapPoints.size();
+  // Point must be inside the image
+  if (!pKF->IsInImage(uv(0), uv(1))) {
+    return -1;
+  }
 
-  // For debbuging
-  int count_notMP = 0, count_bad = 0, count_isinKF = 0, count_negdepth = 0, count_notinim = 0,
-      count_dist = 0, count_normal = 0, count_notidx = 0, count_thcheck = 0;
-  for (int i = 0; i < nMPs; i++) {
-    MapPoint* pMP = vpMapPoints[i];
+  const float ur = uv(0) - pKF->mbf * invz;
 
-    if (!pMP) {
-      count_notMP++;
-      continue;
-    }
+  const float     maxDistance = pMP->GetMaxDistanceInvariance();
+  const float     minDistance = pMP->GetMinDistanceInvariance();
+  Eigen::Vector3f PO          = p3Dw - Ow;
+  const float     dist3D      = PO.norm();
 
-    if (pMP->isBad()) {
-      count_bad++;
-      continue;
-    } else if (pMP->IsInKeyFrame(pKF)) {
-      count_isinKF++;
-      continue;
-    }
+  // Depth must be inside the scale pyramid of the image
+  if (dist3D < minDistance || dist3D > maxDistance) {
+    return -1;
+  }
 
-    Eigen::Vector3f p3Dw = pMP->GetWorldPos();
-    Eigen::Vector3f p3Dc = Tcw * p3Dw;
+  // Viewing angle must be less than 60 deg
+  Eigen::Vector3f Pn = pMP->GetNormal();
 
-    // Depth must be positive
-    if (p3Dc(2) < 0.0f) {
-      count_negdepth++;
-      continue;
-    }
+  if (PO.dot(Pn) < 0.5 * dist3D) {
+    return -1;
+  }
 
-    const float invz = 1 / p3Dc(2);
+  int nPredictedLevel = pMP->PredictScale(dist3D, pKF);
 
-    const Eigen::Vector2f uv = pCamera->project(p3Dc);
+  // Search in a radius
+  const float radius = th * pKF->mvScaleFactors[nPredictedLevel];
 
-    // Point must be inside the image
-    if (!pKF->IsInImage(uv(0), uv(1))) {
-      count_notinim++;
+  const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0), uv(1), radius, bRight);
+
+  if (vIndices.empty()) {
+    return -1;
+  }
+
+  // Match to the most similar keypoint in the radius
+
+  const Descriptor dMP = pMP->GetDescriptor();
+
+  int bestDist = 256;
+  int bestIdx  = -1;
+  for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end();
+       vit != vend;
+       vit++) {
+    std::size_t         idx = *vit;
+    const cv::KeyPoint& kp  = (pKF->NLeft == -1) ? pKF->mvKeysUn[idx]
+                            : (!bRight)          ? pKF->mvKeys[idx]
+                                                 : pKF->mvKeysRight[idx];
+
+    const int& kpLevel = kp.octave;
+
+    if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel) {
       continue;
     }
 
-    const float ur = uv(0) - bf * invz;
+    if (pKF->mvuRight[idx] >= 0) {
+      // Check reprojection error in stereo
+      const float& kpx = kp.pt.x;
+      const float& kpy = kp.pt.y;
+      const float& kpr = pKF->mvuRight[idx];
+      const float  ex  = uv(0) - kpx;
+      const float  ey  = uv(1) - kpy;
+      const float  er  = ur - kpr;
+      const float  e2  = ex * ex + ey * ey + er * er;
 
-    const float     maxDistance = pMP->GetMaxDistanceInvariance();
-    const float     minDistance = pMP->GetMinDistanceInvariance();
-    Eigen::Vector3f PO          = p3Dw - Ow;
-    const float     dist3D      = PO.norm();
+      if (e2 * pKF->mvInvLevelSigma2[kpLevel] > 7.8) {
+        continue;
+      }
+    } else {
+      const float& kpx = kp.pt.x;
+      const float& kpy = kp.pt.y;
+      const float  ex  = uv(0) - kpx;
+      const float  ey  = uv(1) - kpy;
+      const float  e2  = ex * ex + ey * ey;
 
-    // Depth must be inside the scale pyramid of the image
-    if (dist3D < minDistance || dist3D > maxDistance) {
-      count_dist++;
-      continue;
+      if (e2 * pKF->mvInvLevelSigma2[kpLevel] > 5.99) {
+        continue;
+      }
     }
 
-    // Viewing angle must be less than 60 deg
-    Eigen::Vector3f Pn = pMP->GetNormal();
+    if (bRight) {
+      idx += pKF->NLeft;
+    }
 
-    if (PO.dot(Pn) < 0.5 * dist3D) {
-      count_normal++;
-      continue;
+    const Descriptor& dKF = pKF->mDescriptors[idx];
+
+    const int dist = ORBmatcher::DescriptorDistance(dMP, dKF);
+
+    if (dist < bestDist) {
+      bestDist = dist;
+      bestIdx  = idx;
     }
+  }
 
-    int nPredictedLevel = pMP->PredictScale(dist3D, pKF);
+  return bestDist <= ORBmatcher::TH_LOW ? bestIdx : -1;
+}
 
-    // Search in a radius
-    const float radius = th * pKF->mvScaleFactors[nPredictedLevel];
+// Keypoint of pKF to fuse a map point with under a Sim3 pose, or -1. Only reads the point and the
+// keyframe features, so it can run for many points in parallel.
+int MatchToFuseSim3(
+  KeyFrame*                  pKF,
+  MapPoint*                  pMP,
+  const Sophus::SE3f&        Tcw,
+  const Eigen::Vector3f&     Ow,
+  const std::set<MapPoint*>& spAlreadyFound,
+  const float                th
+) {
+  // Discard Bad MapPoints and already found
+  if (pMP->isBad() || spAlreadyFound.count(pMP)) {
+    return -1;
+  }
 
-    const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0), uv(1), radius, bRight);
+  // Get 3D Coords.
+  Eigen::Vector3f p3Dw = pMP->GetWorldPos();
 
-    if (vIndices.empty()) {
-      count_notidx++;
+  // Transform into Camera Coords.
+  Eigen::Vector3f p3Dc = Tcw * p3Dw;
+
+  // Depth must be positive
+  if (p3Dc(2) < 0.0f) {
+    return -1;
+  }
+
+  // Project into Image
+  const Eigen::Vector2f uv = pKF->mpCamera->project(p3Dc);
+
+  // Point must be inside the image
+  if (!pKF->IsInImage(uv(0), uv(1))) {
+    return -1;
+  }
+
+  // Depth must be inside the scale pyramid of the image
+  const float     maxDistance = pMP->GetMaxDistanceInvariance();
+  const float     minDistance = pMP->GetMinDistanceInvariance();
+  Eigen::Vector3f PO          = p3Dw - Ow;
+  const float     dist3D      = PO.norm();
+
+  if (dist3D < minDistance || dist3D > maxDistance) {
+    return -1;
+  }
+
+  // Viewing angle must be less than 60 deg
+  Eigen::Vector3f Pn = pMP->GetNormal();
+
+  if (PO.dot(Pn) < 0.5 * dist3D) {
+    return -1;
+  }
+
+  // Compute predicted scale level
+  const int nPredictedLevel = pMP->PredictScale(dist3D, pKF);
+
+  // Search in a radius
+  const float radius = th * pKF->mvScaleFactors[nPredictedLevel];
+
+  const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0), uv(1), radius);
+
+  if (vIndices.empty()) {
+    return -1;
+  }
+
+  // Match to the most similar keypoint in the radius
+
+  const Descriptor dMP = pMP->GetDescriptor();
+
+  int bestDist = INT_MAX;
+  int bestIdx  = -1;
+  for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(); vit != vIndices.end();
+       vit++) {
+    const std::size_t idx     = *vit;
+    const int&        kpLevel = pKF->mvKeysUn[idx].octave;
+
+    if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel) {
       continue;
     }
 
-    // Match to the most similar keypoint in the radius
+    const Descriptor& dKF = pKF->mDescriptors[idx];
 
-    const cv::Mat dMP = pMP->GetDescriptor();
+    int dist = ORBmatcher::DescriptorDistance(dMP, dKF);
 
-    int bestDist = 256;
-    int bestIdx  = -1;
-    for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end();
-         vit != vend;
-         vit++) {
-      std::size_t         idx = *vit;
-      const cv::KeyPoint& kp  = (pKF->NLeft == -1) ? pKF->mvKeysUn[idx]
-                              : (!bRight)          ? pKF->mvKeys[idx]
-                                                   : pKF->mvKeysRight[idx];
+    if (dist < bestDist) {
+      bestDist = dist;
+      bestIdx  = idx;
+    }
+  }
 
-      const int& kpLevel = kp.octave;
+  return bestDist <= ORBmatcher::TH_LOW ? bestIdx : -1;
+}
 
-      if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel) {
-        continue;
-      }
+} // namespace
 
-      if (pKF->mvuRight[idx] >= 0) {
-        // Check reprojection error in stereo
-        const float& kpx = kp.pt.x;
-        const float& kpy = kp.pt.y;
-        const float& kpr = pKF->mvuRight[idx];
-        const float  ex  = uv(0) - kpx;
-        const float  ey  = uv(1) - kpy;
-        const float  er  = ur - kpr;
-        const float  e2  = ex * ex + ey * ey + er * er;
-
-        if (e2 * pKF->mvInvLevelSigma2[kpLevel] > 7.8) {
-          continue;
-        }
-      } else {
-        const float& kpx = kp.pt.x;
-        const float& kpy = kp.pt.y;
-        const float  ex  = uv(0) - kpx;
-        const float  ey  = uv(1) - kpy;
-        const float  e2  = ex * ex + ey * ey;
-
-        if (e2 * pKF->mvInvLevelSigma2[kpLevel] > 5.99) {
-          continue;
-        }
-      }
+int ORBmatcher::Fuse(
+  KeyFrame*                     pKF,
+  const std::vector<MapPoint*>& vpMapPoints,
+  const float                   th,
+  const bool                    bRight,
+  ThreadPool*                   pThreadPool
+) {
+  GeometricCamera* pCamera;
+  Sophus::SE3f     Tcw;
+  Eigen::Vector3f  Ow;
 
-      if (bRight) {
-        idx += pKF->NLeft;
-      }
+  if (bRight) {
+    Tcw     = pKF->GetRightPose();
+    Ow      = pKF->GetRightCameraCenter();
+    pCamera = pKF->mpCamera2;
+  } else {
+    Tcw     = pKF->GetPose();
+    Ow      = pKF->GetCameraCenter();
+    pCamera = pKF->mpCamera;
+  }
 
-      const cv::Mat& dKF = pKF->mDescriptors.row(idx);
+  int nFused = 0;
 
-      const int dist = DescriptorDistance(dMP, dKF);
+  const int nMPs = vpMapPoints.size();
 
-      if (dist < bestDist) {
-        bestDist = dist;
-        bestIdx  = idx;
-      }
+  // The keypoint of every point is searched independently, possibly in parallel, before any point
+  // is fused.
+  std::vector<int> vMatches(nMPs, -1);
+  ForEachBlock(nMPs, pThreadPool, [&](const int begin, const int end) {
+    for (int i = begin; i < end; i++) {
+      vMatches[i] = MatchToFuse(pKF, vpMapPoints[i], Tcw, Ow, pCamera, th, bRight);
+    }
+  });
+
+  // Points are then fused in order. A point an earlier fuse touched is either bad or observed by
+  // the keyframe by now, and is skipped, so the others keep the keypoint searched above.
+  for (int i = 0; i < nMPs; i++) {
+    MapPoint* pMP = vpMapPoints[i];
+    if (!pMP || pMP->isBad() || pMP->IsInKeyFrame(pKF)) {
+      continue;
+    }
+
+    const int bestIdx = vMatches[i];
+    if (bestIdx < 0) {
+      continue;
     }
 
     // If there is already a MapPoint replace otherwise add new measurement
-    if (bestDist <= TH_LOW) {
-      MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-      if (pMPinKF) {
-        if (!pMPinKF->isBad()) {
-          if (pMPinKF->Observations() > pMP->Observations()) {
-            pMP->Replace(pMPinKF);
-          } else {
-            pMPinKF->Replace(pMP);
-          }
+    MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+    if (pMPinKF) {
+      if (!pMPinKF->isBad()) {
+        if (pMPinKF->Observations() > pMP->Observations()) {
+          pMP->Replace(pMPinKF);
+        } else {
+          pMPinKF->Replace(pMP);
         }
-      } else {
-        pMP->AddObservation(pKF, bestIdx);
-        pKF->AddMapPoint(pMP, bestIdx);
       }
-      nFused++;
     } else {
-      count_thcheck++;
+      pMP->AddObservation(pKF, bestIdx);
+      pKF->AddMapPoint(pMP, bestIdx);
     }
+    nFused++;
   }
 
   return nFused;
@@ -1332,14 +1578,9 @@ int ORBmatcher::Fuse(
   Sophus::Sim3f&                Scw,
   const std::vector<MapPoint*>& vpPoints,
   float                         th,
-  std::vector<MapPoint*>&       vpReplacePoint
+  std::vector<MapPoint*>&       vpReplacePoint,
+  ThreadPool*                   pThreadPool
 ) {
-  // Get Calibration Parameters for later projection
-  const float& fx = pKF->fx;
-  const float& fy = pKF->fy;
-  const float& cx = pKF->cx;
-  const float& cy = pKF->cy;
-
   // Decompose Scw
   Sophus::SE3f    Tcw = Sophus::SE3f(Scw.rotationMatrix(), Scw.translation() / Scw.scale());
   Eigen::Vector3f Ow  = Tcw.inverse().translation();
@@ -1351,104 +1592,102 @@ int ORBmatcher::Fuse(
 
   const int nPoints = vpPoints.size();
 
-  // For each candidate MapPoint project and match
-  for (int iMP = 0; iMP < nPoints; iMP++) {
-    MapPoint* pMP = vpPoints[iMP];
-
-    // Discard Bad MapPoints and already found
-    if (pMP->isBad() || spAlreadyFound.count(pMP)) {
-      continue;
+  // For each candidate MapPoint project and match, possibly in parallel. Replacements are only
+  // recorded, so the matches do not depend on the points fused before.
+  std::vector<int> vMatches(nPoints, -1);
+  ForEachBlock(nPoints, pThreadPool, [&](const int begin, const int end) {
+    for (int iMP = begin; iMP < end; iMP++) {
+      vMatches[iMP] = MatchToFuseSim3(pKF, vpPoints[iMP], Tcw, Ow, spAlreadyFound, th);
     }
+  });
 
-    // Get 3D Coords.
-    Eigen::Vector3f p3Dw = pMP->GetWorldPos();
-
-    // Transform into Camera Coords.
-    Eigen::Vector3f p3Dc = Tcw * p3Dw;
-
-    // Depth must be positive
-    if (p3Dc(2) < 0.0f) {
-      continue;
-    }
-
-    // Project into Image
-    const Eigen::Vector2f uv = pKF->mpCamera->project(p3Dc);
-
-    // Point must be inside the image
-    if (!pKF->IsInImage(uv(0), uv(1))) {
+  for (int iMP = 0; iMP < nPoints; iMP++) {
+    const int bestIdx = vMatches[iMP];
+    if (bestIdx < 0) {
       continue;
     }
+    MapPoint* pMP = vpPoints[iMP];
 
-    // Depth must be inside the scale pyramid of the image
-    const float     maxDistance = pMP->GetMaxDistanceInvariance();
-    const float     minDistance = pMP->GetMinDistanceInvariance();
-    Eigen::Vector3f PO          = p3Dw - Ow;
-    const float     dist3D      = PO.norm();
-
-    if (dist3D < minDistance || dist3D > maxDistance) {
-      continue;
+    // If there is already a MapPoint replace otherwise add new measurement
+    MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+    if (pMPinKF) {
+      if (!pMPinKF->isBad()) {
+        vpReplacePoint[iMP] = pMPinKF;
+      }
+    } else {
+      pMP->AddObservation(pKF, bestIdx);
+      pKF->AddMapPoint(pMP, bestIdx);
     }
+    nFused++;
+  }
 
-    // Viewing angle must be less than 60 deg
-    Eigen::Vector3f Pn = pMP->GetNormal();
+  return nFused;
+}
 
-    if (PO.dot(Pn) < 0.5 * dist3D) {
+// The replacements are grouped by the points they involve, so that two groups never touch the same
+// map point or keyframe observation. Each group replaces its points in order.
+int ORBmatcher::ReplaceFusedPoints(
+  const std::vector<MapPoint*>& vpPoints,
+  const std::vector<MapPoint*>& vpReplacePoint,
+  ThreadPool*                   pThreadPool
+) {
+  // Union-find over the points of the replacements
+  std::unordered_map<MapPoint*, int> mPointNodes;
+  std::vector<int>                   vParents;
+
+  const auto Node = [&](MapPoint* pMP) {
+    const auto it = mPointNodes.emplace(pMP, static_cast<int>(vParents.size())).first;
+    if (it->second == static_cast<int>(vParents.size())) {
+      vParents.push_back(it->second);
+    }
+    return it->second;
+  };
+  const auto Find = [&](int node) {
+    while (vParents[node] != node) {
+      vParents[node] = vParents[vParents[node]];
+      node           = vParents[node];
+    }
+    return node;
+  };
+
+  std::vector<int> vReplaced;
+  for (std::size_t i = 0; i < vpReplacePoint.size(); i++) {
+    if (!vpReplacePoint[i]) {
       continue;
     }
-
-    // Compute predicted scale level
-    const int nPredictedLevel = pMP->PredictScale(dist3D, pKF);
-
-    // Search in a radius
-    const float radius = th * pKF->mvScaleFactors[nPredictedLevel];
-
-    const std::vector<std::size_t> vIndices = pKF->GetFeaturesInArea(uv(0), uv(1), radius);
-
-    if (vIndices.empty()) {
-      continue;
+    vReplaced.push_back(static_cast<int>(i));
+    const int a = Find(Node(vpReplacePoint[i]));
+    const int b = Find(Node(vpPoints[i]));
+    if (a != b) {
+      vParents[std::max(a, b)] = std::min(a, b);
     }
+  }
 
-    // Match to the most similar keypoint in the radius
-
-    const cv::Mat dMP = pMP->GetDescriptor();
-
-    int bestDist = INT_MAX;
-    int bestIdx  = -1;
-    for (std::vector<std::size_t>::const_iterator vit = vIndices.begin(); vit != vIndices.end();
-         vit++) {
-      const std::size_t idx     = *vit;
-      const int&        kpLevel = pKF->mvKeysUn[idx].octave;
-
-      if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel) {
-        continue;
-      }
-
-      const cv::Mat& dKF = pKF->mDescriptors.row(idx);
-
-      int dist = DescriptorDistance(dMP, dKF);
-
-      if (dist < bestDist) {
-        bestDist = dist;
-        bestIdx  = idx;
-      }
+  // Replacements of each group in order, largest groups first
+  std::unordered_map<int, int>  mGroups;
+  std::vector<std::vector<int>> vGroups;
+  for (const int i : vReplaced) {
+    const int  root = Find(mPointNodes[vpReplacePoint[i]]);
+    const auto it   = mGroups.emplace(root, static_cast<int>(vGroups.size())).first;
+    if (it->second == static_cast<int>(vGroups.size())) {
+      vGroups.emplace_back();
     }
+    vGroups[it->second].push_back(i);
+  }
+  std::stable_sort(
+    vGroups.begin(),
+    vGroups.end(),
+    [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); }
+  );
 
-    // If there is already a MapPoint replace otherwise add new measurement
-    if (bestDist <= TH_LOW) {
-      MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-      if (pMPinKF) {
-        if (!pMPinKF->isBad()) {
-          vpReplacePoint[iMP] = pMPinKF;
-        }
-      } else {
-        pMP->AddObservation(pKF, bestIdx);
-        pKF->AddMapPoint(pMP, bestIdx);
-      }
-      nFused++;
+  const auto ReplaceGroup = [&](const int g) {
+    for (const int i : vGroups[g]) {
+      vpReplacePoint[i]->Replace(vpPoints[i]);
     }
-  }
+  };
+  ParallelFor(pThreadPool, 0, static_cast<int>(vGroups.size()), ReplaceGroup);
 
-  return nFused;
+  return static_cast<int>(vReplaced.size());
 }
 
 int ORBmatcher::SearchBySim3(
@@ -1548,7 +1787,7 @@ int ORBmatcher::SearchBySim3(
     }
 
     // Match to the most similar keypoint in the radius
-    const cv::Mat dMP = pMP->GetDescriptor();
+    const Descriptor dMP = pMP->GetDescriptor();
 
     int bestDist = INT_MAX;
     int bestIdx  = -1;
@@ -1563,7 +1802,7 @@ int ORBmatcher::SearchBySim3(
         continue;
       }
 
-      const cv::Mat& dKF = pKF2->mDescriptors.row(idx);
+      const Descriptor& dKF = pKF2->mDescriptors[idx];
 
       const int dist = DescriptorDistance(dMP, dKF);
 
@@ -1633,7 +1872,7 @@ int ORBmatcher::SearchBySim3(
     }
 
     // Match to the most similar keypoint in the radius
-    const cv::Mat dMP = pMP->GetDescriptor();
+    const Descriptor dMP = pMP->GetDescriptor();
 
     int bestDist = INT_MAX;
     int bestIdx  = -1;
@@ -1648,7 +1887,7 @@ int ORBmatcher::SearchBySim3(
         continue;
       }
 
-      const cv::Mat& dKF = pKF1->mDescriptors.row(idx);
+      const Descriptor& dKF = pKF1->mDescriptors[idx];
 
       const int dist = DescriptorDistance(dMP, dKF);
 
@@ -1702,23 +1941,40 @@ int ORBmatcher::SearchByProjection(
   const bool bForward  = tlc(2) > CurrentFrame.mb && !bMono;
   const bool bBackward = -tlc(2) > CurrentFrame.mb && !bMono;
 
-  for (int i = 0; i < LastFrame.N; i++) {
+  // Keypoints in the window of the current map point, and the candidates among them that pass the
+  // checks, scored in one batch
+  std::vector<std::size_t>          vIndices2;
+  std::vector<std::size_t>          vCandidates;
+  std::vector<const unsigned char*> vpCandidateDescs;
+
+  // Project the map points of the last frame in the current one, all at once
+  const int                    N = LastFrame.N;
+  std::vector<Eigen::Vector3f> vx3Dc(N, Eigen::Vector3f::Zero());
+  std::vector<float>           vxc(N, 0.f), vyc(N, 0.f), vzc(N, 1.f), vu(N), vv(N);
+  for (int i = 0; i < N; i++) {
+    MapPoint* pMP = LastFrame.mvpMapPoints[i];
+    if (pMP && !LastFrame.mvbOutlier[i]) {
+      vx3Dc[i] = Tcw * pMP->GetWorldPos();
+      vxc[i]   = vx3Dc[i](0);
+      vyc[i]   = vx3Dc[i](1);
+      vzc[i]   = vx3Dc[i](2);
+    }
+  }
+  CurrentFrame.mpCamera->projectBatch(vxc.data(), vyc.data(), vzc.data(), N, vu.data(), vv.data());
+
+  for (int i = 0; i < N; i++) {
     MapPoint* pMP = LastFrame.mvpMapPoints[i];
     if (pMP) {
       if (!LastFrame.mvbOutlier[i]) {
-        // Project
-        Eigen::Vector3f x3Dw = pMP->GetWorldPos();
-        Eigen::Vector3f x3Dc = Tcw * x3Dw;
+        const Eigen::Vector3f& x3Dc = vx3Dc[i];
 
-        const float xc    = x3Dc(0);
-        const float yc    = x3Dc(1);
         const float invzc = 1.0 / x3Dc(2);
 
         if (invzc < 0) {
           continue;
         }
 
-        Eigen::Vector2f uv = CurrentFrame.mpCamera->project(x3Dc);
+        Eigen::Vector2f uv(vu[i], vv[i]);
 
         if (uv(0) < CurrentFrame.mnMinX || uv(0) > CurrentFrame.mnMaxX) {
           continue;
@@ -1734,26 +1990,24 @@ int ORBmatcher::SearchByProjection(
         // Search in a window. Size depends on scale
         float radius = th * CurrentFrame.mvScaleFactors[nLastOctave];
 
-        std::vector<std::size_t> vIndices2;
-
         if (bForward) {
-          vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave);
+          CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave, -1, false, vIndices2);
         } else if (bBackward) {
-          vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, 0, nLastOctave);
+          CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, 0, nLastOctave, false, vIndices2);
         } else {
-          vIndices2 = CurrentFrame
-                        .GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave - 1, nLastOctave + 1);
+          CurrentFrame.GetFeaturesInArea(
+            uv(0), uv(1), radius, nLastOctave - 1, nLastOctave + 1, false, vIndices2
+          );
         }
 
         if (vIndices2.empty()) {
           continue;
         }
 
-        const cv::Mat dMP = pMP->GetDescriptor();
-
-        int bestDist = 256;
-        int bestIdx2 = -1;
+        const Descriptor dMP = pMP->GetDescriptor();
 
+        vCandidates.clear();
+        vpCandidateDescs.clear();
         for (std::vector<std::size_t>::const_iterator vit  = vIndices2.begin(),
                                                       vend = vIndices2.end();
              vit != vend;
@@ -1774,16 +2028,16 @@ int ORBmatcher::SearchByProjection(
             }
           }
 
-          const cv::Mat& d = CurrentFrame.mDescriptors.row(i2);
-
-          const int dist = DescriptorDistance(dMP, d);
-
-          if (dist < bestDist) {
-            bestDist = dist;
-            bestIdx2 = i2;
-          }
+          vCandidates.push_back(i2);
+          vpCandidateDescs.push_back(CurrentFrame.mDescriptors[i2].data());
         }
 
+        const HammingMatch match = FindBestHamming(
+          dMP.data(), vpCandidateDescs.data(), static_cast<int>(vCandidates.size())
+        );
+        const int bestDist = match.bestDist;
+        const int bestIdx2 = match.bestIdx >= 0 ? static_cast<int>(vCandidates[match.bestIdx]) : -1;
+
         if (bestDist <= TH_HIGH) {
           CurrentFrame.mvpMapPoints[bestIdx2] = pMP;
           nmatches++;
@@ -1820,23 +2074,20 @@ int ORBmatcher::SearchByProjection(
           // Search in a window. Size depends on scale
           float radius = th * CurrentFrame.mvScaleFactors[nLastOctave];
 
-          std::vector<std::size_t> vIndices2;
-
           if (bForward) {
-            vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave, -1, true);
+            CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave, -1, true, vIndices2);
           } else if (bBackward) {
-            vIndices2 = CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, 0, nLastOctave, true);
+            CurrentFrame.GetFeaturesInArea(uv(0), uv(1), radius, 0, nLastOctave, true, vIndices2);
           } else {
-            vIndices2
-              = CurrentFrame
-                  .GetFeaturesInArea(uv(0), uv(1), radius, nLastOctave - 1, nLastOctave + 1, true);
+            CurrentFrame.GetFeaturesInArea(
+              uv(0), uv(1), radius, nLastOctave - 1, nLastOctave + 1, true, vIndices2
+            );
           }
 
-          const cv::Mat dMP = pMP->GetDescriptor();
-
-          int bestDist = 256;
-          int bestIdx2 = -1;
+          const Descriptor dMP = pMP->GetDescriptor();
 
+          vCandidates.clear();
+          vpCandidateDescs.clear();
           for (std::vector<std::size_t>::const_iterator vit  = vIndices2.begin(),
                                                         vend = vIndices2.end();
                vit != vend;
@@ -1848,16 +2099,17 @@ int ORBmatcher::SearchByProjection(
               }
             }
 
-            const cv::Mat& d = CurrentFrame.mDescriptors.row(i2 + CurrentFrame.Nleft);
-
-            const int dist = DescriptorDistance(dMP, d);
-
-            if (dist < bestDist) {
-              bestDist = dist;
-              bestIdx2 = i2;
-            }
+            vCandidates.push_back(i2);
+            vpCandidateDescs.push_back(CurrentFrame.mDescriptors[i2 + CurrentFrame.Nleft].data());
           }
 
+          const HammingMatch match = FindBestHamming(
+            dMP.data(), vpCandidateDescs.data(), static_cast<int>(vCandidates.size())
+          );
+          const int bestDist = match.bestDist;
+          const int bestIdx2
+            = match.bestIdx >= 0 ? static_cast<int>(vCandidates[match.bestIdx]) : -1;
+
           if (bestDist <= TH_HIGH) {
             CurrentFrame.mvpMapPoints[bestIdx2 + CurrentFrame.Nleft] = pMP;
             nmatches++;
@@ -1971,7 +2223,7 @@ int ORBmatcher::SearchByProjection(
           continue;
         }
 
-        const cv::Mat dMP = pMP->GetDescriptor();
+        const Descriptor dMP = pMP->GetDescriptor();
 
         int bestDist = 256;
         int bestIdx2 = -1;
@@ -1984,7 +2236,7 @@ int ORBmatcher::SearchByProjection(
             continue;
           }
 
-          const cv::Mat& d = CurrentFrame.mDescriptors.row(i2);
+          const Descriptor& d = CurrentFrame.mDescriptors[i2];
 
           const int dist = DescriptorDistance(dMP, d);
 
@@ -2070,22 +2322,9 @@ void ORBmatcher::ComputeThreeMaxima(
   }
 }
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+// Wraps HammingDistance for descriptors stored as cv::Mat rows
 int ORBmatcher::DescriptorDistance(const cv::Mat& a, const cv::Mat& b) {
-  const int* pa = a.ptr<int32_t>();
-  const int* pb = b.ptr<int32_t>();
-
-  int dist = 0;
-
-  for (int i = 0; i < 8; i++, pa++, pb++) {
-    unsigned int v = *pa ^ *pb;
-    v              = v - ((v >> 1) & 0x55555555);
-    v              = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-    dist           += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-  }
-
-  return dist;
+  return HammingDistance(a.ptr<unsigned char>(), b.ptr<unsigned char>());
 }
 
 } // namespace ORB_SLAM3
@@ -48,7 +48,8 @@ bool EdgeSE3ProjectXYZOnlyPose::write(std::ostream& os) const {
   return os.good();
 }
 
-void EdgeSE3ProjectXYZOnlyPose::linearizeOplus() {
+template <class Projection>
+void EdgeSE3ProjectXYZOnlyPose::linearizeOplusAs() {
   g2o::VertexSE3Expmap* vi        = static_cast<g2o::VertexSE3Expmap*>(_vertices[0]);
   Eigen::Vector3d       xyz_trans = vi->estimate().map(Xw);
 
@@ -59,9 +60,13 @@ void EdgeSE3ProjectXYZOnlyPose::linearizeOplus() {
   Eigen::Matrix<double, 3, 6> SE3deriv;
   SE3deriv << 0.f, z, -y, 1.f, 0.f, 0.f, -z, 0.f, x, 0.f, 1.f, 0.f, y, -x, 0.f, 0.f, 0.f, 1.f;
 
-  _jacobianOplusXi = -pCamera->projectJac(xyz_trans) * SE3deriv;
+  _jacobianOplusXi = -Projection::ProjectJac(pCamera, xyz_trans) * SE3deriv;
 }
 
+template void EdgeSE3ProjectXYZOnlyPose::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeSE3ProjectXYZOnlyPose::linearizeOplusAs<PinholeProjection>();
+template void EdgeSE3ProjectXYZOnlyPose::linearizeOplusAs<KannalaBrandt8Projection>();
+
 bool EdgeSE3ProjectXYZOnlyPoseToBody::read(std::istream& is) {
   for (int i = 0; i < 2; i++) {
     is >> _measurement[i];
@@ -90,7 +95,8 @@ bool EdgeSE3ProjectXYZOnlyPoseToBody::write(std::ostream& os) const {
   return os.good();
 }
 
-void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplus() {
+template <class Projection>
+void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplusAs() {
   g2o::VertexSE3Expmap* vi = static_cast<g2o::VertexSE3Expmap*>(_vertices[0]);
   g2o::SE3Quat          T_lw(vi->estimate());
   Eigen::Vector3d       X_l = T_lw.map(Xw);
@@ -104,9 +110,14 @@ void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplus() {
   SE3deriv << 0.f, z_w, -y_w, 1.f, 0.f, 0.f, -z_w, 0.f, x_w, 0.f, 1.f, 0.f, y_w, -x_w, 0.f, 0.f,
     0.f, 1.f;
 
-  _jacobianOplusXi = -pCamera->projectJac(X_r) * mTrl.rotation().toRotationMatrix() * SE3deriv;
+  _jacobianOplusXi
+    = -Projection::ProjectJac(pCamera, X_r) * mTrl.rotation().toRotationMatrix() * SE3deriv;
 }
 
+template void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplusAs<PinholeProjection>();
+template void EdgeSE3ProjectXYZOnlyPoseToBody::linearizeOplusAs<KannalaBrandt8Projection>();
+
 EdgeSE3ProjectXYZ::EdgeSE3ProjectXYZ()
   : BaseBinaryEdge<2, Eigen::Vector2d, g2o::VertexSBAPointXYZ, g2o::VertexSE3Expmap>() {
 }
@@ -139,7 +150,8 @@ bool EdgeSE3ProjectXYZ::write(std::ostream& os) const {
   return os.good();
 }
 
-void EdgeSE3ProjectXYZ::linearizeOplus() {
+template <class Projection>
+void EdgeSE3ProjectXYZ::linearizeOplusAs() {
   g2o::VertexSE3Expmap*   vj = static_cast<g2o::VertexSE3Expmap*>(_vertices[1]);
   g2o::SE3Quat            T(vj->estimate());
   g2o::VertexSBAPointXYZ* vi        = static_cast<g2o::VertexSBAPointXYZ*>(_vertices[0]);
@@ -150,7 +162,7 @@ void EdgeSE3ProjectXYZ::linearizeOplus() {
   double y = xyz_trans[1];
   double z = xyz_trans[2];
 
-  auto projectJac = -pCamera->projectJac(xyz_trans);
+  const Eigen::Matrix<double, 2, 3> projectJac = -Projection::ProjectJac(pCamera, xyz_trans);
 
   _jacobianOplusXi = projectJac * T.rotation().toRotationMatrix();
 
@@ -160,6 +172,10 @@ void EdgeSE3ProjectXYZ::linearizeOplus() {
   _jacobianOplusXj = projectJac * SE3deriv;
 }
 
+template void EdgeSE3ProjectXYZ::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeSE3ProjectXYZ::linearizeOplusAs<PinholeProjection>();
+template void EdgeSE3ProjectXYZ::linearizeOplusAs<KannalaBrandt8Projection>();
+
 EdgeSE3ProjectXYZToBody::EdgeSE3ProjectXYZToBody()
   : BaseBinaryEdge<2, Eigen::Vector2d, g2o::VertexSBAPointXYZ, g2o::VertexSE3Expmap>() {
 }
@@ -192,7 +208,8 @@ bool EdgeSE3ProjectXYZToBody::write(std::ostream& os) const {
   return os.good();
 }
 
-void EdgeSE3ProjectXYZToBody::linearizeOplus() {
+template <class Projection>
+void EdgeSE3ProjectXYZToBody::linearizeOplusAs() {
   g2o::VertexSE3Expmap*   vj = static_cast<g2o::VertexSE3Expmap*>(_vertices[1]);
   g2o::SE3Quat            T_lw(vj->estimate());
   g2o::SE3Quat            T_rw = mTrl * T_lw;
@@ -201,7 +218,9 @@ void EdgeSE3ProjectXYZToBody::linearizeOplus() {
   Eigen::Vector3d         X_l  = T_lw.map(X_w);
   Eigen::Vector3d         X_r  = mTrl.map(T_lw.map(X_w));
 
-  _jacobianOplusXi = -pCamera->projectJac(X_r) * T_rw.rotation().toRotationMatrix();
+  const Eigen::Matrix<double, 2, 3> projectJac = -Projection::ProjectJac(pCamera, X_r);
+
+  _jacobianOplusXi = projectJac * T_rw.rotation().toRotationMatrix();
 
   double x = X_l[0];
   double y = X_l[1];
@@ -210,9 +229,13 @@ void EdgeSE3ProjectXYZToBody::linearizeOplus() {
   Eigen::Matrix<double, 3, 6> SE3deriv;
   SE3deriv << 0.f, z, -y, 1.f, 0.f, 0.f, -z, 0.f, x, 0.f, 1.f, 0.f, y, -x, 0.f, 0.f, 0.f, 1.f;
 
-  _jacobianOplusXj = -pCamera->projectJac(X_r) * mTrl.rotation().toRotationMatrix() * SE3deriv;
+  _jacobianOplusXj = projectJac * mTrl.rotation().toRotationMatrix() * SE3deriv;
 }
 
+template void EdgeSE3ProjectXYZToBody::linearizeOplusAs<GeometricCameraProjection>();
+template void EdgeSE3ProjectXYZToBody::linearizeOplusAs<PinholeProjection>();
+template void EdgeSE3ProjectXYZToBody::linearizeOplusAs<KannalaBrandt8Projection>();
+
 VertexSim3Expmap::VertexSim3Expmap() : BaseVertex<7, g2o::Sim3>() {
   _marginalized = false;
   _fix_scale    = false;
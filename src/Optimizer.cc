@@ -19,7 +19,9 @@
 
 #include "Optimizer.h"
 #include <cmath>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <tuple>
 #include <utility>
@@ -30,25 +32,148 @@
 #include <Thirdparty/g2o/g2o/core/sparse_optimizer.h>
 #include <Thirdparty/g2o/g2o/solvers/linear_solver_dense.h>
 #include <Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h>
+#include <Thirdparty/g2o/g2o/solvers/linear_solver_pcg.h>
 #include <Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h>
 #include "Frame.h"
 #include "G2oTypes.h"
 #include "KeyFrame.h"
+#include "LocalBAGraph.h"
 #include "Map.h"
 #include "MapPoint.h"
 #include "OptimizableTypes.h"
+#include "PoseSolver.h"
+#include "ThreadPool.h"
 
 namespace ORB_SLAM3 {
+
+namespace {
+
+// Evaluate and linearize the edges of optimizer on the threads of pThreadPool, when there is more
+// than one
+void SetThreadPool(g2o::SparseOptimizer& optimizer, ThreadPool* pThreadPool) {
+  if (!pThreadPool || pThreadPool->NumThreads() <= 1) {
+    return;
+  }
+
+  optimizer.setParallelFor(
+    pThreadPool->NumThreads(),
+    [pThreadPool](int begin, int end, const std::function<void(int)>& fn) {
+      pThreadPool->ParallelFor(begin, end, fn);
+    }
+  );
+}
+
+// IMU state of pFrame
+PoseSolver::ImuState GetImuState(Frame* pFrame) {
+  PoseSolver::ImuState state;
+  state.Rwb = pFrame->GetImuRotation().cast<double>();
+  state.twb = pFrame->GetImuPosition().cast<double>();
+  state.v   = pFrame->GetVelocity().cast<double>();
+  state.bg << pFrame->mImuBias.bwx, pFrame->mImuBias.bwy, pFrame->mImuBias.bwz;
+  state.ba << pFrame->mImuBias.bax, pFrame->mImuBias.bay, pFrame->mImuBias.baz;
+  return state;
+}
+
+void SetImuState(Frame* pFrame, const PoseSolver::ImuState& state) {
+  pFrame->SetImuPoseVelocity(
+    state.Rwb.cast<float>(), state.twb.cast<float>(), state.v.cast<float>()
+  );
+  pFrame->mImuBias = IMU::Bias(
+    state.ba(0), state.ba(1), state.ba(2), state.bg(0), state.bg(1), state.bg(2)
+  );
+}
+
+// Cameras and observations of pFrame in pSolver for the inertial pose optimizations, whose
+// information accounts for the uncertainty of the camera. Returns the number of observations.
+int SetInertialObservations(Frame* pFrame, PoseSolver* pSolver) {
+  pSolver->Reset();
+  pSolver->SetCamera(pFrame->mpCamera);
+  if (pFrame->mpCamera2) {
+    pSolver->SetRightCamera(pFrame->mpCamera2, pFrame->GetRelativePoseTrl());
+  } else {
+    pSolver->SetStereoRig(pFrame->fx, pFrame->fy, pFrame->cx, pFrame->cy, pFrame->mbf);
+  }
+  pSolver->SetImuCalibration(pFrame->mImuCalib.mTcb);
+
+  const int  N      = pFrame->N;
+  const int  Nleft  = pFrame->Nleft;
+  const bool bRight = (Nleft != -1);
+
+  int nInitialCorrespondences = 0;
+
+  std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
+
+  for (int i = 0; i < N; i++) {
+    MapPoint* pMP = pFrame->mvpMapPoints[i];
+    if (pMP) {
+      nInitialCorrespondences++;
+      pFrame->mvbOutlier[i] = false;
+
+      const Eigen::Vector3f x3Dw   = pMP->GetWorldPos();
+      const bool            bClose = pMP->mTrackDepth < 10.f;
+
+      if ((!bRight && pFrame->mvuRight[i] < 0) || i < Nleft) { // Left monocular observation
+        const cv::KeyPoint&   kpUn = i < Nleft ? pFrame->mvKeys[i] : pFrame->mvKeysUn[i];
+        const Eigen::Vector2d obs(kpUn.pt.x, kpUn.pt.y);
+
+        // Add here uncerteinty
+        const float unc2      = pFrame->mpCamera->uncertainty2(obs);
+        const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
+        pSolver->AddMonocular(x3Dw, obs.cast<float>(), invSigma2, i, bClose);
+      } else if (!bRight) { // Stereo observation
+        const cv::KeyPoint&   kpUn = pFrame->mvKeysUn[i];
+        const Eigen::Vector2d obs(kpUn.pt.x, kpUn.pt.y);
+
+        // Add here uncerteinty
+        const float unc2      = pFrame->mpCamera->uncertainty2(obs);
+        const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
+        pSolver->AddStereo(
+          x3Dw, Eigen::Vector3f(kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i]), invSigma2, i
+        );
+      } else { // Right monocular observation
+        const cv::KeyPoint&   kpUn = pFrame->mvKeysRight[i - Nleft];
+        const Eigen::Vector2d obs(kpUn.pt.x, kpUn.pt.y);
+
+        // Add here uncerteinty
+        const float unc2      = pFrame->mpCamera->uncertainty2(obs);
+        const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
+        pSolver->AddRight(x3Dw, obs.cast<float>(), invSigma2, i, bClose);
+      }
+    }
+  }
+
+  return nInitialCorrespondences;
+}
+
+// Linear solver of type for the camera block of a BlockSolver
+template <class BlockSolver>
+typename BlockSolver::LinearSolverType* NewLinearSolver(Optimizer::eLinearSolver type) {
+  if (type == Optimizer::PCG) {
+    return new g2o::LinearSolverPCG<typename BlockSolver::PoseMatrixType>();
+  }
+  return new g2o::LinearSolverEigen<typename BlockSolver::PoseMatrixType>();
+}
+
+} // namespace
+
 bool sortByVal(const std::pair<MapPoint*, int>& a, const std::pair<MapPoint*, int>& b) {
   return (a.second < b.second);
 }
 
 void Optimizer::GlobalBundleAdjustemnt(
-  Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust
+  Map*                pMap,
+  int                 nIterations,
+  bool*               pbStopFlag,
+  const unsigned long nLoopKF,
+  const bool          bRobust,
+  ThreadPool*         pThreadPool,
+  eLinearSolver       linearSolverType
 ) {
   std::vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
   std::vector<MapPoint*> vpMP  = pMap->GetAllMapPoints();
-  BundleAdjustment(vpKFs, vpMP, nIterations, pbStopFlag, nLoopKF, bRobust);
+  BundleAdjustment(
+    vpKFs, vpMP, nIterations, pbStopFlag, nLoopKF, bRobust, pThreadPool, linearSolverType
+  );
 }
 
 void Optimizer::BundleAdjustment(
@@ -57,7 +182,9 @@ void Optimizer::BundleAdjustment(
   int                           nIterations,
   bool*                         pbStopFlag,
   const unsigned long           nLoopKF,
-  const bool                    bRobust
+  const bool                    bRobust,
+  ThreadPool*                   pThreadPool,
+  eLinearSolver                 linearSolverType
 ) {
   std::vector<bool> vbNotIncludedMP;
   vbNotIncludedMP.resize(vpMP.size());
@@ -67,13 +194,14 @@ void Optimizer::BundleAdjustment(
   g2o::SparseOptimizer                    optimizer;
   g2o::BlockSolver_6_3::LinearSolverType* linearSolver;
 
-  linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+  linearSolver = NewLinearSolver<g2o::BlockSolver_6_3>(linearSolverType);
 
   g2o::BlockSolver_6_3* solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
 
   g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
   optimizer.setAlgorithm(solver);
   optimizer.setVerbose(false);
+  SetThreadPool(optimizer, pThreadPool);
 
   if (pbStopFlag) {
     optimizer.setForceStopFlag(pbStopFlag);
@@ -170,7 +298,8 @@ void Optimizer::BundleAdjustment(
         Eigen::Matrix<double, 2, 1> obs;
         obs << kpUn.pt.x, kpUn.pt.y;
 
-        ORB_SLAM3::EdgeSE3ProjectXYZ* e = new ORB_SLAM3::EdgeSE3ProjectXYZ();
+        ORB_SLAM3::EdgeSE3ProjectXYZ* e
+          = NewCameraModelEdge<ORB_SLAM3::EdgeSE3ProjectXYZ>(pKF->mpCamera);
 
         e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
         e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKF->mnId)));
@@ -236,7 +365,8 @@ void Optimizer::BundleAdjustment(
           cv::KeyPoint                kp = pKF->mvKeysRight[rightIndex];
           obs << kp.pt.x, kp.pt.y;
 
-          ORB_SLAM3::EdgeSE3ProjectXYZToBody* e = new ORB_SLAM3::EdgeSE3ProjectXYZToBody();
+          ORB_SLAM3::EdgeSE3ProjectXYZToBody* e
+            = NewCameraModelEdge<ORB_SLAM3::EdgeSE3ProjectXYZToBody>(pKF->mpCamera2);
 
           e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
           e->setVertex(
@@ -385,7 +515,9 @@ void Optimizer::FullInertialBA(
   float                   priorG,
   float                   priorA,
   Eigen::VectorXd*        vSingVal,
-  bool*                   bHess
+  bool*                   bHess,
+  ThreadPool*             pThreadPool,
+  eLinearSolver           linearSolverType
 ) {
   long unsigned int            maxKFid = pMap->GetMaxKFid();
   const std::vector<KeyFrame*> vpKFs   = pMap->GetAllKeyFrames();
@@ -395,7 +527,7 @@ void Optimizer::FullInertialBA(
   g2o::SparseOptimizer                 optimizer;
   g2o::BlockSolverX::LinearSolverType* linearSolver;
 
-  linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+  linearSolver = NewLinearSolver<g2o::BlockSolverX>(linearSolverType);
 
   g2o::BlockSolverX* solver_ptr = new g2o::BlockSolverX(linearSolver);
 
@@ -403,6 +535,7 @@ void Optimizer::FullInertialBA(
   solver->setUserLambdaInit(1e-5);
   optimizer.setAlgorithm(solver);
   optimizer.setVerbose(false);
+  SetThreadPool(optimizer, pThreadPool);
 
   if (pbStopFlag) {
     optimizer.setForceStopFlag(pbStopFlag);
@@ -611,7 +744,7 @@ void Optimizer::FullInertialBA(
           Eigen::Matrix<double, 2, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y;
 
-          EdgeMono* e = new EdgeMono(0);
+          EdgeMono* e = NewCameraModelEdge<EdgeMono>(pKFi->mpCamera, 0);
 
           g2o::OptimizableGraph::Vertex* VP
             = dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId));
@@ -639,7 +772,7 @@ void Optimizer::FullInertialBA(
           Eigen::Matrix<double, 3, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-          EdgeStereo* e = new EdgeStereo(0);
+          EdgeStereo* e = NewCameraModelEdge<EdgeStereo>(pKFi->mpCamera, 0);
 
           g2o::OptimizableGraph::Vertex* VP
             = dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId));
@@ -673,7 +806,7 @@ void Optimizer::FullInertialBA(
             kpUn = pKFi->mvKeysRight[rightIndex];
             obs << kpUn.pt.x, kpUn.pt.y;
 
-            EdgeMono* e = new EdgeMono(1);
+            EdgeMono* e = NewCameraModelEdge<EdgeMono>(pKFi->mpCamera2, 1);
 
             g2o::OptimizableGraph::Vertex* VP
               = dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId));
@@ -782,178 +915,59 @@ void Optimizer::FullInertialBA(
   pMap->IncreaseChangeIndex();
 }
 
-int Optimizer::PoseOptimization(Frame* pFrame) {
-  g2o::SparseOptimizer                    optimizer;
-  g2o::BlockSolver_6_3::LinearSolverType* linearSolver;
-
-  linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-  g2o::BlockSolver_6_3* solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-  g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-  optimizer.setAlgorithm(solver);
+int Optimizer::PoseOptimization(Frame* pFrame, PoseSolver* pSolver) {
+  std::unique_ptr<PoseSolver> pFrameSolver;
+  if (!pSolver) {
+    pFrameSolver = std::make_unique<PoseSolver>();
+    pSolver      = pFrameSolver.get();
+  }
+  pSolver->Reset();
+  pSolver->SetCamera(pFrame->mpCamera);
+  if (pFrame->mpCamera2) {
+    pSolver->SetRightCamera(pFrame->mpCamera2, pFrame->GetRelativePoseTrl());
+  } else {
+    pSolver->SetStereoRig(pFrame->fx, pFrame->fy, pFrame->cx, pFrame->cy, pFrame->mbf);
+  }
 
   int nInitialCorrespondences = 0;
 
-  // Set Frame vertex
-  g2o::VertexSE3Expmap* vSE3 = new g2o::VertexSE3Expmap();
-  Sophus::SE3<float>    Tcw  = pFrame->GetPose();
-  vSE3->setEstimate(
-    g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>())
-  );
-  vSE3->setId(0);
-  vSE3->setFixed(false);
-  optimizer.addVertex(vSE3);
-
-  // Set MapPoint vertices
+  // Set MapPoint observations
   const int N = pFrame->N;
 
-  std::vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose*>       vpEdgesMono;
-  std::vector<ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody*> vpEdgesMono_FHR;
-  std::vector<std::size_t>                                 vnIndexEdgeMono, vnIndexEdgeRight;
-  vpEdgesMono.reserve(N);
-  vpEdgesMono_FHR.reserve(N);
-  vnIndexEdgeMono.reserve(N);
-  vnIndexEdgeRight.reserve(N);
-
-  std::vector<g2o::EdgeStereoSE3ProjectXYZOnlyPose*> vpEdgesStereo;
-  std::vector<std::size_t>                           vnIndexEdgeStereo;
-  vpEdgesStereo.reserve(N);
-  vnIndexEdgeStereo.reserve(N);
-
-  const float deltaMono   = std::sqrt(5.991);
-  const float deltaStereo = std::sqrt(7.815);
-
   {
     std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
 
     for (int i = 0; i < N; i++) {
       MapPoint* pMP = pFrame->mvpMapPoints[i];
       if (pMP) {
+        nInitialCorrespondences++;
+        pFrame->mvbOutlier[i] = false;
+
+        const Eigen::Vector3f x3Dw = pMP->GetWorldPos();
+
         // Conventional SLAM
         if (!pFrame->mpCamera2) {
+          const cv::KeyPoint& kpUn      = pFrame->mvKeysUn[i];
+          const float         invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
           if (pFrame->mvuRight[i] < 0) { // Monocular observation
-            nInitialCorrespondences++;
-            pFrame->mvbOutlier[i] = false;
-
-            Eigen::Matrix<double, 2, 1> obs;
-            const cv::KeyPoint&         kpUn = pFrame->mvKeysUn[i];
-            obs << kpUn.pt.x, kpUn.pt.y;
-
-            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose* e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-            e->setMeasurement(obs);
-            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(deltaMono);
-
-            e->pCamera = pFrame->mpCamera;
-            e->Xw      = pMP->GetWorldPos().cast<double>();
-
-            optimizer.addEdge(e);
-
-            vpEdgesMono.push_back(e);
-            vnIndexEdgeMono.push_back(i);
+            pSolver->AddMonocular(x3Dw, Eigen::Vector2f(kpUn.pt.x, kpUn.pt.y), invSigma2, i);
           } else { // Stereo observation
-            nInitialCorrespondences++;
-            pFrame->mvbOutlier[i] = false;
-
-            Eigen::Matrix<double, 3, 1> obs;
-            const cv::KeyPoint&         kpUn  = pFrame->mvKeysUn[i];
-            const float&                kp_ur = pFrame->mvuRight[i];
-            obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
-
-            g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
-
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-            e->setMeasurement(obs);
-            const float     invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-            Eigen::Matrix3d Info      = Eigen::Matrix3d::Identity() * invSigma2;
-            e->setInformation(Info);
-
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(deltaStereo);
-
-            e->fx = pFrame->fx;
-            e->fy = pFrame->fy;
-            e->cx = pFrame->cx;
-            e->cy = pFrame->cy;
-            e->bf = pFrame->mbf;
-            e->Xw = pMP->GetWorldPos().cast<double>();
-
-            optimizer.addEdge(e);
-
-            vpEdgesStereo.push_back(e);
-            vnIndexEdgeStereo.push_back(i);
+            pSolver->AddStereo(
+              x3Dw,
+              Eigen::Vector3f(kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i]),
+              invSigma2,
+              i
+            );
           }
         } else { // SLAM with respect a rigid body
-          nInitialCorrespondences++;
-
-          cv::KeyPoint kpUn;
-
           if (i < pFrame->Nleft) { // Left camera observation
-            kpUn = pFrame->mvKeys[i];
-
-            pFrame->mvbOutlier[i] = false;
-
-            Eigen::Matrix<double, 2, 1> obs;
-            obs << kpUn.pt.x, kpUn.pt.y;
-
-            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose* e = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose();
-
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-            e->setMeasurement(obs);
-            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(deltaMono);
-
-            e->pCamera = pFrame->mpCamera;
-            e->Xw      = pMP->GetWorldPos().cast<double>();
-
-            optimizer.addEdge(e);
-
-            vpEdgesMono.push_back(e);
-            vnIndexEdgeMono.push_back(i);
+            const cv::KeyPoint& kp        = pFrame->mvKeys[i];
+            const float         invSigma2 = pFrame->mvInvLevelSigma2[kp.octave];
+            pSolver->AddMonocular(x3Dw, Eigen::Vector2f(kp.pt.x, kp.pt.y), invSigma2, i);
           } else {
-            kpUn = pFrame->mvKeysRight[i - pFrame->Nleft];
-
-            Eigen::Matrix<double, 2, 1> obs;
-            obs << kpUn.pt.x, kpUn.pt.y;
-
-            pFrame->mvbOutlier[i] = false;
-
-            ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody* e
-              = new ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody();
-
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(0)));
-            e->setMeasurement(obs);
-            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
-            e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(deltaMono);
-
-            e->pCamera = pFrame->mpCamera2;
-            e->Xw      = pMP->GetWorldPos().cast<double>();
-
-            e->mTrl = g2o::SE3Quat(
-              pFrame->GetRelativePoseTrl().unit_quaternion().cast<double>(),
-              pFrame->GetRelativePoseTrl().translation().cast<double>()
-            );
-
-            optimizer.addEdge(e);
-
-            vpEdgesMono_FHR.push_back(e);
-            vnIndexEdgeRight.push_back(i);
+            const cv::KeyPoint& kp        = pFrame->mvKeysRight[i - pFrame->Nleft];
+            const float         invSigma2 = pFrame->mvInvLevelSigma2[kp.octave];
+            pSolver->AddRight(x3Dw, Eigen::Vector2f(kp.pt.x, kp.pt.y), invSigma2, i);
           }
         }
       }
@@ -967,121 +981,25 @@ int Optimizer::PoseOptimization(Frame* pFrame) {
   // We perform 4 optimizations, after each optimization we classify observation as inlier/outlier
   // At the next optimization, outliers are not included, but at the end they can be classified as
   // inliers again.
-  const float chi2Mono[4]   = {5.991, 5.991, 5.991, 5.991};
-  const float chi2Stereo[4] = {7.815, 7.815, 7.815, 7.815};
-  const int   its[4]        = {10, 10, 10, 10};
-
-  int nBad = 0;
-  for (std::size_t it = 0; it < 4; it++) {
-    Tcw = pFrame->GetPose();
-    vSE3->setEstimate(
-      g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>())
-    );
-
-    optimizer.initializeOptimization(0);
-    optimizer.optimize(its[it]);
-
-    nBad = 0;
-    for (std::size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
-      ORB_SLAM3::EdgeSE3ProjectXYZOnlyPose* e = vpEdgesMono[i];
-
-      const std::size_t idx = vnIndexEdgeMono[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if (chi2 > chi2Mono[it]) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBad++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    for (std::size_t i = 0, iend = vpEdgesMono_FHR.size(); i < iend; i++) {
-      ORB_SLAM3::EdgeSE3ProjectXYZOnlyPoseToBody* e = vpEdgesMono_FHR[i];
-
-      const std::size_t idx = vnIndexEdgeRight[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if (chi2 > chi2Mono[it]) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBad++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    for (std::size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
-      g2o::EdgeStereoSE3ProjectXYZOnlyPose* e = vpEdgesStereo[i];
-
-      const std::size_t idx = vnIndexEdgeStereo[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if (chi2 > chi2Stereo[it]) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBad++;
-      } else {
-        e->setLevel(0);
-        pFrame->mvbOutlier[idx] = false;
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    if (optimizer.edges().size() < 10) {
-      break;
-    }
-  }
+  Sophus::SE3f Tcw  = pFrame->GetPose();
+  const int    nBad = pSolver->Optimize(Tcw, pFrame->mvbOutlier);
 
   // Recover optimized pose and return number of inliers
-  g2o::VertexSE3Expmap* vSE3_recov    = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(0));
-  g2o::SE3Quat          SE3quat_recov = vSE3_recov->estimate();
-  Sophus::SE3<float>    pose(
-    SE3quat_recov.rotation().cast<float>(),
-    SE3quat_recov.translation().cast<float>()
-  );
-  pFrame->SetPose(pose);
+  pFrame->SetPose(Tcw);
 
   return nInitialCorrespondences - nBad;
 }
 
 void Optimizer::LocalBundleAdjustment(
-  KeyFrame* pKF,
-  bool*     pbStopFlag,
-  Map*      pMap,
-  int&      num_fixedKF,
-  int&      num_OptKF,
-  int&      num_MPs,
-  int&      num_edges
+  KeyFrame*     pKF,
+  bool*         pbStopFlag,
+  Map*          pMap,
+  int&          num_fixedKF,
+  int&          num_OptKF,
+  int&          num_MPs,
+  int&          num_edges,
+  ThreadPool*   pThreadPool,
+  LocalBAGraph* pGraph
 ) {
   // Local KeyFrames: First Breath Search from Current Keyframe
   std::list<KeyFrame*> lLocalKeyFrames;
@@ -1152,27 +1070,22 @@ void Optimizer::LocalBundleAdjustment(
     return;
   }
 
-  // Setup optimizer
-  g2o::SparseOptimizer                    optimizer;
-  g2o::BlockSolver_6_3::LinearSolverType* linearSolver;
-
-  linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-  g2o::BlockSolver_6_3* solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-  g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-  if (pMap->IsInertial()) {
-    solver->setUserLambdaInit(100.0);
+  // Setup optimizer, on the graph of the previous windows when given
+  std::unique_ptr<LocalBAGraph> pWindowGraph;
+  if (!pGraph) {
+    pWindowGraph = std::make_unique<LocalBAGraph>();
+    pGraph       = pWindowGraph.get();
   }
+  g2o::SparseOptimizer& optimizer = pGraph->Optimizer();
 
-  optimizer.setAlgorithm(solver);
-  optimizer.setVerbose(false);
+  g2o::OptimizationAlgorithmLevenberg* solver
+    = static_cast<g2o::OptimizationAlgorithmLevenberg*>(optimizer.solver());
+  solver->setUserLambdaInit(pMap->IsInertial() ? 100.0 : 0.0);
 
-  if (pbStopFlag) {
-    optimizer.setForceStopFlag(pbStopFlag);
-  }
+  SetThreadPool(optimizer, pThreadPool);
+  optimizer.setForceStopFlag(pbStopFlag);
 
-  unsigned long maxKFid = 0;
+  pGraph->BeginWindow();
 
   // DEBUG LBA
   pCurrentMap->msOptKFs.clear();
@@ -1183,17 +1096,12 @@ void Optimizer::LocalBundleAdjustment(
        lit != lend;
        lit++) {
     KeyFrame*             pKFi = *lit;
-    g2o::VertexSE3Expmap* vSE3 = new g2o::VertexSE3Expmap();
+    g2o::VertexSE3Expmap* vSE3 = pGraph->KeyFrameVertex(pKFi->mnId);
     Sophus::SE3<float>    Tcw  = pKFi->GetPose();
     vSE3->setEstimate(
       g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>())
     );
-    vSE3->setId(pKFi->mnId);
     vSE3->setFixed(pKFi->mnId == pMap->GetInitKFid());
-    optimizer.addVertex(vSE3);
-    if (pKFi->mnId > maxKFid) {
-      maxKFid = pKFi->mnId;
-    }
     // DEBUG LBA
     pCurrentMap->msOptKFs.insert(pKFi->mnId);
   }
@@ -1204,17 +1112,12 @@ void Optimizer::LocalBundleAdjustment(
        lit != lend;
        lit++) {
     KeyFrame*             pKFi = *lit;
-    g2o::VertexSE3Expmap* vSE3 = new g2o::VertexSE3Expmap();
+    g2o::VertexSE3Expmap* vSE3 = pGraph->KeyFrameVertex(pKFi->mnId);
     Sophus::SE3<float>    Tcw  = pKFi->GetPose();
     vSE3->setEstimate(
       g2o::SE3Quat(Tcw.unit_quaternion().cast<double>(), Tcw.translation().cast<double>())
     );
-    vSE3->setId(pKFi->mnId);
     vSE3->setFixed(true);
-    optimizer.addVertex(vSE3);
-    if (pKFi->mnId > maxKFid) {
-      maxKFid = pKFi->mnId;
-    }
     // DEBUG LBA
     pCurrentMap->msFixedKFs.insert(pKFi->mnId);
   }
@@ -1261,12 +1164,8 @@ void Optimizer::LocalBundleAdjustment(
        lit != lend;
        lit++) {
     MapPoint*               pMP    = *lit;
-    g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+    g2o::VertexSBAPointXYZ* vPoint = pGraph->MapPointVertex(pMP->mnId);
     vPoint->setEstimate(pMP->GetWorldPos().cast<double>());
-    int id = pMP->mnId + maxKFid + 1;
-    vPoint->setId(id);
-    vPoint->setMarginalized(true);
-    optimizer.addVertex(vPoint);
     nPoints++;
 
     const std::map<KeyFrame*, std::tuple<int, int>> observations = pMP->GetObservations();
@@ -1279,7 +1178,8 @@ void Optimizer::LocalBundleAdjustment(
       KeyFrame* pKFi = mit->first;
 
       if (!pKFi->isBad() && pKFi->GetMap() == pCurrentMap) {
-        const int leftIndex = std::get<0>(mit->second);
+        g2o::VertexSE3Expmap* vSE3      = pGraph->KeyFrameVertex(pKFi->mnId);
+        const int             leftIndex = std::get<0>(mit->second);
 
         // Monocular observation
         if (leftIndex != -1 && pKFi->mvuRight[std::get<0>(mit->second)] < 0) {
@@ -1287,24 +1187,16 @@ void Optimizer::LocalBundleAdjustment(
           Eigen::Matrix<double, 2, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y;
 
-          ORB_SLAM3::EdgeSE3ProjectXYZ* e = new ORB_SLAM3::EdgeSE3ProjectXYZ();
+          ORB_SLAM3::EdgeSE3ProjectXYZ* e = pGraph->MonocularEdge(vPoint, vSE3, pKFi->mpCamera);
 
-          e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-          e->setVertex(
-            1,
-            dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-          );
           e->setMeasurement(obs);
           const float& invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
           e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
+          e->robustKernel()->setDelta(thHuberMono);
 
           e->pCamera = pKFi->mpCamera;
 
-          optimizer.addEdge(e);
           vpEdgesMono.push_back(e);
           vpEdgeKFMono.push_back(pKFi);
           vpMapPointEdgeMono.push_back(pMP);
@@ -1317,21 +1209,14 @@ void Optimizer::LocalBundleAdjustment(
           const float                 kp_ur = pKFi->mvuRight[std::get<0>(mit->second)];
           obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-          g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+          g2o::EdgeStereoSE3ProjectXYZ* e = pGraph->StereoEdge(vPoint, vSE3);
 
-          e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-          e->setVertex(
-            1,
-            dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-          );
           e->setMeasurement(obs);
           const float&    invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
           Eigen::Matrix3d Info      = Eigen::Matrix3d::Identity() * invSigma2;
           e->setInformation(Info);
 
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberStereo);
+          e->robustKernel()->setDelta(thHuberStereo);
 
           e->fx = pKFi->fx;
           e->fy = pKFi->fy;
@@ -1339,7 +1224,6 @@ void Optimizer::LocalBundleAdjustment(
           e->cy = pKFi->cy;
           e->bf = pKFi->mbf;
 
-          optimizer.addEdge(e);
           vpEdgesStereo.push_back(e);
           vpEdgeKFStereo.push_back(pKFi);
           vpMapPointEdgeStereo.push_back(pMP);
@@ -1357,20 +1241,14 @@ void Optimizer::LocalBundleAdjustment(
             cv::KeyPoint                kp = pKFi->mvKeysRight[rightIndex];
             obs << kp.pt.x, kp.pt.y;
 
-            ORB_SLAM3::EdgeSE3ProjectXYZToBody* e = new ORB_SLAM3::EdgeSE3ProjectXYZToBody();
+            ORB_SLAM3::EdgeSE3ProjectXYZToBody* e
+              = pGraph->RightEdge(vPoint, vSE3, pKFi->mpCamera2);
 
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-            e->setVertex(
-              1,
-              dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-            );
             e->setMeasurement(obs);
             const float& invSigma2 = pKFi->mvInvLevelSigma2[kp.octave];
             e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(thHuberMono);
+            e->robustKernel()->setDelta(thHuberMono);
 
             Sophus::SE3f Trl = pKFi->GetRelativePoseTrl();
             e->mTrl          = g2o::SE3Quat(
@@ -1380,7 +1258,6 @@ void Optimizer::LocalBundleAdjustment(
 
             e->pCamera = pKFi->mpCamera2;
 
-            optimizer.addEdge(e);
             vpEdgesBody.push_back(e);
             vpEdgeKFBody.push_back(pKFi);
             vpMapPointEdgeBody.push_back(pMP);
@@ -1393,6 +1270,8 @@ void Optimizer::LocalBundleAdjustment(
   }
   num_edges = nEdges;
 
+  pGraph->EndWindow();
+
   if (pbStopFlag) {
     if (*pbStopFlag) {
       return;
@@ -1465,8 +1344,8 @@ void Optimizer::LocalBundleAdjustment(
   for (std::list<KeyFrame*>::iterator lit = lLocalKeyFrames.begin(), lend = lLocalKeyFrames.end();
        lit != lend;
        lit++) {
-    KeyFrame*             pKFi = *lit;
-    g2o::VertexSE3Expmap* vSE3 = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(pKFi->mnId));
+    KeyFrame*             pKFi    = *lit;
+    g2o::VertexSE3Expmap* vSE3    = pGraph->KeyFrameVertex(pKFi->mnId);
     g2o::SE3Quat          SE3quat = vSE3->estimate();
     Sophus::SE3f Tiw(SE3quat.rotation().cast<float>(), SE3quat.translation().cast<float>());
     pKFi->SetPose(Tiw);
@@ -1476,9 +1355,8 @@ void Optimizer::LocalBundleAdjustment(
   for (std::list<MapPoint*>::iterator lit = lLocalMapPoints.begin(), lend = lLocalMapPoints.end();
        lit != lend;
        lit++) {
-    MapPoint*               pMP = *lit;
-    g2o::VertexSBAPointXYZ* vPoint
-      = static_cast<g2o::VertexSBAPointXYZ*>(optimizer.vertex(pMP->mnId + maxKFid + 1));
+    MapPoint*               pMP    = *lit;
+    g2o::VertexSBAPointXYZ* vPoint = pGraph->MapPointVertex(pMP->mnId);
     pMP->SetWorldPos(vPoint->estimate().cast<float>());
     pMP->UpdateNormalAndDepth();
   }
@@ -2369,15 +2247,17 @@ int Optimizer::OptimizeSim3(
 }
 
 void Optimizer::LocalInertialBA(
-  KeyFrame* pKF,
-  bool*     pbStopFlag,
-  Map*      pMap,
-  int&      num_fixedKF,
-  int&      num_OptKF,
-  int&      num_MPs,
-  int&      num_edges,
-  bool      bLarge,
-  bool      bRecInit
+  KeyFrame*             pKF,
+  bool*                 pbStopFlag,
+  Map*                  pMap,
+  int&                  num_fixedKF,
+  int&                  num_OptKF,
+  int&                  num_MPs,
+  int&                  num_edges,
+  bool                  bLarge,
+  bool                  bRecInit,
+  ThreadPool*           pThreadPool,
+  LocalInertialBAGraph* pGraph
 ) {
   Map* pCurrentMap = pKF->GetMap();
 
@@ -2387,8 +2267,7 @@ void Optimizer::LocalInertialBA(
     maxOpt = 25;
     opt_it = 4;
   }
-  const int           Nd      = std::min((int)pCurrentMap->KeyFramesInMap() - 2, maxOpt);
-  const unsigned long maxKFid = pKF->mnId;
+  const int Nd = std::min((int)pCurrentMap->KeyFramesInMap() - 2, maxOpt);
 
   std::vector<KeyFrame*>       vpOptimizableKFs;
   const std::vector<KeyFrame*> vpNeighsKFs = pKF->GetVectorCovisibleKeyFrames();
@@ -2497,87 +2376,60 @@ void Optimizer::LocalInertialBA(
 
   bool bNonFixed = (lFixedKeyFrames.size() == 0);
 
-  // Setup optimizer
-  g2o::SparseOptimizer                 optimizer;
-  g2o::BlockSolverX::LinearSolverType* linearSolver;
-  linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>();
+  // Setup optimizer, on the graph of the previous windows when given
+  std::unique_ptr<LocalInertialBAGraph> pWindowGraph;
+  if (!pGraph) {
+    pWindowGraph = std::make_unique<LocalInertialBAGraph>();
+    pGraph       = pWindowGraph.get();
+  }
+  g2o::SparseOptimizer& optimizer = pGraph->Optimizer();
 
-  g2o::BlockSolverX* solver_ptr = new g2o::BlockSolverX(linearSolver);
+  g2o::OptimizationAlgorithmLevenberg* solver
+    = static_cast<g2o::OptimizationAlgorithmLevenberg*>(optimizer.solver());
+  // 1e-2 when large to avoid iterating for finding optimal lambda
+  solver->setUserLambdaInit(bLarge ? 1e-2 : 1e0);
+  SetThreadPool(optimizer, pThreadPool);
 
-  if (bLarge) {
-    g2o::OptimizationAlgorithmLevenberg* solver
-      = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    solver->setUserLambdaInit(1e-2); // to avoid iterating for finding optimal lambda
-    optimizer.setAlgorithm(solver);
-  } else {
-    g2o::OptimizationAlgorithmLevenberg* solver
-      = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    solver->setUserLambdaInit(1e0);
-    optimizer.setAlgorithm(solver);
-  }
+  pGraph->BeginWindow();
+
+  // Set KeyFrame vertices: pose, and velocity and biases with IMU
+  const auto setKeyFrameVertices = [pGraph](KeyFrame* pKFi, const bool bFixed, const bool bImu) {
+    VertexPose* VP = pGraph->PoseVertex(pKFi->mnId);
+    VP->setEstimate(ImuCamPose(pKFi));
+    VP->setFixed(bFixed);
+
+    if (bImu) {
+      VertexVelocity* VV = pGraph->VelocityVertex(pKFi->mnId);
+      VV->setEstimate(pKFi->GetVelocity().cast<double>());
+      VV->setFixed(bFixed);
+      VertexGyroBias* VG = pGraph->GyroBiasVertex(pKFi->mnId);
+      VG->setEstimate(pKFi->GetGyroBias().cast<double>());
+      VG->setFixed(bFixed);
+      VertexAccBias* VA = pGraph->AccBiasVertex(pKFi->mnId);
+      VA->setEstimate(pKFi->GetAccBias().cast<double>());
+      VA->setFixed(bFixed);
+    }
+  };
 
   // Set Local temporal KeyFrame vertices
   N = vpOptimizableKFs.size();
   for (int i = 0; i < N; i++) {
-    KeyFrame* pKFi = vpOptimizableKFs[i];
-
-    VertexPose* VP = new VertexPose(pKFi);
-    VP->setId(pKFi->mnId);
-    VP->setFixed(false);
-    optimizer.addVertex(VP);
-
-    if (pKFi->bImu) {
-      VertexVelocity* VV = new VertexVelocity(pKFi);
-      VV->setId(maxKFid + 3 * (pKFi->mnId) + 1);
-      VV->setFixed(false);
-      optimizer.addVertex(VV);
-      VertexGyroBias* VG = new VertexGyroBias(pKFi);
-      VG->setId(maxKFid + 3 * (pKFi->mnId) + 2);
-      VG->setFixed(false);
-      optimizer.addVertex(VG);
-      VertexAccBias* VA = new VertexAccBias(pKFi);
-      VA->setId(maxKFid + 3 * (pKFi->mnId) + 3);
-      VA->setFixed(false);
-      optimizer.addVertex(VA);
-    }
-  }
+    setKeyFrameVertices(vpOptimizableKFs[i], false, vpOptimizableKFs[i]->bImu);
+  }
 
   // Set Local visual KeyFrame vertices
   for (std::list<KeyFrame*>::iterator it = lpOptVisKFs.begin(), itEnd = lpOptVisKFs.end();
        it != itEnd;
        it++) {
-    KeyFrame*   pKFi = *it;
-    VertexPose* VP   = new VertexPose(pKFi);
-    VP->setId(pKFi->mnId);
-    VP->setFixed(false);
-    optimizer.addVertex(VP);
+    setKeyFrameVertices(*it, false, false);
   }
 
   // Set Fixed KeyFrame vertices
   for (std::list<KeyFrame*>::iterator lit = lFixedKeyFrames.begin(), lend = lFixedKeyFrames.end();
        lit != lend;
        lit++) {
-    KeyFrame*   pKFi = *lit;
-    VertexPose* VP   = new VertexPose(pKFi);
-    VP->setId(pKFi->mnId);
-    VP->setFixed(true);
-    optimizer.addVertex(VP);
-
-    if (pKFi->bImu) // This should be done only for keyframe just before temporal window
-    {
-      VertexVelocity* VV = new VertexVelocity(pKFi);
-      VV->setId(maxKFid + 3 * (pKFi->mnId) + 1);
-      VV->setFixed(true);
-      optimizer.addVertex(VV);
-      VertexGyroBias* VG = new VertexGyroBias(pKFi);
-      VG->setId(maxKFid + 3 * (pKFi->mnId) + 2);
-      VG->setFixed(true);
-      optimizer.addVertex(VG);
-      VertexAccBias* VA = new VertexAccBias(pKFi);
-      VA->setId(maxKFid + 3 * (pKFi->mnId) + 3);
-      VA->setFixed(true);
-      optimizer.addVertex(VA);
-    }
+    // Inertial vertices should be set only for keyframe just before temporal window
+    setKeyFrameVertices(*lit, true, (*lit)->bImu);
   }
 
   // Create intertial constraints
@@ -2594,27 +2446,12 @@ void Optimizer::LocalInertialBA(
     }
     if (pKFi->bImu && pKFi->mPrevKF->bImu && pKFi->mpImuPreintegrated) {
       pKFi->mpImuPreintegrated->SetNewBias(pKFi->mPrevKF->GetImuBias());
-      g2o::HyperGraph::Vertex* VP1 = optimizer.vertex(pKFi->mPrevKF->mnId);
-      g2o::HyperGraph::Vertex* VV1 = optimizer.vertex(maxKFid + 3 * (pKFi->mPrevKF->mnId) + 1);
-      g2o::HyperGraph::Vertex* VG1 = optimizer.vertex(maxKFid + 3 * (pKFi->mPrevKF->mnId) + 2);
-      g2o::HyperGraph::Vertex* VA1 = optimizer.vertex(maxKFid + 3 * (pKFi->mPrevKF->mnId) + 3);
-      g2o::HyperGraph::Vertex* VP2 = optimizer.vertex(pKFi->mnId);
-      g2o::HyperGraph::Vertex* VV2 = optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 1);
-      g2o::HyperGraph::Vertex* VG2 = optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 2);
-      g2o::HyperGraph::Vertex* VA2 = optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 3);
-
-      if (!VP1 || !VV1 || !VG1 || !VA1 || !VP2 || !VV2 || !VG2 || !VA2) {
+      if (!pGraph->HasInertialVertices(pKFi->mPrevKF->mnId)
+          || !pGraph->HasInertialVertices(pKFi->mnId)) {
         continue;
       }
 
-      vei[i] = new EdgeInertial(pKFi->mpImuPreintegrated);
-
-      vei[i]->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VP1));
-      vei[i]->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VV1));
-      vei[i]->setVertex(2, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VG1));
-      vei[i]->setVertex(3, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VA1));
-      vei[i]->setVertex(4, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VP2));
-      vei[i]->setVertex(5, dynamic_cast<g2o::OptimizableGraph::Vertex*>(VV2));
+      vei[i] = pGraph->InertialEdge(pKFi->mPrevKF->mnId, pKFi->mnId, pKFi->mpImuPreintegrated);
 
       if (i == N - 1 || bRecInit) {
         // All inertial residuals are included without robust cost function, but not that one
@@ -2628,24 +2465,16 @@ void Optimizer::LocalInertialBA(
         }
         rki->setDelta(std::sqrt(16.92));
       }
-      optimizer.addEdge(vei[i]);
 
-      vegr[i] = new EdgeGyroRW();
-      vegr[i]->setVertex(0, VG1);
-      vegr[i]->setVertex(1, VG2);
+      vegr[i] = pGraph->GyroRandomWalkEdge(pKFi->mPrevKF->mnId, pKFi->mnId);
       Eigen::Matrix3d InfoG
         = pKFi->mpImuPreintegrated->C.block<3, 3>(9, 9).cast<double>().inverse();
       vegr[i]->setInformation(InfoG);
-      optimizer.addEdge(vegr[i]);
 
-      vear[i] = new EdgeAccRW();
-      vear[i]->setVertex(0, VA1);
-      vear[i]->setVertex(1, VA2);
+      vear[i] = pGraph->AccRandomWalkEdge(pKFi->mPrevKF->mnId, pKFi->mnId);
       Eigen::Matrix3d InfoA
         = pKFi->mpImuPreintegrated->C.block<3, 3>(12, 12).cast<double>().inverse();
       vear[i]->setInformation(InfoA);
-
-      optimizer.addEdge(vear[i]);
     } else {
       // (error) faile to build inertial edge.
     }
@@ -2679,8 +2508,6 @@ void Optimizer::LocalInertialBA(
   const float thHuberStereo = std::sqrt(7.815);
   const float chi2Stereo2   = 7.815;
 
-  const unsigned long iniMPid = maxKFid * 5;
-
   std::map<int, int> mVisEdges;
   for (int i = 0; i < N; i++) {
     KeyFrame* pKFi        = vpOptimizableKFs[i];
@@ -2696,13 +2523,8 @@ void Optimizer::LocalInertialBA(
        lit != lend;
        lit++) {
     MapPoint*               pMP    = *lit;
-    g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+    g2o::VertexSBAPointXYZ* vPoint = pGraph->MapPointVertex(pMP->mnId);
     vPoint->setEstimate(pMP->GetWorldPos().cast<double>());
-
-    unsigned long id = pMP->mnId + iniMPid + 1;
-    vPoint->setId(id);
-    vPoint->setMarginalized(true);
-    optimizer.addVertex(vPoint);
     const std::map<KeyFrame*, std::tuple<int, int>> observations = pMP->GetObservations();
 
     // Create visual constraints
@@ -2717,7 +2539,8 @@ void Optimizer::LocalInertialBA(
       }
 
       if (!pKFi->isBad() && pKFi->GetMap() == pCurrentMap) {
-        const int leftIndex = std::get<0>(mit->second);
+        VertexPose* VP        = pGraph->PoseVertex(pKFi->mnId);
+        const int   leftIndex = std::get<0>(mit->second);
 
         cv::KeyPoint kpUn;
 
@@ -2728,13 +2551,7 @@ void Optimizer::LocalInertialBA(
           Eigen::Matrix<double, 2, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y;
 
-          EdgeMono* e = new EdgeMono(0);
-
-          e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-          e->setVertex(
-            1,
-            dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-          );
+          EdgeMono* e = pGraph->MonocularEdge(vPoint, VP, pKFi->mpCamera);
           e->setMeasurement(obs);
 
           // Add here uncerteinty
@@ -2743,11 +2560,8 @@ void Optimizer::LocalInertialBA(
           const float& invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave] / unc2;
           e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
+          e->robustKernel()->setDelta(thHuberMono);
 
-          optimizer.addEdge(e);
           vpEdgesMono.push_back(e);
           vpEdgeKFMono.push_back(pKFi);
           vpMapPointEdgeMono.push_back(pMP);
@@ -2759,13 +2573,7 @@ void Optimizer::LocalInertialBA(
           Eigen::Matrix<double, 3, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-          EdgeStereo* e = new EdgeStereo(0);
-
-          e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-          e->setVertex(
-            1,
-            dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-          );
+          EdgeStereo* e = pGraph->StereoEdge(vPoint, VP, pKFi->mpCamera);
           e->setMeasurement(obs);
 
           // Add here uncerteinty
@@ -2774,11 +2582,8 @@ void Optimizer::LocalInertialBA(
           const float& invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave] / unc2;
           e->setInformation(Eigen::Matrix3d::Identity() * invSigma2);
 
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberStereo);
+          e->robustKernel()->setDelta(thHuberStereo);
 
-          optimizer.addEdge(e);
           vpEdgesStereo.push_back(e);
           vpEdgeKFStereo.push_back(pKFi);
           vpMapPointEdgeStereo.push_back(pMP);
@@ -2795,13 +2600,7 @@ void Optimizer::LocalInertialBA(
             cv::KeyPoint                kp = pKFi->mvKeysRight[rightIndex];
             obs << kp.pt.x, kp.pt.y;
 
-            EdgeMono* e = new EdgeMono(1);
-
-            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-            e->setVertex(
-              1,
-              dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId))
-            );
+            EdgeMono* e = pGraph->RightEdge(vPoint, VP, pKFi->mpCamera2);
             e->setMeasurement(obs);
 
             // Add here uncerteinty
@@ -2810,11 +2609,8 @@ void Optimizer::LocalInertialBA(
             const float& invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave] / unc2;
             e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-            g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-            e->setRobustKernel(rk);
-            rk->setDelta(thHuberMono);
+            e->robustKernel()->setDelta(thHuberMono);
 
-            optimizer.addEdge(e);
             vpEdgesMono.push_back(e);
             vpEdgeKFMono.push_back(pKFi);
             vpMapPointEdgeMono.push_back(pMP);
@@ -2829,14 +2625,13 @@ void Optimizer::LocalInertialBA(
     assert(mit->second >= 3);
   }
 
+  pGraph->EndWindow();
+
   optimizer.initializeOptimization();
   optimizer.computeActiveErrors();
   float err = optimizer.activeRobustChi2();
   optimizer.optimize(opt_it); // Originally to 2
   float err_end = optimizer.activeRobustChi2();
-  if (pbStopFlag) {
-    optimizer.setForceStopFlag(pbStopFlag);
-  }
 
   std::vector<std::pair<KeyFrame*, MapPoint*>> vToErase;
   vToErase.reserve(vpEdgesMono.size() + vpEdgesStereo.size());
@@ -2903,20 +2698,17 @@ void Optimizer::LocalInertialBA(
   for (int i = 0; i < N; i++) {
     KeyFrame* pKFi = vpOptimizableKFs[i];
 
-    VertexPose*  VP = static_cast<VertexPose*>(optimizer.vertex(pKFi->mnId));
+    VertexPose*  VP = pGraph->PoseVertex(pKFi->mnId);
     Sophus::SE3f Tcw(VP->estimate().Rcw[0].cast<float>(), VP->estimate().tcw[0].cast<float>());
     pKFi->SetPose(Tcw);
     pKFi->mnBALocalForKF = 0;
 
     if (pKFi->bImu) {
-      VertexVelocity* VV
-        = static_cast<VertexVelocity*>(optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 1));
+      VertexVelocity* VV = pGraph->VelocityVertex(pKFi->mnId);
       pKFi->SetVelocity(VV->estimate().cast<float>());
-      VertexGyroBias* VG
-        = static_cast<VertexGyroBias*>(optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 2));
-      VertexAccBias* VA
-        = static_cast<VertexAccBias*>(optimizer.vertex(maxKFid + 3 * (pKFi->mnId) + 3));
-      Vector6d b;
+      VertexGyroBias* VG = pGraph->GyroBiasVertex(pKFi->mnId);
+      VertexAccBias*  VA = pGraph->AccBiasVertex(pKFi->mnId);
+      Vector6d        b;
       b << VG->estimate(), VA->estimate();
       pKFi->SetNewBias(IMU::Bias(b[3], b[4], b[5], b[0], b[1], b[2]));
     }
@@ -2927,7 +2719,7 @@ void Optimizer::LocalInertialBA(
        it != itEnd;
        it++) {
     KeyFrame*    pKFi = *it;
-    VertexPose*  VP   = static_cast<VertexPose*>(optimizer.vertex(pKFi->mnId));
+    VertexPose*  VP   = pGraph->PoseVertex(pKFi->mnId);
     Sophus::SE3f Tcw(VP->estimate().Rcw[0].cast<float>(), VP->estimate().tcw[0].cast<float>());
     pKFi->SetPose(Tcw);
     pKFi->mnBALocalForKF = 0;
@@ -2937,9 +2729,8 @@ void Optimizer::LocalInertialBA(
   for (std::list<MapPoint*>::iterator lit = lLocalMapPoints.begin(), lend = lLocalMapPoints.end();
        lit != lend;
        lit++) {
-    MapPoint*               pMP = *lit;
-    g2o::VertexSBAPointXYZ* vPoint
-      = static_cast<g2o::VertexSBAPointXYZ*>(optimizer.vertex(pMP->mnId + iniMPid + 1));
+    MapPoint*               pMP    = *lit;
+    g2o::VertexSBAPointXYZ* vPoint = pGraph->MapPointVertex(pMP->mnId);
     pMP->SetWorldPos(vPoint->estimate().cast<float>());
     pMP->UpdateNormalAndDepth();
   }
@@ -3647,7 +3438,8 @@ void Optimizer::LocalBundleAdjustment(
         Eigen::Matrix<double, 2, 1> obs;
         obs << kpUn.pt.x, kpUn.pt.y;
 
-        ORB_SLAM3::EdgeSE3ProjectXYZ* e = new ORB_SLAM3::EdgeSE3ProjectXYZ();
+        ORB_SLAM3::EdgeSE3ProjectXYZ* e
+          = NewCameraModelEdge<ORB_SLAM3::EdgeSE3ProjectXYZ>(pKF->mpCamera);
 
         e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
         e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKF->mnId)));
@@ -4284,7 +4076,7 @@ void Optimizer::MergeInertialBA(
           Eigen::Matrix<double, 2, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y;
 
-          EdgeMono* e = new EdgeMono();
+          EdgeMono* e = NewCameraModelEdge<EdgeMono>(pKFi->mpCamera);
           e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
           e->setVertex(
             1,
@@ -4306,7 +4098,7 @@ void Optimizer::MergeInertialBA(
           Eigen::Matrix<double, 3, 1> obs;
           obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-          EdgeStereo* e = new EdgeStereo();
+          EdgeStereo* e = NewCameraModelEdge<EdgeStereo>(pKFi->mpCamera);
 
           e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
           e->setVertex(
@@ -4454,781 +4246,85 @@ void Optimizer::MergeInertialBA(
   pMap->IncreaseChangeIndex();
 }
 
-int Optimizer::PoseInertialOptimizationLastKeyFrame(Frame* pFrame, bool bRecInit) {
-  g2o::SparseOptimizer                 optimizer;
-  g2o::BlockSolverX::LinearSolverType* linearSolver;
-
-  linearSolver = new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>();
-
-  g2o::BlockSolverX* solver_ptr = new g2o::BlockSolverX(linearSolver);
-
-  g2o::OptimizationAlgorithmGaussNewton* solver
-    = new g2o::OptimizationAlgorithmGaussNewton(solver_ptr);
-  optimizer.setVerbose(false);
-  optimizer.setAlgorithm(solver);
-
-  int nInitialMonoCorrespondences   = 0;
-  int nInitialStereoCorrespondences = 0;
-  int nInitialCorrespondences       = 0;
-
-  // Set Frame vertex
-  VertexPose* VP = new VertexPose(pFrame);
-  VP->setId(0);
-  VP->setFixed(false);
-  optimizer.addVertex(VP);
-  VertexVelocity* VV = new VertexVelocity(pFrame);
-  VV->setId(1);
-  VV->setFixed(false);
-  optimizer.addVertex(VV);
-  VertexGyroBias* VG = new VertexGyroBias(pFrame);
-  VG->setId(2);
-  VG->setFixed(false);
-  optimizer.addVertex(VG);
-  VertexAccBias* VA = new VertexAccBias(pFrame);
-  VA->setId(3);
-  VA->setFixed(false);
-  optimizer.addVertex(VA);
-
-  // Set MapPoint vertices
-  const int  N      = pFrame->N;
-  const int  Nleft  = pFrame->Nleft;
-  const bool bRight = (Nleft != -1);
-
-  std::vector<EdgeMonoOnlyPose*>   vpEdgesMono;
-  std::vector<EdgeStereoOnlyPose*> vpEdgesStereo;
-  std::vector<std::size_t>         vnIndexEdgeMono;
-  std::vector<std::size_t>         vnIndexEdgeStereo;
-  vpEdgesMono.reserve(N);
-  vpEdgesStereo.reserve(N);
-  vnIndexEdgeMono.reserve(N);
-  vnIndexEdgeStereo.reserve(N);
-
-  const float thHuberMono   = std::sqrt(5.991);
-  const float thHuberStereo = std::sqrt(7.815);
-
-  {
-    std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
-
-    for (int i = 0; i < N; i++) {
-      MapPoint* pMP = pFrame->mvpMapPoints[i];
-      if (pMP) {
-        cv::KeyPoint kpUn;
-
-        if ((!bRight && pFrame->mvuRight[i] < 0) || i < Nleft) { // Left monocular observation
-          if (i < Nleft) {                                       // pair left-right
-            kpUn = pFrame->mvKeys[i];
-          } else {
-            kpUn = pFrame->mvKeysUn[i];
-          }
-
-          nInitialMonoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          Eigen::Matrix<double, 2, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y;
-
-          EdgeMonoOnlyPose* e = new EdgeMonoOnlyPose(pMP->GetWorldPos(), 0);
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs);
-
-          const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
-
-          optimizer.addEdge(e);
-
-          vpEdgesMono.push_back(e);
-          vnIndexEdgeMono.push_back(i);
-        } else if (!bRight) { // Stereo observation
-          nInitialStereoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          kpUn                              = pFrame->mvKeysUn[i];
-          const float                 kp_ur = pFrame->mvuRight[i];
-          Eigen::Matrix<double, 3, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
-
-          EdgeStereoOnlyPose* e = new EdgeStereoOnlyPose(pMP->GetWorldPos());
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs.head(2));
-
-          const float& invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix3d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberStereo);
-
-          optimizer.addEdge(e);
-
-          vpEdgesStereo.push_back(e);
-          vnIndexEdgeStereo.push_back(i);
-        }
-
-        if (bRight && i >= Nleft) { // Right monocular observation
-          nInitialMonoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          kpUn = pFrame->mvKeysRight[i - Nleft];
-          Eigen::Matrix<double, 2, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y;
-
-          EdgeMonoOnlyPose* e = new EdgeMonoOnlyPose(pMP->GetWorldPos(), 1);
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs);
-
-          const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
-
-          optimizer.addEdge(e);
-
-          vpEdgesMono.push_back(e);
-          vnIndexEdgeMono.push_back(i);
-        }
-      }
-    }
-  }
-  nInitialCorrespondences = nInitialMonoCorrespondences + nInitialStereoCorrespondences;
-
-  KeyFrame*   pKF = pFrame->mpLastKeyFrame;
-  VertexPose* VPk = new VertexPose(pKF);
-  VPk->setId(4);
-  VPk->setFixed(true);
-  optimizer.addVertex(VPk);
-  VertexVelocity* VVk = new VertexVelocity(pKF);
-  VVk->setId(5);
-  VVk->setFixed(true);
-  optimizer.addVertex(VVk);
-  VertexGyroBias* VGk = new VertexGyroBias(pKF);
-  VGk->setId(6);
-  VGk->setFixed(true);
-  optimizer.addVertex(VGk);
-  VertexAccBias* VAk = new VertexAccBias(pKF);
-  VAk->setId(7);
-  VAk->setFixed(true);
-  optimizer.addVertex(VAk);
-
-  EdgeInertial* ei = new EdgeInertial(pFrame->mpImuPreintegrated);
-
-  ei->setVertex(0, VPk);
-  ei->setVertex(1, VVk);
-  ei->setVertex(2, VGk);
-  ei->setVertex(3, VAk);
-  ei->setVertex(4, VP);
-  ei->setVertex(5, VV);
-  optimizer.addEdge(ei);
-
-  EdgeGyroRW* egr = new EdgeGyroRW();
-  egr->setVertex(0, VGk);
-  egr->setVertex(1, VG);
-  Eigen::Matrix3d InfoG = pFrame->mpImuPreintegrated->C.block<3, 3>(9, 9).cast<double>().inverse();
-  egr->setInformation(InfoG);
-  optimizer.addEdge(egr);
-
-  EdgeAccRW* ear = new EdgeAccRW();
-  ear->setVertex(0, VAk);
-  ear->setVertex(1, VA);
-  Eigen::Matrix3d InfoA
-    = pFrame->mpImuPreintegrated->C.block<3, 3>(12, 12).cast<double>().inverse();
-  ear->setInformation(InfoA);
-  optimizer.addEdge(ear);
+int Optimizer::PoseInertialOptimizationLastKeyFrame(
+  Frame* pFrame, bool bRecInit, PoseSolver* pSolver
+) {
+  std::unique_ptr<PoseSolver> pFrameSolver;
+  if (!pSolver) {
+    pFrameSolver = std::make_unique<PoseSolver>();
+    pSolver      = pFrameSolver.get();
+  }
+  const int nInitialCorrespondences = SetInertialObservations(pFrame, pSolver);
+
+  // Inertial residual from the last keyframe, whose state is fixed
+  KeyFrame*            pKF = pFrame->mpLastKeyFrame;
+  PoseSolver::ImuState previous;
+  previous.Rwb = pKF->GetImuRotation().cast<double>();
+  previous.twb = pKF->GetImuPosition().cast<double>();
+  previous.v   = pKF->GetVelocity().cast<double>();
+  previous.bg  = pKF->GetGyroBias().cast<double>();
+  previous.ba  = pKF->GetAccBias().cast<double>();
+
+  const Eigen::Matrix<float, 15, 15>& C = pFrame->mpImuPreintegrated->C;
+  pSolver->SetInertial(
+    previous,
+    pFrame->mpImuPreintegrated,
+    C.block<3, 3>(9, 9).cast<double>().inverse(),
+    C.block<3, 3>(12, 12).cast<double>().inverse(),
+    nullptr
+  );
 
   // We perform 4 optimizations, after each optimization we classify observation as inlier/outlier
   // At the next optimization, outliers are not included, but at the end they can be classified as
   // inliers again.
-  float chi2Mono[4]   = {12, 7.5, 5.991, 5.991};
-  float chi2Stereo[4] = {15.6, 9.8, 7.815, 7.815};
-
-  int its[4] = {10, 10, 10, 10};
-
-  int nBad           = 0;
-  int nBadMono       = 0;
-  int nBadStereo     = 0;
-  int nInliersMono   = 0;
-  int nInliersStereo = 0;
-  int nInliers       = 0;
-  for (std::size_t it = 0; it < 4; it++) {
-    optimizer.initializeOptimization(0);
-    optimizer.optimize(its[it]);
-
-    nBad            = 0;
-    nBadMono        = 0;
-    nBadStereo      = 0;
-    nInliers        = 0;
-    nInliersMono    = 0;
-    nInliersStereo  = 0;
-    float chi2close = 1.5 * chi2Mono[it];
-
-    // For monocular observations
-    for (std::size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
-      EdgeMonoOnlyPose* e = vpEdgesMono[i];
-
-      const std::size_t idx = vnIndexEdgeMono[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2   = e->chi2();
-      bool        bClose = pFrame->mvpMapPoints[idx]->mTrackDepth < 10.f;
-
-      if ((chi2 > chi2Mono[it] && !bClose) || (bClose && chi2 > chi2close) || !e->isDepthPositive()) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBadMono++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-        nInliersMono++;
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    // For stereo observations
-    for (std::size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
-      EdgeStereoOnlyPose* e = vpEdgesStereo[i];
-
-      const std::size_t idx = vnIndexEdgeStereo[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if (chi2 > chi2Stereo[it]) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1); // not included in next optimization
-        nBadStereo++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-        nInliersStereo++;
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    nInliers = nInliersMono + nInliersStereo;
-    nBad     = nBadMono + nBadStereo;
-
-    if (optimizer.edges().size() < 10) {
-      break;
-    }
-  }
-
-  // If not too much tracks, recover not too bad points
-  if ((nInliers < 30) && !bRecInit) {
-    nBad                              = 0;
-    const float         chi2MonoOut   = 18.f;
-    const float         chi2StereoOut = 24.f;
-    EdgeMonoOnlyPose*   e1;
-    EdgeStereoOnlyPose* e2;
-    for (std::size_t i = 0, iend = vnIndexEdgeMono.size(); i < iend; i++) {
-      const std::size_t idx = vnIndexEdgeMono[i];
-      e1                    = vpEdgesMono[i];
-      e1->computeError();
-      if (e1->chi2() < chi2MonoOut) {
-        pFrame->mvbOutlier[idx] = false;
-      } else {
-        nBad++;
-      }
-    }
-    for (std::size_t i = 0, iend = vnIndexEdgeStereo.size(); i < iend; i++) {
-      const std::size_t idx = vnIndexEdgeStereo[i];
-      e2                    = vpEdgesStereo[i];
-      e2->computeError();
-      if (e2->chi2() < chi2StereoOut) {
-        pFrame->mvbOutlier[idx] = false;
-      } else {
-        nBad++;
-      }
-    }
-  }
-
-  // Recover optimized pose, velocity and biases
-  pFrame->SetImuPoseVelocity(
-    VP->estimate().Rwb.cast<float>(),
-    VP->estimate().twb.cast<float>(),
-    VV->estimate().cast<float>()
-  );
-  Vector6d b;
-  b << VG->estimate(), VA->estimate();
-  pFrame->mImuBias = IMU::Bias(b[3], b[4], b[5], b[0], b[1], b[2]);
-
-  // Recover Hessian, marginalize keyFframe states and generate new prior for frame
+  PoseSolver::ImuState          state = GetImuState(pFrame);
   Eigen::Matrix<double, 15, 15> H;
-  H.setZero();
-
-  H.block<9, 9>(0, 0)   += ei->GetHessian2();
-  H.block<3, 3>(9, 9)   += egr->GetHessian2();
-  H.block<3, 3>(12, 12) += ear->GetHessian2();
-
-  int tot_in = 0, tot_out = 0;
-  for (std::size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
-    EdgeMonoOnlyPose* e = vpEdgesMono[i];
+  const int nBad = pSolver->OptimizeInertial(state, pFrame->mvbOutlier, bRecInit, H);
 
-    const std::size_t idx = vnIndexEdgeMono[i];
-
-    if (!pFrame->mvbOutlier[idx]) {
-      H.block<6, 6>(0, 0) += e->GetHessian();
-      tot_in++;
-    } else {
-      tot_out++;
-    }
-  }
-
-  for (std::size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
-    EdgeStereoOnlyPose* e = vpEdgesStereo[i];
-
-    const std::size_t idx = vnIndexEdgeStereo[i];
-
-    if (!pFrame->mvbOutlier[idx]) {
-      H.block<6, 6>(0, 0) += e->GetHessian();
-      tot_in++;
-    } else {
-      tot_out++;
-    }
-  }
+  // Recover optimized pose, velocity and biases
+  SetImuState(pFrame, state);
 
-  pFrame->mpcpi = new ConstraintPoseImu(
-    VP->estimate().Rwb,
-    VP->estimate().twb,
-    VV->estimate(),
-    VG->estimate(),
-    VA->estimate(),
-    H
-  );
+  // New prior for frame from the Hessian, keyframe states marginalized
+  pFrame->mpcpi = new ConstraintPoseImu(state.Rwb, state.twb, state.v, state.bg, state.ba, H);
 
   return nInitialCorrespondences - nBad;
 }
 
-int Optimizer::PoseInertialOptimizationLastFrame(Frame* pFrame, bool bRecInit) {
-  g2o::SparseOptimizer                 optimizer;
-  g2o::BlockSolverX::LinearSolverType* linearSolver;
-
-  linearSolver = new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>();
-
-  g2o::BlockSolverX* solver_ptr = new g2o::BlockSolverX(linearSolver);
-
-  g2o::OptimizationAlgorithmGaussNewton* solver
-    = new g2o::OptimizationAlgorithmGaussNewton(solver_ptr);
-  optimizer.setAlgorithm(solver);
-  optimizer.setVerbose(false);
-
-  int nInitialMonoCorrespondences   = 0;
-  int nInitialStereoCorrespondences = 0;
-  int nInitialCorrespondences       = 0;
-
-  // Set Current Frame vertex
-  VertexPose* VP = new VertexPose(pFrame);
-  VP->setId(0);
-  VP->setFixed(false);
-  optimizer.addVertex(VP);
-  VertexVelocity* VV = new VertexVelocity(pFrame);
-  VV->setId(1);
-  VV->setFixed(false);
-  optimizer.addVertex(VV);
-  VertexGyroBias* VG = new VertexGyroBias(pFrame);
-  VG->setId(2);
-  VG->setFixed(false);
-  optimizer.addVertex(VG);
-  VertexAccBias* VA = new VertexAccBias(pFrame);
-  VA->setId(3);
-  VA->setFixed(false);
-  optimizer.addVertex(VA);
-
-  // Set MapPoint vertices
-  const int  N      = pFrame->N;
-  const int  Nleft  = pFrame->Nleft;
-  const bool bRight = (Nleft != -1);
-
-  std::vector<EdgeMonoOnlyPose*>   vpEdgesMono;
-  std::vector<EdgeStereoOnlyPose*> vpEdgesStereo;
-  std::vector<std::size_t>         vnIndexEdgeMono;
-  std::vector<std::size_t>         vnIndexEdgeStereo;
-  vpEdgesMono.reserve(N);
-  vpEdgesStereo.reserve(N);
-  vnIndexEdgeMono.reserve(N);
-  vnIndexEdgeStereo.reserve(N);
-
-  const float thHuberMono   = std::sqrt(5.991);
-  const float thHuberStereo = std::sqrt(7.815);
-
-  {
-    std::unique_lock<std::mutex> lock(MapPoint::mGlobalMutex);
-
-    for (int i = 0; i < N; i++) {
-      MapPoint* pMP = pFrame->mvpMapPoints[i];
-      if (pMP) {
-        cv::KeyPoint kpUn;
-        // Left monocular observation
-        if ((!bRight && pFrame->mvuRight[i] < 0) || i < Nleft) {
-          if (i < Nleft) { // pair left-right
-            kpUn = pFrame->mvKeys[i];
-          } else {
-            kpUn = pFrame->mvKeysUn[i];
-          }
-
-          nInitialMonoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          Eigen::Matrix<double, 2, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y;
-
-          EdgeMonoOnlyPose* e = new EdgeMonoOnlyPose(pMP->GetWorldPos(), 0);
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs);
-
-          const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
-
-          optimizer.addEdge(e);
-
-          vpEdgesMono.push_back(e);
-          vnIndexEdgeMono.push_back(i);
-        }
-        // Stereo observation
-        else if (!bRight) {
-          nInitialStereoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          kpUn                              = pFrame->mvKeysUn[i];
-          const float                 kp_ur = pFrame->mvuRight[i];
-          Eigen::Matrix<double, 3, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
-
-          EdgeStereoOnlyPose* e = new EdgeStereoOnlyPose(pMP->GetWorldPos());
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs.head(2));
-
-          const float& invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix3d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberStereo);
-
-          optimizer.addEdge(e);
-
-          vpEdgesStereo.push_back(e);
-          vnIndexEdgeStereo.push_back(i);
-        }
-
-        // Right monocular observation
-        if (bRight && i >= Nleft) {
-          nInitialMonoCorrespondences++;
-          pFrame->mvbOutlier[i] = false;
-
-          kpUn = pFrame->mvKeysRight[i - Nleft];
-          Eigen::Matrix<double, 2, 1> obs;
-          obs << kpUn.pt.x, kpUn.pt.y;
-
-          EdgeMonoOnlyPose* e = new EdgeMonoOnlyPose(pMP->GetWorldPos(), 1);
-
-          e->setVertex(0, VP);
-          e->setMeasurement(obs);
-
-          // Add here uncerteinty
-          const float unc2 = pFrame->mpCamera->uncertainty2(obs);
-
-          const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave] / unc2;
-          e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
-
-          g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-          e->setRobustKernel(rk);
-          rk->setDelta(thHuberMono);
-
-          optimizer.addEdge(e);
-
-          vpEdgesMono.push_back(e);
-          vnIndexEdgeMono.push_back(i);
-        }
-      }
-    }
+int Optimizer::PoseInertialOptimizationLastFrame(
+  Frame* pFrame, bool bRecInit, PoseSolver* pSolver
+) {
+  std::unique_ptr<PoseSolver> pFrameSolver;
+  if (!pSolver) {
+    pFrameSolver = std::make_unique<PoseSolver>();
+    pSolver      = pFrameSolver.get();
   }
+  const int nInitialCorrespondences = SetInertialObservations(pFrame, pSolver);
 
-  nInitialCorrespondences = nInitialMonoCorrespondences + nInitialStereoCorrespondences;
-
-  // Set Previous Frame Vertex
+  // Inertial residual from the previous frame, optimized too under its prior. A previous frame
+  // without prior is held fixed, with the thresholds of the last keyframe optimization.
   Frame* pFp = pFrame->mpPrevFrame;
 
-  VertexPose* VPk = new VertexPose(pFp);
-  VPk->setId(4);
-  VPk->setFixed(false);
-  optimizer.addVertex(VPk);
-  VertexVelocity* VVk = new VertexVelocity(pFp);
-  VVk->setId(5);
-  VVk->setFixed(false);
-  optimizer.addVertex(VVk);
-  VertexGyroBias* VGk = new VertexGyroBias(pFp);
-  VGk->setId(6);
-  VGk->setFixed(false);
-  optimizer.addVertex(VGk);
-  VertexAccBias* VAk = new VertexAccBias(pFp);
-  VAk->setId(7);
-  VAk->setFixed(false);
-  optimizer.addVertex(VAk);
-
-  EdgeInertial* ei = new EdgeInertial(pFrame->mpImuPreintegratedFrame);
-
-  ei->setVertex(0, VPk);
-  ei->setVertex(1, VVk);
-  ei->setVertex(2, VGk);
-  ei->setVertex(3, VAk);
-  ei->setVertex(4, VP);
-  ei->setVertex(5, VV);
-  optimizer.addEdge(ei);
-
-  EdgeGyroRW* egr = new EdgeGyroRW();
-  egr->setVertex(0, VGk);
-  egr->setVertex(1, VG);
-  Eigen::Matrix3d InfoG = pFrame->mpImuPreintegrated->C.block<3, 3>(9, 9).cast<double>().inverse();
-  egr->setInformation(InfoG);
-  optimizer.addEdge(egr);
-
-  EdgeAccRW* ear = new EdgeAccRW();
-  ear->setVertex(0, VAk);
-  ear->setVertex(1, VA);
-  Eigen::Matrix3d InfoA
-    = pFrame->mpImuPreintegrated->C.block<3, 3>(12, 12).cast<double>().inverse();
-  ear->setInformation(InfoA);
-  optimizer.addEdge(ear);
-
-  if (!pFp->mpcpi) {
-    // Constraint to previous frame non existing.
-  }
-
-  EdgePriorPoseImu* ep = new EdgePriorPoseImu(pFp->mpcpi);
-
-  ep->setVertex(0, VPk);
-  ep->setVertex(1, VVk);
-  ep->setVertex(2, VGk);
-  ep->setVertex(3, VAk);
-  g2o::RobustKernelHuber* rkp = new g2o::RobustKernelHuber;
-  ep->setRobustKernel(rkp);
-  rkp->setDelta(5);
-  optimizer.addEdge(ep);
+  const Eigen::Matrix<float, 15, 15>& C = pFrame->mpImuPreintegrated->C;
+  pSolver->SetInertial(
+    GetImuState(pFp),
+    pFrame->mpImuPreintegratedFrame,
+    C.block<3, 3>(9, 9).cast<double>().inverse(),
+    C.block<3, 3>(12, 12).cast<double>().inverse(),
+    pFp->mpcpi
+  );
 
   // We perform 4 optimizations, after each optimization we classify observation as inlier/outlier
   // At the next optimization, outliers are not included, but at the end they can be classified as
   // inliers again.
-  const float chi2Mono[4]   = {5.991, 5.991, 5.991, 5.991};
-  const float chi2Stereo[4] = {15.6f, 9.8f, 7.815f, 7.815f};
-  const int   its[4]        = {10, 10, 10, 10};
-
-  int nBad           = 0;
-  int nBadMono       = 0;
-  int nBadStereo     = 0;
-  int nInliersMono   = 0;
-  int nInliersStereo = 0;
-  int nInliers       = 0;
-  for (std::size_t it = 0; it < 4; it++) {
-    optimizer.initializeOptimization(0);
-    optimizer.optimize(its[it]);
-
-    nBad            = 0;
-    nBadMono        = 0;
-    nBadStereo      = 0;
-    nInliers        = 0;
-    nInliersMono    = 0;
-    nInliersStereo  = 0;
-    float chi2close = 1.5 * chi2Mono[it];
-
-    for (std::size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
-      EdgeMonoOnlyPose* e = vpEdgesMono[i];
-
-      const std::size_t idx    = vnIndexEdgeMono[i];
-      bool              bClose = pFrame->mvpMapPoints[idx]->mTrackDepth < 10.f;
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if ((chi2 > chi2Mono[it] && !bClose) || (bClose && chi2 > chi2close) || !e->isDepthPositive()) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBadMono++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-        nInliersMono++;
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    for (std::size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
-      EdgeStereoOnlyPose* e = vpEdgesStereo[i];
-
-      const std::size_t idx = vnIndexEdgeStereo[i];
-
-      if (pFrame->mvbOutlier[idx]) {
-        e->computeError();
-      }
-
-      const float chi2 = e->chi2();
-
-      if (chi2 > chi2Stereo[it]) {
-        pFrame->mvbOutlier[idx] = true;
-        e->setLevel(1);
-        nBadStereo++;
-      } else {
-        pFrame->mvbOutlier[idx] = false;
-        e->setLevel(0);
-        nInliersStereo++;
-      }
-
-      if (it == 2) {
-        e->setRobustKernel(0);
-      }
-    }
-
-    nInliers = nInliersMono + nInliersStereo;
-    nBad     = nBadMono + nBadStereo;
-
-    if (optimizer.edges().size() < 10) {
-      break;
-    }
-  }
-
-  if ((nInliers < 30) && !bRecInit) {
-    nBad                              = 0;
-    const float         chi2MonoOut   = 18.f;
-    const float         chi2StereoOut = 24.f;
-    EdgeMonoOnlyPose*   e1;
-    EdgeStereoOnlyPose* e2;
-    for (std::size_t i = 0, iend = vnIndexEdgeMono.size(); i < iend; i++) {
-      const std::size_t idx = vnIndexEdgeMono[i];
-      e1                    = vpEdgesMono[i];
-      e1->computeError();
-      if (e1->chi2() < chi2MonoOut) {
-        pFrame->mvbOutlier[idx] = false;
-      } else {
-        nBad++;
-      }
-    }
-    for (std::size_t i = 0, iend = vnIndexEdgeStereo.size(); i < iend; i++) {
-      const std::size_t idx = vnIndexEdgeStereo[i];
-      e2                    = vpEdgesStereo[i];
-      e2->computeError();
-      if (e2->chi2() < chi2StereoOut) {
-        pFrame->mvbOutlier[idx] = false;
-      } else {
-        nBad++;
-      }
-    }
-  }
-
-  nInliers = nInliersMono + nInliersStereo;
+  PoseSolver::ImuState          state = GetImuState(pFrame);
+  Eigen::Matrix<double, 15, 15> H;
+  const int nBad = pSolver->OptimizeInertial(state, pFrame->mvbOutlier, bRecInit, H);
 
   // Recover optimized pose, velocity and biases
-  pFrame->SetImuPoseVelocity(
-    VP->estimate().Rwb.cast<float>(),
-    VP->estimate().twb.cast<float>(),
-    VV->estimate().cast<float>()
-  );
-  Vector6d b;
-  b << VG->estimate(), VA->estimate();
-  pFrame->mImuBias = IMU::Bias(b[3], b[4], b[5], b[0], b[1], b[2]);
-
-  // Recover Hessian, marginalize previous frame states and generate new prior for frame
-  Eigen::Matrix<double, 30, 30> H;
-  H.setZero();
-
-  H.block<24, 24>(0, 0) += ei->GetHessian();
-
-  Eigen::Matrix<double, 6, 6> Hgr = egr->GetHessian();
-  H.block<3, 3>(9, 9)             += Hgr.block<3, 3>(0, 0);
-  H.block<3, 3>(9, 24)            += Hgr.block<3, 3>(0, 3);
-  H.block<3, 3>(24, 9)            += Hgr.block<3, 3>(3, 0);
-  H.block<3, 3>(24, 24)           += Hgr.block<3, 3>(3, 3);
-
-  Eigen::Matrix<double, 6, 6> Har = ear->GetHessian();
-  H.block<3, 3>(12, 12)           += Har.block<3, 3>(0, 0);
-  H.block<3, 3>(12, 27)           += Har.block<3, 3>(0, 3);
-  H.block<3, 3>(27, 12)           += Har.block<3, 3>(3, 0);
-  H.block<3, 3>(27, 27)           += Har.block<3, 3>(3, 3);
-
-  H.block<15, 15>(0, 0) += ep->GetHessian();
-
-  int tot_in = 0, tot_out = 0;
-  for (std::size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
-    EdgeMonoOnlyPose* e = vpEdgesMono[i];
-
-    const std::size_t idx = vnIndexEdgeMono[i];
+  SetImuState(pFrame, state);
 
-    if (!pFrame->mvbOutlier[idx]) {
-      H.block<6, 6>(15, 15) += e->GetHessian();
-      tot_in++;
-    } else {
-      tot_out++;
-    }
-  }
-
-  for (std::size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
-    EdgeStereoOnlyPose* e = vpEdgesStereo[i];
-
-    const std::size_t idx = vnIndexEdgeStereo[i];
-
-    if (!pFrame->mvbOutlier[idx]) {
-      H.block<6, 6>(15, 15) += e->GetHessian();
-      tot_in++;
-    } else {
-      tot_out++;
-    }
-  }
-
-  H = Marginalize(H, 0, 14);
-
-  pFrame->mpcpi = new ConstraintPoseImu(
-    VP->estimate().Rwb,
-    VP->estimate().twb,
-    VV->estimate(),
-    VG->estimate(),
-    VA->estimate(),
-    H.block<15, 15>(15, 15)
-  );
+  // New prior for frame from the Hessian, previous frame states marginalized
+  pFrame->mpcpi = new ConstraintPoseImu(state.Rwb, state.twb, state.v, state.bg, state.ba, H);
   delete pFp->mpcpi;
   pFp->mpcpi = NULL;
 
@@ -0,0 +1,817 @@
+#include "PoseSolver.h"
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+#include <Eigen/SVD>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "G2oTypes.h"
+#include "GeometricCamera.h"
+#include "ImuTypes.h"
+
+namespace ORB_SLAM3 {
+
+namespace {
+
+const int   kRounds     = 4;
+const int   kIterations = 10;
+const float kChi2Mono   = 5.991f;
+const float kChi2Stereo = 7.815f;
+
+// Chi2 thresholds of the rounds of the inertial optimizations, the monocular ones for the previous
+// state fixed (last keyframe) or optimized (last frame). Close points get 1.5 times the monocular
+// threshold.
+const float kChi2MonoKeyFrame[kRounds]   = {12.f, 7.5f, 5.991f, 5.991f};
+const float kChi2MonoFrame[kRounds]      = {5.991f, 5.991f, 5.991f, 5.991f};
+const float kChi2StereoInertial[kRounds] = {15.6f, 9.8f, 7.815f, 7.815f};
+const float kChi2CloseFactor             = 1.5f;
+
+// With less inliers, the inertial optimizations keep the observations up to these chi2
+const int   kMinInertialInliers  = 30;
+const float kChi2MonoRecovered   = 18.f;
+const float kChi2StereoRecovered = 24.f;
+
+// Huber width of the prior of the previous state
+const double kHuberPrior = 5.0;
+
+// Entries of a residual row: the Jacobian, the residual and the weight
+const int kRowEntries = 8;
+
+// Points x, y, z transformed by R, t into xo, yo, zo
+void TransformPoints(
+  const Eigen::Matrix3f& R,
+  const Eigen::Vector3f& t,
+  const float*           x,
+  const float*           y,
+  const float*           z,
+  const std::size_t      n,
+  float*                 xo,
+  float*                 yo,
+  float*                 zo
+) {
+  for (std::size_t i = 0; i < n; i++) {
+    const float px = x[i], py = y[i], pz = z[i];
+    xo[i]          = R(0, 0) * px + R(0, 1) * py + R(0, 2) * pz + t(0);
+    yo[i]          = R(1, 0) * px + R(1, 1) * py + R(1, 2) * pz + t(1);
+    zo[i]          = R(2, 0) * px + R(2, 1) * py + R(2, 2) * pz + t(2);
+  }
+}
+
+// Row of the residual e whose derivative with respect to the point Xc in the camera is p. The
+// pose is updated as exp(dx) * Tcw with dx = (omega, upsilon), so that dXc / dx = [-[Xc]x | I]
+// and the row of the Jacobian of e = measurement - projection is -(Xc x p, p).
+void WriteRow(
+  float*                 pRow,
+  const std::size_t      stride,
+  const Eigen::Vector3f& Xc,
+  const Eigen::Vector3f& p,
+  const float            e,
+  const float            w
+) {
+  const Eigen::Vector3f c = Xc.cross(p);
+  pRow[0]                 = -c(0);
+  pRow[stride]            = -c(1);
+  pRow[2 * stride]        = -c(2);
+  pRow[3 * stride]        = -p(0);
+  pRow[4 * stride]        = -p(1);
+  pRow[5 * stride]        = -p(2);
+  pRow[6 * stride]        = e;
+  pRow[7 * stride]        = w;
+}
+
+void ClearRows(float* pRow, const std::size_t stride, const int nRows) {
+  for (int r = 0; r < nRows; r++) {
+    for (int k = 0; k < kRowEntries; k++) {
+      pRow[k * stride + r] = 0.f;
+    }
+  }
+}
+
+// Weight of the information and cost of an observation at chi2, with a Huber kernel of width
+// delta when bRobust
+float RobustWeight(const float chi2, const float delta, const bool bRobust, double& cost) {
+  if (!bRobust || chi2 <= delta * delta) {
+    cost += chi2;
+    return 1.f;
+  }
+  const float e = std::sqrt(chi2);
+  cost += 2.f * delta * e - delta * delta;
+  return delta / e;
+}
+
+// Residual e of R rows with Jacobian J with respect to the inertial states and information w *
+// Info, into the normal equations H dx = g
+template <int R>
+void AddResidual(
+  const Eigen::Matrix<double, R, 30>& J,
+  const Eigen::Matrix<double, R, 1>&  e,
+  const Eigen::Matrix<double, R, R>&  Info,
+  const double                        w,
+  Eigen::Matrix<double, 30, 30>&      H,
+  Eigen::Matrix<double, 30, 1>&       g
+) {
+  const Eigen::Matrix<double, 30, R> JtW = J.transpose() * (w * Info);
+  H.noalias() += JtW * J;
+  g.noalias() += JtW * e;
+}
+
+// Gauss-Newton step dx of the first N states, false when H is not positive definite
+template <int N>
+bool SolveStep(
+  const Eigen::Matrix<double, 30, 30>& H,
+  const Eigen::Matrix<double, 30, 1>&  g,
+  Eigen::Matrix<double, 30, 1>&        dx
+) {
+  const Eigen::LDLT<Eigen::Matrix<double, N, N>> ldlt(H.topLeftCorner<N, N>());
+  if (ldlt.info() != Eigen::Success || !ldlt.isPositive()) {
+    return false;
+  }
+  dx.setZero();
+  dx.head<N>() = ldlt.solve(-g.head<N>());
+  return dx.allFinite();
+}
+
+// Update of an IMU state as the g2o vertices of the inertial optimizations: the rotation and
+// translation of the pose in the IMU frame, the velocity and biases in the world
+void UpdateState(PoseSolver::ImuState& state, const Eigen::Matrix<double, 15, 1>& dx) {
+  state.twb += state.Rwb * dx.segment<3>(3);
+  state.Rwb = state.Rwb * ExpSO3(dx.segment<3>(0));
+  state.v   += dx.segment<3>(6);
+  state.bg  += dx.segment<3>(9);
+  state.ba  += dx.segment<3>(12);
+}
+
+} // namespace
+
+void PoseSolver::Observations::Clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  u.clear();
+  v.clear();
+  ur.clear();
+  invSigma2.clear();
+  index.clear();
+  close.clear();
+}
+
+void PoseSolver::Observations::Add(
+  const Eigen::Vector3f& x3Dw, const float invSigma2_, const int index_, const bool bClose
+) {
+  x.push_back(x3Dw(0));
+  y.push_back(x3Dw(1));
+  z.push_back(x3Dw(2));
+  invSigma2.push_back(invSigma2_);
+  index.push_back(index_);
+  close.push_back(bClose);
+}
+
+PoseSolver::PoseSolver()
+  : mpCamera(nullptr)
+  , mpCamera2(nullptr)
+  , mfx(0.f)
+  , mfy(0.f)
+  , mcx(0.f)
+  , mcy(0.f)
+  , mbf(0.f)
+  , mpInt(nullptr)
+  , mpPrior(nullptr)
+  , mnRows(0) {
+}
+
+void PoseSolver::Reset() {
+  for (Observations& obs : mvObservations) {
+    obs.Clear();
+  }
+  mpCamera  = nullptr;
+  mpCamera2 = nullptr;
+  mpInt     = nullptr;
+  mpPrior   = nullptr;
+}
+
+void PoseSolver::SetCamera(GeometricCamera* pCamera) {
+  mpCamera = pCamera;
+}
+
+void PoseSolver::SetRightCamera(GeometricCamera* pCamera2, const Sophus::SE3f& Trl) {
+  mpCamera2 = pCamera2;
+  mTrl      = Trl;
+}
+
+void PoseSolver::SetStereoRig(
+  const float fx, const float fy, const float cx, const float cy, const float bf
+) {
+  mfx = fx;
+  mfy = fy;
+  mcx = cx;
+  mcy = cy;
+  mbf = bf;
+}
+
+void PoseSolver::SetImuCalibration(const Sophus::SE3f& Tcb) {
+  mTcb = Tcb;
+}
+
+void PoseSolver::SetInertial(
+  const ImuState&          previous,
+  IMU::Preintegrated*      pInt,
+  const Eigen::Matrix3d&   InfoG,
+  const Eigen::Matrix3d&   InfoA,
+  const ConstraintPoseImu* pPrior
+) {
+  mPrevious = previous;
+  mpInt     = pInt;
+  mInfoG    = InfoG;
+  mInfoA    = InfoA;
+  mpPrior   = pPrior;
+
+  // Information of the preintegrated rotation, velocity and position, without the eigenvalues
+  // EdgeInertial drops
+  Eigen::Matrix<double, 9, 9> Info = pInt->C.block<9, 9>(0, 0).cast<double>().inverse();
+  Info = (Info + Info.transpose()) / 2;
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 9, 9>> es(Info);
+  Eigen::Matrix<double, 9, 1>                                      eigs = es.eigenvalues();
+  for (int i = 0; i < 9; i++) {
+    if (eigs[i] < 1e-12) {
+      eigs[i] = 0;
+    }
+  }
+  mInfoInertial = es.eigenvectors() * eigs.asDiagonal() * es.eigenvectors().transpose();
+}
+
+void PoseSolver::AddMonocular(
+  const Eigen::Vector3f& x3Dw,
+  const Eigen::Vector2f& uv,
+  const float            invSigma2,
+  const int              index,
+  const bool             bClose
+) {
+  Observations& obs = mvObservations[MONOCULAR];
+  obs.Add(x3Dw, invSigma2, index, bClose);
+  obs.u.push_back(uv(0));
+  obs.v.push_back(uv(1));
+}
+
+void PoseSolver::AddRight(
+  const Eigen::Vector3f& x3Dw,
+  const Eigen::Vector2f& uv,
+  const float            invSigma2,
+  const int              index,
+  const bool             bClose
+) {
+  Observations& obs = mvObservations[RIGHT];
+  obs.Add(x3Dw, invSigma2, index, bClose);
+  obs.u.push_back(uv(0));
+  obs.v.push_back(uv(1));
+}
+
+void PoseSolver::AddStereo(
+  const Eigen::Vector3f& x3Dw, const Eigen::Vector3f& uvr, const float invSigma2, const int index
+) {
+  Observations& obs = mvObservations[STEREO];
+  obs.Add(x3Dw, invSigma2, index, false);
+  obs.u.push_back(uvr(0));
+  obs.v.push_back(uvr(1));
+  obs.ur.push_back(uvr(2));
+}
+
+std::size_t PoseSolver::NumObservations() const {
+  return mvObservations[MONOCULAR].Size() + mvObservations[RIGHT].Size()
+       + mvObservations[STEREO].Size();
+}
+
+int PoseSolver::Optimize(Sophus::SE3f& Tcw, std::vector<bool>& vbOutlier) {
+  for (Observations& obs : mvObservations) {
+    obs.inlier.assign(obs.Size(), 1);
+    obs.chi2.resize(obs.Size());
+  }
+
+  // Every round starts from the given pose, only the inliers change
+  const Sophus::SE3d Tcw0 = Tcw.cast<double>();
+  Sophus::SE3d       Tcwd = Tcw0;
+  int                nBad = 0;
+  for (int round = 0; round < kRounds; round++) {
+    const bool bRobust = round < kRounds - 1;
+    Tcwd               = Tcw0;
+    OptimizeRound(Tcwd, bRobust);
+
+    Evaluate(Tcwd, bRobust);
+    nBad = 0;
+    for (int kind = 0; kind < NUM_KINDS; kind++) {
+      Observations& obs    = mvObservations[kind];
+      const float   thChi2 = kind == STEREO ? kChi2Stereo : kChi2Mono;
+      for (std::size_t i = 0; i < obs.Size(); i++) {
+        const bool bOutlier     = !(obs.chi2[i] <= thChi2);
+        obs.inlier[i]           = !bOutlier;
+        vbOutlier[obs.index[i]] = bOutlier;
+        nBad += bOutlier;
+      }
+    }
+
+    if (NumObservations() < 10) {
+      break;
+    }
+  }
+
+  Tcw = Tcwd.cast<float>();
+  return nBad;
+}
+
+void PoseSolver::OptimizeRound(Sophus::SE3d& Tcw, const bool bRobust) {
+  Eigen::Matrix<double, 6, 6> H;
+  Eigen::Matrix<double, 6, 1> g;
+  double                      cost = Evaluate(Tcw, bRobust);
+  Accumulate(H, g);
+
+  const double maxDiagonal = H.diagonal().maxCoeff();
+  if (!(maxDiagonal > 0.0)) { // no inliers
+    return;
+  }
+
+  // Gauss-Newton steps while they lower the cost, damped otherwise
+  double lambda = 0.0;
+  for (int it = 0; it < kIterations; it++) {
+    Eigen::Matrix<double, 6, 6> A = H;
+    A.diagonal().array() += lambda;
+    const Eigen::LLT<Eigen::Matrix<double, 6, 6>> llt(A);
+    const Eigen::Matrix<double, 6, 1>              dx = llt.solve(-g);
+    if (llt.info() != Eigen::Success || !dx.allFinite()) {
+      lambda = lambda > 0.0 ? 10.0 * lambda : 1e-5 * maxDiagonal;
+      continue;
+    }
+
+    // dx is (omega, upsilon), the tangent of Sophus (upsilon, omega)
+    Eigen::Matrix<double, 6, 1> tangent;
+    tangent << dx.tail<3>(), dx.head<3>();
+    const Sophus::SE3d TcwNew  = Sophus::SE3d::exp(tangent) * Tcw;
+
+    const double newCost = Evaluate(TcwNew, bRobust);
+    if (!(newCost <= cost)) {
+      lambda = lambda > 0.0 ? 10.0 * lambda : 1e-5 * maxDiagonal;
+      continue;
+    }
+
+    Tcw  = TcwNew;
+    cost = newCost;
+    if (dx.squaredNorm() < 1e-12) {
+      break;
+    }
+    Accumulate(H, g);
+    lambda /= 10.0;
+  }
+}
+
+int PoseSolver::OptimizeInertial(
+  ImuState&                      state,
+  std::vector<bool>&             vbOutlier,
+  const bool                     bRecInit,
+  Eigen::Matrix<double, 15, 15>& H
+) {
+  for (Observations& obs : mvObservations) {
+    obs.inlier.assign(obs.Size(), 1);
+    obs.chi2.resize(obs.Size());
+  }
+
+  // Edges of the g2o graph: the observations, the inertial and random walk ones and the prior
+  const std::size_t nEdges   = NumObservations() + (mpPrior ? 4 : 3);
+  const float*      chi2Mono = mpPrior ? kChi2MonoFrame : kChi2MonoKeyFrame;
+
+  // Unlike the pose only optimization, every round continues from the previous one
+  ImuState previous = mPrevious;
+  int      nBad     = 0;
+  int      nInliers = 0;
+  for (int round = 0; round < kRounds; round++) {
+    const bool bRobust = round < kRounds - 1;
+    OptimizeInertialRound(state, previous, bRobust);
+
+    EvaluateInertial(state, bRobust);
+    nBad     = 0;
+    nInliers = 0;
+    for (int kind = 0; kind < NUM_KINDS; kind++) {
+      Observations& obs = mvObservations[kind];
+      for (std::size_t i = 0; i < obs.Size(); i++) {
+        bool bOutlier;
+        if (kind == STEREO) {
+          bOutlier = !(obs.chi2[i] <= kChi2StereoInertial[round]);
+        } else {
+          const float thChi2 = obs.close[i] ? kChi2CloseFactor * chi2Mono[round] : chi2Mono[round];
+          bOutlier           = !(obs.chi2[i] <= thChi2) || !(obs.zc[i] > 0.f);
+        }
+        obs.inlier[i]           = !bOutlier;
+        vbOutlier[obs.index[i]] = bOutlier;
+        nBad += bOutlier;
+        nInliers += !bOutlier;
+      }
+    }
+
+    if (nEdges < 10) {
+      break;
+    }
+  }
+
+  // If not too much tracks, recover not too bad points
+  if (nInliers < kMinInertialInliers && !bRecInit) {
+    nBad = 0;
+    for (int kind = 0; kind < NUM_KINDS; kind++) {
+      Observations& obs    = mvObservations[kind];
+      const float   thChi2 = kind == STEREO ? kChi2StereoRecovered : kChi2MonoRecovered;
+      for (std::size_t i = 0; i < obs.Size(); i++) {
+        if (obs.chi2[i] < thChi2) {
+          vbOutlier[obs.index[i]] = false;
+        } else {
+          nBad++;
+        }
+      }
+    }
+  }
+
+  // Hessian of the final inliers without the Huber kernels, the previous state marginalized as
+  // Optimizer::Marginalize does
+  for (Observations& obs : mvObservations) {
+    for (std::size_t i = 0; i < obs.Size(); i++) {
+      obs.inlier[i] = !vbOutlier[obs.index[i]];
+    }
+  }
+  InertialHessian  Hs;
+  InertialGradient g;
+  AccumulateInertial(state, previous, false, false, Hs, g);
+  if (!mpPrior) {
+    H = Hs.topLeftCorner<15, 15>();
+  } else {
+    const Eigen::JacobiSVD<Eigen::Matrix<double, 15, 15>> svd(
+      Hs.bottomRightCorner<15, 15>(), Eigen::ComputeFullU | Eigen::ComputeFullV
+    );
+    Eigen::Matrix<double, 15, 1> invSingularValues = svd.singularValues();
+    for (int i = 0; i < 15; i++) {
+      invSingularValues(i) = invSingularValues(i) > 1e-6 ? 1.0 / invSingularValues(i) : 0.0;
+    }
+    const Eigen::Matrix<double, 15, 15> invHp
+      = svd.matrixV() * invSingularValues.asDiagonal() * svd.matrixU().transpose();
+    H = Hs.topLeftCorner<15, 15>()
+      - Hs.topRightCorner<15, 15>() * invHp * Hs.bottomLeftCorner<15, 15>();
+  }
+
+  return nBad;
+}
+
+void PoseSolver::OptimizeInertialRound(ImuState& state, ImuState& previous, const bool bRobust) {
+  InertialHessian              H;
+  InertialGradient             g;
+  Eigen::Matrix<double, 30, 1> dx;
+
+  // Plain Gauss-Newton steps, as the g2o optimizations
+  for (int it = 0; it < kIterations; it++) {
+    AccumulateInertial(state, previous, bRobust, true, H, g);
+    const bool bSolved = mpPrior ? SolveStep<30>(H, g, dx) : SolveStep<15>(H, g, dx);
+    if (!bSolved) {
+      return;
+    }
+
+    UpdateState(state, dx.head<15>());
+    if (mpPrior) {
+      UpdateState(previous, dx.tail<15>());
+    }
+    if (dx.squaredNorm() < 1e-12) {
+      break;
+    }
+  }
+}
+
+void PoseSolver::AccumulateInertial(
+  const ImuState&   state,
+  const ImuState&   previous,
+  const bool        bRobust,
+  const bool        bRobustPrior,
+  InertialHessian&  H,
+  InertialGradient& g
+) {
+  H.setZero();
+  g.setZero();
+
+  // The rows of the observations are derived for the update exp(dx) * Tcw of the camera pose.
+  // Updating the IMU pose as Twb * exp(dxb) moves the camera by exp(-Ad(Tcb) dxb) * Tcw.
+  EvaluateInertial(state, bRobust);
+  Eigen::Matrix<double, 6, 6> Hc;
+  Eigen::Matrix<double, 6, 1> gc;
+  Accumulate(Hc, gc);
+
+  const Eigen::Matrix3d       Rcb = mTcb.rotationMatrix().cast<double>();
+  const Eigen::Vector3d       tcb = mTcb.translation().cast<double>();
+  Eigen::Matrix<double, 6, 6> M   = Eigen::Matrix<double, 6, 6>::Zero();
+  M.block<3, 3>(0, 0)             = -Rcb;
+  M.block<3, 3>(3, 0)             = -Sophus::SO3d::hat(tcb) * Rcb;
+  M.block<3, 3>(3, 3)             = -Rcb;
+  H.topLeftCorner<6, 6>()         = M.transpose() * Hc * M;
+  g.head<6>()                     = M.transpose() * gc;
+
+  // Inertial residual, as EdgeInertial from the previous state to the frame one
+  const IMU::Bias b1(
+    previous.ba(0), previous.ba(1), previous.ba(2), previous.bg(0), previous.bg(1), previous.bg(2)
+  );
+  const Eigen::Matrix3d dR = mpInt->GetDeltaRotation(b1).cast<double>();
+  const Eigen::Vector3d dV = mpInt->GetDeltaVelocity(b1).cast<double>();
+  const Eigen::Vector3d dP = mpInt->GetDeltaPosition(b1).cast<double>();
+  const IMU::Bias       db = mpInt->GetDeltaBias(b1);
+  const Eigen::Vector3d dbg(db.bwx, db.bwy, db.bwz);
+  const Eigen::Vector3d gw(0.0, 0.0, -IMU::GRAVITY_VALUE);
+  const double          dt = mpInt->dT;
+
+  const Eigen::Matrix3d Rbw1  = previous.Rwb.transpose();
+  const Eigen::Matrix3d eR    = dR.transpose() * Rbw1 * state.Rwb;
+  const Eigen::Vector3d er    = LogSO3(eR);
+  const Eigen::Matrix3d invJr = InverseRightJacobianSO3(er);
+  const Eigen::Vector3d v12   = Rbw1 * (state.v - previous.v - gw * dt);
+  const Eigen::Vector3d p12
+    = Rbw1 * (state.twb - previous.twb - previous.v * dt - 0.5 * gw * dt * dt);
+  Vector9d ei;
+  ei << er, v12 - dV, p12 - dP;
+
+  const Eigen::Matrix3d        JRg = mpInt->JRg.cast<double>();
+  Eigen::Matrix<double, 9, 30> Ji  = Eigen::Matrix<double, 9, 30>::Zero();
+  Ji.block<3, 3>(0, 0)             = invJr;
+  Ji.block<3, 3>(6, 3)             = Rbw1 * state.Rwb;
+  Ji.block<3, 3>(3, 6)             = Rbw1;
+  Ji.block<3, 3>(0, 15)            = -invJr * state.Rwb.transpose() * previous.Rwb;
+  Ji.block<3, 3>(3, 15)            = Sophus::SO3d::hat(v12);
+  Ji.block<3, 3>(6, 15)            = Sophus::SO3d::hat(p12);
+  Ji.block<3, 3>(6, 18)            = -Eigen::Matrix3d::Identity();
+  Ji.block<3, 3>(3, 21)            = -Rbw1;
+  Ji.block<3, 3>(6, 21)            = -Rbw1 * dt;
+  Ji.block<3, 3>(0, 24)            = -invJr * eR.transpose() * RightJacobianSO3(JRg * dbg) * JRg;
+  Ji.block<3, 3>(3, 24)            = -mpInt->JVg.cast<double>();
+  Ji.block<3, 3>(6, 24)            = -mpInt->JPg.cast<double>();
+  Ji.block<3, 3>(3, 27)            = -mpInt->JVa.cast<double>();
+  Ji.block<3, 3>(6, 27)            = -mpInt->JPa.cast<double>();
+  AddResidual<9>(Ji, ei, mInfoInertial, 1.0, H, g);
+
+  // Random walks of the biases
+  Eigen::Matrix<double, 3, 30> Jb = Eigen::Matrix<double, 3, 30>::Zero();
+  Jb.block<3, 3>(0, 9)            = Eigen::Matrix3d::Identity();
+  Jb.block<3, 3>(0, 24)           = -Eigen::Matrix3d::Identity();
+  AddResidual<3>(Jb, state.bg - previous.bg, mInfoG, 1.0, H, g);
+  Jb.setZero();
+  Jb.block<3, 3>(0, 12) = Eigen::Matrix3d::Identity();
+  Jb.block<3, 3>(0, 27) = -Eigen::Matrix3d::Identity();
+  AddResidual<3>(Jb, state.ba - previous.ba, mInfoA, 1.0, H, g);
+
+  if (!mpPrior) {
+    return;
+  }
+
+  // Prior of the previous state, as EdgePriorPoseImu
+  const ConstraintPoseImu& prior = *mpPrior;
+  const Eigen::Vector3d    erp   = LogSO3(prior.Rwb.transpose() * previous.Rwb);
+  Vector15d                ep;
+  ep << erp, prior.Rwb.transpose() * (previous.twb - prior.twb), previous.v - prior.vwb,
+    previous.bg - prior.bg, previous.ba - prior.ba;
+
+  Eigen::Matrix<double, 15, 30> Jp = Eigen::Matrix<double, 15, 30>::Zero();
+  Jp.block<3, 3>(0, 15)            = InverseRightJacobianSO3(erp);
+  Jp.block<3, 3>(3, 18)            = prior.Rwb.transpose() * previous.Rwb;
+  Jp.block<9, 9>(6, 21).setIdentity();
+
+  double       w    = 1.0;
+  const double chi2 = ep.dot(prior.H * ep);
+  if (bRobustPrior && chi2 > kHuberPrior * kHuberPrior) {
+    w = kHuberPrior / std::sqrt(chi2);
+  }
+  AddResidual<15>(Jp, ep, prior.H, w, H, g);
+}
+
+double PoseSolver::EvaluateInertial(const ImuState& state, const bool bRobust) {
+  const Eigen::Matrix3d Rcb = mTcb.rotationMatrix().cast<double>();
+  const Eigen::Matrix3d Rcw = Rcb * state.Rwb.transpose();
+  const Eigen::Vector3d tcw = mTcb.translation().cast<double>() - Rcw * state.twb;
+  return Evaluate(Rcw.cast<float>(), tcw.cast<float>(), bRobust);
+}
+
+double PoseSolver::Evaluate(const Sophus::SE3d& Tcw, const bool bRobust) {
+  const Sophus::SE3f Tcwf = Tcw.cast<float>();
+  return Evaluate(Tcwf.rotationMatrix(), Tcwf.translation(), bRobust);
+}
+
+double PoseSolver::Evaluate(
+  const Eigen::Matrix3f& Rcw, const Eigen::Vector3f& tcw, const bool bRobust
+) {
+  const std::size_t nMono   = mvObservations[MONOCULAR].Size();
+  const std::size_t nRight  = mvObservations[RIGHT].Size();
+  const std::size_t nStereo = mvObservations[STEREO].Size();
+  const std::size_t nRows   = 2 * nMono + 2 * nRight + 3 * nStereo;
+  mnRows                    = (nRows + 3) / 4 * 4;
+  mvRows.resize(kRowEntries * mnRows);
+  ClearRows(mvRows.data() + nRows, mnRows, static_cast<int>(mnRows - nRows));
+
+  for (int kind = 0; kind < NUM_KINDS; kind++) {
+    Observations&     obs = mvObservations[kind];
+    const std::size_t n   = obs.Size();
+    obs.xc.resize(n);
+    obs.yc.resize(n);
+    obs.zc.resize(n);
+    if (kind == RIGHT) {
+      obs.xl.resize(n);
+      obs.yl.resize(n);
+      obs.zl.resize(n);
+      TransformPoints(
+        Rcw,
+        tcw,
+        obs.x.data(),
+        obs.y.data(),
+        obs.z.data(),
+        n,
+        obs.xl.data(),
+        obs.yl.data(),
+        obs.zl.data()
+      );
+      TransformPoints(
+        mTrl.rotationMatrix(),
+        mTrl.translation(),
+        obs.xl.data(),
+        obs.yl.data(),
+        obs.zl.data(),
+        n,
+        obs.xc.data(),
+        obs.yc.data(),
+        obs.zc.data()
+      );
+    } else {
+      TransformPoints(
+        Rcw,
+        tcw,
+        obs.x.data(),
+        obs.y.data(),
+        obs.z.data(),
+        n,
+        obs.xc.data(),
+        obs.yc.data(),
+        obs.zc.data()
+      );
+    }
+  }
+
+  const float deltaMono = std::sqrt(kChi2Mono);
+  double      cost      = 0.0;
+  float*      pRows     = mvRows.data();
+  EvaluateCamera(mvObservations[MONOCULAR], mpCamera, false, deltaMono, bRobust, pRows, cost);
+  pRows += 2 * nMono;
+  EvaluateCamera(mvObservations[RIGHT], mpCamera2, true, deltaMono, bRobust, pRows, cost);
+  pRows += 2 * nRight;
+  EvaluateStereo(bRobust, pRows, cost);
+  return cost;
+}
+
+void PoseSolver::EvaluateCamera(
+  Observations&    obs,
+  GeometricCamera* pCamera,
+  const bool       bRight,
+  const float      delta,
+  const bool       bRobust,
+  float*           pRows,
+  double&          cost
+) {
+  const std::size_t n = obs.Size();
+  if (n == 0) {
+    return;
+  }
+
+  obs.pu.resize(n);
+  obs.pv.resize(n);
+  obs.jac.resize(6 * n);
+  pCamera->projectBatch(
+    obs.xc.data(), obs.yc.data(), obs.zc.data(), n, obs.pu.data(), obs.pv.data()
+  );
+  pCamera->projectJacBatch(obs.xc.data(), obs.yc.data(), obs.zc.data(), n, obs.jac.data());
+
+  // The right points depend on the pose through the left ones, Xr = Rrl Xl + trl
+  const Eigen::Matrix3f Rrl = mTrl.rotationMatrix();
+  const float*          J   = obs.jac.data();
+  for (std::size_t i = 0; i < n; i++) {
+    const float eu   = obs.u[i] - obs.pu[i];
+    const float ev   = obs.v[i] - obs.pv[i];
+    const float chi2 = obs.invSigma2[i] * (eu * eu + ev * ev);
+    obs.chi2[i]      = chi2;
+
+    float* pRow = pRows + 2 * i;
+    if (!obs.inlier[i] || !std::isfinite(chi2)) {
+      ClearRows(pRow, mnRows, 2);
+      continue;
+    }
+
+    const float w = obs.invSigma2[i] * RobustWeight(chi2, delta, bRobust, cost);
+    Eigen::Vector3f pu(J[i], J[n + i], J[2 * n + i]);
+    Eigen::Vector3f pv(J[3 * n + i], J[4 * n + i], J[5 * n + i]);
+    Eigen::Vector3f Xc;
+    if (bRight) {
+      pu = Rrl.transpose() * pu;
+      pv = Rrl.transpose() * pv;
+      Xc = Eigen::Vector3f(obs.xl[i], obs.yl[i], obs.zl[i]);
+    } else {
+      Xc = Eigen::Vector3f(obs.xc[i], obs.yc[i], obs.zc[i]);
+    }
+    WriteRow(pRow, mnRows, Xc, pu, eu, w);
+    WriteRow(pRow + 1, mnRows, Xc, pv, ev, w);
+  }
+}
+
+void PoseSolver::EvaluateStereo(const bool bRobust, float* pRows, double& cost) {
+  Observations&     obs   = mvObservations[STEREO];
+  const float       delta = std::sqrt(kChi2Stereo);
+  const std::size_t n     = obs.Size();
+  for (std::size_t i = 0; i < n; i++) {
+    const Eigen::Vector3f Xc(obs.xc[i], obs.yc[i], obs.zc[i]);
+    const float           invz  = 1.f / Xc(2);
+    const float           invz2 = invz * invz;
+    const float           pu    = mfx * Xc(0) * invz + mcx;
+    const float           pv    = mfy * Xc(1) * invz + mcy;
+
+    const float eu   = obs.u[i] - pu;
+    const float ev   = obs.v[i] - pv;
+    const float er   = obs.ur[i] - (pu - mbf * invz);
+    const float chi2 = obs.invSigma2[i] * (eu * eu + ev * ev + er * er);
+    obs.chi2[i]      = chi2;
+
+    float* pRow = pRows + 3 * i;
+    if (!obs.inlier[i] || !std::isfinite(chi2)) {
+      ClearRows(pRow, mnRows, 3);
+      continue;
+    }
+
+    const float           w = obs.invSigma2[i] * RobustWeight(chi2, delta, bRobust, cost);
+    const Eigen::Vector3f ju(mfx * invz, 0.f, -mfx * Xc(0) * invz2);
+    const Eigen::Vector3f jv(0.f, mfy * invz, -mfy * Xc(1) * invz2);
+    const Eigen::Vector3f jr(ju(0), 0.f, ju(2) + mbf * invz2);
+    WriteRow(pRow, mnRows, Xc, ju, eu, w);
+    WriteRow(pRow + 1, mnRows, Xc, jv, ev, w);
+    WriteRow(pRow + 2, mnRows, Xc, jr, er, w);
+  }
+}
+
+void PoseSolver::Accumulate(Eigen::Matrix<double, 6, 6>& H, Eigen::Matrix<double, 6, 1>& g) const {
+  const float* J[6];
+  for (int k = 0; k < 6; k++) {
+    J[k] = mvRows.data() + k * mnRows;
+  }
+  const float* E = mvRows.data() + 6 * mnRows;
+  const float* W = mvRows.data() + 7 * mnRows;
+
+  // Upper triangle of H row by row, then g
+  double sums[27] = {};
+
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  // Partial sums of 4 rows per lane, flushed to double every block to bound the float rounding
+  const std::size_t kBlock = 256;
+  while (i < mnRows) {
+    __m128 acc[27];
+    for (int s = 0; s < 27; s++) {
+      acc[s] = _mm_setzero_ps();
+    }
+    const std::size_t end = std::min(mnRows, i + kBlock);
+    for (; i < end; i += 4) {
+      __m128 j[6], wj[6];
+      const __m128 w = _mm_loadu_ps(W + i);
+      for (int k = 0; k < 6; k++) {
+        j[k]  = _mm_loadu_ps(J[k] + i);
+        wj[k] = _mm_mul_ps(w, j[k]);
+      }
+      int s = 0;
+      for (int r = 0; r < 6; r++) {
+        for (int c = r; c < 6; c++) {
+          acc[s] = _mm_add_ps(acc[s], _mm_mul_ps(wj[r], j[c]));
+          s++;
+        }
+      }
+      const __m128 e = _mm_loadu_ps(E + i);
+      for (int k = 0; k < 6; k++) {
+        acc[21 + k] = _mm_add_ps(acc[21 + k], _mm_mul_ps(wj[k], e));
+      }
+    }
+    for (int s = 0; s < 27; s++) {
+      float lanes[4];
+      _mm_storeu_ps(lanes, acc[s]);
+      sums[s] += static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+  }
+#endif
+  for (; i < mnRows; i++) {
+    int s = 0;
+    for (int r = 0; r < 6; r++) {
+      const double wj = static_cast<double>(W[i]) * J[r][i];
+      for (int c = r; c < 6; c++) {
+        sums[s++] += wj * J[c][i];
+      }
+      sums[21 + r] += wj * E[i];
+    }
+  }
+
+  int s = 0;
+  for (int r = 0; r < 6; r++) {
+    for (int c = r; c < 6; c++) {
+      H(r, c) = H(c, r) = sums[s++];
+    }
+    g(r) = sums[21 + r];
+  }
+}
+
+} // namespace ORB_SLAM3
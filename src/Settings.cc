@@ -420,6 +420,16 @@ void Settings::readORB(cv::FileStorage& fSettings) {
   nLevels_     = readParameter<int>(fSettings, "ORBextractor.nLevels", found);
   initThFAST_  = readParameter<int>(fSettings, "ORBextractor.iniThFAST", found);
   minThFAST_   = readParameter<int>(fSettings, "ORBextractor.minThFAST", found);
+
+  nExtractorThreads_ = readParameter<int>(fSettings, "ORBextractor.nThreads", found, false);
+  if (!found) {
+    nExtractorThreads_ = 1;
+  }
+
+  nDescriptorAngleBins_ = readParameter<int>(fSettings, "ORBextractor.angleBins", found, false);
+  if (!found) {
+    nDescriptorAngleBins_ = 0;
+  }
 }
 
 void Settings::readViewer(cv::FileStorage& fSettings) {
@@ -456,7 +466,7 @@ void Settings::readOtherParameters(cv::FileStorage& fSettings) {
 }
 
 void Settings::precomputeRectificationMaps() {
-  // Precompute rectification maps, new calibrations, ...
+  // Precompute rectification maps, in fixed point, new calibrations, ...
   cv::Mat K1 = static_cast<Pinhole*>(calibration1_)->toK();
   K1.convertTo(K1, CV_64F);
   cv::Mat K2 = static_cast<Pinhole*>(calibration2_)->toK();
@@ -495,7 +505,7 @@ void Settings::precomputeRectificationMaps() {
     R_r1_u1,
     P1.rowRange(0, 3).colRange(0, 3),
     newImSize_,
-    CV_32F,
+    CV_16SC2,
     M1l_,
     M2l_
   );
@@ -505,7 +515,7 @@ void Settings::precomputeRectificationMaps() {
     R_r2_u2,
     P2.rowRange(0, 3).colRange(0, 3),
     newImSize_,
-    CV_32F,
+    CV_16SC2,
     M1r_,
     M2r_
   );
@@ -634,6 +644,8 @@ std::string Settings::Str() const {
   output += fmt::format("- ORB number of scales: {}\n"  , nLevels_    );
   output += fmt::format("- Initial FAST threshold: {}\n", initThFAST_ );
   output += fmt::format("- Min FAST threshold: {}\n"    , minThFAST_  );
+  output += fmt::format("- Extractor threads: {}\n"     , nExtractorThreads_);
+  output += fmt::format("- Descriptor angle bins: {}\n" , nDescriptorAngleBins_);
   // clang-format on
 
   return output;
@@ -0,0 +1,249 @@
+#include "StereoMatching.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "HammingDistance.h"
+
+namespace ORB_SLAM3 {
+
+void RowBuckets::Assign(
+  const std::vector<cv::KeyPoint>& vKeys, const std::vector<float>& vScaleFactors, const int nRows
+) {
+  const int n = static_cast<int>(vKeys.size());
+  mvMinRows.resize(n);
+  mvMaxRows.resize(n);
+
+  // Count the keypoints of every row, then turn the counts into row starts
+  mvRowStarts.assign(nRows + 1, 0);
+  for (int i = 0; i < n; i++) {
+    const float y = vKeys[i].pt.y;
+    const float r = 2.0f * vScaleFactors[vKeys[i].octave];
+    mvMinRows[i]  = std::max(static_cast<int>(std::floor(y - r)), 0);
+    mvMaxRows[i]  = std::min(static_cast<int>(std::ceil(y + r)), nRows - 1);
+    for (int row = mvMinRows[i]; row <= mvMaxRows[i]; row++) {
+      mvRowStarts[row + 1]++;
+    }
+  }
+  for (int row = 0; row < nRows; row++) {
+    mvRowStarts[row + 1] += mvRowStarts[row];
+  }
+
+  // Place the keypoints in increasing order, using the start of the next row as the fill position
+  // and shifting it back afterwards
+  mvIndices.resize(mvRowStarts[nRows]);
+  for (int i = 0; i < n; i++) {
+    for (int row = mvMinRows[i]; row <= mvMaxRows[i]; row++) {
+      mvIndices[mvRowStarts[row]++] = i;
+    }
+  }
+  for (int row = nRows; row > 0; row--) {
+    mvRowStarts[row] = mvRowStarts[row - 1];
+  }
+  mvRowStarts[0] = 0;
+}
+
+namespace {
+
+// Whether a unit vector at |dot| from a unit normal is within the angle a + b of its plane, with
+// sinA, cosA, sinB and cosB the sine and cosine of a and b.
+inline bool WithinAngleSum(
+  const float dot, const float sinA, const float cosA, const float sinB, const float cosB
+) {
+  const float cosSum = cosA * cosB - sinA * sinB;
+  return cosSum <= 0.0f || std::abs(dot) <= sinA * cosB + cosA * sinB;
+}
+
+} // namespace
+
+void BearingCells::Assign(
+  const std::vector<cv::Point2f>&     vPoints,
+  const std::vector<Eigen::Vector3f>& vBearings,
+  const std::vector<float>&           vTolerances,
+  const int                           cellSize
+) {
+  const int n = static_cast<int>(vPoints.size());
+  mvUnitBearings.resize(n);
+  mvSinTolerances.resize(n);
+  mvCosTolerances.resize(n);
+  mvCells.resize(n);
+
+  int nCols = 1, nRows = 1;
+  for (int i = 0; i < n; i++) {
+    mvUnitBearings[i]  = vBearings[i].normalized();
+    mvSinTolerances[i] = std::sin(vTolerances[i]);
+    mvCosTolerances[i] = std::cos(vTolerances[i]);
+    nCols              = std::max(nCols, static_cast<int>(vPoints[i].x) / cellSize + 1);
+    nRows              = std::max(nRows, static_cast<int>(vPoints[i].y) / cellSize + 1);
+  }
+
+  // Counting sort of the keypoints by cell, then drop the empty cells
+  std::vector<int> vStarts(nCols * nRows + 1, 0);
+  for (int i = 0; i < n; i++) {
+    const int x = std::max(static_cast<int>(vPoints[i].x) / cellSize, 0);
+    const int y = std::max(static_cast<int>(vPoints[i].y) / cellSize, 0);
+    mvCells[i]  = y * nCols + x;
+    vStarts[mvCells[i] + 1]++;
+  }
+  mvCellStarts.assign(1, 0);
+  for (std::size_t c = 1; c < vStarts.size(); c++) {
+    if (vStarts[c] > 0) {
+      mvCellStarts.push_back(mvCellStarts.back() + vStarts[c]);
+    }
+    vStarts[c] += vStarts[c - 1];
+  }
+  mvIndices.resize(n);
+  for (int i = 0; i < n; i++) {
+    mvIndices[vStarts[mvCells[i]]++] = i;
+  }
+
+  // Cone of every cell: mean bearing, angle to its farthest keypoint and largest tolerance
+  const int nCells = static_cast<int>(mvCellStarts.size()) - 1;
+  mvCellCenters.resize(nCells);
+  mvCellSinBounds.resize(nCells);
+  mvCellCosBounds.resize(nCells);
+  for (int c = 0; c < nCells; c++) {
+    Eigen::Vector3f center = Eigen::Vector3f::Zero();
+    for (int k = mvCellStarts[c]; k < mvCellStarts[c + 1]; k++) {
+      center += mvUnitBearings[mvIndices[k]];
+    }
+    center.normalize();
+
+    float minCos = 1.0f, maxTolerance = 0.0f;
+    for (int k = mvCellStarts[c]; k < mvCellStarts[c + 1]; k++) {
+      minCos       = std::min(minCos, center.dot(mvUnitBearings[mvIndices[k]]));
+      maxTolerance = std::max(maxTolerance, vTolerances[mvIndices[k]]);
+    }
+
+    const float bound = std::acos(std::max(minCos, -1.0f)) + maxTolerance;
+
+    mvCellCenters[c]   = center;
+    mvCellSinBounds[c] = bound < CV_PI / 2 ? std::sin(bound) : 1.0f;
+    mvCellCosBounds[c] = bound < CV_PI / 2 ? std::cos(bound) : 0.0f;
+  }
+}
+
+void BearingCells::Query(
+  const Eigen::Vector3f& n, const float tolerance, std::vector<int>& vIndices
+) const {
+  const float sinTolerance = std::sin(tolerance);
+  const float cosTolerance = std::cos(tolerance);
+
+  vIndices.clear();
+  const int nCells = static_cast<int>(mvCellCenters.size());
+  for (int c = 0; c < nCells; c++) {
+    // A keypoint of the cell is at least as far from the plane as the center, minus the cone angle
+    if (!WithinAngleSum(
+          n.dot(mvCellCenters[c]),
+          mvCellSinBounds[c],
+          mvCellCosBounds[c],
+          sinTolerance,
+          cosTolerance
+        )) {
+      continue;
+    }
+
+    for (int k = mvCellStarts[c]; k < mvCellStarts[c + 1]; k++) {
+      const int i = mvIndices[k];
+      if (WithinAngleSum(
+            n.dot(mvUnitBearings[i]),
+            mvSinTolerances[i],
+            mvCosTolerances[i],
+            sinTolerance,
+            cosTolerance
+          )) {
+        vIndices.push_back(i);
+      }
+    }
+  }
+  std::sort(vIndices.begin(), vIndices.end());
+}
+
+int MatchInBand(
+  const unsigned char*        query,
+  const unsigned char* const* candidates,
+  const int                   n,
+  const float                 ratio,
+  const int                   thDist,
+  const int                   thLoneDist
+) {
+  if (n <= 0) {
+    return -1;
+  }
+  const HammingMatch match = FindBestHamming(query, candidates, n);
+  if (n == 1) {
+    return match.bestDist <= thLoneDist ? match.bestIdx : -1;
+  }
+  if (match.bestDist > thDist || match.bestDist >= match.secondDist * ratio) {
+    return -1;
+  }
+  return match.bestIdx;
+}
+
+void PatchSADSweep(
+  const cv::Mat& left,
+  const cv::Mat& right,
+  const int      xL,
+  const int      xR,
+  const int      y,
+  const int      w,
+  const int      L,
+  int*           distances
+) {
+  const int size  = 2 * w + 1;
+  const int sweep = size + 2 * L;
+
+#if defined(__SSE2__)
+  if (size <= 16 && sweep <= 32) {
+    // Rows are copied to zero padded buffers, so that full width loads never leave the images
+    alignas(16) uchar vPatch[16] = {};
+    alignas(16) uchar vStrip[32] = {};
+    alignas(16) uchar vMask[16]  = {};
+    std::memset(vMask, 0xFF, size);
+    const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(vMask));
+
+    __m128i vSums[32];
+    for (int d = 0; d <= 2 * L; d++) {
+      vSums[d] = _mm_setzero_si128();
+    }
+
+    for (int v = y - w; v <= y + w; v++) {
+      std::memcpy(vPatch, left.ptr<uchar>(v) + xL - w, size);
+      std::memcpy(vStrip, right.ptr<uchar>(v) + xR - L - w, sweep);
+      const __m128i patch = _mm_load_si128(reinterpret_cast<const __m128i*>(vPatch));
+      for (int d = 0; d <= 2 * L; d++) {
+        const __m128i strip
+          = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(vStrip + d)), mask);
+        vSums[d] = _mm_add_epi64(vSums[d], _mm_sad_epu8(patch, strip));
+      }
+    }
+
+    for (int d = 0; d <= 2 * L; d++) {
+      distances[d] = _mm_cvtsi128_si32(vSums[d]) + _mm_cvtsi128_si32(_mm_srli_si128(vSums[d], 8));
+    }
+    return;
+  }
+#endif
+
+  std::fill(distances, distances + 2 * L + 1, 0);
+  for (int v = y - w; v <= y + w; v++) {
+    const uchar* rowL = left.ptr<uchar>(v) + xL - w;
+    const uchar* rowR = right.ptr<uchar>(v) + xR - L - w;
+    for (int d = 0; d <= 2 * L; d++) {
+      int sum = 0;
+      for (int u = 0; u < size; u++) {
+        sum += std::abs(rowL[u] - rowR[d + u]);
+      }
+      distances[d] += sum;
+    }
+  }
+}
+
+bool PatchSADSweepFits(const int xR, const int w, const int L, const int cols) {
+  return xR - L - w >= 0 && xR + L + w + 1 < cols;
+}
+
+} // namespace ORB_SLAM3
@@ -24,6 +24,7 @@
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <stdexcept>
 #include <thread>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -117,6 +118,17 @@ System::System(
     activeLC = static_cast<int>(fsSettings["loopClosing"]) != 0;
   }
 
+  // Threads of each of tracking, local mapping and loop closing, read once for the three of them
+  int nThreads = 1;
+  if (settings_) {
+    nThreads = settings_->nExtractorThreads();
+  } else {
+    node = fsSettings["ORBextractor.nThreads"];
+    if (!node.empty() && node.isInt()) {
+      nThreads = node.operator int();
+    }
+  }
+
   mStrVocabularyFilePath = strVocFile;
 
   bool loadedAtlas = false;
@@ -202,7 +214,8 @@ System::System(
     strSettingsFile,
     mSensor,
     settings_,
-    strSequence
+    strSequence,
+    nThreads
   );
 
   // Initialize the Local Mapping thread and launch
@@ -212,7 +225,8 @@ System::System(
     mpAtlas,
     mSensor == MONOCULAR || mSensor == IMU_MONOCULAR,
     mSensor == IMU_MONOCULAR || mSensor == IMU_STEREO || mSensor == IMU_RGBD,
-    strSequence
+    strSequence,
+    nThreads
   );
   mptLocalMapping        = new std::thread(&ORB_SLAM3::LocalMapping::Run, mpLocalMapper);
   mpLocalMapper->mInitFr = initFr;
@@ -239,7 +253,8 @@ System::System(
     mpKeyFrameDatabase,
     mpVocabulary,
     mSensor != MONOCULAR,
-    activeLC
+    activeLC,
+    nThreads
   ); // mSensor!=MONOCULAR);
   mptLoopClosing = new std::thread(&ORB_SLAM3::LoopClosing::Run, mpLoopCloser);
 
@@ -278,26 +293,10 @@ Sophus::SE3f System::TrackStereo(
     throw std::runtime_error("Invalid sensor type, it should be Stereo or Stereo-Inertial");
   }
 
-  cv::Mat imLeftToFeed, imRightToFeed;
-  if (settings_ && settings_->needToRectify()) {
-    _logger->debug("Rectifying both images...");
-
-    cv::Mat M1l = settings_->M1l();
-    cv::Mat M2l = settings_->M2l();
-    cv::Mat M1r = settings_->M1r();
-    cv::Mat M2r = settings_->M2r();
-
-    cv::remap(imLeft, imLeftToFeed, M1l, M2l, cv::INTER_LINEAR);
-    cv::remap(imRight, imRightToFeed, M1r, M2r, cv::INTER_LINEAR);
-  } else if (settings_ && settings_->needToResize()) {
-    _logger->debug("Resizing both images...");
-
-    cv::resize(imLeft, imLeftToFeed, settings_->newImSize());
-    cv::resize(imRight, imRightToFeed, settings_->newImSize());
-  } else {
-    _logger->debug("Cloning both image...");
-    imLeftToFeed  = imLeft.clone();
-    imRightToFeed = imRight.clone();
+  // The images are only read by the tracker, which rectifies or resizes them, if needed, into the
+  // pyramids of its extractors
+  if (settings_ && (settings_->needToRectify() || settings_->needToResize())) {
+    _logger->debug("Feeding both images to be conditioned...");
   }
 
   // Check mode change
@@ -349,7 +348,7 @@ Sophus::SE3f System::TrackStereo(
   }
 
   _logger->debug("Grabbing Stereo images...");
-  Sophus::SE3f Tcw = mpTracker->GrabImageStereo(imLeftToFeed, imRightToFeed, timestamp, filename);
+  Sophus::SE3f Tcw = mpTracker->GrabImageStereo(imLeft, imRight, timestamp, filename);
 
   std::unique_lock<std::mutex> lock2(mMutexState);
   mTrackingState      = mpTracker->mState;
@@ -376,14 +375,17 @@ Sophus::SE3f System::TrackRGBD(
     throw std::runtime_error("Invalid sensor type, it should be RGB-D or RGB-D Inertial");
   }
 
-  cv::Mat imToFeed      = im.clone();
-  cv::Mat imDepthToFeed = depthmap.clone();
+  // The images are only read by the tracker
+  cv::Mat imToFeed      = im;
+  cv::Mat imDepthToFeed = depthmap;
   if (settings_ && settings_->needToResize()) {
     _logger->debug("Resizing RGB-D image...");
     cv::Mat resizedIm;
     cv::resize(im, resizedIm, settings_->newImSize());
     imToFeed = resizedIm;
-    cv::resize(depthmap, imDepthToFeed, settings_->newImSize());
+    cv::Mat resizedDepthmap;
+    cv::resize(depthmap, resizedDepthmap, settings_->newImSize());
+    imDepthToFeed = resizedDepthmap;
   }
 
   // Check mode change
@@ -469,7 +471,8 @@ Sophus::SE3f System::TrackMonocular(
     throw std::runtime_error("Invalid sensor type, it should be Monocular or Monocular-Inertial");
   }
 
-  cv::Mat imToFeed = im.clone();
+  // The image is only read by the tracker
+  cv::Mat imToFeed = im;
   if (settings_ && settings_->needToResize()) {
     _logger->debug("Resizing image...");
     cv::Mat resizedIm;
@@ -542,6 +545,46 @@ Sophus::SE3f System::TrackMonocular(
   return Tcw;
 }
 
+Sophus::SE3f System::TrackStereo(
+  const ImageView&               left,
+  const ImageView&               right,
+  const double&                  timestamp,
+  const std::vector<IMU::Point>& vImuMeas,
+  std::string                    filename
+) {
+  ViewRelease releaseLeft(left), releaseRight(right);
+  const cv::Mat imLeft  = ViewToGray(left, mvViewGrayBuffers[0], releaseLeft);
+  const cv::Mat imRight = ViewToGray(right, mvViewGrayBuffers[1], releaseRight);
+  return TrackStereo(imLeft, imRight, timestamp, vImuMeas, filename);
+}
+
+Sophus::SE3f System::TrackRGBD(
+  const ImageView&               im,
+  const ImageView&               depthmap,
+  const double&                  timestamp,
+  const std::vector<IMU::Point>& vImuMeas,
+  std::string                    filename
+) {
+  if (depthmap.format != ImageView::DEPTH16 && depthmap.format != ImageView::DEPTH32F) {
+    throw std::invalid_argument("Invalid depth map format, it should be DEPTH16 or DEPTH32F");
+  }
+
+  ViewRelease   releaseIm(im), releaseDepthmap(depthmap);
+  const cv::Mat imGray = ViewToGray(im, mvViewGrayBuffers[0], releaseIm);
+  return TrackRGBD(imGray, depthmap.Mat(), timestamp, vImuMeas, filename);
+}
+
+Sophus::SE3f System::TrackMonocular(
+  const ImageView&               im,
+  const double&                  timestamp,
+  const std::vector<IMU::Point>& vImuMeas,
+  std::string                    filename
+) {
+  ViewRelease   releaseIm(im);
+  const cv::Mat imGray = ViewToGray(im, mvViewGrayBuffers[0], releaseIm);
+  return TrackMonocular(imGray, timestamp, vImuMeas, filename);
+}
+
 void System::ActivateLocalizationMode() {
   std::unique_lock<std::mutex> lock(mMutexMode);
   mbActivateLocalizationMode = true;
@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace ORB_SLAM3 {
+
+ThreadPool::ThreadPool(const int nThreads)
+  : mpJob(nullptr)
+  , mnNext(0)
+  , mnEnd(0)
+  , mnBusy(0)
+  , mnGeneration(0)
+  , mbStop(false) {
+  const int nWorkers = std::max(nThreads, 1) - 1;
+  mvWorkers.reserve(nWorkers);
+  for (int i = 0; i < nWorkers; i++) {
+    mvWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mbStop = true;
+  }
+  mcvWork.notify_all();
+  for (std::thread& worker : mvWorkers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(const int begin, const int end, const std::function<void(int)>& fn) {
+  if (end - begin <= 0) {
+    return;
+  }
+
+  if (mvWorkers.empty() || end - begin == 1) {
+    for (int i = begin; i < end; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lockCaller(mMutexCaller);
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mpJob  = &fn;
+    mnNext = begin;
+    mnEnd  = end;
+    mnBusy = static_cast<int>(mvWorkers.size());
+    mnGeneration++;
+  }
+  mcvWork.notify_all();
+
+  RunJob();
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  mcvDone.wait(lock, [this] { return mnBusy == 0; });
+  mpJob = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+  unsigned long nSeenGeneration = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mcvWork.wait(lock, [&] { return mbStop || mnGeneration != nSeenGeneration; });
+      if (mbStop) {
+        return;
+      }
+      nSeenGeneration = mnGeneration;
+    }
+
+    RunJob();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (--mnBusy == 0) {
+      mcvDone.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunJob() {
+  for (int i = mnNext++; i < mnEnd; i = mnNext++) {
+    (*mpJob)(i);
+  }
+}
+
+void ParallelFor(
+  ThreadPool* pThreadPool, const int begin, const int end, const std::function<void(int)>& fn
+) {
+  if (pThreadPool) {
+    pThreadPool->ParallelFor(begin, end, fn);
+    return;
+  }
+  for (int i = begin; i < end; i++) {
+    fn(i);
+  }
+}
+
+} // namespace ORB_SLAM3
@@ -23,6 +23,7 @@
 #include "Atlas.h"
 #include "Converter.h"
 #include "FrameDrawer.h"
+#include "ImageConditioner.h"
 #include "KannalaBrandt8.h"
 #include "KeyFrameDatabase.h"
 #include "LocalMapping.h"
@@ -33,8 +34,10 @@
 #include "ORBmatcher.h"
 #include "Optimizer.h"
 #include "Pinhole.h"
+#include "PoseSolver.h"
 #include "Settings.h"
 #include "System.h"
+#include "ThreadPool.h"
 #include "Viewer.h"
 
 namespace ORB_SLAM3 {
@@ -49,7 +52,8 @@ Tracking::Tracking(
   const std::string& strSettingPath,
   const int          sensor,
   Settings*          settings,
-  const std::string& _nameSeq
+  const std::string& _nameSeq,
+  const int          nThreads
 )
   : mState(NO_IMAGES_YET)
   , mSensor(sensor)
@@ -58,6 +62,8 @@ Tracking::Tracking(
   , mbOnlyTracking(false)
   , mbMapUpdated(false)
   , mbVO(false)
+  , mpThreadPool(std::make_unique<ThreadPool>(nThreads))
+  , mpPoseSolver(std::make_unique<PoseSolver>())
   , mpORBVocabulary(pVoc)
   , mpKeyFrameDB(pKFDB)
   , mbReadyToInitializate(false)
@@ -572,17 +578,33 @@ void Tracking::newParameterLoader(Settings* settings) {
   int   fIniThFAST   = settings->initThFAST();
   int   fMinThFAST   = settings->minThFAST();
   float fScaleFactor = settings->scaleFactor();
+  int   nAngleBins   = settings->nDescriptorAngleBins();
 
-  mpORBextractorLeft = new ORBextractor(nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+  mpORBextractorLeft = new ORBextractor(
+    nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+  );
 
   if (mSensor == System::STEREO || mSensor == System::IMU_STEREO) {
-    mpORBextractorRight
-      = new ORBextractor(nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+    mpORBextractorRight = new ORBextractor(
+      nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+    );
+
+    // Stereo images are rectified or resized straight into the pyramids of the extractors
+    if (settings->needToRectify()) {
+      mpConditionerLeft  = std::make_unique<ImageConditioner>(settings->M1l(), settings->M2l());
+      mpConditionerRight = std::make_unique<ImageConditioner>(settings->M1r(), settings->M2r());
+    } else if (settings->needToResize()) {
+      mpConditionerLeft  = std::make_unique<ImageConditioner>(settings->newImSize());
+      mpConditionerRight = std::make_unique<ImageConditioner>(settings->newImSize());
+    }
+    mpORBextractorLeft->SetInputConditioner(mpConditionerLeft.get());
+    mpORBextractorRight->SetInputConditioner(mpConditionerRight.get());
   }
 
   if (mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR) {
-    mpIniORBextractor
-      = new ORBextractor(5 * nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+    mpIniORBextractor = new ORBextractor(
+      5 * nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+    );
   }
 
   // IMU parameters
@@ -1168,16 +1190,26 @@ bool Tracking::ParseORBParamFile(cv::FileStorage& fSettings) {
     return false;
   }
 
-  mpORBextractorLeft = new ORBextractor(nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+  int nAngleBins = 0;
+  node           = fSettings["ORBextractor.angleBins"];
+  if (!node.empty() && node.isInt()) {
+    nAngleBins = node.operator int();
+  }
+
+  mpORBextractorLeft = new ORBextractor(
+    nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+  );
 
   if (mSensor == System::STEREO || mSensor == System::IMU_STEREO) {
-    mpORBextractorRight
-      = new ORBextractor(nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+    mpORBextractorRight = new ORBextractor(
+      nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+    );
   }
 
   if (mSensor == System::MONOCULAR || mSensor == System::IMU_MONOCULAR) {
-    mpIniORBextractor
-      = new ORBextractor(5 * nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST);
+    mpIniORBextractor = new ORBextractor(
+      5 * nFeatures, fScaleFactor, nLevels, fIniThFAST, fMinThFAST, mpThreadPool.get(), nAngleBins
+    );
   }
 
   _logger->info(
@@ -1186,12 +1218,16 @@ bool Tracking::ParseORBParamFile(cv::FileStorage& fSettings) {
     "- Scale Levels: {}\n"
     "- Scale Factor: {:.6f}\n"
     "- Initial Fast Threshold: {}\n"
-    "- Minimum Fast Threshold: {}\n",
+    "- Minimum Fast Threshold: {}\n"
+    "- Extractor Threads: {}\n"
+    "- Descriptor Angle Bins: {}\n",
     nFeatures,
     nLevels,
     fScaleFactor,
     fIniThFAST,
-    fMinThFAST
+    fMinThFAST,
+    mpThreadPool->NumThreads(),
+    nAngleBins
   );
 
   return true;
@@ -1326,35 +1362,29 @@ bool Tracking::GetStepByStep() {
   return bStepByStep;
 }
 
+cv::Mat Tracking::ToGray(const cv::Mat& im, cv::Mat& buffer) {
+  if (im.channels() == 1) {
+    return im;
+  }
+
+  _logger->debug("Grabbed image has {} channels", im.channels());
+  if (im.channels() == 3) {
+    cv::cvtColor(im, buffer, mbRGB ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+  } else {
+    cv::cvtColor(im, buffer, mbRGB ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+  }
+  return buffer;
+}
+
 Sophus::SE3f Tracking::GrabImageStereo(
   const cv::Mat& imRectLeft,
   const cv::Mat& imRectRight,
   const double&  timestamp,
   std::string    filename
 ) {
-  mImGray             = imRectLeft;
-  cv::Mat imGrayRight = imRectRight;
-  mImRight            = imRectRight;
-
-  if (mImGray.channels() == 3) {
-    _logger->debug("Grabbed images have 3 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-      cv::cvtColor(imGrayRight, imGrayRight, cv::COLOR_RGB2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
-      cv::cvtColor(imGrayRight, imGrayRight, cv::COLOR_BGR2GRAY);
-    }
-  } else if (mImGray.channels() == 4) {
-    _logger->debug("Grabbed images have 4 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-      cv::cvtColor(imGrayRight, imGrayRight, cv::COLOR_RGBA2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
-      cv::cvtColor(imGrayRight, imGrayRight, cv::COLOR_BGRA2GRAY);
-    }
-  }
+  mImGray                   = ToGray(imRectLeft, mvGrayBuffers[0]);
+  const cv::Mat imGrayRight = ToGray(imRectRight, mvGrayBuffers[1]);
+  mImRight                  = imRectRight;
 
   _logger->debug("Creating frame...");
   if (mSensor == System::STEREO && !mpCamera2) {
@@ -1369,7 +1399,11 @@ Sophus::SE3f Tracking::GrabImageStereo(
       mDistCoef,
       mbf,
       mThDepth,
-      mpCamera
+      mpCamera,
+      nullptr,
+      IMU::Calib(),
+      mpThreadPool.get(),
+      &mRowBuckets
     );
   } else if (mSensor == System::STEREO && mpCamera2) {
     mCurrentFrame = Frame(
@@ -1385,7 +1419,11 @@ Sophus::SE3f Tracking::GrabImageStereo(
       mThDepth,
       mpCamera,
       mpCamera2,
-      mTlr
+      mTlr,
+      nullptr,
+      IMU::Calib(),
+      mpThreadPool.get(),
+      &mBearingCells
     );
   } else if (mSensor == System::IMU_STEREO && !mpCamera2) {
     mCurrentFrame = Frame(
@@ -1401,7 +1439,9 @@ Sophus::SE3f Tracking::GrabImageStereo(
       mThDepth,
       mpCamera,
       &mLastFrame,
-      *mpImuCalib
+      *mpImuCalib,
+      mpThreadPool.get(),
+      &mRowBuckets
     );
   } else if (mSensor == System::IMU_STEREO && mpCamera2) {
     mCurrentFrame = Frame(
@@ -1419,11 +1459,19 @@ Sophus::SE3f Tracking::GrabImageStereo(
       mpCamera2,
       mTlr,
       &mLastFrame,
-      *mpImuCalib
+      *mpImuCalib,
+      mpThreadPool.get(),
+      &mBearingCells
     );
   }
   _logger->debug("Frame created with ID {}", mCurrentFrame.mnId);
 
+  // Conditioned images only exist as level 0 of the pyramids, valid until the next frame
+  if (mpConditionerLeft) {
+    mImGray  = mpORBextractorLeft->mvImagePyramid[0];
+    mImRight = mpORBextractorRight->mvImagePyramid[0];
+  }
+
   mCurrentFrame.mNameFile = filename;
   mCurrentFrame.mnDataset = mnNumDataset;
 
@@ -1442,27 +1490,13 @@ Sophus::SE3f Tracking::GrabImageStereo(
 Sophus::SE3f Tracking::GrabImageRGBD(
   const cv::Mat& imRGB, const cv::Mat& imD, const double& timestamp, std::string filename
 ) {
-  mImGray         = imRGB;
+  mImGray         = ToGray(imRGB, mvGrayBuffers[0]);
   cv::Mat imDepth = imD;
 
-  if (mImGray.channels() == 3) {
-    _logger->debug("Grabbed image has 3 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
-    }
-  } else if (mImGray.channels() == 4) {
-    _logger->debug("Grabbed image has 4 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
-    }
-  }
-
+  // Converted into a buffer of our own, the input may be read only
   if ((std::fabs(mDepthMapFactor - 1.0f) > 1e-5) || imDepth.type() != CV_32F) {
-    imDepth.convertTo(imDepth, CV_32F, mDepthMapFactor);
+    imD.convertTo(mDepthBuffer, CV_32F, mDepthMapFactor);
+    imDepth = mDepthBuffer;
     _logger->debug("Grabbed image converted to CV_32F");
   }
 
@@ -1515,22 +1549,7 @@ Sophus::SE3f Tracking::GrabImageRGBD(
 Sophus::SE3f Tracking::GrabImageMonocular(
   const cv::Mat& im, const double& timestamp, std::string filename
 ) {
-  mImGray = im;
-  if (mImGray.channels() == 3) {
-    _logger->debug("Grabbed image has 3 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGB2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGR2GRAY);
-    }
-  } else if (mImGray.channels() == 4) {
-    _logger->debug("Grabbed image has 4 channels");
-    if (mbRGB) {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_RGBA2GRAY);
-    } else {
-      cv::cvtColor(mImGray, mImGray, cv::COLOR_BGRA2GRAY);
-    }
-  }
+  mImGray = ToGray(im, mvGrayBuffers[0]);
 
   _logger->debug("Creating frame...");
   if (mSensor == System::MONOCULAR) {
@@ -2461,7 +2480,9 @@ void Tracking::CreateInitialMapMonocular() {
 
   // Bundle Adjustment
   _logger->info("New map created with {} map points", mpAtlas->MapPointsInMap());
-  Optimizer::GlobalBundleAdjustemnt(mpAtlas->GetCurrentMap(), 20);
+  Optimizer::GlobalBundleAdjustemnt(
+    mpAtlas->GetCurrentMap(), 20, NULL, 0, true, mpThreadPool.get()
+  );
 
   float medianDepth = pKFini->ComputeSceneMedianDepth(2);
   float invMedianDepth;
@@ -2615,7 +2636,7 @@ bool Tracking::TrackReferenceKeyFrame() {
 
   // mCurrentFrame.PrintPointDistribution();
 
-  Optimizer::PoseOptimization(&mCurrentFrame);
+  Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
 
   // Discard outliers
   int nmatchesMap = 0;
@@ -2781,7 +2802,7 @@ bool Tracking::TrackWithMotionModel() {
   }
 
   // Optimize frame pose with all matches
-  Optimizer::PoseOptimization(&mCurrentFrame);
+  Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
 
   // Discard outliers
   int nmatchesMap = 0;
@@ -2838,20 +2859,22 @@ bool Tracking::TrackLocalMap() {
 
   int inliers;
   if (!mpAtlas->isImuInitialized()) {
-    Optimizer::PoseOptimization(&mCurrentFrame);
+    Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
   } else {
     if (mCurrentFrame.mnId <= mnLastRelocFrameId + mnFramesToResetIMU) {
       _logger->debug("Optimizing pose when tracking local map...");
-      Optimizer::PoseOptimization(&mCurrentFrame);
+      Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
     } else {
       // if(!mbMapUpdated && mState == OK) //  && (mnMatchesInliers>30))
       if (!mbMapUpdated) { // && (mnMatchesInliers>30))
         _logger->debug("Optimizing pose with IMU from last frame when tracking local map...");
-        inliers = Optimizer::PoseInertialOptimizationLastFrame(&mCurrentFrame
+        inliers = Optimizer::PoseInertialOptimizationLastFrame(
+          &mCurrentFrame, false, mpPoseSolver.get()
         ); // , !mpLastKeyFrame->GetMap()->GetIniertialBA1());
       } else {
         _logger->debug("Optimizing pose with IMU from last key frame when tracking local map...");
-        inliers = Optimizer::PoseInertialOptimizationLastKeyFrame(&mCurrentFrame
+        inliers = Optimizer::PoseInertialOptimizationLastKeyFrame(
+          &mCurrentFrame, false, mpPoseSolver.get()
         ); // , !mpLastKeyFrame->GetMap()->GetIniertialBA1());
       }
     }
@@ -3205,6 +3228,8 @@ void Tracking::SearchLocalPoints() {
   int nToMatch = 0;
 
   // Project points in frame and check its visibility
+  std::vector<MapPoint*> vpToProject;
+  vpToProject.reserve(mvpLocalMapPoints.size());
   for (std::vector<MapPoint*>::iterator vit  = mvpLocalMapPoints.begin(),
                                         vend = mvpLocalMapPoints.end();
        vit != vend;
@@ -3217,8 +3242,15 @@ void Tracking::SearchLocalPoints() {
     if (pMP->isBad()) {
       continue;
     }
-    // Project (this fills MapPoint variables for matching)
-    if (mCurrentFrame.isInFrustum(pMP, 0.5)) {
+    vpToProject.push_back(pMP);
+  }
+
+  // Project all of them at once (this fills MapPoint variables for matching)
+  std::vector<bool> vbInFrustum;
+  mCurrentFrame.isInFrustum(vpToProject, 0.5, vbInFrustum);
+  for (std::size_t i = 0; i < vpToProject.size(); i++) {
+    MapPoint* pMP = vpToProject[i];
+    if (vbInFrustum[i]) {
       pMP->IncreaseVisible();
       nToMatch++;
     }
@@ -3257,7 +3289,8 @@ void Tracking::SearchLocalPoints() {
       mvpLocalMapPoints,
       th,
       mpLocalMapper->mbFarPoints,
-      mpLocalMapper->mThFarPoints
+      mpLocalMapper->mThFarPoints,
+      mpThreadPool->NumThreads() > 1 ? mpThreadPool.get() : nullptr
     );
   }
 }
@@ -3545,7 +3578,7 @@ bool Tracking::Relocalization() {
           }
         }
 
-        int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+        int nGood = Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
 
         if (nGood < 10) {
           continue;
@@ -3563,7 +3596,7 @@ bool Tracking::Relocalization() {
             = matcher2.SearchByProjection(mCurrentFrame, vpCandidateKFs[i], sFound, 10, 100);
 
           if (nadditional + nGood >= 50) {
-            nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+            nGood = Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
 
             // If many inliers but still not enough, search by projection again in a narrower window
             // the camera has been already optimized with many points
@@ -3579,7 +3612,7 @@ bool Tracking::Relocalization() {
 
               // Final optimization
               if (nGood + nadditional >= 50) {
-                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                nGood = Optimizer::PoseOptimization(&mCurrentFrame, mpPoseSolver.get());
 
                 for (int io = 0; io < mCurrentFrame.N; io++) {
                   if (mCurrentFrame.mvbOutlier[io]) {
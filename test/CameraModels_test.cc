@@ -0,0 +1,100 @@
+#include "KannalaBrandt8.h"
+#include "Pinhole.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Points in front of the camera within 55 degrees of the optical axis, one of them on it
+void RandomPoints(
+  const int n, std::vector<float>& x, std::vector<float>& y, std::vector<float>& z
+) {
+  std::mt19937                          rng(1);
+  std::uniform_real_distribution<float> xy(-2.5f, 2.5f), depth(1.0f, 5.0f);
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+  for (int i = 0; i < n; i++) {
+    z[i] = depth(rng);
+    x[i] = xy(rng) * z[i] / 2.5f;
+    y[i] = xy(rng) * z[i] / 2.5f;
+  }
+  x[3] = y[3] = 0.f;
+}
+
+// The batched functions agree with the per point ones, for a count that leaves a scalar tail
+void ExpectBatchesMatch(GeometricCamera& camera, const float tolerance) {
+  const int          n = 103;
+  std::vector<float> x, y, z;
+  RandomPoints(n, x, y, z);
+
+  std::vector<float> u(n), v(n);
+  camera.projectBatch(x.data(), y.data(), z.data(), n, u.data(), v.data());
+  for (int i = 0; i < n; i++) {
+    const Eigen::Vector2f uv = camera.project(Eigen::Vector3f(x[i], y[i], z[i]));
+    EXPECT_NEAR(u[i], uv(0), tolerance);
+    EXPECT_NEAR(v[i], uv(1), tolerance);
+  }
+
+  std::vector<float> rx(n), ry(n), rz(n);
+  camera.unprojectBatch(u.data(), v.data(), n, rx.data(), ry.data(), rz.data());
+  for (int i = 0; i < n; i++) {
+    const Eigen::Vector3f ray = camera.unprojectEig(cv::Point2f(u[i], v[i]));
+    EXPECT_NEAR(rx[i], ray(0), 1e-5f);
+    EXPECT_NEAR(ry[i], ray(1), 1e-5f);
+    EXPECT_NEAR(rz[i], ray(2), 1e-5f);
+    EXPECT_NEAR(rx[i], x[i] / z[i], 1e-3f);
+    EXPECT_NEAR(ry[i], y[i] / z[i], 1e-3f);
+  }
+
+  std::vector<float> jac(6 * n);
+  camera.projectJacBatch(x.data(), y.data(), z.data(), n, jac.data());
+  for (int i = 0; i < n; i++) {
+    if (x[i] == 0.f && y[i] == 0.f) {
+      continue;
+    }
+    const Eigen::Matrix<double, 2, 3> J = camera.projectJac(Eigen::Vector3d(x[i], y[i], z[i]));
+    for (int r = 0; r < 2; r++) {
+      for (int c = 0; c < 3; c++) {
+        EXPECT_NEAR(jac[(3 * r + c) * n + i], J(r, c), 1e-3 * (1.0 + std::abs(J(r, c))));
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(CameraModelsTest, PinholeBatchesMatchPerPoint) {
+  Pinhole camera(std::vector<float>{458.654f, 457.296f, 367.215f, 248.375f});
+  ExpectBatchesMatch(camera, 1e-3f);
+}
+
+TEST(CameraModelsTest, KannalaBrandt8BatchesMatchPerPoint) {
+  KannalaBrandt8 camera(
+    std::vector<float>{190.978f, 190.973f, 254.932f, 256.897f, 0.0034f, 0.0008f, -0.0013f, 0.0002f}
+  );
+  ExpectBatchesMatch(camera, 1e-2f);
+}
+
+TEST(CameraModelsTest, KannalaBrandt8UnprojectInvertsProject) {
+  KannalaBrandt8 camera(
+    std::vector<float>{190.978f, 190.973f, 254.932f, 256.897f, 0.0034f, 0.0008f, -0.0013f, 0.0002f}
+  );
+  std::vector<float> x, y, z;
+  RandomPoints(50, x, y, z);
+
+  // The same holds once the distortion changes after construction
+  for (const float k1 : {0.0008f, 0.03f}) {
+    camera.setParameter(k1, 5);
+    for (std::size_t i = 0; i < x.size(); i++) {
+      const Eigen::Vector2f uv  = camera.project(Eigen::Vector3f(x[i], y[i], z[i]));
+      const Eigen::Vector3f ray = camera.unprojectEig(cv::Point2f(uv(0), uv(1)));
+      EXPECT_NEAR(ray(0), x[i] / z[i], 1e-3f);
+      EXPECT_NEAR(ray(1), y[i] / z[i], 1e-3f);
+    }
+  }
+}
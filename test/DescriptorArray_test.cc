@@ -0,0 +1,79 @@
+#include "DescriptorArray.h"
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+cv::Mat SequentialDescriptors(const int n, const int offset) {
+  cv::Mat descriptors(n, Descriptor::kBytes, CV_8UC1);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < Descriptor::kBytes; j++) {
+      descriptors.ptr<unsigned char>(i)[j] = static_cast<unsigned char>(offset + 7 * i + j);
+    }
+  }
+  return descriptors;
+}
+
+} // namespace
+
+TEST(DescriptorArrayTest, RoundTripsThroughMat) {
+  const cv::Mat         mat = SequentialDescriptors(5, 0);
+  const DescriptorArray descriptors(mat);
+  ASSERT_EQ(descriptors.size(), 5u);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(std::memcmp(descriptors[i].data(), mat.ptr<unsigned char>(i), Descriptor::kBytes), 0);
+    EXPECT_EQ(Descriptor::FromMat(mat.row(i)), descriptors[i]);
+  }
+
+  const cv::Mat copy = descriptors.ToMat();
+  ASSERT_EQ(copy.rows, 5);
+  ASSERT_EQ(copy.cols, Descriptor::kBytes);
+  EXPECT_EQ(std::memcmp(copy.ptr<unsigned char>(), mat.ptr<unsigned char>(), 5 * 32), 0);
+  const cv::Mat row = descriptors[3].ToMat();
+  EXPECT_EQ(std::memcmp(row.ptr<unsigned char>(), mat.ptr<unsigned char>(3), 32), 0);
+}
+
+TEST(DescriptorArrayTest, AsMatSharesStorage) {
+  const DescriptorArray descriptors(SequentialDescriptors(3, 1));
+  const cv::Mat         view = descriptors.AsMat();
+  EXPECT_EQ(view.rows, 3);
+  EXPECT_EQ(view.ptr<unsigned char>(2), descriptors[2].data());
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(descriptors.data()) % 32, 0u);
+
+  EXPECT_TRUE(DescriptorArray().AsMat().empty());
+}
+
+TEST(DescriptorArrayTest, AssignsNonContinuousRows) {
+  // Column range of a wider matrix, rows are not contiguous
+  const cv::Mat wide = SequentialDescriptors(4, 3);
+  cv::Mat       padded(4, 2 * Descriptor::kBytes, CV_8UC1);
+  for (int i = 0; i < 4; i++) {
+    std::memcpy(padded.ptr<unsigned char>(i), wide.ptr<unsigned char>(i), Descriptor::kBytes);
+  }
+  const cv::Mat view = padded.colRange(0, Descriptor::kBytes);
+  ASSERT_FALSE(view.isContinuous());
+
+  DescriptorArray descriptors;
+  descriptors.Assign(view);
+  ASSERT_EQ(descriptors.size(), 4u);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(Descriptor::FromMat(wide.row(i)), descriptors[i]);
+  }
+
+  descriptors.Assign(cv::Mat());
+  EXPECT_TRUE(descriptors.empty());
+}
+
+TEST(DescriptorArrayTest, AppendKeepsOrder) {
+  DescriptorArray       left(SequentialDescriptors(2, 0));
+  const DescriptorArray right(SequentialDescriptors(3, 100));
+  left.Append(right);
+  ASSERT_EQ(left.size(), 5u);
+  EXPECT_EQ(left[1], DescriptorArray(SequentialDescriptors(2, 0))[1]);
+  for (std::size_t i = 0; i < right.size(); i++) {
+    EXPECT_EQ(left[2 + i], right[i]);
+  }
+}
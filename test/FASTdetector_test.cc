@@ -0,0 +1,61 @@
+#include "FASTdetector.h"
+#include <vector>
+#include <gtest/gtest.h>
+#include <opencv2/features2d.hpp>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+cv::Mat MakeTexturedImage(const int rows, const int cols) {
+  cv::Mat image(rows, cols, CV_8UC1);
+  cv::RNG rng(42);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      const int checker     = ((x / 5 + y / 7) % 2) * 200;
+      image.at<uchar>(y, x) = cv::saturate_cast<uchar>(
+        rng.uniform(0, 4) == 0 ? rng.uniform(0, 256) : checker + rng.uniform(0, 30)
+      );
+    }
+  }
+  return image;
+}
+
+} // namespace
+
+TEST(FASTdetectorTest, MatchesOpenCVPerCell) {
+  const cv::Mat image = MakeTexturedImage(240, 320);
+  const int     minTh = 7;
+  const int     iniTh = 20;
+
+  cv::Mat scores(image.size(), CV_8UC1);
+  ComputeFASTScores(image, scores, minTh, 0, image.rows);
+
+  for (int y = 0; y + 20 < image.rows; y += 29) {
+    for (int x = 0; x + 20 < image.cols; x += 31) {
+      const cv::Rect cell(x, y, std::min(41, image.cols - x), std::min(41, image.rows - y));
+      for (const int th : {minTh, iniTh}) {
+        std::vector<cv::KeyPoint> expected, actual;
+        cv::FAST(image(cell), expected, th, true);
+        DetectFASTInCell(scores, cell, th, cv::Point2f(0.f, 0.f), actual);
+
+        ASSERT_EQ(expected.size(), actual.size());
+        for (std::size_t i = 0; i < expected.size(); i++) {
+          EXPECT_EQ(expected[i].pt, actual[i].pt);
+          EXPECT_EQ(expected[i].response, actual[i].response);
+        }
+      }
+    }
+  }
+}
+
+TEST(FASTdetectorTest, RowBandsMatchWholeImage) {
+  const cv::Mat image = MakeTexturedImage(97, 131);
+
+  cv::Mat whole(image.size(), CV_8UC1), bands(image.size(), CV_8UC1);
+  ComputeFASTScores(image, whole, 7, 0, image.rows);
+  ComputeFASTScores(image, bands, 7, 0, 40);
+  ComputeFASTScores(image, bands, 7, 40, image.rows);
+
+  EXPECT_EQ(cv::countNonZero(whole != bands), 0);
+}
@@ -0,0 +1,61 @@
+#include "FeatureGrid.h"
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+TEST(FeatureGridTest, AssignBucketsByCellInOrder) {
+  const int        nCols = 5, nRows = 4;
+  FeatureGrid      grid(nCols, nRows);
+  std::mt19937     rng(1);
+  std::vector<int> vCells(300);
+  for (int& cell : vCells) {
+    cell = static_cast<int>(rng() % (nCols * nRows + 3)) - 3;
+  }
+  grid.Assign(vCells);
+
+  for (int x = 0; x < nCols; x++) {
+    for (int y = 0; y < nRows; y++) {
+      std::vector<std::size_t> vExpected;
+      for (std::size_t i = 0; i < vCells.size(); i++) {
+        if (vCells[i] == grid.CellIndex(x, y)) {
+          vExpected.push_back(i);
+        }
+      }
+      EXPECT_EQ(grid.CellSize(x, y), vExpected.size());
+      EXPECT_EQ(std::vector<std::size_t>(grid.ColumnBegin(x, y), grid.ColumnEnd(x, y)), vExpected);
+    }
+  }
+
+  // A column range spans its cells one after the other
+  std::vector<std::size_t> vColumn;
+  for (int y = 1; y <= 3; y++) {
+    vColumn.insert(vColumn.end(), grid.ColumnBegin(2, y), grid.ColumnEnd(2, y));
+  }
+  EXPECT_EQ(std::vector<std::size_t>(grid.ColumnBegin(2, 1), grid.ColumnEnd(2, 3)), vColumn);
+
+  // Reassigning replaces the previous buckets
+  grid.Assign(std::vector<int>{grid.CellIndex(4, 3), -1, grid.CellIndex(4, 3)});
+  EXPECT_EQ(
+    std::vector<std::size_t>(grid.ColumnBegin(4, 0), grid.ColumnEnd(4, 3)),
+    (std::vector<std::size_t>{0, 2})
+  );
+  EXPECT_EQ(grid.CellSize(0, 0), 0u);
+}
+
+TEST(FeatureGridTest, RoundTripsThroughCells) {
+  std::vector<std::vector<std::vector<std::size_t>>> cells(
+    3, std::vector<std::vector<std::size_t>>(2)
+  );
+  cells[0][1] = {0, 4};
+  cells[2][0] = {1, 2};
+  cells[1][1] = {5};
+
+  const FeatureGrid grid = FeatureGrid::FromCells(cells);
+  EXPECT_EQ(grid.Cols(), 3);
+  EXPECT_EQ(grid.Rows(), 2);
+  EXPECT_EQ(grid.ToCells(), cells);
+
+  EXPECT_TRUE(FeatureGrid::FromCells({}).ToCells().empty());
+}
@@ -0,0 +1,77 @@
+#include "GeometricTools.h"
+#include <random>
+#include <vector>
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Pose looking along +z from center O, rotated about the y axis by yaw
+Eigen::Matrix<float, 3, 4> LookingPose(const Eigen::Vector3f& O, const float yaw) {
+  const Eigen::Matrix3f Rwc = Eigen::AngleAxisf(yaw, Eigen::Vector3f::UnitY()).toRotationMatrix();
+  Eigen::Matrix<float, 3, 4> Tcw;
+  Tcw.block<3, 3>(0, 0) = Rwc.transpose();
+  Tcw.col(3)            = -Rwc.transpose() * O;
+  return Tcw;
+}
+
+} // namespace
+
+// The batch recovers the points seen without noise, as the DLT does, for a count that leaves a
+// scalar tail
+TEST(GeometricToolsTest, TriangulateBatchMatchesDLT) {
+  const Eigen::Vector3f            O1(0.f, 0.f, 0.f), O2(0.4f, 0.05f, -0.1f);
+  const Eigen::Matrix<float, 3, 4> Tc1w = LookingPose(O1, 0.f);
+  const Eigen::Matrix<float, 3, 4> Tc2w = LookingPose(O2, -0.1f);
+
+  const int                             n = 103;
+  std::mt19937                          rng(1);
+  std::uniform_real_distribution<float> xy(-2.f, 2.f), depth(2.f, 8.f);
+
+  std::vector<Eigen::Vector3f> vPoints(n);
+  std::vector<float>           vRays1(3 * n), vRays2(3 * n);
+  for (int i = 0; i < n; i++) {
+    vPoints[i] = Eigen::Vector3f(xy(rng), xy(rng), depth(rng));
+    for (int c = 0; c < 3; c++) {
+      // Rays of different lengths
+      vRays1[c * n + i] = 0.5f * (vPoints[i] - O1)(c);
+      vRays2[c * n + i] = 2.0f * (vPoints[i] - O2)(c);
+    }
+  }
+
+  std::vector<float> vCosParallax(n), vX3D(3 * n);
+  GeometricTools::TriangulateBatch(
+    O1, O2, vRays1.data(), vRays2.data(), n, vCosParallax.data(), vX3D.data()
+  );
+
+  for (int i = 0; i < n; i++) {
+    const Eigen::Vector3f ray1 = vPoints[i] - O1, ray2 = vPoints[i] - O2;
+    EXPECT_NEAR(vCosParallax[i], ray1.normalized().dot(ray2.normalized()), 1e-5f);
+
+    const Eigen::Vector3f x3D(vX3D[i], vX3D[n + i], vX3D[2 * n + i]);
+    EXPECT_TRUE(x3D.isApprox(vPoints[i], 1e-4f));
+
+    Eigen::Matrix<float, 3, 4> T1 = Tc1w, T2 = Tc2w;
+    Eigen::Vector3f            xn1 = Tc1w.block<3, 3>(0, 0) * vPoints[i] + Tc1w.col(3);
+    Eigen::Vector3f            xn2 = Tc2w.block<3, 3>(0, 0) * vPoints[i] + Tc2w.col(3);
+    xn1 /= xn1(2);
+    xn2 /= xn2(2);
+    Eigen::Vector3f x3DDLT;
+    ASSERT_TRUE(GeometricTools::Triangulate(xn1, xn2, T1, T2, x3DDLT));
+    EXPECT_TRUE(x3D.isApprox(x3DDLT, 1e-3f));
+  }
+}
+
+// Parallel rays have no closest points
+TEST(GeometricToolsTest, TriangulateBatchParallelRaysAreNotFinite) {
+  const Eigen::Vector3f O1(0.f, 0.f, 0.f), O2(1.f, 0.f, 0.f);
+  const float           vRays[3] = {0.f, 0.f, 1.f};
+
+  float cosParallax, vX3D[3];
+  GeometricTools::TriangulateBatch(O1, O2, vRays, vRays, 1, &cosParallax, vX3D);
+
+  EXPECT_FLOAT_EQ(cosParallax, 1.f);
+  EXPECT_FALSE(Eigen::Vector3f(vX3D[0], vX3D[1], vX3D[2]).allFinite());
+}
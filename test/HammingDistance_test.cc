@@ -0,0 +1,98 @@
+#include "HammingDistance.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Bit by bit reference, independent of the popcount kernels
+int ReferenceDistance(const unsigned char* a, const unsigned char* b) {
+  int dist = 0;
+  for (int i = 0; i < 32; i++) {
+    for (int bit = 0; bit < 8; bit++) {
+      dist += ((a[i] ^ b[i]) >> bit) & 1;
+    }
+  }
+  return dist;
+}
+
+std::vector<unsigned char> RandomDescriptors(const int n, std::mt19937& rng) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<unsigned char>         vData(32 * n);
+  for (unsigned char& value : vData) {
+    value = static_cast<unsigned char>(byte(rng));
+  }
+  return vData;
+}
+
+} // namespace
+
+TEST(HammingDistanceTest, BatchMatchesReference) {
+  std::mt19937 rng(7);
+  // Sizes around the vector widths exercise the remainder handling of every kernel
+  for (const int n : {0, 1, 2, 3, 4, 5, 7, 8, 9, 31, 64, 65, 200}) {
+    const std::vector<unsigned char> vQuery = RandomDescriptors(1, rng);
+    const std::vector<unsigned char> vData  = RandomDescriptors(n, rng);
+
+    std::vector<const unsigned char*> vpCandidates(n);
+    for (int i = 0; i < n; i++) {
+      // Reverse order so that pointers are not contiguous
+      vpCandidates[i] = vData.data() + 32 * (n - 1 - i);
+    }
+
+    std::vector<int> vPointerDists(n, -1), vStridedDists(n, -1);
+    HammingDistances(vQuery.data(), vpCandidates.data(), n, vPointerDists.data());
+    HammingDistances(vQuery.data(), vData.data(), 32, n, vStridedDists.data());
+
+    for (int i = 0; i < n; i++) {
+      const int expected = ReferenceDistance(vQuery.data(), vpCandidates[i]);
+      ASSERT_EQ(HammingDistance(vQuery.data(), vpCandidates[i]), expected);
+      ASSERT_EQ(vPointerDists[i], expected) << HammingBackend() << " n=" << n << " i=" << i;
+      ASSERT_EQ(vStridedDists[n - 1 - i], expected) << HammingBackend() << " n=" << n;
+    }
+  }
+}
+
+TEST(HammingDistanceTest, BestMatchKeepsEarliestOnTies) {
+  const int          vDists[] = {40, 12, 30, 12, 256};
+  const HammingMatch match    = BestHammingMatch(vDists, 5);
+  EXPECT_EQ(match.bestDist, 12);
+  EXPECT_EQ(match.bestIdx, 1);
+  EXPECT_EQ(match.secondDist, 12);
+  EXPECT_EQ(match.secondIdx, 3);
+
+  const HammingMatch empty = BestHammingMatch(vDists, 0);
+  EXPECT_EQ(empty.bestDist, 256);
+  EXPECT_EQ(empty.bestIdx, -1);
+  EXPECT_EQ(empty.secondDist, 256);
+  EXPECT_EQ(empty.secondIdx, -1);
+}
+
+TEST(HammingDistanceTest, FindBestMatchesTwoPass) {
+  std::mt19937 rng(11);
+  for (const int n : {1, 10, 63, 64, 130}) {
+    const std::vector<unsigned char> vQuery = RandomDescriptors(1, rng);
+    std::vector<unsigned char>       vData  = RandomDescriptors(n, rng);
+    // Duplicate a candidate across the chunk boundary to check the tie order
+    if (n > 64) {
+      std::copy(vData.begin() + 32 * 3, vData.begin() + 32 * 4, vData.begin() + 32 * 70);
+    }
+
+    std::vector<const unsigned char*> vpCandidates(n);
+    for (int i = 0; i < n; i++) {
+      vpCandidates[i] = vData.data() + 32 * i;
+    }
+    std::vector<int> vDists(n);
+    HammingDistances(vQuery.data(), vpCandidates.data(), n, vDists.data());
+
+    const HammingMatch expected = BestHammingMatch(vDists.data(), n);
+    const HammingMatch match    = FindBestHamming(vQuery.data(), vpCandidates.data(), n);
+    EXPECT_EQ(match.bestDist, expected.bestDist);
+    EXPECT_EQ(match.bestIdx, expected.bestIdx);
+    EXPECT_EQ(match.secondDist, expected.secondDist);
+    EXPECT_EQ(match.secondIdx, expected.secondIdx);
+  }
+}
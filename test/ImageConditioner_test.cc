@@ -0,0 +1,74 @@
+#include "ImageConditioner.h"
+#include <gtest/gtest.h>
+#include <opencv2/imgproc.hpp>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+cv::Mat RandomImage(const cv::Size& size) {
+  cv::Mat image(size, CV_8UC1);
+  cv::randu(image, 0, 256);
+  return image;
+}
+
+// Conditions src into the interior of a bordered buffer, as the extractor does for level 0, and
+// checks that the border is left untouched
+cv::Mat ApplyIntoView(const ImageConditioner& conditioner, const cv::Mat& src) {
+  const int border = 19;
+  cv::Mat   buffer(
+    conditioner.OutputSize().height + 2 * border,
+    conditioner.OutputSize().width + 2 * border,
+    CV_8UC1,
+    cv::Scalar(7)
+  );
+  cv::Mat view = buffer(cv::Rect(cv::Point(border, border), conditioner.OutputSize()));
+
+  conditioner.Apply(src, view);
+  EXPECT_EQ(view.data, buffer.ptr(border, border));
+
+  cv::Mat borderMask(buffer.size(), CV_8UC1, cv::Scalar(255));
+  borderMask(cv::Rect(cv::Point(border, border), conditioner.OutputSize())).setTo(0);
+  EXPECT_EQ(cv::countNonZero((buffer != 7) & borderMask), 0);
+
+  return view.clone();
+}
+
+} // namespace
+
+TEST(ImageConditionerTest, RectifyMatchesRemap) {
+  const cv::Mat  src = RandomImage(cv::Size(160, 120));
+  const cv::Size size(144, 100);
+
+  // Rotated and scaled sampling, partly outside of the source
+  cv::Mat mapX(size, CV_32FC1), mapY(size, CV_32FC1);
+  for (int y = 0; y < size.height; y++) {
+    for (int x = 0; x < size.width; x++) {
+      mapX.at<float>(y, x) = 1.1f * x + 0.05f * y - 3.3f;
+      mapY.at<float>(y, x) = 1.2f * y - 0.04f * x + 0.7f;
+    }
+  }
+
+  cv::Mat fixed1, fixed2, expected;
+  cv::convertMaps(mapX, mapY, fixed1, fixed2, CV_16SC2);
+  cv::remap(src, expected, fixed1, fixed2, cv::INTER_LINEAR);
+
+  // Float and fixed point maps give the same conditioner
+  for (const ImageConditioner& conditioner :
+       {ImageConditioner(mapX, mapY), ImageConditioner(fixed1, fixed2)}) {
+    ASSERT_EQ(conditioner.OutputSize(), size);
+    EXPECT_EQ(cv::norm(ApplyIntoView(conditioner, src), expected, cv::NORM_INF), 0);
+  }
+}
+
+TEST(ImageConditionerTest, ResizeMatchesResize) {
+  const cv::Mat  src = RandomImage(cv::Size(160, 120));
+  const cv::Size size(100, 75);
+
+  cv::Mat expected;
+  cv::resize(src, expected, size);
+
+  const ImageConditioner conditioner(size);
+  ASSERT_EQ(conditioner.OutputSize(), size);
+  EXPECT_EQ(cv::norm(ApplyIntoView(conditioner, src), expected, cv::NORM_INF), 0);
+}
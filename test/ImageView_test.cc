@@ -0,0 +1,191 @@
+#include "ImageView.h"
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Takes a view as the System overloads do: its gray image is read by track, which may return early
+// or throw, and the view is released once on every path
+int TrackView(
+  const ImageView& view, cv::Mat& buffer, const std::function<int(const cv::Mat&)>& track
+) {
+  ViewRelease   release(view);
+  const cv::Mat im = ViewToGray(view, buffer, release);
+  return track(im);
+}
+
+// 2 x 3 view of the color (R, G, B) = (200, 10, 30) in the given format, rows padded to 16 bytes
+ImageView ColorView(const ImageView::Format format, std::vector<std::uint8_t>& vPixels) {
+  const bool         bRGB      = format == ImageView::RGB8 || format == ImageView::RGBA8;
+  const int          nChannels = format == ImageView::RGB8 || format == ImageView::BGR8 ? 3 : 4;
+  const std::uint8_t r = 200, g = 10, b = 30;
+  const std::uint8_t vColor[4] = {bRGB ? r : b, g, bRGB ? b : r, 255};
+
+  ImageView view;
+  view.width  = 3;
+  view.height = 2;
+  view.step   = 16;
+  view.format = format;
+  vPixels.assign(view.height * view.step, 0);
+  for (int y = 0; y < view.height; y++) {
+    for (int x = 0; x < view.width; x++) {
+      for (int c = 0; c < nChannels; c++) {
+        vPixels[y * view.step + x * nChannels + c] = vColor[c];
+      }
+    }
+  }
+  view.data = vPixels.data();
+  return view;
+}
+
+} // namespace
+
+// The header shares the pixels of the view, rows being step bytes apart
+TEST(ImageViewTest, MatAliasesPixels) {
+  const int                 width = 5, height = 3, step = 8;
+  std::vector<std::uint8_t> vPixels(height * step);
+  for (std::size_t i = 0; i < vPixels.size(); i++) {
+    vPixels[i] = static_cast<std::uint8_t>(i);
+  }
+
+  ImageView view;
+  view.data   = vPixels.data();
+  view.width  = width;
+  view.height = height;
+  view.step   = step;
+
+  const cv::Mat im = view.Mat();
+  EXPECT_EQ(im.data, vPixels.data());
+  EXPECT_EQ(im.type(), CV_8UC1);
+  EXPECT_EQ(im.size(), cv::Size(width, height));
+  EXPECT_EQ(im.step[0], static_cast<std::size_t>(step));
+  EXPECT_EQ(im.at<std::uint8_t>(2, 4), 2 * step + 4);
+}
+
+TEST(ImageViewTest, TypeFollowsFormat) {
+  ImageView view;
+  const std::pair<ImageView::Format, int> vFormats[] = {
+    {ImageView::GRAY8, CV_8UC1},
+    {ImageView::RGB8, CV_8UC3},
+    {ImageView::BGR8, CV_8UC3},
+    {ImageView::RGBA8, CV_8UC4},
+    {ImageView::BGRA8, CV_8UC4},
+    {ImageView::DEPTH16, CV_16UC1},
+    {ImageView::DEPTH32F, CV_32FC1}
+  };
+  for (const auto& format : vFormats) {
+    view.format = format.first;
+    EXPECT_EQ(view.Type(), format.second);
+  }
+}
+
+// Color formats are converted by their channel order, into the buffer, and released right after
+TEST(ImageViewTest, ViewToGrayConvertsColor) {
+  for (const ImageView::Format format :
+       {ImageView::RGB8, ImageView::BGR8, ImageView::RGBA8, ImageView::BGRA8}) {
+    std::vector<std::uint8_t> vPixels;
+    ImageView                 view     = ColorView(format, vPixels);
+    int                       nRelease = 0;
+    view.release                       = [&nRelease]() { nRelease++; };
+
+    cv::Mat     buffer;
+    ViewRelease release(view);
+    cv::Mat     gray = ViewToGray(view, buffer, release);
+    EXPECT_EQ(nRelease, 1) << "format " << format;
+    EXPECT_EQ(gray.data, buffer.data);
+    ASSERT_EQ(gray.type(), CV_8UC1);
+    ASSERT_EQ(gray.size(), cv::Size(3, 2));
+    // 0.299 R + 0.587 G + 0.114 B
+    for (int y = 0; y < 2; y++) {
+      for (int x = 0; x < 3; x++) {
+        EXPECT_NEAR(gray.at<std::uint8_t>(y, x), 69, 1) << "format " << format;
+      }
+    }
+
+    release.Release();
+    EXPECT_EQ(nRelease, 1);
+  }
+}
+
+// Gray views are read in place, depth maps are refused
+TEST(ImageViewTest, ViewToGrayKeepsGrayInPlace) {
+  std::vector<std::uint8_t> vPixels(2 * 8, 7);
+  ImageView                 view;
+  view.data    = vPixels.data();
+  view.width   = 5;
+  view.height  = 2;
+  view.step    = 8;
+  int nRelease = 0;
+  view.release = [&nRelease]() { nRelease++; };
+
+  cv::Mat buffer;
+  {
+    ViewRelease   release(view);
+    const cv::Mat gray = ViewToGray(view, buffer, release);
+    EXPECT_EQ(gray.data, vPixels.data());
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(nRelease, 0);
+  }
+  EXPECT_EQ(nRelease, 1);
+
+  view.format = ImageView::DEPTH16;
+  {
+    ViewRelease release(view);
+    EXPECT_THROW(ViewToGray(view, buffer, release), std::invalid_argument);
+  }
+  EXPECT_EQ(nRelease, 2);
+}
+
+// A gray view is released once after tracking returns, early or not, or throws. A color view is
+// released once, before tracking reads its conversion.
+TEST(ImageViewTest, ReleasedOnceAfterTracking) {
+  std::vector<std::uint8_t> vGray(4 * 4, 1);
+  ImageView                 grayView;
+  grayView.data    = vGray.data();
+  grayView.width   = 4;
+  grayView.height  = 4;
+  grayView.step    = 4;
+  int nRelease     = 0;
+  grayView.release = [&nRelease]() { nRelease++; };
+
+  cv::Mat buffer;
+  for (const bool bEarlyReturn : {false, true}) {
+    nRelease        = 0;
+    const int state = TrackView(grayView, buffer, [&](const cv::Mat& im) {
+      EXPECT_EQ(nRelease, 0);
+      if (bEarlyReturn) {
+        return -1;
+      }
+      return static_cast<int>(im.at<std::uint8_t>(0, 0));
+    });
+    EXPECT_EQ(state, bEarlyReturn ? -1 : 1);
+    EXPECT_EQ(nRelease, 1);
+  }
+
+  nRelease = 0;
+  EXPECT_THROW(
+    TrackView(
+      grayView,
+      buffer,
+      [](const cv::Mat&) -> int { throw std::runtime_error("Invalid sensor type"); }
+    ),
+    std::runtime_error
+  );
+  EXPECT_EQ(nRelease, 1);
+
+  std::vector<std::uint8_t> vColor;
+  ImageView                 colorView = ColorView(ImageView::BGRA8, vColor);
+  colorView.release                   = [&nRelease]() { nRelease++; };
+  nRelease                            = 0;
+  TrackView(colorView, buffer, [&](const cv::Mat&) {
+    EXPECT_EQ(nRelease, 1);
+    return 0;
+  });
+  EXPECT_EQ(nRelease, 1);
+}
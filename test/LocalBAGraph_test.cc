@@ -0,0 +1,226 @@
+#include "LocalBAGraph.h"
+#include <memory>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <Thirdparty/g2o/g2o/core/robust_kernel_impl.h>
+#include "CameraModels/Pinhole.h"
+#include "G2oTypes.h"
+#include "ImuTypes.h"
+#include "OptimizableTypes.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Set up the window of keyframes [firstKF, lastKF) with every point observed by each of them, the
+// first two fixed, and return the monocular edges
+std::vector<EdgeSE3ProjectXYZ*> SetWindow(
+  LocalBAGraph&                       graph,
+  Pinhole&                            camera,
+  const std::vector<g2o::SE3Quat>&    vTcw,
+  const std::vector<Eigen::Vector3d>& vPoints,
+  const int                           firstKF,
+  const int                           lastKF
+) {
+  graph.BeginWindow();
+  std::vector<g2o::VertexSE3Expmap*> vpKFVertices;
+  for (int i = firstKF; i < lastKF; i++) {
+    g2o::VertexSE3Expmap* vSE3 = graph.KeyFrameVertex(i);
+    vSE3->setEstimate(vTcw[i]);
+    vSE3->setFixed(i < firstKF + 2);
+    vpKFVertices.push_back(vSE3);
+  }
+
+  std::vector<EdgeSE3ProjectXYZ*> vpEdges;
+  for (std::size_t j = 0; j < vPoints.size(); j++) {
+    g2o::VertexSBAPointXYZ* vPoint = graph.MapPointVertex(j);
+    vPoint->setEstimate(vPoints[j] + Eigen::Vector3d(0.02, -0.01, 0.03));
+    for (int i = firstKF; i < lastKF; i++) {
+      EdgeSE3ProjectXYZ* e = graph.MonocularEdge(vPoint, vpKFVertices[i - firstKF], &camera);
+      e->setMeasurement(camera.project(vTcw[i].map(vPoints[j])));
+      e->setInformation(Eigen::Matrix2d::Identity());
+      e->robustKernel()->setDelta(2.45);
+      e->pCamera = &camera;
+      vpEdges.push_back(e);
+    }
+  }
+  graph.EndWindow();
+  return vpEdges;
+}
+
+// Preintegration of a body at rest from one keyframe to the next
+std::unique_ptr<IMU::Preintegrated> Preintegration(const IMU::Calib& calib) {
+  std::unique_ptr<IMU::Preintegrated> pInt
+    = std::make_unique<IMU::Preintegrated>(IMU::Bias(), calib);
+  for (int i = 0; i < 20; i++) {
+    pInt->IntegrateNewMeasurement(
+      Eigen::Vector3f(0.f, 0.f, IMU::GRAVITY_VALUE), Eigen::Vector3f::Zero(), 0.005f
+    );
+  }
+  return pInt;
+}
+
+// Set up the window of keyframes [firstKF, lastKF) of a body at rest at the origin, with the
+// preintegrations vpInt[i] from keyframe i - 1 to i. The first keyframe is fixed, the others start
+// off by 2 cm each. Returns the inertial edges.
+std::vector<EdgeInertial*> SetInertialWindow(
+  LocalInertialBAGraph&                   graph,
+  Pinhole&                                camera,
+  const std::vector<IMU::Preintegrated*>& vpInt,
+  const int                               firstKF,
+  const int                               lastKF
+) {
+  graph.BeginWindow();
+  for (int i = firstKF; i < lastKF; i++) {
+    ImuCamPose pose;
+    pose.Rwb     = Eigen::Matrix3d::Identity();
+    pose.twb     = Eigen::Vector3d(0.02 * (i - firstKF), 0.0, 0.0);
+    pose.Rcw     = {Eigen::Matrix3d::Identity()};
+    pose.tcw     = {-pose.twb};
+    pose.Rcb     = {Eigen::Matrix3d::Identity()};
+    pose.Rbc     = {Eigen::Matrix3d::Identity()};
+    pose.tcb     = {Eigen::Vector3d::Zero()};
+    pose.tbc     = {Eigen::Vector3d::Zero()};
+    pose.bf      = 0.0;
+    pose.pCamera = {&camera};
+    pose.its     = 0;
+
+    const bool      bFixed = i == firstKF;
+    VertexPose*     VP     = graph.PoseVertex(i);
+    VertexVelocity* VV     = graph.VelocityVertex(i);
+    VertexGyroBias* VG     = graph.GyroBiasVertex(i);
+    VertexAccBias*  VA     = graph.AccBiasVertex(i);
+    VP->setEstimate(pose);
+    VV->setEstimate(Eigen::Vector3d::Zero());
+    VG->setEstimate(Eigen::Vector3d::Zero());
+    VA->setEstimate(Eigen::Vector3d::Zero());
+    VP->setFixed(bFixed);
+    VV->setFixed(bFixed);
+    VG->setFixed(bFixed);
+    VA->setFixed(bFixed);
+  }
+
+  std::vector<EdgeInertial*> vpEdges;
+  for (int i = firstKF + 1; i < lastKF; i++) {
+    vpEdges.push_back(graph.InertialEdge(i - 1, i, vpInt[i]));
+    graph.GyroRandomWalkEdge(i - 1, i)->setInformation(Eigen::Matrix3d::Identity());
+    graph.AccRandomWalkEdge(i - 1, i)->setInformation(Eigen::Matrix3d::Identity());
+  }
+  graph.EndWindow();
+  return vpEdges;
+}
+
+} // namespace
+
+TEST(LocalBAGraphTest, KeepsSharedObjectsAndRecyclesTheOthers) {
+  Pinhole camera(std::vector<float>{458.654f, 457.296f, 367.215f, 248.375f});
+
+  std::vector<g2o::SE3Quat> vTcw;
+  for (int i = 0; i < 5; i++) {
+    vTcw.emplace_back(Eigen::Quaterniond::Identity(), Eigen::Vector3d(-0.2 * i, 0.0, 0.0));
+  }
+  std::mt19937                           rng(1);
+  std::uniform_real_distribution<double> xy(-1.0, 1.0), depth(4.0, 6.0);
+  std::vector<Eigen::Vector3d>           vPoints;
+  for (int j = 0; j < 40; j++) {
+    vPoints.emplace_back(xy(rng), xy(rng), depth(rng));
+  }
+
+  LocalBAGraph graph;
+  const std::vector<EdgeSE3ProjectXYZ*> vpFirst = SetWindow(graph, camera, vTcw, vPoints, 0, 3);
+  EXPECT_EQ(graph.NumVertices(), 3u + vPoints.size());
+  EXPECT_EQ(graph.NumEdges(), 3 * vPoints.size());
+
+  // The window slides by one keyframe: the edges of the shared keyframes are kept
+  const std::vector<EdgeSE3ProjectXYZ*> vpSecond = SetWindow(graph, camera, vTcw, vPoints, 1, 4);
+  EXPECT_EQ(graph.NumVertices(), 3u + vPoints.size());
+  EXPECT_EQ(graph.NumEdges(), 3 * vPoints.size());
+  for (std::size_t j = 0; j < vPoints.size(); j++) {
+    EXPECT_EQ(vpSecond[3 * j], vpFirst[3 * j + 1]);
+    EXPECT_EQ(vpSecond[3 * j + 1], vpFirst[3 * j + 2]);
+  }
+
+  // The graph of the window optimizes as a new one
+  g2o::SparseOptimizer& optimizer = graph.Optimizer();
+  ASSERT_TRUE(optimizer.initializeOptimization());
+  optimizer.optimize(10);
+  for (int i = 1; i < 4; i++) {
+    const g2o::SE3Quat Tcw = graph.KeyFrameVertex(i)->estimate();
+    EXPECT_LT((Tcw.translation() - vTcw[i].translation()).norm(), 1e-3) << "keyframe " << i;
+  }
+
+  // Shrinking the window removes what it no longer has
+  g2o::VertexSE3Expmap* vLeaving = graph.KeyFrameVertex(1);
+  SetWindow(graph, camera, vTcw, vPoints, 2, 4);
+  EXPECT_EQ(graph.NumVertices(), 2u + vPoints.size());
+  EXPECT_EQ(graph.NumEdges(), 2 * vPoints.size());
+
+  // and the keyframe entering a later window takes the vertex and edges of one that left
+  const std::vector<EdgeSE3ProjectXYZ*> vpThird = SetWindow(graph, camera, vTcw, vPoints, 2, 5);
+  EXPECT_EQ(graph.NumVertices(), 3u + vPoints.size());
+  EXPECT_EQ(graph.NumEdges(), 3 * vPoints.size());
+  EXPECT_EQ(graph.KeyFrameVertex(4), vLeaving);
+  EXPECT_EQ(vLeaving->id(), 8);
+  for (std::size_t j = 0; j < vPoints.size(); j++) {
+    EXPECT_EQ(vpThird[3 * j + 2]->vertex(1), vLeaving);
+  }
+  ASSERT_TRUE(optimizer.initializeOptimization());
+}
+
+TEST(LocalBAGraphTest, KeepsInertialEdgesOfTheSamePreintegration) {
+  Pinhole          camera(std::vector<float>{458.654f, 457.296f, 367.215f, 248.375f});
+  const IMU::Calib calib(Sophus::SE3f(), 1.7e-4f, 2.0e-3f, 1.9e-5f, 3.0e-3f);
+
+  std::vector<std::unique_ptr<IMU::Preintegrated>> vPreintegrated;
+  std::vector<IMU::Preintegrated*>                 vpInt;
+  for (int i = 0; i < 5; i++) {
+    vPreintegrated.push_back(Preintegration(calib));
+    vpInt.push_back(vPreintegrated.back().get());
+  }
+  const Matrix9d information = EdgeInertial(vpInt[2]).information();
+
+  LocalInertialBAGraph             graph;
+  const std::vector<EdgeInertial*> vpFirst = SetInertialWindow(graph, camera, vpInt, 0, 3);
+  EXPECT_EQ(graph.NumVertices(), 4u * 3);
+  EXPECT_EQ(graph.NumEdges(), 3u * 2);
+
+  // The window downweights the edge to its fixed keyframe
+  vpFirst[1]->setInformation(vpFirst[1]->information() * 1e-2);
+  vpFirst[1]->setRobustKernel(new g2o::RobustKernelHuber);
+
+  // The next window keeps it, as it was made from the preintegration
+  const std::vector<EdgeInertial*> vpSecond = SetInertialWindow(graph, camera, vpInt, 1, 4);
+  EXPECT_EQ(graph.NumVertices(), 4u * 3);
+  EXPECT_EQ(graph.NumEdges(), 3u * 2);
+  ASSERT_EQ(vpSecond.size(), 2u);
+  EXPECT_EQ(vpSecond[0], vpFirst[1]);
+  EXPECT_TRUE(vpSecond[0]->information().isApprox(information));
+  EXPECT_EQ(vpSecond[0]->robustKernel(), nullptr);
+  EXPECT_EQ(vpSecond[1]->mpInt, vpInt[3]);
+  EXPECT_FALSE(graph.HasInertialVertices(0));
+  EXPECT_TRUE(graph.HasInertialVertices(3));
+
+  g2o::SparseOptimizer& optimizer = graph.Optimizer();
+  ASSERT_TRUE(optimizer.initializeOptimization());
+  optimizer.optimize(5);
+  for (int i = 2; i < 4; i++) {
+    EXPECT_LT(graph.PoseVertex(i)->estimate().twb.norm(), 1e-3) << "keyframe " << i;
+  }
+
+  // An edge is made again for a new preintegration between the keyframes
+  vpInt[3] = vpInt[4];
+  const std::vector<EdgeInertial*> vpThird = SetInertialWindow(graph, camera, vpInt, 1, 4);
+  EXPECT_EQ(vpThird[0], vpSecond[0]);
+  EXPECT_EQ(vpThird[1]->mpInt, vpInt[3]);
+  EXPECT_EQ(graph.NumEdges(), 3u * 2);
+
+  // Clearing the graph removes everything, for later windows to start over
+  graph.Clear();
+  EXPECT_EQ(graph.NumVertices(), 0u);
+  EXPECT_EQ(graph.NumEdges(), 0u);
+  EXPECT_FALSE(graph.HasInertialVertices(3));
+  SetInertialWindow(graph, camera, vpInt, 1, 4);
+  EXPECT_EQ(graph.NumVertices(), 4u * 3);
+  ASSERT_TRUE(optimizer.initializeOptimization());
+}
@@ -0,0 +1,112 @@
+#include "ORBdescriptor.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <opencv2/imgproc.hpp>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+const int HALF_PATCH_SIZE = 15;
+
+// Scalar reference implementations, as formerly found in ORBextractor.cc
+float ReferenceAngle(const cv::Mat& image, const cv::Point2f& pt, const std::vector<int>& umax) {
+  int          m_01 = 0, m_10 = 0;
+  const uchar* center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+  for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u) {
+    m_10 += u * center[u];
+  }
+  const int step = (int)image.step1();
+  for (int v = 1; v <= HALF_PATCH_SIZE; ++v) {
+    int v_sum = 0;
+    for (int u = -umax[v]; u <= umax[v]; ++u) {
+      int val_plus = center[u + v * step], val_minus = center[u - v * step];
+      v_sum += (val_plus - val_minus);
+      m_10  += u * (val_plus + val_minus);
+    }
+    m_01 += v * v_sum;
+  }
+  return cv::fastAtan2((float)m_01, (float)m_10);
+}
+
+void ReferenceDescriptor(
+  const cv::KeyPoint& kpt, const cv::Mat& img, const std::vector<cv::Point>& pattern, uchar* desc
+) {
+  const float  angle = (float)kpt.angle * (float)(CV_PI / 180.f);
+  const float  a = (float)std::cos(angle), b = (float)std::sin(angle);
+  const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+  const int    step   = (int)img.step;
+  auto         value  = [&](const cv::Point& p) {
+    return center[cvRound(p.x * b + p.y * a) * step + cvRound(p.x * a - p.y * b)];
+  };
+  for (int i = 0; i < 32; i++) {
+    int val = 0;
+    for (int j = 0; j < 8; j++) {
+      val |= (value(pattern[16 * i + 2 * j]) < value(pattern[16 * i + 2 * j + 1])) << j;
+    }
+    desc[i] = (uchar)val;
+  }
+}
+
+std::vector<int> MakeUmax() {
+  std::vector<int> umax(HALF_PATCH_SIZE + 1);
+  const int        vmax = cvFloor(HALF_PATCH_SIZE * std::sqrt(2.f) / 2 + 1);
+  const int        vmin = cvCeil(HALF_PATCH_SIZE * std::sqrt(2.f) / 2);
+  for (int v = 0; v <= vmax; ++v) {
+    umax[v] = cvRound(std::sqrt(HALF_PATCH_SIZE * HALF_PATCH_SIZE - v * v));
+  }
+  for (int v = HALF_PATCH_SIZE, v0 = 0; v >= vmin; --v) {
+    while (umax[v0] == umax[v0 + 1]) {
+      ++v0;
+    }
+    umax[v] = v0;
+    ++v0;
+  }
+  return umax;
+}
+
+} // namespace
+
+TEST(ORBdescriptorTest, MatchesScalarReference) {
+  cv::RNG rng(7);
+  cv::Mat image(120, 160, CV_8UC1);
+  rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+  cv::GaussianBlur(image, image, cv::Size(3, 3), 1);
+
+  std::vector<cv::Point> pattern(512);
+  for (cv::Point& p : pattern) {
+    p = cv::Point(rng.uniform(-13, 14), rng.uniform(-13, 14));
+  }
+
+  // Keypoints down to the last valid row, so that the non-gather path is also covered
+  std::vector<cv::KeyPoint> keypoints;
+  for (int i = 0; i < 500; i++) {
+    keypoints.emplace_back(rng.uniform(19.f, 140.f), rng.uniform(19.f, 100.f), 31.f);
+  }
+
+  const std::vector<int> umax = MakeUmax();
+  ComputeOrientations(image, keypoints, umax);
+  for (const cv::KeyPoint& kpt : keypoints) {
+    ASSERT_EQ(kpt.angle, ReferenceAngle(image, kpt.pt, umax));
+  }
+
+  cv::Mat descriptors;
+  ComputeDescriptors(image, keypoints, pattern, descriptors);
+  ASSERT_EQ(descriptors.rows, static_cast<int>(keypoints.size()));
+  for (std::size_t i = 0; i < keypoints.size(); i++) {
+    uchar expected[32];
+    ReferenceDescriptor(keypoints[i], image, pattern, expected);
+    EXPECT_EQ(std::memcmp(expected, descriptors.ptr((int)i), 32), 0) << "keypoint " << i;
+  }
+
+  // With one bin per degree and integer angles the binned path is exact as well
+  for (cv::KeyPoint& kpt : keypoints) {
+    kpt.angle = static_cast<float>(cvRound(kpt.angle) % 360);
+  }
+  ComputeDescriptors(image, keypoints, pattern, descriptors);
+  cv::Mat binned;
+  ComputeDescriptorsBinned(image, keypoints, ComputeRotatedPatterns(pattern, 360), 360, binned);
+  EXPECT_EQ(cv::countNonZero(descriptors != binned), 0);
+}
@@ -0,0 +1,351 @@
+#include "ORBextractor.h"
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <random>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include <opencv2/imgproc.hpp>
+#include "ThreadPool.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// List-based quadtree distribution, as formerly found in ORBextractor.cc
+struct ReferenceNode {
+  std::vector<cv::KeyPoint>          vKeys;
+  cv::Point2i                        UL, UR, BL, BR;
+  std::list<ReferenceNode>::iterator lit;
+  bool                               bNoMore = false;
+
+  void DivideNode(ReferenceNode& n1, ReferenceNode& n2, ReferenceNode& n3, ReferenceNode& n4) {
+    const int halfX = std::ceil(static_cast<float>(UR.x - UL.x) / 2);
+    const int halfY = std::ceil(static_cast<float>(BR.y - UL.y) / 2);
+
+    n1.UL = UL;
+    n1.UR = cv::Point2i(UL.x + halfX, UL.y);
+    n1.BL = cv::Point2i(UL.x, UL.y + halfY);
+    n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
+    n2.UL = n1.UR;
+    n2.UR = UR;
+    n2.BL = n1.BR;
+    n2.BR = cv::Point2i(UR.x, UL.y + halfY);
+    n3.UL = n1.BL;
+    n3.UR = n1.BR;
+    n3.BL = BL;
+    n3.BR = cv::Point2i(n1.BR.x, BL.y);
+    n4.UL = n3.UR;
+    n4.UR = n2.BR;
+    n4.BL = n3.BR;
+    n4.BR = BR;
+
+    for (const cv::KeyPoint& kp : vKeys) {
+      if (kp.pt.x < n1.UR.x) {
+        (kp.pt.y < n1.BR.y ? n1 : n3).vKeys.push_back(kp);
+      } else {
+        (kp.pt.y < n1.BR.y ? n2 : n4).vKeys.push_back(kp);
+      }
+    }
+    for (ReferenceNode* pNode : {&n1, &n2, &n3, &n4}) {
+      pNode->bNoMore = pNode->vKeys.size() == 1;
+    }
+  }
+};
+
+std::vector<cv::KeyPoint> ReferenceDistributeOctTree(
+  const std::vector<cv::KeyPoint>& vToDistributeKeys,
+  const int                        minX,
+  const int                        maxX,
+  const int                        minY,
+  const int                        maxY,
+  const int                        N
+) {
+  const int   nIni = std::round(static_cast<float>(maxX - minX) / (maxY - minY));
+  const float hX   = static_cast<float>(maxX - minX) / nIni;
+
+  std::list<ReferenceNode>    lNodes;
+  std::vector<ReferenceNode*> vpIniNodes(nIni);
+  for (int i = 0; i < nIni; i++) {
+    ReferenceNode ni;
+    ni.UL = cv::Point2i(hX * static_cast<float>(i), 0);
+    ni.UR = cv::Point2i(hX * static_cast<float>(i + 1), 0);
+    ni.BL = cv::Point2i(ni.UL.x, maxY - minY);
+    ni.BR = cv::Point2i(ni.UR.x, maxY - minY);
+    lNodes.push_back(ni);
+    vpIniNodes[i] = &lNodes.back();
+  }
+  for (const cv::KeyPoint& kp : vToDistributeKeys) {
+    vpIniNodes[kp.pt.x / hX]->vKeys.push_back(kp);
+  }
+  for (auto lit = lNodes.begin(); lit != lNodes.end();) {
+    if (lit->vKeys.empty()) {
+      lit = lNodes.erase(lit);
+    } else {
+      lit->bNoMore = lit->vKeys.size() == 1;
+      lit++;
+    }
+  }
+
+  std::vector<std::pair<int, ReferenceNode*>> vSizeAndPointerToNode;
+
+  // Divide a node, pushing its non-empty children to the front of the list
+  const auto divide = [&](ReferenceNode& node) {
+    ReferenceNode n1, n2, n3, n4;
+    node.DivideNode(n1, n2, n3, n4);
+    int nToExpand = 0;
+    for (ReferenceNode* pChild : {&n1, &n2, &n3, &n4}) {
+      if (pChild->vKeys.empty()) {
+        continue;
+      }
+      lNodes.push_front(*pChild);
+      if (pChild->vKeys.size() > 1) {
+        nToExpand++;
+        vSizeAndPointerToNode.emplace_back(pChild->vKeys.size(), &lNodes.front());
+        lNodes.front().lit = lNodes.begin();
+      }
+    }
+    return nToExpand;
+  };
+
+  const auto compareNodes = [](const std::pair<int, ReferenceNode*>& e1,
+                               const std::pair<int, ReferenceNode*>& e2) {
+    if (e1.first != e2.first) {
+      return e1.first < e2.first;
+    }
+    return e1.second->UL.x < e2.second->UL.x;
+  };
+
+  bool bFinish = false;
+  while (!bFinish) {
+    int prevSize  = lNodes.size();
+    int nToExpand = 0;
+    vSizeAndPointerToNode.clear();
+
+    for (auto lit = lNodes.begin(); lit != lNodes.end();) {
+      if (lit->bNoMore) {
+        lit++;
+      } else {
+        nToExpand += divide(*lit);
+        lit       = lNodes.erase(lit);
+      }
+    }
+
+    if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
+      bFinish = true;
+    } else if (((int)lNodes.size() + nToExpand * 3) > N) {
+      while (!bFinish) {
+        prevSize = lNodes.size();
+
+        std::vector<std::pair<int, ReferenceNode*>> vPrevSizeAndPointerToNode
+          = vSizeAndPointerToNode;
+        vSizeAndPointerToNode.clear();
+
+        std::sort(vPrevSizeAndPointerToNode.begin(), vPrevSizeAndPointerToNode.end(), compareNodes);
+        for (int j = vPrevSizeAndPointerToNode.size() - 1; j >= 0; j--) {
+          divide(*vPrevSizeAndPointerToNode[j].second);
+          lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
+          if ((int)lNodes.size() >= N) {
+            break;
+          }
+        }
+
+        if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
+          bFinish = true;
+        }
+      }
+    }
+  }
+
+  std::vector<cv::KeyPoint> vResultKeys;
+  for (const ReferenceNode& node : lNodes) {
+    const cv::KeyPoint* pKP = &node.vKeys[0];
+    for (const cv::KeyPoint& kp : node.vKeys) {
+      if (kp.response > pKP->response) {
+        pKP = &kp;
+      }
+    }
+    vResultKeys.push_back(*pKP);
+  }
+  return vResultKeys;
+}
+
+class TestORBextractor : public ORBextractor {
+public:
+  TestORBextractor() : ORBextractor(1000, 1.2f, 8, 20, 7) {}
+
+  using ORBextractor::DistributeOctTree;
+};
+
+// Keypoints in the region of size W x H, identified by their class_id. Responses take few values
+// so that many nodes hold ties.
+std::vector<cv::KeyPoint> RandomKeyPoints(
+  std::mt19937& rng, const int n, const int W, const int H
+) {
+  std::vector<cv::KeyPoint> vKeys(n);
+  for (int i = 0; i < n; i++) {
+    vKeys[i].pt       = cv::Point2f(rng() % W + (rng() % 2 ? 0.5f : 0.f), rng() % H);
+    vKeys[i].response = rng() % 20;
+    vKeys[i].class_id = i;
+  }
+  return vKeys;
+}
+
+std::vector<int> Ids(const std::vector<cv::KeyPoint>& vKeys) {
+  std::vector<int> vIds;
+  for (const cv::KeyPoint& kp : vKeys) {
+    vIds.push_back(kp.class_id);
+  }
+  return vIds;
+}
+
+// Distribute with the extractor and the reference on the region [16, 16 + W) x [16, 16 + H)
+void ExpectSameAsReference(
+  TestORBextractor&                extractor,
+  const std::vector<cv::KeyPoint>& vKeys,
+  const int                        W,
+  const int                        H,
+  const int                        N,
+  const int                        level,
+  std::vector<cv::KeyPoint>&       vResultKeys
+) {
+  extractor.DistributeOctTree(vKeys, 16, 16 + W, 16, 16 + H, N, level, vResultKeys);
+  EXPECT_EQ(Ids(vResultKeys), Ids(ReferenceDistributeOctTree(vKeys, 16, 16 + W, 16, 16 + H, N)))
+    << vKeys.size() << " keypoints in " << W << "x" << H << ", " << N << " features";
+}
+
+// Textured image of size W x H: random shapes on a noisy background
+cv::Mat TexturedImage(std::mt19937& rng, const int W, const int H) {
+  cv::Mat image(H, W, CV_8UC1);
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      image.at<uchar>(y, x) = 96 + rng() % 64;
+    }
+  }
+  for (int i = 0; i < W * H / 2000; i++) {
+    const cv::Point  center(rng() % W, rng() % H);
+    const cv::Scalar color(rng() % 256);
+    if (rng() % 2) {
+      cv::circle(image, center, 3 + rng() % 20, color, cv::FILLED);
+    } else {
+      const cv::Point corner(center.x + 5 + rng() % 30, center.y + 5 + rng() % 30);
+      cv::rectangle(image, center, corner, color, cv::FILLED);
+    }
+  }
+  return image;
+}
+
+// Run the extractor on image and expect the features of a freshly built extractor on the same
+// threads, bit for bit
+void ExpectSameAsFreshExtractor(
+  ORBextractor& extractor, ThreadPool& threadPool, const cv::Mat& image
+) {
+  std::vector<int> vLappingArea = {0, 1000};
+
+  std::vector<cv::KeyPoint> vKeys;
+  cv::Mat                   descriptors;
+
+  const int nMono = extractor(image, cv::Mat(), vKeys, descriptors, vLappingArea);
+
+  ORBextractor              fresh(1000, 1.2f, 8, 20, 7, &threadPool);
+  std::vector<cv::KeyPoint> vFreshKeys;
+  cv::Mat                   freshDescriptors;
+
+  const int nFreshMono = fresh(image, cv::Mat(), vFreshKeys, freshDescriptors, vLappingArea);
+
+  EXPECT_EQ(nMono, nFreshMono);
+  ASSERT_EQ(vKeys.size(), vFreshKeys.size()) << image.cols << "x" << image.rows;
+  ASSERT_FALSE(vKeys.empty());
+  for (std::size_t i = 0; i < vKeys.size(); i++) {
+    EXPECT_EQ(vKeys[i].pt, vFreshKeys[i].pt) << "keypoint " << i;
+    EXPECT_EQ(vKeys[i].angle, vFreshKeys[i].angle) << "keypoint " << i;
+    EXPECT_EQ(vKeys[i].octave, vFreshKeys[i].octave) << "keypoint " << i;
+    EXPECT_EQ(vKeys[i].response, vFreshKeys[i].response) << "keypoint " << i;
+  }
+  ASSERT_EQ(descriptors.size(), freshDescriptors.size());
+  EXPECT_EQ(cv::countNonZero(descriptors != freshDescriptors), 0);
+  for (int level = 0; level < extractor.GetLevels(); level++) {
+    const cv::Mat& pyramid      = extractor.mvImagePyramid[level];
+    const cv::Mat& freshPyramid = fresh.mvImagePyramid[level];
+    ASSERT_EQ(pyramid.size(), freshPyramid.size()) << "level " << level;
+    EXPECT_EQ(cv::countNonZero(pyramid != freshPyramid), 0) << "level " << level;
+  }
+}
+
+} // namespace
+
+TEST(ORBextractorTest, ReusedBuffersMatchFreshExtractor) {
+  std::mt19937  rng(11);
+  const cv::Mat large = TexturedImage(rng, 752, 480);
+  const cv::Mat small = TexturedImage(rng, 512, 384);
+  const cv::Mat other = TexturedImage(rng, 800, 600);
+
+  // The buffers of the large image are reused for a smaller one, whose levels all have other
+  // sizes, then for the large one again and for a view into a wider image
+  ThreadPool   threadPool(4);
+  ORBextractor extractor(1000, 1.2f, 8, 20, 7, &threadPool);
+  ExpectSameAsFreshExtractor(extractor, threadPool, large);
+  ExpectSameAsFreshExtractor(extractor, threadPool, small);
+  ExpectSameAsFreshExtractor(extractor, threadPool, large);
+  ExpectSameAsFreshExtractor(extractor, threadPool, other(cv::Rect(30, 50, 640, 480)));
+  ExpectSameAsFreshExtractor(extractor, threadPool, small);
+}
+
+TEST(ORBextractorTest, DistributeOctTreeMatchesListBasedReference) {
+  TestORBextractor          extractor;
+  std::mt19937              rng(3);
+  std::vector<cv::KeyPoint> vResultKeys;
+  for (int t = 0; t < 300; t++) {
+    const int H = 60 + rng() % 400;
+    const int W = H + rng() % 700;
+    const std::vector<cv::KeyPoint> vKeys = RandomKeyPoints(rng, rng() % 3000, W, H);
+    // The arena of each level is reused from one call to the next
+    ExpectSameAsReference(extractor, vKeys, W, H, 1 + rng() % 600, rng() % 8, vResultKeys);
+  }
+}
+
+TEST(ORBextractorTest, DistributeOctTreeTruncatesToMaxFeatures) {
+  TestORBextractor          extractor;
+  std::mt19937              rng(5);
+  std::vector<cv::KeyPoint> vResultKeys;
+  const std::vector<cv::KeyPoint> vKeys = RandomKeyPoints(rng, 5000, 720, 460);
+  for (const int N : {1, 7, 50, 217, 1000}) {
+    ExpectSameAsReference(extractor, vKeys, 720, 460, N, 0, vResultKeys);
+    EXPECT_GE(vResultKeys.size(), static_cast<std::size_t>(N));
+    EXPECT_LT(vResultKeys.size(), vKeys.size());
+  }
+}
+
+TEST(ORBextractorTest, DistributeOctTreeSingleNode) {
+  TestORBextractor          extractor;
+  std::vector<cv::KeyPoint> vResultKeys(3);
+
+  // No keypoint: the output is cleared
+  ExpectSameAsReference(extractor, {}, 300, 300, 100, 0, vResultKeys);
+  EXPECT_TRUE(vResultKeys.empty());
+
+  // A single keypoint, in the only initial node or in one of several
+  cv::KeyPoint kp(cv::Point2f(250.5f, 20.f), 7.f);
+  kp.response = 3.f;
+  kp.class_id = 0;
+  ExpectSameAsReference(extractor, {kp}, 300, 300, 100, 1, vResultKeys);
+  ExpectSameAsReference(extractor, {kp}, 900, 300, 100, 1, vResultKeys);
+  ASSERT_EQ(vResultKeys.size(), 1u);
+  EXPECT_EQ(vResultKeys[0].class_id, 0);
+
+  // Keypoints that no division separates stay in one node, which keeps the first strongest
+  std::vector<cv::KeyPoint> vKeys(6, kp);
+  for (int i = 0; i < 6; i++) {
+    vKeys[i].response = i % 3;
+    vKeys[i].class_id = i;
+  }
+  ExpectSameAsReference(extractor, vKeys, 300, 300, 100, 2, vResultKeys);
+  ASSERT_EQ(vResultKeys.size(), 1u);
+  EXPECT_EQ(vResultKeys[0].class_id, 2);
+
+  // A single feature is asked for
+  std::mt19937 rng(9);
+  ExpectSameAsReference(extractor, RandomKeyPoints(rng, 40, 300, 300), 300, 300, 1, 3, vResultKeys);
+  EXPECT_FALSE(vResultKeys.empty());
+}
@@ -0,0 +1,719 @@
+#include "Frame.h"
+#include "KeyFrame.h"
+#include "Map.h"
+#include "MapPoint.h"
+#include "ORBmatcher.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include <gtest/gtest.h>
+#include "CameraModels/Pinhole.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+const float kWidth = 640.f, kHeight = 480.f;
+
+Descriptor RandomDescriptor(std::mt19937& rng) {
+  Descriptor descriptor;
+  for (std::uint64_t& word : descriptor.words) {
+    word = (static_cast<std::uint64_t>(rng()) << 32) | rng();
+  }
+  return descriptor;
+}
+
+// Descriptor differing from the given one by nBits random bits, possibly the same bit twice
+Descriptor Perturbed(Descriptor descriptor, const int nBits, std::mt19937& rng) {
+  for (int i = 0; i < nBits; i++) {
+    const int bit = static_cast<int>(rng() % (8 * Descriptor::kBytes));
+    descriptor.data()[bit / 8] ^= static_cast<unsigned char>(1u << (bit % 8));
+  }
+  return descriptor;
+}
+
+// Grid of the keypoints vKeys of F, as the frame constructors assign them
+FeatureGrid GridOf(Frame& F, const std::vector<cv::KeyPoint>& vKeys) {
+  FeatureGrid      grid(FRAME_GRID_COLS, FRAME_GRID_ROWS);
+  std::vector<int> vCells(vKeys.size(), -1);
+  for (std::size_t i = 0; i < vKeys.size(); i++) {
+    int x, y;
+    if (F.PosInGrid(vKeys[i], x, y)) {
+      vCells[i] = grid.CellIndex(x, y);
+    }
+  }
+  grid.Assign(vCells);
+  return grid;
+}
+
+// Frame of a single camera at the origin with the given keypoints and descriptors on the grid of a
+// kWidth x kHeight image, as the frame constructors assign them.
+std::unique_ptr<Frame> MakeFrame(
+  const std::vector<cv::KeyPoint>& vKeys, const std::vector<Descriptor>& vDescriptors
+) {
+  Frame::mnMinX                 = 0.f;
+  Frame::mnMaxX                 = kWidth;
+  Frame::mnMinY                 = 0.f;
+  Frame::mnMaxY                 = kHeight;
+  Frame::mfGridElementWidthInv  = FRAME_GRID_COLS / kWidth;
+  Frame::mfGridElementHeightInv = FRAME_GRID_ROWS / kHeight;
+
+  auto pF               = std::make_unique<Frame>();
+  pF->mnId              = 0;
+  pF->N                 = static_cast<int>(vKeys.size());
+  pF->Nleft             = -1;
+  pF->mvKeys            = vKeys;
+  pF->mvKeysUn          = vKeys;
+  pF->mvuRight          = std::vector<float>(vKeys.size(), -1.f);
+  pF->mvDepth           = std::vector<float>(vKeys.size(), -1.f);
+  pF->mnScaleLevels     = 2;
+  pF->mfScaleFactor     = 1.2f;
+  pF->mfLogScaleFactor  = std::log(1.2f);
+  pF->mvScaleFactors    = {1.f, 1.2f};
+  pF->mvInvScaleFactors = {1.f, 1.f / 1.2f};
+  pF->mvLevelSigma2     = {1.f, 1.44f};
+  pF->mvInvLevelSigma2  = {1.f, 1.f / 1.44f};
+  pF->mvpMapPoints.assign(vKeys.size(), nullptr);
+  pF->mvbOutlier.assign(vKeys.size(), false);
+  pF->SetPose(Sophus::SE3f());
+
+  DescriptorArray descriptors;
+  descriptors.Resize(vDescriptors.size());
+  for (std::size_t i = 0; i < vDescriptors.size(); i++) {
+    descriptors[i] = vDescriptors[i];
+  }
+  pF->mDescriptors = std::move(descriptors);
+
+  pF->mGrid = GridOf(*pF, vKeys);
+  return pF;
+}
+
+// Keypoints crowded in a corner of the image, so that the search windows overlap, with map points
+// projected next to them. Several points are built from the descriptor of the same keypoint and
+// compete for it. A few keypoints are already matched, some to points seen by keyframes.
+struct ProjectionScene {
+  std::vector<cv::KeyPoint>              vKeys;
+  std::vector<Descriptor>                vDescriptors;
+  Map                                    map;
+  std::unique_ptr<Frame>                 pReference;
+  std::vector<std::unique_ptr<MapPoint>> vpOwned;
+  std::vector<MapPoint*>                 vpLocalMapPoints;
+  std::vector<std::pair<int, MapPoint*>> vPrevious;
+
+  explicit ProjectionScene(const unsigned seed) {
+    std::mt19937 rng(seed);
+    const int    nKeys = 150, nMPs = 200, nPrevious = 12;
+
+    for (int i = 0; i < nKeys; i++) {
+      const float x = 20.f + static_cast<float>(rng() % 16000) / 100.f;
+      const float y = 20.f + static_cast<float>(rng() % 12000) / 100.f;
+      vKeys.emplace_back(x, y, 31.f, -1.f, 0.f, static_cast<int>(rng() % 2));
+      vDescriptors.push_back(RandomDescriptor(rng));
+    }
+
+    std::vector<cv::KeyPoint> vReferenceKeys;
+    std::vector<Descriptor>   vReferenceDescriptors;
+    std::vector<int>          vTargets;
+    for (int i = 0; i < nMPs + nPrevious; i++) {
+      const int target = static_cast<int>(rng() % (nKeys / 3));
+      vTargets.push_back(target);
+      vReferenceKeys.emplace_back(0.f, 0.f, 31.f, -1.f, 0.f, 0);
+      vReferenceDescriptors.push_back(
+        Perturbed(vDescriptors[target], static_cast<int>(rng() % 60), rng)
+      );
+    }
+    pReference = MakeFrame(vReferenceKeys, vReferenceDescriptors);
+
+    for (int i = 0; i < nMPs + nPrevious; i++) {
+      vpOwned.push_back(
+        std::make_unique<MapPoint>(Eigen::Vector3f(0.f, 0.f, 1.f), &map, pReference.get(), i)
+      );
+      MapPoint*           pMP = vpOwned.back().get();
+      const cv::KeyPoint& kp  = vKeys[vTargets[i]];
+
+      pMP->nObs              = 2;
+      pMP->mbTrackInView     = rng() % 10 != 0;
+      pMP->mbTrackInViewR    = false;
+      pMP->mTrackProjX       = kp.pt.x + static_cast<float>(rng() % 1000) / 100.f - 5.f;
+      pMP->mTrackProjY       = kp.pt.y + static_cast<float>(rng() % 1000) / 100.f - 5.f;
+      pMP->mTrackProjXR      = -1.f;
+      pMP->mTrackDepth       = 1.f;
+      pMP->mnTrackScaleLevel = kp.octave;
+      pMP->mTrackViewCos     = 1.f;
+
+      if (i < nMPs) {
+        vpLocalMapPoints.push_back(pMP);
+      } else {
+        // Matched by the previous frame, half of them to points not in any keyframe
+        pMP->nObs = (i % 2) ? 2 : 0;
+        vPrevious.emplace_back(static_cast<int>(rng() % nKeys), pMP);
+      }
+    }
+  }
+
+  std::unique_ptr<Frame> CurrentFrame() const {
+    std::unique_ptr<Frame> pF = MakeFrame(vKeys, vDescriptors);
+    for (const auto& [idx, pMP] : vPrevious) {
+      pF->mvpMapPoints[idx] = pMP;
+    }
+    return pF;
+  }
+};
+
+// Search of the map points one after the other, as a single camera frame was tracked before the
+// search was parallelized. Each point takes its best keypoint not matched to a point seen by a
+// keyframe, so later points see the matches of the earlier ones.
+int SerialSearchByProjection(
+  Frame& F, const std::vector<MapPoint*>& vpMapPoints, const float th, const float nnratio
+) {
+  int nmatches = 0;
+  for (MapPoint* pMP : vpMapPoints) {
+    if (!pMP->mbTrackInView || pMP->isBad()) {
+      continue;
+    }
+
+    // Radius of a point seen head on
+    const int                      nLevel   = pMP->mnTrackScaleLevel;
+    const float                    r        = 2.5f * th;
+    const std::vector<std::size_t> vIndices = F.GetFeaturesInArea(
+      pMP->mTrackProjX, pMP->mTrackProjY, r * F.mvScaleFactors[nLevel], nLevel - 1, nLevel
+    );
+
+    const Descriptor descriptor = pMP->GetDescriptor();
+    int              bestDist = 256, bestLevel = -1, bestDist2 = 256, bestLevel2 = -1, bestIdx = -1;
+    for (const std::size_t idx : vIndices) {
+      if (F.mvpMapPoints[idx] && F.mvpMapPoints[idx]->Observations() > 0) {
+        continue;
+      }
+
+      const int dist = ORBmatcher::DescriptorDistance(descriptor, F.mDescriptors[idx]);
+      if (dist < bestDist) {
+        bestDist2  = bestDist;
+        bestDist   = dist;
+        bestLevel2 = bestLevel;
+        bestLevel  = F.mvKeysUn[idx].octave;
+        bestIdx    = static_cast<int>(idx);
+      } else if (dist < bestDist2) {
+        bestLevel2 = F.mvKeysUn[idx].octave;
+        bestDist2  = dist;
+      }
+    }
+
+    if (bestDist <= ORBmatcher::TH_HIGH
+        && (bestLevel != bestLevel2 || bestDist <= nnratio * bestDist2)) {
+      F.mvpMapPoints[bestIdx] = pMP;
+      nmatches++;
+    }
+  }
+  return nmatches;
+}
+
+// Keyframe of two cameras sharing their center at the origin, as the local mapping fuses points
+// into it, with map points projected onto its keypoints. Several points compete for the same
+// keypoint, some of them already matched to a point of the keyframe, and some appear twice in the
+// list to fuse. Monocular keyframes in front of it give the points their observations and
+// descriptors. The keyframes are built once, so that the observations of every point are in the
+// same order from one population to the next.
+struct FuseScene {
+  // Point of the scene, observed by its first nObservers observers, and by the keyframe at kfIdx
+  // unless -1
+  struct PointDesign {
+    Eigen::Vector3f pos;
+    Descriptor      descriptor;
+    int             nObservers;
+    int             kfIdx;
+  };
+
+  Map                                    map;
+  Pinhole                                leftCamera, rightCamera;
+  std::unique_ptr<KeyFrame>              pKF;
+  std::vector<std::unique_ptr<KeyFrame>> vpObservers;
+  std::vector<PointDesign>               vDesigns;
+  std::vector<int>                       vFused;
+  std::vector<std::unique_ptr<MapPoint>> vpOwned;
+
+  explicit FuseScene(const unsigned seed)
+    : leftCamera(std::vector<float>{458.f, 457.f, 320.f, 240.f})
+    , rightCamera(std::vector<float>{458.f, 457.f, 300.f, 250.f}) {
+    std::mt19937 rng(seed);
+    const int    nTargets = 40, nCandidates = 80, nObservers = 3;
+
+    // Keypoints of every target in both images, with descriptors unrelated from one image to the
+    // other
+    std::vector<Eigen::Vector3f> vTargets;
+    std::vector<cv::KeyPoint>    vLeftKeys, vRightKeys;
+    std::vector<Descriptor>      vLeftDescriptors, vRightDescriptors;
+    const auto                   Noise = [&rng](const float amplitude) {
+      return amplitude * (static_cast<float>(rng() % 2001) / 1000.f - 1.f);
+    };
+    for (int t = 0; t < nTargets; t++) {
+      const float           u = 40.f + static_cast<float>(rng() % 56000) / 100.f;
+      const float           v = 40.f + static_cast<float>(rng() % 40000) / 100.f;
+      const float           z = 2.f + static_cast<float>(rng() % 2000) / 1000.f;
+      const Eigen::Vector3f X((u - 320.f) / 458.f * z, (v - 240.f) / 457.f * z, z);
+      const Eigen::Vector2f uvR = rightCamera.project(X);
+      vTargets.push_back(X);
+      vLeftKeys.emplace_back(u + Noise(0.4f), v + Noise(0.4f), 31.f, -1.f, 0.f, 1);
+      vRightKeys.emplace_back(uvR(0) + Noise(0.4f), uvR(1) + Noise(0.4f), 31.f, -1.f, 0.f, 1);
+      vLeftDescriptors.push_back(RandomDescriptor(rng));
+      vRightDescriptors.push_back(RandomDescriptor(rng));
+    }
+
+    // Points already matched by the keyframe, one per target in one of the images
+    for (int t = 0; t < nTargets; t++) {
+      const bool bRight = rng() % 2;
+      vDesigns.push_back(
+        {vTargets[t],
+         bRight ? vRightDescriptors[t] : vLeftDescriptors[t],
+         1 + static_cast<int>(rng() % nObservers),
+         bRight ? nTargets + t : t}
+      );
+    }
+
+    // Points to fuse, crowded on half of the targets
+    for (int i = 0; i < nCandidates; i++) {
+      const int         t     = static_cast<int>(rng() % (nTargets / 2));
+      const Descriptor& d     = rng() % 2 ? vRightDescriptors[t] : vLeftDescriptors[t];
+      Eigen::Vector3f   noise = Eigen::Vector3f::Zero();
+      for (int k = 0; k < 3; k++) {
+        noise(k) = Noise(0.003f);
+      }
+      vDesigns.push_back(
+        {vTargets[t] + noise,
+         Perturbed(d, static_cast<int>(rng() % 40), rng),
+         1 + static_cast<int>(rng() % nObservers),
+         -1}
+      );
+      vFused.push_back(nTargets + i);
+    }
+    for (int i = 0; i < 10; i++) {
+      vFused.push_back(nTargets + static_cast<int>(rng() % nCandidates));
+    }
+    for (int i = 0; i < 5; i++) {
+      vFused.push_back(static_cast<int>(rng() % nTargets));
+    }
+    std::shuffle(vFused.begin(), vFused.end(), rng);
+
+    // Stereo keyframe at the origin
+    std::unique_ptr<Frame> pF = MakeFrame(vLeftKeys, vLeftDescriptors);
+    pF->N                     = 2 * nTargets;
+    pF->Nleft                 = nTargets;
+    pF->Nright                = nTargets;
+    pF->mvKeysRight           = vRightKeys;
+    pF->mvuRight              = std::vector<float>(2 * nTargets, -1.f);
+    pF->mvDepth               = std::vector<float>(2 * nTargets, -1.f);
+    pF->mvpMapPoints.assign(2 * nTargets, nullptr);
+    pF->mvbOutlier.assign(2 * nTargets, false);
+    pF->mvLeftToRightMatch = std::vector<int>(nTargets, -1);
+    pF->mvRightToLeftMatch = std::vector<int>(nTargets, -1);
+    pF->mpCamera           = &leftCamera;
+    pF->mpCamera2          = &rightCamera;
+    pF->mGridRight         = GridOf(*pF, vRightKeys);
+
+    DescriptorArray descriptors = pF->mDescriptors;
+    DescriptorArray descriptorsRight;
+    descriptorsRight.Resize(nTargets);
+    for (int t = 0; t < nTargets; t++) {
+      descriptorsRight[t] = vRightDescriptors[t];
+    }
+    descriptors.Append(descriptorsRight);
+    pF->mDescriptors      = std::move(descriptors);
+    pF->mDescriptorsRight = std::move(descriptorsRight);
+    pKF                   = std::make_unique<KeyFrame>(*pF, &map, nullptr);
+
+    // Observers 20 cm in front of the keyframe, keypoint i observing point i
+    std::vector<cv::KeyPoint> vObservedKeys;
+    std::vector<Descriptor>   vObservedDescriptors;
+    for (const PointDesign& design : vDesigns) {
+      vObservedKeys.emplace_back(0.f, 0.f, 31.f, -1.f, 0.f, 1);
+      vObservedDescriptors.push_back(design.descriptor);
+    }
+    for (int k = 0; k < nObservers; k++) {
+      std::unique_ptr<Frame> pObserved = MakeFrame(vObservedKeys, vObservedDescriptors);
+      pObserved->mpCamera              = &leftCamera;
+      pObserved->SetPose(
+        Sophus::SE3f(Eigen::Matrix3f::Identity(), Eigen::Vector3f(0.f, 0.f, -0.2f))
+      );
+      vpObservers.push_back(std::make_unique<KeyFrame>(*pObserved, &map, nullptr));
+    }
+  }
+
+  // Create the points afresh and return the list to fuse, nullptr standing for -1 in vIndices
+  std::vector<MapPoint*> Populate(const std::vector<int>& vIndices) {
+    for (KeyFrame* pKFi : KeyFrames()) {
+      for (int idx = 0; idx < pKFi->N; idx++) {
+        pKFi->EraseMapPointMatch(idx);
+      }
+    }
+
+    vpOwned.clear();
+    for (std::size_t i = 0; i < vDesigns.size(); i++) {
+      const PointDesign& design = vDesigns[i];
+      vpOwned.push_back(std::make_unique<MapPoint>(design.pos, vpObservers[0].get(), &map));
+      MapPoint* pMP = vpOwned.back().get();
+      for (int k = 0; k < design.nObservers; k++) {
+        pMP->AddObservation(vpObservers[k].get(), static_cast<int>(i));
+        vpObservers[k]->AddMapPoint(pMP, i);
+      }
+      if (design.kfIdx >= 0) {
+        pMP->AddObservation(pKF.get(), design.kfIdx);
+        pKF->AddMapPoint(pMP, design.kfIdx);
+      }
+      pMP->ComputeDistinctiveDescriptors();
+      pMP->UpdateNormalAndDepth();
+    }
+
+    std::vector<MapPoint*> vpMapPoints;
+    for (const int i : vIndices) {
+      vpMapPoints.push_back(i >= 0 ? vpOwned[i].get() : nullptr);
+    }
+    return vpMapPoints;
+  }
+
+  std::vector<KeyFrame*> KeyFrames() const {
+    std::vector<KeyFrame*> vpKFs = {pKF.get()};
+    for (const std::unique_ptr<KeyFrame>& pObserver : vpObservers) {
+      vpKFs.push_back(pObserver.get());
+    }
+    return vpKFs;
+  }
+
+  // Index of pMP in the scene, or -1
+  int Label(MapPoint* pMP) const {
+    for (std::size_t i = 0; i < vpOwned.size(); i++) {
+      if (vpOwned[i].get() == pMP) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  // Points of every keyframe, and for every point whether it is bad, its replacement, observations
+  // and descriptor, with the points named by their index in the scene
+  struct State {
+    std::vector<int>        vKeyFramePoints, vBad, vReplaced, vObservations;
+    std::vector<Descriptor> vDescriptors;
+  };
+
+  State GetState() const {
+    State state;
+    for (KeyFrame* pKFi : KeyFrames()) {
+      for (int idx = 0; idx < pKFi->N; idx++) {
+        state.vKeyFramePoints.push_back(Label(pKFi->GetMapPoint(idx)));
+      }
+    }
+    for (const std::unique_ptr<MapPoint>& pMP : vpOwned) {
+      state.vBad.push_back(pMP->isBad());
+      state.vReplaced.push_back(Label(pMP->GetReplaced()));
+      state.vObservations.push_back(pMP->Observations());
+      state.vDescriptors.push_back(pMP->GetDescriptor());
+    }
+    return state;
+  }
+};
+
+void ExpectSameState(const FuseScene::State& a, const FuseScene::State& b) {
+  EXPECT_EQ(a.vKeyFramePoints, b.vKeyFramePoints);
+  EXPECT_EQ(a.vBad, b.vBad);
+  EXPECT_EQ(a.vReplaced, b.vReplaced);
+  EXPECT_EQ(a.vObservations, b.vObservations);
+  EXPECT_TRUE(a.vDescriptors == b.vDescriptors);
+}
+
+// Keypoint of pKF the fuse matched pMP with before it was parallelized, or -1. The Sim3 fuse only
+// searches the left image and does not check the reprojection error.
+int SerialMatchToFuse(
+  KeyFrame*              pKF,
+  MapPoint*              pMP,
+  const Sophus::SE3f&    Tcw,
+  const Eigen::Vector3f& Ow,
+  GeometricCamera*       pCamera,
+  const float            th,
+  const bool             bRight,
+  const bool             bSim3
+) {
+  const Eigen::Vector3f p3Dw = pMP->GetWorldPos();
+  const Eigen::Vector3f p3Dc = Tcw * p3Dw;
+  if (p3Dc(2) < 0.0f) {
+    return -1;
+  }
+
+  const Eigen::Vector2f uv = pCamera->project(p3Dc);
+  if (!pKF->IsInImage(uv(0), uv(1))) {
+    return -1;
+  }
+
+  const Eigen::Vector3f PO     = p3Dw - Ow;
+  const float           dist3D = PO.norm();
+  if (dist3D < pMP->GetMinDistanceInvariance() || dist3D > pMP->GetMaxDistanceInvariance()) {
+    return -1;
+  }
+  if (PO.dot(pMP->GetNormal()) < 0.5 * dist3D) {
+    return -1;
+  }
+
+  const int   nPredictedLevel = pMP->PredictScale(dist3D, pKF);
+  const float radius          = th * pKF->mvScaleFactors[nPredictedLevel];
+
+  // The keyframe has no stereo depth, so the monocular reprojection error applies
+  int bestDist = 256, bestIdx = -1;
+  for (const std::size_t idx : pKF->GetFeaturesInArea(uv(0), uv(1), radius, bRight)) {
+    const cv::KeyPoint& kp = bRight ? pKF->mvKeysRight[idx] : pKF->mvKeys[idx];
+    if (kp.octave < nPredictedLevel - 1 || kp.octave > nPredictedLevel) {
+      continue;
+    }
+
+    const float ex = uv(0) - kp.pt.x, ey = uv(1) - kp.pt.y;
+    if (!bSim3 && (ex * ex + ey * ey) * pKF->mvInvLevelSigma2[kp.octave] > 5.99) {
+      continue;
+    }
+
+    const int        kfIdx = bRight ? static_cast<int>(idx) + pKF->NLeft : static_cast<int>(idx);
+    const Descriptor dMP   = pMP->GetDescriptor();
+    const int        dist  = ORBmatcher::DescriptorDistance(dMP, pKF->mDescriptors[kfIdx]);
+    if (dist < bestDist) {
+      bestDist = dist;
+      bestIdx  = kfIdx;
+    }
+  }
+  return bestDist <= ORBmatcher::TH_LOW ? bestIdx : -1;
+}
+
+// Fuse of the points one after the other, each seeing the replacements of the earlier ones.
+// Counts in nReplacedBefore the points replaced by an earlier point of the list before their turn.
+int SerialFuse(
+  KeyFrame*                     pKF,
+  const std::vector<MapPoint*>& vpMapPoints,
+  const float                   th,
+  const bool                    bRight,
+  int&                          nReplacedBefore
+) {
+  const Sophus::SE3f     Tcw     = bRight ? pKF->GetRightPose() : pKF->GetPose();
+  const Eigen::Vector3f  Ow      = bRight ? pKF->GetRightCameraCenter() : pKF->GetCameraCenter();
+  GeometricCamera* const pCamera = bRight ? pKF->mpCamera2 : pKF->mpCamera;
+
+  std::set<MapPoint*> spBad;
+  for (MapPoint* pMP : vpMapPoints) {
+    if (pMP && pMP->isBad()) {
+      spBad.insert(pMP);
+    }
+  }
+
+  int nFused = 0;
+  for (MapPoint* pMP : vpMapPoints) {
+    if (!pMP) {
+      continue;
+    }
+    if (pMP->isBad()) {
+      nReplacedBefore += spBad.count(pMP) ? 0 : 1;
+      continue;
+    }
+    if (pMP->IsInKeyFrame(pKF)) {
+      continue;
+    }
+
+    const int bestIdx = SerialMatchToFuse(pKF, pMP, Tcw, Ow, pCamera, th, bRight, false);
+    if (bestIdx < 0) {
+      continue;
+    }
+
+    MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+    if (pMPinKF) {
+      if (!pMPinKF->isBad()) {
+        if (pMPinKF->Observations() > pMP->Observations()) {
+          pMP->Replace(pMPinKF);
+        } else {
+          pMPinKF->Replace(pMP);
+        }
+      }
+    } else {
+      pMP->AddObservation(pKF, bestIdx);
+      pKF->AddMapPoint(pMP, bestIdx);
+    }
+    nFused++;
+  }
+  return nFused;
+}
+
+// Sim3 fuse of the points with the keyframe pose, then replacement of the points found in order,
+// as the loop closing did before both were parallelized. Counts in nChained the replacements
+// involving a point that an earlier one replaced.
+int SerialFuseSim3(
+  KeyFrame*                     pKF,
+  const std::vector<MapPoint*>& vpPoints,
+  const float                   th,
+  std::vector<MapPoint*>&       vpReplacePoint,
+  int&                          nChained
+) {
+  const std::set<MapPoint*> spAlreadyFound = pKF->GetMapPoints();
+
+  int nFused = 0;
+  for (std::size_t i = 0; i < vpPoints.size(); i++) {
+    MapPoint* pMP = vpPoints[i];
+    if (pMP->isBad() || spAlreadyFound.count(pMP)) {
+      continue;
+    }
+
+    const int bestIdx = SerialMatchToFuse(
+      pKF, pMP, pKF->GetPose(), pKF->GetCameraCenter(), pKF->mpCamera, th, false, true
+    );
+    if (bestIdx < 0) {
+      continue;
+    }
+
+    MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+    if (pMPinKF) {
+      if (!pMPinKF->isBad()) {
+        vpReplacePoint[i] = pMPinKF;
+      }
+    } else {
+      pMP->AddObservation(pKF, bestIdx);
+      pKF->AddMapPoint(pMP, bestIdx);
+    }
+    nFused++;
+  }
+
+  for (std::size_t i = 0; i < vpPoints.size(); i++) {
+    if (vpReplacePoint[i]) {
+      nChained += vpReplacePoint[i]->isBad() || vpPoints[i]->isBad();
+      vpReplacePoint[i]->Replace(vpPoints[i]);
+    }
+  }
+  return nFused;
+}
+
+} // namespace
+
+TEST(ORBmatcherTest, SearchByProjectionMatchesSerialSearch) {
+  ThreadPool threadPool(4);
+  for (unsigned seed = 1; seed <= 5; seed++) {
+    const ProjectionScene scene(seed);
+    const float           th = 3.f, nnratio = 0.8f;
+    ORBmatcher            matcher(nnratio);
+
+    const std::unique_ptr<Frame> pSerial = scene.CurrentFrame();
+    const int nSerial = SerialSearchByProjection(*pSerial, scene.vpLocalMapPoints, th, nnratio);
+
+    const std::unique_ptr<Frame> pInline = scene.CurrentFrame();
+    const int nInline = matcher.SearchByProjection(*pInline, scene.vpLocalMapPoints, th);
+
+    const std::unique_ptr<Frame> pParallel = scene.CurrentFrame();
+    const int                    nParallel = matcher.SearchByProjection(
+      *pParallel, scene.vpLocalMapPoints, th, false, 50.f, &threadPool
+    );
+
+    EXPECT_GT(nSerial, 0);
+    EXPECT_EQ(nInline, nSerial);
+    EXPECT_EQ(nParallel, nSerial);
+    EXPECT_EQ(pInline->mvpMapPoints, pSerial->mvpMapPoints);
+    EXPECT_EQ(pParallel->mvpMapPoints, pSerial->mvpMapPoints);
+
+    // Some points lose their best keypoint to an earlier point, so the order of the search matters
+    int nDisplaced = 0;
+    for (MapPoint* pMP : scene.vpLocalMapPoints) {
+      const std::unique_ptr<Frame> pAlone = scene.CurrentFrame();
+      SerialSearchByProjection(*pAlone, {pMP}, th, nnratio);
+      const auto itAlone
+        = std::find(pAlone->mvpMapPoints.begin(), pAlone->mvpMapPoints.end(), pMP);
+      const auto itSerial
+        = std::find(pSerial->mvpMapPoints.begin(), pSerial->mvpMapPoints.end(), pMP);
+      if (itAlone - pAlone->mvpMapPoints.begin() != itSerial - pSerial->mvpMapPoints.begin()) {
+        nDisplaced++;
+      }
+    }
+    EXPECT_GT(nDisplaced, 0);
+  }
+}
+
+TEST(ORBmatcherTest, FuseMatchesSerialFuse) {
+  ThreadPool threadPool(4);
+  int        nRightFused = 0, nReplacedBefore = 0;
+  for (unsigned seed = 1; seed <= 5; seed++) {
+    FuseScene  scene(seed);
+    ORBmatcher matcher;
+    KeyFrame*  pKF = scene.pKF.get();
+
+    // The local mapping fuses the points into the left image, then into the right one
+    std::vector<int> vFused = scene.vFused;
+    vFused.push_back(-1);
+
+    std::vector<MapPoint*> vpMapPoints  = scene.Populate(vFused);
+    const int              nSerialLeft  = SerialFuse(pKF, vpMapPoints, 3.f, false, nReplacedBefore);
+    const int              nSerialRight = SerialFuse(pKF, vpMapPoints, 3.f, true, nReplacedBefore);
+    const FuseScene::State serial       = scene.GetState();
+
+    vpMapPoints                         = scene.Populate(vFused);
+    const int              nInlineLeft  = matcher.Fuse(pKF, vpMapPoints, 3.f, false);
+    const int              nInlineRight = matcher.Fuse(pKF, vpMapPoints, 3.f, true);
+    const FuseScene::State inlined      = scene.GetState();
+
+    vpMapPoints                           = scene.Populate(vFused);
+    const int              nParallelLeft  = matcher.Fuse(pKF, vpMapPoints, 3.f, false, &threadPool);
+    const int              nParallelRight = matcher.Fuse(pKF, vpMapPoints, 3.f, true, &threadPool);
+    const FuseScene::State parallel       = scene.GetState();
+
+    EXPECT_GT(nSerialLeft, 0);
+    EXPECT_GT(nSerialRight, 0);
+    EXPECT_EQ(nInlineLeft, nSerialLeft);
+    EXPECT_EQ(nInlineRight, nSerialRight);
+    EXPECT_EQ(nParallelLeft, nSerialLeft);
+    EXPECT_EQ(nParallelRight, nSerialRight);
+    ExpectSameState(inlined, serial);
+    ExpectSameState(parallel, serial);
+
+    // Some points are fused into the right image, after the left keypoints
+    for (int idx = pKF->NLeft; idx < pKF->N; idx++) {
+      const int label  = serial.vKeyFramePoints[idx];
+      nRightFused     += label >= 0 && scene.vDesigns[label].kfIdx != idx;
+    }
+  }
+  EXPECT_GT(nRightFused, 0);
+  EXPECT_GT(nReplacedBefore, 0);
+}
+
+TEST(ORBmatcherTest, FuseSim3AndReplaceMatchSerialFuse) {
+  ThreadPool threadPool(4);
+  int        nChained = 0;
+  for (unsigned seed = 1; seed <= 5; seed++) {
+    FuseScene  scene(seed);
+    ORBmatcher matcher(0.8f);
+    KeyFrame*  pKF = scene.pKF.get();
+
+    // The loop closing fuses the points with the pose of the keyframe as a Sim3
+    const Sophus::SE3f Tcw = pKF->GetPose();
+    Sophus::Sim3f      Scw(Tcw.unit_quaternion(), Tcw.translation());
+
+    std::vector<MapPoint*> vpPoints = scene.Populate(scene.vFused);
+    std::vector<MapPoint*> vpSerialReplace(vpPoints.size(), nullptr);
+    const int        nSerial = SerialFuseSim3(pKF, vpPoints, 4.f, vpSerialReplace, nChained);
+    std::vector<int> vSerialReplace;
+    for (MapPoint* pRep : vpSerialReplace) {
+      vSerialReplace.push_back(scene.Label(pRep));
+    }
+    const FuseScene::State serial = scene.GetState();
+
+    for (ThreadPool* pThreadPool : {static_cast<ThreadPool*>(nullptr), &threadPool}) {
+      vpPoints = scene.Populate(scene.vFused);
+      std::vector<MapPoint*> vpReplace(vpPoints.size(), nullptr);
+      const int        nFused = matcher.Fuse(pKF, Scw, vpPoints, 4.f, vpReplace, pThreadPool);
+      std::vector<int> vReplace;
+      for (MapPoint* pRep : vpReplace) {
+        vReplace.push_back(scene.Label(pRep));
+      }
+      const int nReplaced = ORBmatcher::ReplaceFusedPoints(vpPoints, vpReplace, pThreadPool);
+
+      EXPECT_EQ(nFused, nSerial);
+      EXPECT_EQ(vReplace, vSerialReplace);
+      EXPECT_EQ(
+        nReplaced, std::count_if(vReplace.begin(), vReplace.end(), [](int i) { return i >= 0; })
+      );
+      ExpectSameState(scene.GetState(), serial);
+    }
+  }
+  EXPECT_GT(nChained, 0);
+}
@@ -0,0 +1,68 @@
+#include "OptimizableTypes.h"
+#include <memory>
+#include <typeinfo>
+#include <vector>
+#include <gtest/gtest.h>
+#include <Thirdparty/g2o/g2o/core/jacobian_workspace.h>
+#include "CameraModels/KannalaBrandt8.h"
+#include "CameraModels/Pinhole.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Error and Jacobians of e, which map into workspace as when the optimizer linearizes it
+void Evaluate(EdgeSE3ProjectXYZ* e, g2o::JacobianWorkspace& workspace) {
+  workspace.updateSize(e);
+  workspace.allocate();
+  e->computeError();
+  static_cast<g2o::OptimizableGraph::Edge*>(e)->linearizeOplus(workspace);
+}
+
+// The edge created for the model of camera has the error and Jacobians of the plain edge, which
+// projects through the virtual functions
+void ExpectSpecializedEdgeMatches(GeometricCamera& camera) {
+  const Eigen::Quaterniond q = Eigen::Quaterniond(0.98, 0.1, -0.15, 0.05).normalized();
+
+  g2o::VertexSE3Expmap pose;
+  pose.setEstimate(g2o::SE3Quat(q, Eigen::Vector3d(0.2, -0.1, 0.3)));
+
+  const std::vector<Eigen::Vector3d> vPoints
+    = {Eigen::Vector3d(0.4, -0.3, 2.5), Eigen::Vector3d(-1.2, 0.8, 3), Eigen::Vector3d(0, 0, 1.5)};
+  for (const Eigen::Vector3d& Xw : vPoints) {
+    g2o::VertexSBAPointXYZ point;
+    point.setEstimate(Xw);
+
+    std::unique_ptr<EdgeSE3ProjectXYZ> plain(new EdgeSE3ProjectXYZ());
+    std::unique_ptr<EdgeSE3ProjectXYZ> specialized(NewCameraModelEdge<EdgeSE3ProjectXYZ>(&camera));
+    ASSERT_NE(typeid(*specialized), typeid(EdgeSE3ProjectXYZ));
+
+    g2o::JacobianWorkspace vWorkspaces[2];
+    EdgeSE3ProjectXYZ*     vEdges[2] = {plain.get(), specialized.get()};
+    for (int i = 0; i < 2; i++) {
+      vEdges[i]->setVertex(0, &point);
+      vEdges[i]->setVertex(1, &pose);
+      vEdges[i]->setMeasurement(Eigen::Vector2d(300.0, 200.0));
+      vEdges[i]->pCamera = &camera;
+      Evaluate(vEdges[i], vWorkspaces[i]);
+    }
+
+    EXPECT_TRUE(specialized->error().isApprox(plain->error(), 1e-12));
+    EXPECT_TRUE(specialized->jacobianOplusXi().isApprox(plain->jacobianOplusXi(), 1e-12));
+    EXPECT_TRUE(specialized->jacobianOplusXj().isApprox(plain->jacobianOplusXj(), 1e-12));
+  }
+}
+
+} // namespace
+
+TEST(OptimizableTypesTest, PinholeEdgeMatchesVirtualProjection) {
+  Pinhole camera(std::vector<float>{458.654f, 457.296f, 367.215f, 248.375f});
+  ExpectSpecializedEdgeMatches(camera);
+}
+
+TEST(OptimizableTypesTest, KannalaBrandt8EdgeMatchesVirtualProjection) {
+  KannalaBrandt8 camera(
+    std::vector<float>{190.978f, 190.973f, 254.932f, 256.897f, 0.0034f, 0.0008f, -0.0013f, 0.0002f}
+  );
+  ExpectSpecializedEdgeMatches(camera);
+}
@@ -0,0 +1,637 @@
+#include "PoseSolver.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <Thirdparty/g2o/g2o/core/block_solver.h>
+#include <Thirdparty/g2o/g2o/core/optimization_algorithm_gauss_newton.h>
+#include <Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <Thirdparty/g2o/g2o/core/robust_kernel_impl.h>
+#include <Thirdparty/g2o/g2o/solvers/linear_solver_dense.h>
+#include <Thirdparty/g2o/g2o/types/types_six_dof_expmap.h>
+#include "CameraModels/Pinhole.h"
+#include "G2oTypes.h"
+#include "ImuTypes.h"
+#include "OptimizableTypes.h"
+#include "Optimizer.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+enum eKind { MONOCULAR, STEREO, RIGHT };
+
+struct Observation {
+  eKind           kind;
+  Eigen::Vector3f x3Dw;
+  Eigen::Vector3f measurement; // u, v and the right coordinate of stereo observations
+  float           invSigma2;
+};
+
+// Synthetic frame at Tcw observing points in front of it with pixel noise, every tenth
+// observation a gross outlier
+struct Scene {
+  Pinhole      camera  = Pinhole(std::vector<float>{458.654f, 457.296f, 367.215f, 248.375f});
+  Pinhole      camera2 = Pinhole(std::vector<float>{457.587f, 456.134f, 379.999f, 255.238f});
+  Sophus::SE3f Trl     = Sophus::SE3f(
+    Sophus::SO3f::exp(Eigen::Vector3f(0.01f, -0.02f, 0.005f)), Eigen::Vector3f(-0.11f, 0.f, 0.f)
+  );
+  float bf = 0.11f * 458.654f;
+
+  Sophus::SE3f             Tcw;
+  std::vector<Observation> vObservations;
+  std::vector<bool>        vbTrueOutlier;
+
+  Scene(
+    const std::vector<eKind>& vKinds,
+    const Sophus::SE3f&       Tcw_ = Sophus::SE3f(
+      Sophus::SO3f::exp(Eigen::Vector3f(0.05f, -0.1f, 0.02f)), Eigen::Vector3f(0.3f, -0.2f, 0.5f)
+    )
+  )
+    : Tcw(Tcw_) {
+    std::mt19937                          rng(7);
+    std::normal_distribution<float>       noise(0.f, 0.5f);
+    std::uniform_real_distribution<float> xy(-2.f, 2.f), depth(3.f, 8.f), gross(15.f, 40.f);
+
+    const float vInvSigma2[3] = {1.f, 1.f / 1.44f, 1.f / 2.0736f};
+    for (int i = 0; i < 300; i++) {
+      const eKind           kind = vKinds[i % vKinds.size()];
+      const Eigen::Vector3f x3Dc(xy(rng), xy(rng), depth(rng));
+      Observation           obs;
+      obs.kind      = kind;
+      obs.x3Dw      = Tcw.inverse() * x3Dc;
+      obs.invSigma2 = vInvSigma2[i % 3];
+
+      const Eigen::Vector3f x3D = kind == RIGHT ? Eigen::Vector3f(Trl * x3Dc) : x3Dc;
+      const Eigen::Vector2f uv  = (kind == RIGHT ? camera2 : camera).project(x3D);
+      obs.measurement           = Eigen::Vector3f(
+        uv(0) + noise(rng), uv(1) + noise(rng), uv(0) - bf / x3D(2) + noise(rng)
+      );
+      vbTrueOutlier.push_back(i % 10 == 5);
+      if (vbTrueOutlier.back()) {
+        obs.measurement += Eigen::Vector3f(gross(rng), -gross(rng), gross(rng));
+      }
+      vObservations.push_back(obs);
+    }
+  }
+
+  // Pose the optimizations start from
+  Sophus::SE3f InitialPose() const {
+    return Sophus::SE3f(
+             Sophus::SO3f::exp(Eigen::Vector3f(0.01f, 0.005f, -0.01f)),
+             Eigen::Vector3f(0.03f, -0.02f, 0.04f)
+           )
+         * Tcw;
+  }
+};
+
+int SolverPoseOptimization(const Scene& scene, Sophus::SE3f& Tcw, std::vector<bool>& vbOutlier) {
+  PoseSolver solver;
+  solver.Reset();
+  solver.SetCamera(const_cast<Pinhole*>(&scene.camera));
+  solver.SetRightCamera(const_cast<Pinhole*>(&scene.camera2), scene.Trl);
+  solver.SetStereoRig(458.654f, 457.296f, 367.215f, 248.375f, scene.bf);
+  for (std::size_t i = 0; i < scene.vObservations.size(); i++) {
+    const Observation&    obs = scene.vObservations[i];
+    const Eigen::Vector2f uv  = obs.measurement.head<2>();
+    if (obs.kind == MONOCULAR) {
+      solver.AddMonocular(obs.x3Dw, uv, obs.invSigma2, i);
+    } else if (obs.kind == RIGHT) {
+      solver.AddRight(obs.x3Dw, uv, obs.invSigma2, i);
+    } else {
+      solver.AddStereo(obs.x3Dw, obs.measurement, obs.invSigma2, i);
+    }
+  }
+  vbOutlier.assign(scene.vObservations.size(), false);
+  Tcw = scene.InitialPose();
+  return solver.Optimize(Tcw, vbOutlier);
+}
+
+// The g2o optimization the solver replaces in Optimizer::PoseOptimization
+int G2oPoseOptimization(const Scene& scene, Sophus::SE3f& Tcw, std::vector<bool>& vbOutlier) {
+  g2o::SparseOptimizer optimizer;
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(new g2o::BlockSolver_6_3(
+    new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>()
+  )));
+
+  const Sophus::SE3f Tcw0 = scene.InitialPose();
+  const g2o::SE3Quat SE3Tcw0(
+    Tcw0.unit_quaternion().cast<double>(), Tcw0.translation().cast<double>()
+  );
+
+  g2o::VertexSE3Expmap* vSE3 = new g2o::VertexSE3Expmap();
+  vSE3->setId(0);
+  optimizer.addVertex(vSE3);
+
+  std::vector<g2o::OptimizableGraph::Edge*> vpEdges;
+  for (const Observation& obs : scene.vObservations) {
+    g2o::OptimizableGraph::Edge* e;
+    if (obs.kind == MONOCULAR) {
+      EdgeSE3ProjectXYZOnlyPose* eMono = new EdgeSE3ProjectXYZOnlyPose();
+      eMono->setMeasurement(obs.measurement.head<2>().cast<double>());
+      eMono->setInformation(Eigen::Matrix2d::Identity() * obs.invSigma2);
+      eMono->pCamera = const_cast<Pinhole*>(&scene.camera);
+      eMono->Xw      = obs.x3Dw.cast<double>();
+      e              = eMono;
+    } else if (obs.kind == RIGHT) {
+      EdgeSE3ProjectXYZOnlyPoseToBody* eRight = new EdgeSE3ProjectXYZOnlyPoseToBody();
+      eRight->setMeasurement(obs.measurement.head<2>().cast<double>());
+      eRight->setInformation(Eigen::Matrix2d::Identity() * obs.invSigma2);
+      eRight->pCamera = const_cast<Pinhole*>(&scene.camera2);
+      eRight->Xw      = obs.x3Dw.cast<double>();
+      eRight->mTrl    = g2o::SE3Quat(
+        scene.Trl.unit_quaternion().cast<double>(), scene.Trl.translation().cast<double>()
+      );
+      e = eRight;
+    } else {
+      g2o::EdgeStereoSE3ProjectXYZOnlyPose* eStereo = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
+      eStereo->setMeasurement(obs.measurement.cast<double>());
+      eStereo->setInformation(Eigen::Matrix3d::Identity() * obs.invSigma2);
+      eStereo->fx = 458.654f;
+      eStereo->fy = 457.296f;
+      eStereo->cx = 367.215f;
+      eStereo->cy = 248.375f;
+      eStereo->bf = scene.bf;
+      eStereo->Xw = obs.x3Dw.cast<double>();
+      e           = eStereo;
+    }
+    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+    rk->setDelta(std::sqrt(obs.kind == STEREO ? 7.815 : 5.991));
+    e->setRobustKernel(rk);
+    e->setVertex(0, vSE3);
+    optimizer.addEdge(e);
+    vpEdges.push_back(e);
+  }
+
+  vbOutlier.assign(vpEdges.size(), false);
+  int nBad = 0;
+  for (int it = 0; it < 4; it++) {
+    vSE3->setEstimate(SE3Tcw0);
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(10);
+
+    nBad = 0;
+    for (std::size_t i = 0; i < vpEdges.size(); i++) {
+      g2o::OptimizableGraph::Edge* e = vpEdges[i];
+      e->computeError();
+      const float thChi2 = scene.vObservations[i].kind == STEREO ? 7.815f : 5.991f;
+      vbOutlier[i]       = e->chi2() > thChi2;
+      e->setLevel(vbOutlier[i] ? 1 : 0);
+      nBad += vbOutlier[i];
+      if (it == 2) {
+        e->setRobustKernel(0);
+      }
+    }
+  }
+
+  const g2o::SE3Quat SE3Tcw = vSE3->estimate();
+  Tcw = Sophus::SE3f(SE3Tcw.rotation().cast<float>(), SE3Tcw.translation().cast<float>());
+  return nBad;
+}
+
+// The solver finds the outliers and the pose of the g2o optimization
+void ExpectSolverMatchesG2o(const std::vector<eKind>& vKinds) {
+  const Scene scene(vKinds);
+
+  Sophus::SE3f      TcwSolver, TcwG2o;
+  std::vector<bool> vbOutlierSolver, vbOutlierG2o;
+  const int         nBadSolver = SolverPoseOptimization(scene, TcwSolver, vbOutlierSolver);
+  const int         nBadG2o    = G2oPoseOptimization(scene, TcwG2o, vbOutlierG2o);
+
+  EXPECT_EQ(nBadSolver, nBadG2o);
+  EXPECT_EQ(vbOutlierSolver, vbOutlierG2o);
+  EXPECT_EQ(vbOutlierSolver, scene.vbTrueOutlier);
+  EXPECT_LT((TcwSolver.translation() - TcwG2o.translation()).norm(), 1e-4f);
+  EXPECT_LT((TcwSolver.so3().inverse() * TcwG2o.so3()).log().norm(), 1e-5f);
+  EXPECT_LT((TcwSolver.translation() - scene.Tcw.translation()).norm(), 1e-2f);
+}
+
+// Observations of the inertial optimizations tracked close to the camera
+bool IsClose(const std::size_t i) {
+  return i % 4 == 1;
+}
+
+PoseSolver::ImuState PreviousImuState() {
+  PoseSolver::ImuState state;
+  state.Rwb = Sophus::SO3d::exp(Eigen::Vector3d(0.1, -0.05, 0.3)).matrix();
+  state.twb = Eigen::Vector3d(1.0, 2.0, 0.5);
+  state.v   = Eigen::Vector3d(0.5, -0.2, 0.1);
+  state.bg  = Eigen::Vector3d(0.001, -0.002, 0.0015);
+  state.ba  = Eigen::Vector3d(0.02, -0.01, 0.03);
+  return state;
+}
+
+// Integrates 0.1 s of measurements into preintegrated and returns the state they lead to
+PoseSolver::ImuState Integrate(
+  IMU::Preintegrated& preintegrated, const PoseSolver::ImuState& previous
+) {
+  for (int i = 0; i < 20; i++) {
+    const float t = 0.005f * i;
+    preintegrated.IntegrateNewMeasurement(
+      Eigen::Vector3f(0.3f + t, -0.2f, IMU::GRAVITY_VALUE + 0.1f),
+      Eigen::Vector3f(0.1f, -0.05f + t, 0.2f),
+      0.005f
+    );
+  }
+
+  const Eigen::Vector3d gw(0.0, 0.0, -IMU::GRAVITY_VALUE);
+  const double          dt = preintegrated.dT;
+
+  // Integrated at the bias of previous
+  PoseSolver::ImuState state = previous;
+  state.Rwb = NormalizeRotation(Eigen::Matrix3d(previous.Rwb * preintegrated.dR.cast<double>()));
+  state.v   = previous.v + gw * dt + previous.Rwb * preintegrated.dV.cast<double>();
+  state.twb = previous.twb + previous.v * dt + 0.5 * gw * dt * dt
+            + previous.Rwb * preintegrated.dP.cast<double>();
+  return state;
+}
+
+// Synthetic frame reached from a previous IMU state, observing the points of a Scene from the
+// camera of its true IMU state
+struct InertialScene {
+  IMU::Calib           calib;
+  IMU::Preintegrated   preintegrated;
+  PoseSolver::ImuState previous;
+  PoseSolver::ImuState truth;
+  ConstraintPoseImu    prior;
+  Scene                scene;
+
+  InertialScene(const std::vector<eKind>& vKinds)
+    : calib(
+        Sophus::SE3f(
+          Sophus::SO3f::exp(Eigen::Vector3f(0.02f, -0.01f, 0.03f)),
+          Eigen::Vector3f(0.05f, -0.02f, 0.01f)
+        ),
+        2.4e-3f,
+        2.8e-2f,
+        1.3e-6f,
+        2.1e-4f
+      )
+    , preintegrated(IMU::Bias(0.02f, -0.01f, 0.03f, 0.001f, -0.002f, 0.0015f), calib)
+    , previous(PreviousImuState())
+    , truth(Integrate(preintegrated, previous))
+    , prior(
+        previous.Rwb,
+        previous.twb,
+        previous.v,
+        previous.bg,
+        previous.ba,
+        Eigen::Matrix<double, 15, 1>::Constant(1e4).asDiagonal()
+      )
+    , scene(
+        vKinds,
+        calib.mTcb
+          * Sophus::SE3f(
+              Sophus::SO3d(truth.Rwb).cast<float>(), truth.twb.cast<float>()
+          ).inverse()
+      ) {
+  }
+
+  // State the optimizations start from
+  PoseSolver::ImuState InitialState() const {
+    PoseSolver::ImuState state = truth;
+    state.Rwb = state.Rwb * Sophus::SO3d::exp(Eigen::Vector3d(0.01, -0.008, 0.012)).matrix();
+    state.twb += Eigen::Vector3d(0.03, -0.02, 0.025);
+    state.v   += Eigen::Vector3d(0.05, -0.04, 0.03);
+    state.bg  += Eigen::Vector3d(0.0005, 0.0005, -0.0005);
+    state.ba  += Eigen::Vector3d(0.01, -0.01, 0.01);
+    return state;
+  }
+};
+
+int SolverInertialOptimization(
+  InertialScene&                 inertial,
+  const bool                     bPrior,
+  PoseSolver::ImuState&          state,
+  std::vector<bool>&             vbOutlier,
+  Eigen::Matrix<double, 15, 15>& H
+) {
+  const Scene& scene = inertial.scene;
+
+  PoseSolver solver;
+  solver.Reset();
+  solver.SetCamera(const_cast<Pinhole*>(&scene.camera));
+  solver.SetRightCamera(const_cast<Pinhole*>(&scene.camera2), scene.Trl);
+  solver.SetStereoRig(458.654f, 457.296f, 367.215f, 248.375f, scene.bf);
+  solver.SetImuCalibration(inertial.calib.mTcb);
+  for (std::size_t i = 0; i < scene.vObservations.size(); i++) {
+    const Observation&    obs = scene.vObservations[i];
+    const Eigen::Vector2f uv  = obs.measurement.head<2>();
+    if (obs.kind == MONOCULAR) {
+      solver.AddMonocular(obs.x3Dw, uv, obs.invSigma2, i, IsClose(i));
+    } else if (obs.kind == RIGHT) {
+      solver.AddRight(obs.x3Dw, uv, obs.invSigma2, i, IsClose(i));
+    } else {
+      solver.AddStereo(obs.x3Dw, obs.measurement, obs.invSigma2, i);
+    }
+  }
+
+  const Eigen::Matrix<float, 15, 15>& C = inertial.preintegrated.C;
+  solver.SetInertial(
+    inertial.previous,
+    &inertial.preintegrated,
+    C.block<3, 3>(9, 9).cast<double>().inverse(),
+    C.block<3, 3>(12, 12).cast<double>().inverse(),
+    bPrior ? &inertial.prior : nullptr
+  );
+
+  vbOutlier.assign(scene.vObservations.size(), false);
+  state = inertial.InitialState();
+  return solver.OptimizeInertial(state, vbOutlier, false, H);
+}
+
+// IMU pose of the g2o inertial optimizations, with the cameras of scene
+ImuCamPose G2oImuCamPose(const InertialScene& inertial, const PoseSolver::ImuState& state) {
+  const Scene& scene = inertial.scene;
+
+  const Sophus::SE3d        Tcb = inertial.calib.mTcb.cast<double>();
+  std::vector<Sophus::SE3d> vTcb{Tcb, scene.Trl.cast<double>() * Tcb};
+
+  ImuCamPose pose;
+  pose.Rwb  = state.Rwb;
+  pose.twb  = state.twb;
+  pose.Rwb0 = state.Rwb;
+  pose.DR.setIdentity();
+  pose.bf  = scene.bf;
+  pose.its = 0;
+  pose.pCamera = {const_cast<Pinhole*>(&scene.camera), const_cast<Pinhole*>(&scene.camera2)};
+  for (const Sophus::SE3d& Tcbi : vTcb) {
+    pose.Rcb.push_back(Tcbi.rotationMatrix());
+    pose.tcb.push_back(Tcbi.translation());
+    pose.Rbc.push_back(Tcbi.rotationMatrix().transpose());
+    pose.tbc.push_back(Tcbi.inverse().translation());
+    pose.Rcw.push_back(Tcbi.rotationMatrix() * state.Rwb.transpose());
+    pose.tcw.push_back(Tcbi.translation() - pose.Rcw.back() * state.twb);
+  }
+  return pose;
+}
+
+// The g2o optimizations the solver replaces in Optimizer::PoseInertialOptimizationLastKeyFrame,
+// and PoseInertialOptimizationLastFrame with bPrior
+int G2oInertialOptimization(
+  InertialScene&                 inertial,
+  const bool                     bPrior,
+  PoseSolver::ImuState&          state,
+  std::vector<bool>&             vbOutlier,
+  Eigen::Matrix<double, 15, 15>& H
+) {
+  const Scene& scene = inertial.scene;
+
+  g2o::SparseOptimizer optimizer;
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmGaussNewton(new g2o::BlockSolverX(
+    new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>()
+  )));
+
+  const PoseSolver::ImuState state0 = inertial.InitialState();
+
+  VertexPose* VP = new VertexPose();
+  VP->setEstimate(G2oImuCamPose(inertial, state0));
+  VP->setId(0);
+  optimizer.addVertex(VP);
+  VertexVelocity* VV = new VertexVelocity();
+  VV->setEstimate(state0.v);
+  VV->setId(1);
+  optimizer.addVertex(VV);
+  VertexGyroBias* VG = new VertexGyroBias();
+  VG->setEstimate(state0.bg);
+  VG->setId(2);
+  optimizer.addVertex(VG);
+  VertexAccBias* VA = new VertexAccBias();
+  VA->setEstimate(state0.ba);
+  VA->setId(3);
+  optimizer.addVertex(VA);
+
+  std::vector<EdgeMonoOnlyPose*>   vpEdgesMono;
+  std::vector<EdgeStereoOnlyPose*> vpEdgesStereo;
+  std::vector<std::size_t>         vnIndexEdgeMono, vnIndexEdgeStereo;
+  for (std::size_t i = 0; i < scene.vObservations.size(); i++) {
+    const Observation&      obs = scene.vObservations[i];
+    g2o::RobustKernelHuber* rk  = new g2o::RobustKernelHuber;
+    if (obs.kind == STEREO) {
+      EdgeStereoOnlyPose* e = new EdgeStereoOnlyPose(obs.x3Dw);
+      e->setVertex(0, VP);
+      e->setMeasurement(obs.measurement.cast<double>());
+      e->setInformation(Eigen::Matrix3d::Identity() * obs.invSigma2);
+      rk->setDelta(std::sqrt(7.815));
+      e->setRobustKernel(rk);
+      optimizer.addEdge(e);
+      vpEdgesStereo.push_back(e);
+      vnIndexEdgeStereo.push_back(i);
+    } else {
+      EdgeMonoOnlyPose* e = new EdgeMonoOnlyPose(obs.x3Dw, obs.kind == RIGHT ? 1 : 0);
+      e->setVertex(0, VP);
+      e->setMeasurement(obs.measurement.head<2>().cast<double>());
+      e->setInformation(Eigen::Matrix2d::Identity() * obs.invSigma2);
+      rk->setDelta(std::sqrt(5.991));
+      e->setRobustKernel(rk);
+      optimizer.addEdge(e);
+      vpEdgesMono.push_back(e);
+      vnIndexEdgeMono.push_back(i);
+    }
+  }
+
+  const PoseSolver::ImuState& previous = inertial.previous;
+
+  VertexPose* VPk = new VertexPose();
+  VPk->setEstimate(G2oImuCamPose(inertial, previous));
+  VPk->setId(4);
+  VPk->setFixed(!bPrior);
+  optimizer.addVertex(VPk);
+  VertexVelocity* VVk = new VertexVelocity();
+  VVk->setEstimate(previous.v);
+  VVk->setId(5);
+  VVk->setFixed(!bPrior);
+  optimizer.addVertex(VVk);
+  VertexGyroBias* VGk = new VertexGyroBias();
+  VGk->setEstimate(previous.bg);
+  VGk->setId(6);
+  VGk->setFixed(!bPrior);
+  optimizer.addVertex(VGk);
+  VertexAccBias* VAk = new VertexAccBias();
+  VAk->setEstimate(previous.ba);
+  VAk->setId(7);
+  VAk->setFixed(!bPrior);
+  optimizer.addVertex(VAk);
+
+  EdgeInertial* ei = new EdgeInertial(&inertial.preintegrated);
+  ei->setVertex(0, VPk);
+  ei->setVertex(1, VVk);
+  ei->setVertex(2, VGk);
+  ei->setVertex(3, VAk);
+  ei->setVertex(4, VP);
+  ei->setVertex(5, VV);
+  optimizer.addEdge(ei);
+
+  const Eigen::Matrix<float, 15, 15>& C = inertial.preintegrated.C;
+
+  EdgeGyroRW* egr = new EdgeGyroRW();
+  egr->setVertex(0, VGk);
+  egr->setVertex(1, VG);
+  egr->setInformation(C.block<3, 3>(9, 9).cast<double>().inverse());
+  optimizer.addEdge(egr);
+
+  EdgeAccRW* ear = new EdgeAccRW();
+  ear->setVertex(0, VAk);
+  ear->setVertex(1, VA);
+  ear->setInformation(C.block<3, 3>(12, 12).cast<double>().inverse());
+  optimizer.addEdge(ear);
+
+  EdgePriorPoseImu* ep = nullptr;
+  if (bPrior) {
+    ep = new EdgePriorPoseImu(&inertial.prior);
+    ep->setVertex(0, VPk);
+    ep->setVertex(1, VVk);
+    ep->setVertex(2, VGk);
+    ep->setVertex(3, VAk);
+    g2o::RobustKernelHuber* rkp = new g2o::RobustKernelHuber;
+    rkp->setDelta(5);
+    ep->setRobustKernel(rkp);
+    optimizer.addEdge(ep);
+  }
+
+  const float chi2MonoKeyFrame[4] = {12, 7.5, 5.991, 5.991};
+  const float chi2MonoFrame[4]    = {5.991, 5.991, 5.991, 5.991};
+  const float chi2Stereo[4]       = {15.6, 9.8, 7.815, 7.815};
+  const float* chi2Mono           = bPrior ? chi2MonoFrame : chi2MonoKeyFrame;
+
+  vbOutlier.assign(scene.vObservations.size(), false);
+  int nBad = 0;
+  for (int it = 0; it < 4; it++) {
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(10);
+
+    nBad = 0;
+    for (std::size_t i = 0; i < vpEdgesMono.size(); i++) {
+      EdgeMonoOnlyPose* e   = vpEdgesMono[i];
+      const std::size_t idx = vnIndexEdgeMono[i];
+      e->computeError();
+      const float thChi2 = IsClose(idx) ? 1.5f * chi2Mono[it] : chi2Mono[it];
+      vbOutlier[idx]     = e->chi2() > thChi2 || !e->isDepthPositive();
+      e->setLevel(vbOutlier[idx] ? 1 : 0);
+      nBad += vbOutlier[idx];
+      if (it == 2) {
+        e->setRobustKernel(0);
+      }
+    }
+    for (std::size_t i = 0; i < vpEdgesStereo.size(); i++) {
+      EdgeStereoOnlyPose* e   = vpEdgesStereo[i];
+      const std::size_t   idx = vnIndexEdgeStereo[i];
+      e->computeError();
+      vbOutlier[idx] = e->chi2() > chi2Stereo[it];
+      e->setLevel(vbOutlier[idx] ? 1 : 0);
+      nBad += vbOutlier[idx];
+      if (it == 2) {
+        e->setRobustKernel(0);
+      }
+    }
+  }
+
+  state.Rwb = VP->estimate().Rwb;
+  state.twb = VP->estimate().twb;
+  state.v   = VV->estimate();
+  state.bg  = VG->estimate();
+  state.ba  = VA->estimate();
+
+  // Hessian of the inliers, previous states marginalized
+  Eigen::Matrix<double, 30, 30> Hs = Eigen::Matrix<double, 30, 30>::Zero();
+  Hs.block<24, 24>(0, 0) += ei->GetHessian();
+  const Eigen::Matrix<double, 6, 6> Hgr = egr->GetHessian();
+  const Eigen::Matrix<double, 6, 6> Har = ear->GetHessian();
+  for (int r = 0; r < 2; r++) {
+    for (int c = 0; c < 2; c++) {
+      Hs.block<3, 3>(9 + 15 * r, 9 + 15 * c)   += Hgr.block<3, 3>(3 * r, 3 * c);
+      Hs.block<3, 3>(12 + 15 * r, 12 + 15 * c) += Har.block<3, 3>(3 * r, 3 * c);
+    }
+  }
+  if (ep) {
+    Hs.block<15, 15>(0, 0) += ep->GetHessian();
+  }
+  for (std::size_t i = 0; i < vpEdgesMono.size(); i++) {
+    if (!vbOutlier[vnIndexEdgeMono[i]]) {
+      Hs.block<6, 6>(15, 15) += vpEdgesMono[i]->GetHessian();
+    }
+  }
+  for (std::size_t i = 0; i < vpEdgesStereo.size(); i++) {
+    if (!vbOutlier[vnIndexEdgeStereo[i]]) {
+      Hs.block<6, 6>(15, 15) += vpEdgesStereo[i]->GetHessian();
+    }
+  }
+  if (bPrior) {
+    H = Optimizer::Marginalize(Hs, 0, 14).block<15, 15>(15, 15);
+  } else {
+    H = Hs.block<15, 15>(15, 15);
+  }
+  return nBad;
+}
+
+// The solver finds the outliers, the state and the Hessian of the g2o optimization
+void ExpectInertialSolverMatchesG2o(const std::vector<eKind>& vKinds, const bool bPrior) {
+  InertialScene inertial(vKinds);
+
+  PoseSolver::ImuState          stateSolver, stateG2o;
+  std::vector<bool>             vbOutlierSolver, vbOutlierG2o;
+  Eigen::Matrix<double, 15, 15> HSolver, HG2o;
+  const int nBadSolver
+    = SolverInertialOptimization(inertial, bPrior, stateSolver, vbOutlierSolver, HSolver);
+  const int nBadG2o = G2oInertialOptimization(inertial, bPrior, stateG2o, vbOutlierG2o, HG2o);
+
+  const int nInliers = std::count(
+    inertial.scene.vbTrueOutlier.begin(), inertial.scene.vbTrueOutlier.end(), false
+  );
+  EXPECT_EQ(nBadSolver, nBadG2o);
+  EXPECT_EQ(static_cast<int>(vbOutlierSolver.size()) - nBadSolver, nInliers);
+  EXPECT_EQ(vbOutlierSolver, vbOutlierG2o);
+  EXPECT_EQ(vbOutlierSolver, inertial.scene.vbTrueOutlier);
+  EXPECT_LT(LogSO3(stateSolver.Rwb.transpose() * stateG2o.Rwb).norm(), 1e-5);
+  EXPECT_LT((stateSolver.twb - stateG2o.twb).norm(), 1e-4);
+  EXPECT_LT((stateSolver.v - stateG2o.v).norm(), 1e-4);
+  EXPECT_LT((stateSolver.bg - stateG2o.bg).norm(), 1e-6);
+  EXPECT_LT((stateSolver.ba - stateG2o.ba).norm(), 1e-5);
+  EXPECT_LT((HSolver - HG2o).norm(), 1e-4 * HG2o.norm());
+  EXPECT_LT((stateSolver.twb - inertial.truth.twb).norm(), 1e-2);
+}
+
+} // namespace
+
+TEST(PoseSolverTest, MonocularMatchesG2o) {
+  ExpectSolverMatchesG2o({MONOCULAR});
+}
+
+TEST(PoseSolverTest, StereoMatchesG2o) {
+  ExpectSolverMatchesG2o({MONOCULAR, STEREO, STEREO});
+}
+
+TEST(PoseSolverTest, CameraPairMatchesG2o) {
+  ExpectSolverMatchesG2o({MONOCULAR, RIGHT});
+}
+
+TEST(PoseSolverTest, FindsOutlierAmongFewObservations) {
+  const Scene scene({MONOCULAR});
+
+  PoseSolver solver;
+  solver.Reset();
+  solver.SetCamera(const_cast<Pinhole*>(&scene.camera));
+  for (int i = 0; i < 6; i++) {
+    const Observation& obs = scene.vObservations[i];
+    solver.AddMonocular(obs.x3Dw, obs.measurement.head<2>(), obs.invSigma2, i);
+  }
+  std::vector<bool> vbOutlier(6, false);
+  Sophus::SE3f      Tcw = scene.InitialPose();
+  EXPECT_EQ(solver.Optimize(Tcw, vbOutlier), 1);
+  EXPECT_TRUE(vbOutlier[5]);
+  EXPECT_EQ(solver.NumObservations(), 6u);
+}
+
+TEST(PoseSolverTest, InertialLastKeyFrameMatchesG2o) {
+  ExpectInertialSolverMatchesG2o({MONOCULAR, STEREO, STEREO}, false);
+}
+
+TEST(PoseSolverTest, InertialLastFrameMatchesG2o) {
+  ExpectInertialSolverMatchesG2o({MONOCULAR, RIGHT}, true);
+}
+
+// Optimizer::PoseInertialOptimizationLastFrame holds a previous frame without prior fixed, as the
+// g2o optimization of the last keyframe does
+TEST(PoseSolverTest, InertialLastFrameWithoutPriorMatchesG2o) {
+  ExpectInertialSolverMatchesG2o({MONOCULAR, RIGHT}, false);
+}
@@ -0,0 +1,28 @@
+#include "SharedValue.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+TEST(SharedValueTest, CopiesShareTheValue) {
+  SharedValue<std::vector<float>>       a = std::vector<float>{1.0f, 2.0f, 3.0f};
+  const SharedValue<std::vector<float>> b = a;
+  EXPECT_TRUE(b.SharesWith(a));
+  EXPECT_EQ(&a.get(), &b.get());
+  EXPECT_EQ(b.size(), 3u);
+  EXPECT_EQ(b[1], 2.0f);
+
+  // Assigning a new value leaves the copies with the old one
+  a = std::vector<float>{4.0f};
+  EXPECT_FALSE(b.SharesWith(a));
+  EXPECT_EQ(a.size(), 1u);
+  const std::vector<float>& v = b;
+  EXPECT_EQ(v, (std::vector<float>{1.0f, 2.0f, 3.0f}));
+}
+
+TEST(SharedValueTest, DefaultIsEmpty) {
+  const SharedValue<std::vector<int>> value;
+  EXPECT_TRUE(value.empty());
+  EXPECT_EQ(value.begin(), value.end());
+  EXPECT_EQ(value->size(), 0u);
+}
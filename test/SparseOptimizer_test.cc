@@ -0,0 +1,206 @@
+#include <functional>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <Thirdparty/g2o/g2o/core/block_solver.h>
+#include <Thirdparty/g2o/g2o/core/openmp_mutex.h>
+#include <Thirdparty/g2o/g2o/core/optimization_algorithm_levenberg.h>
+#include <Thirdparty/g2o/g2o/core/robust_kernel_impl.h>
+#include <Thirdparty/g2o/g2o/core/sparse_optimizer.h>
+#include <Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h>
+#include <Thirdparty/g2o/g2o/solvers/linear_solver_pcg.h>
+#include <Thirdparty/g2o/g2o/types/types_six_dof_expmap.h>
+#include "ThreadPool.h"
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+// Poses after a bundle adjustment of keyframes observing every point with a BlockSolver solving
+// the camera system with pLinearSolver, the edges linearized and the points eliminated on the
+// threads of pThreadPool when given. The final chi2 is returned in pChi2, when given.
+template <class BlockSolver>
+std::vector<g2o::SE3Quat> OptimizePoses(
+  typename BlockSolver::LinearSolverType* pLinearSolver,
+  ThreadPool*                             pThreadPool,
+  double*                                 pChi2 = nullptr
+) {
+  g2o::SparseOptimizer optimizer;
+  optimizer.setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(new BlockSolver(pLinearSolver)));
+  if (pThreadPool) {
+    optimizer.setParallelFor(
+      pThreadPool->NumThreads(),
+      [pThreadPool](int begin, int end, const std::function<void(int)>& fn) {
+        pThreadPool->ParallelFor(begin, end, fn);
+      }
+    );
+  }
+
+  std::mt19937                     rng(1);
+  std::normal_distribution<double> noise(0.0, 1.0);
+
+  const int nKFs = 6, nPoints = 300;
+  std::vector<g2o::SE3Quat> vTcw;
+  for (int i = 0; i < nKFs; i++) {
+    vTcw.emplace_back(Eigen::Quaterniond::Identity(), Eigen::Vector3d(0.2 * i, 0.0, 0.0));
+
+    Eigen::Matrix<double, 6, 1> perturbation;
+    for (int k = 0; k < 6; k++) {
+      perturbation[k] = 0.01 * noise(rng);
+    }
+    g2o::VertexSE3Expmap* vPose = new g2o::VertexSE3Expmap();
+    vPose->setEstimate(i == 0 ? vTcw[i] : g2o::SE3Quat::exp(perturbation) * vTcw[i]);
+    vPose->setId(i);
+    vPose->setFixed(i == 0);
+    optimizer.addVertex(vPose);
+  }
+
+  for (int j = 0; j < nPoints; j++) {
+    const Eigen::Vector3d x3D(noise(rng), noise(rng), 5.0 + noise(rng));
+
+    g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+    vPoint->setEstimate(x3D + 0.05 * Eigen::Vector3d(noise(rng), noise(rng), noise(rng)));
+    vPoint->setId(nKFs + j);
+    vPoint->setMarginalized(true);
+    optimizer.addVertex(vPoint);
+
+    for (int i = 0; i < nKFs; i++) {
+      const Eigen::Vector3d x3Dc = vTcw[i].map(x3D);
+
+      g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+      e->fx = e->fy = 450.0;
+      e->cx         = 320.0;
+      e->cy         = 240.0;
+      e->setVertex(0, vPoint);
+      e->setVertex(1, optimizer.vertex(i));
+      e->setMeasurement(Eigen::Vector2d(
+        450.0 * x3Dc[0] / x3Dc[2] + 320.0 + 0.5 * noise(rng),
+        450.0 * x3Dc[1] / x3Dc[2] + 240.0 + 0.5 * noise(rng)
+      ));
+      e->setInformation(Eigen::Matrix2d::Identity());
+      g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber();
+      rk->setDelta(2.45);
+      e->setRobustKernel(rk);
+      optimizer.addEdge(e);
+    }
+  }
+
+  optimizer.initializeOptimization();
+  optimizer.optimize(10);
+  if (pChi2) {
+    optimizer.computeActiveErrors();
+    *pChi2 = optimizer.activeRobustChi2();
+  }
+
+  std::vector<g2o::SE3Quat> vPoses;
+  for (int i = 0; i < nKFs; i++) {
+    vPoses.push_back(static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(i))->estimate());
+  }
+  return vPoses;
+}
+
+template <class BlockSolver>
+typename BlockSolver::LinearSolverType* NewCholesky() {
+  return new g2o::LinearSolverEigen<typename BlockSolver::PoseMatrixType>();
+}
+
+template <class BlockSolver>
+void ExpectParallelMatchesSerial() {
+  const std::vector<g2o::SE3Quat> vSerial
+    = OptimizePoses<BlockSolver>(NewCholesky<BlockSolver>(), nullptr);
+
+  ThreadPool                      pool(4);
+  const std::vector<g2o::SE3Quat> vParallel
+    = OptimizePoses<BlockSolver>(NewCholesky<BlockSolver>(), &pool);
+
+  ASSERT_EQ(vParallel.size(), vSerial.size());
+  for (std::size_t i = 0; i < vSerial.size(); i++) {
+    // Only the order of the sums into the Hessian differs
+    EXPECT_TRUE(vParallel[i].log().isApprox(vSerial[i].log(), 1e-9)) << "pose " << i;
+  }
+}
+
+// The conjugate gradients, with the products on the threads of a pool, take the steps of the
+// Cholesky factorization when solving every system exactly. Solving them only as far as the
+// forcing terms require takes other steps, which end at a chi2 as low.
+template <class BlockSolver>
+void ExpectPCGMatchesCholesky() {
+  double                          choleskyChi2;
+  const std::vector<g2o::SE3Quat> vCholesky
+    = OptimizePoses<BlockSolver>(NewCholesky<BlockSolver>(), nullptr, &choleskyChi2);
+
+  ThreadPool pool(4);
+  for (const double forcingTerm : {0.0, 0.1}) {
+    g2o::LinearSolverPCG<typename BlockSolver::PoseMatrixType>* pPCG
+      = new g2o::LinearSolverPCG<typename BlockSolver::PoseMatrixType>();
+    pPCG->setTolerance(1e-10);
+    pPCG->setForcingTerm(forcingTerm);
+    double                          pcgChi2;
+    const std::vector<g2o::SE3Quat> vPCG = OptimizePoses<BlockSolver>(pPCG, &pool, &pcgChi2);
+
+    EXPECT_NEAR(pcgChi2, choleskyChi2, 1e-4 * choleskyChi2) << "forcing term " << forcingTerm;
+    if (forcingTerm > 0.0) {
+      continue;
+    }
+    ASSERT_EQ(vPCG.size(), vCholesky.size());
+    for (std::size_t i = 0; i < vCholesky.size(); i++) {
+      EXPECT_TRUE(vPCG[i].log().isApprox(vCholesky[i].log(), 1e-6)) << "pose " << i;
+    }
+  }
+}
+
+} // namespace
+
+TEST(SparseOptimizerTest, ParallelBundleAdjustmentMatchesSerial) {
+  ExpectParallelMatchesSerial<g2o::BlockSolver_6_3>();
+}
+
+TEST(SparseOptimizerTest, ParallelBundleAdjustmentMatchesSerialWithDynamicBlocks) {
+  ExpectParallelMatchesSerial<g2o::BlockSolverX>();
+}
+
+TEST(SparseOptimizerTest, SingleThreadedBundleAdjustmentIsReproducible) {
+  ThreadPool pool(1);
+  for (ThreadPool* pThreadPool : {static_cast<ThreadPool*>(nullptr), &pool}) {
+    const std::vector<g2o::SE3Quat> vFirst
+      = OptimizePoses<g2o::BlockSolver_6_3>(NewCholesky<g2o::BlockSolver_6_3>(), pThreadPool);
+    const std::vector<g2o::SE3Quat> vSecond
+      = OptimizePoses<g2o::BlockSolver_6_3>(NewCholesky<g2o::BlockSolver_6_3>(), pThreadPool);
+
+    ASSERT_EQ(vSecond.size(), vFirst.size());
+    for (std::size_t i = 0; i < vFirst.size(); i++) {
+      EXPECT_TRUE(vSecond[i].log() == vFirst[i].log()) << "pose " << i;
+    }
+  }
+}
+
+// Without parallel edges the lock of a quadratic form does nothing but, in debug builds, check
+// that it is locked and unlocked in turn
+TEST(SparseOptimizerTest, QuadraticFormLockChecksPairingWhenNotConcurrent) {
+  g2o::OpenMPMutex mutex;
+  EXPECT_DEBUG_DEATH(mutex.unlock(), "not locked");
+  mutex.lock();
+  EXPECT_DEBUG_DEATH(mutex.lock(), "already locked");
+  mutex.unlock();
+}
+
+TEST(SparseOptimizerTest, ConcurrentQuadraticFormLockExcludesThreads) {
+  g2o::OpenMPMutex mutex;
+  mutex.setConcurrent(true);
+
+  ThreadPool pool(4);
+  int        nCount = 0;
+  pool.ParallelFor(0, 20000, [&](int) {
+    g2o::ScopedOpenMPMutex lock(&mutex);
+    nCount++;
+  });
+  EXPECT_EQ(nCount, 20000);
+}
+
+TEST(SparseOptimizerTest, PCGBundleAdjustmentMatchesCholesky) {
+  ExpectPCGMatchesCholesky<g2o::BlockSolver_6_3>();
+}
+
+TEST(SparseOptimizerTest, PCGBundleAdjustmentMatchesCholeskyWithDynamicBlocks) {
+  ExpectPCGMatchesCholesky<g2o::BlockSolverX>();
+}
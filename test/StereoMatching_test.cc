@@ -0,0 +1,203 @@
+#include "StereoMatching.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+namespace {
+
+typedef std::array<unsigned char, 32> Bits256;
+
+// Copy of the descriptor at exactly dist bits from it
+Bits256 AtDistance(const Bits256& descriptor, const int dist) {
+  Bits256 flipped = descriptor;
+  for (int bit = 0; bit < dist; bit++) {
+    flipped[bit / 8] ^= 1 << (bit % 8);
+  }
+  return flipped;
+}
+
+// MatchInBand of the query against candidates at the given distances from it, with the thresholds
+// of the fisheye stereo matching
+int MatchAtDistances(const std::vector<int>& vDistances) {
+  Bits256 query;
+  for (std::size_t i = 0; i < query.size(); i++) {
+    query[i] = static_cast<unsigned char>(37 * i + 11);
+  }
+  std::vector<Bits256>              vCandidates;
+  std::vector<const unsigned char*> vpCandidates;
+  for (const int dist : vDistances) {
+    vCandidates.push_back(AtDistance(query, dist));
+  }
+  for (const Bits256& candidate : vCandidates) {
+    vpCandidates.push_back(candidate.data());
+  }
+  return MatchInBand(
+    query.data(), vpCandidates.data(), static_cast<int>(vpCandidates.size()), 0.7f, 100, 50
+  );
+}
+
+} // namespace
+
+TEST(StereoMatchingTest, RowBucketsMatchNestedRows) {
+  const int                 nRows         = 40;
+  const std::vector<float>  vScaleFactors = {1.0f, 1.2f, 1.44f, 1.728f};
+  std::mt19937              rng(2);
+  std::vector<cv::KeyPoint> vKeys(500);
+  for (cv::KeyPoint& kp : vKeys) {
+    kp.pt.x   = static_cast<float>(rng() % 1000) / 10.0f;
+    kp.pt.y   = static_cast<float>(rng() % 420) / 10.0f - 1.0f;
+    kp.octave = static_cast<int>(rng() % vScaleFactors.size());
+  }
+
+  // Buckets as the nested per row vectors they replace, clamped to the image rows
+  std::vector<std::vector<std::size_t>> vRowIndices(nRows);
+  for (std::size_t i = 0; i < vKeys.size(); i++) {
+    const float r    = 2.0f * vScaleFactors[vKeys[i].octave];
+    const int   minr = static_cast<int>(std::floor(vKeys[i].pt.y - r));
+    const int   maxr = static_cast<int>(std::ceil(vKeys[i].pt.y + r));
+    for (int row = std::max(minr, 0); row <= std::min(maxr, nRows - 1); row++) {
+      vRowIndices[row].push_back(i);
+    }
+  }
+
+  RowBuckets buckets;
+  for (int pass = 0; pass < 2; pass++) {
+    buckets.Assign(vKeys, vScaleFactors, nRows);
+    ASSERT_EQ(buckets.Rows(), nRows);
+    for (int row = 0; row < nRows; row++) {
+      EXPECT_EQ(
+        std::vector<std::size_t>(buckets.RowBegin(row), buckets.RowEnd(row)), vRowIndices[row]
+      );
+    }
+  }
+}
+
+TEST(StereoMatchingTest, PatchSADSweepMatchesScalar) {
+  std::mt19937 rng(4);
+  cv::Mat      left(40, 60, CV_8UC1), right(40, 60, CV_8UC1);
+  for (int y = 0; y < 40; y++) {
+    for (int x = 0; x < 60; x++) {
+      left.ptr<uchar>(y)[x]  = static_cast<uchar>(rng());
+      right.ptr<uchar>(y)[x] = static_cast<uchar>(rng());
+    }
+  }
+
+  // The first sizes take the SIMD path, the last one the scalar loop
+  for (const int w : {5, 2, 7, 9}) {
+    const int L = 5;
+    for (int q = 0; q < 20; q++) {
+      const int xL = w + static_cast<int>(rng() % (60 - 2 * w));
+      const int xR = L + w + static_cast<int>(rng() % (60 - 2 * (L + w)));
+      const int y  = w + static_cast<int>(rng() % (40 - 2 * w));
+
+      std::vector<int> vDists(2 * L + 1);
+      PatchSADSweep(left, right, xL, xR, y, w, L, vDists.data());
+      for (int d = -L; d <= L; d++) {
+        int expected = 0;
+        for (int v = -w; v <= w; v++) {
+          for (int u = -w; u <= w; u++) {
+            const int a  = left.ptr<uchar>(y + v)[xL + u];
+            const int b  = right.ptr<uchar>(y + v)[xR + d + u];
+            expected    += std::abs(a - b);
+          }
+        }
+        EXPECT_EQ(vDists[L + d], expected);
+      }
+    }
+  }
+}
+
+TEST(StereoMatchingTest, BearingCellsQueryIsExact) {
+  std::mt19937                          rng(6);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+  // Keypoints of an equidistant fisheye camera with a 180 degree field of view
+  const float                  f = 100.0f, c = 160.0f;
+  std::vector<cv::Point2f>     vPoints;
+  std::vector<Eigen::Vector3f> vBearings;
+  std::vector<float>           vTolerances;
+  while (vPoints.size() < 400) {
+    const float x = uniform(rng), y = uniform(rng);
+    const float r = std::sqrt(x * x + y * y);
+    if (r > 1.0f || r < 1e-3f) {
+      continue;
+    }
+    const float theta = r * static_cast<float>(CV_PI) / 2;
+    const float s     = std::sin(theta);
+    vPoints.push_back(cv::Point2f(c + f * theta * x / r, c + f * theta * y / r));
+    // Bearings need not be unit
+    vBearings.push_back(2.0f * Eigen::Vector3f(s * x / r, s * y / r, std::cos(theta)));
+    vTolerances.push_back(0.005f + 0.02f * (uniform(rng) + 1.0f));
+  }
+
+  BearingCells cells;
+  cells.Assign(vPoints, vBearings, vTolerances, 24);
+
+  std::vector<int> vIndices;
+  for (int q = 0; q < 100; q++) {
+    const Eigen::Vector3f n
+      = Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng)).normalized();
+    const float tolerance = 0.01f * (uniform(rng) + 1.0f);
+
+    std::vector<int> vExpected;
+    for (std::size_t i = 0; i < vBearings.size(); i++) {
+      const float angle = std::asin(std::abs(n.dot(vBearings[i].normalized())));
+      if (angle <= vTolerances[i] + tolerance - 1e-5f) {
+        vExpected.push_back(static_cast<int>(i));
+      }
+    }
+
+    cells.Query(n, tolerance, vIndices);
+    for (const int i : vExpected) {
+      EXPECT_TRUE(std::binary_search(vIndices.begin(), vIndices.end(), i));
+    }
+    for (const int i : vIndices) {
+      const float angle = std::asin(std::abs(n.dot(vBearings[i].normalized())));
+      EXPECT_LE(angle, vTolerances[i] + tolerance + 1e-5f);
+    }
+    EXPECT_TRUE(std::is_sorted(vIndices.begin(), vIndices.end()));
+  }
+}
+
+TEST(StereoMatchingTest, MatchInBandGatesLoneCandidates) {
+  // A lone candidate is only kept when it is close, a wrong one is rejected even though it is far
+  // below the ratio of the largest distance
+  EXPECT_EQ(MatchAtDistances({120}), -1);
+  EXPECT_EQ(MatchAtDistances({60}), -1);
+  EXPECT_EQ(MatchAtDistances({30}), 0);
+  EXPECT_EQ(MatchAtDistances({}), -1);
+
+  // Several candidates go through the ratio test and the absolute distance
+  EXPECT_EQ(MatchAtDistances({30, 80}), 0);
+  EXPECT_EQ(MatchAtDistances({90, 20, 70}), 1);
+  EXPECT_EQ(MatchAtDistances({40, 50}), -1);
+  EXPECT_EQ(MatchAtDistances({110, 250}), -1);
+  EXPECT_EQ(MatchAtDistances({80, 250}), 0);
+}
+
+TEST(StereoMatchingTest, PatchSADSweepFitsKeepsReadsInside) {
+  const int w = 5, L = 5, cols = 60;
+
+  // The leftmost sweep starts at column 0. The bound used to be xR + L - w >= 0, which let the
+  // sweep read L + w columns to the left of the image.
+  EXPECT_FALSE(PatchSADSweepFits(L + w - 1, w, L, cols));
+  EXPECT_TRUE(PatchSADSweepFits(L + w, w, L, cols));
+  EXPECT_FALSE(PatchSADSweepFits(0, w, L, cols));
+
+  // The rightmost sweep stops short of the last column
+  EXPECT_TRUE(PatchSADSweepFits(cols - L - w - 2, w, L, cols));
+  EXPECT_FALSE(PatchSADSweepFits(cols - L - w - 1, w, L, cols));
+
+  for (int xR = -1; xR <= cols; xR++) {
+    if (PatchSADSweepFits(xR, w, L, cols)) {
+      EXPECT_GE(xR - L - w, 0);
+      EXPECT_LT(xR + L + w, cols - 1);
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace ORB_SLAM3;
+
+TEST(ThreadPoolTest, VisitsEveryIndexOnce) {
+  for (const int nThreads : {1, 2, 4}) {
+    ThreadPool pool(nThreads);
+    EXPECT_EQ(pool.NumThreads(), nThreads);
+
+    // Reuse the pool several times to exercise the generation handshake
+    for (int run = 0; run < 50; run++) {
+      std::vector<std::atomic<int>> vCounts(97);
+      pool.ParallelFor(0, static_cast<int>(vCounts.size()), [&](const int i) { vCounts[i]++; });
+      for (const std::atomic<int>& count : vCounts) {
+        ASSERT_EQ(count.load(), 1);
+      }
+    }
+  }
+}
+
+TEST(ThreadPoolTest, EmptyRangeIsNoop) {
+  ThreadPool pool(3);
+  int        nCalls = 0;
+  pool.ParallelFor(5, 5, [&](const int) { nCalls++; });
+  pool.ParallelFor(5, 2, [&](const int) { nCalls++; });
+  EXPECT_EQ(nCalls, 0);
+}
+
+TEST(ThreadPoolTest, SharedByConcurrentCallers) {
+  // The left and right extractors of a stereo frame run on two threads sharing the pool
+  ThreadPool pool(4);
+  const auto Run = [&pool](std::vector<std::atomic<int>>& vCounts) {
+    for (int run = 0; run < 50; run++) {
+      pool.ParallelFor(0, static_cast<int>(vCounts.size()), [&](const int i) { vCounts[i]++; });
+    }
+  };
+  std::vector<std::atomic<int>> vCountsLeft(97), vCountsRight(61);
+  std::thread                   threadLeft(Run, std::ref(vCountsLeft));
+  std::thread                   threadRight(Run, std::ref(vCountsRight));
+  threadLeft.join();
+  threadRight.join();
+  for (const std::atomic<int>& count : vCountsLeft) {
+    EXPECT_EQ(count.load(), 50);
+  }
+  for (const std::atomic<int>& count : vCountsRight) {
+    EXPECT_EQ(count.load(), 50);
+  }
+}
+
+TEST(ThreadPoolTest, NullPoolRunsInOrderOnCaller) {
+  const std::thread::id caller = std::this_thread::get_id();
+  std::vector<int>      vOrder;
+  ParallelFor(nullptr, 2, 7, [&](const int i) {
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+    vOrder.push_back(i);
+  });
+  EXPECT_EQ(vOrder, std::vector<int>({2, 3, 4, 5, 6}));
+}